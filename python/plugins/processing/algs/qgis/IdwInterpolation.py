@@ -29,6 +29,7 @@ from qgis.PyQt.QtGui import QIcon
 from qgis.core import (QgsRectangle,
                        QgsProcessingUtils,
                        QgsProcessingParameterNumber,
+                       QgsProcessingParameterBoolean,
                        QgsProcessingParameterExtent,
                        QgsProcessingParameterDefinition,
                        QgsProcessingParameterRasterDestination,
@@ -46,10 +47,13 @@ pluginPath = os.path.split(os.path.split(os.path.dirname(__file__))[0])[0]
 class IdwInterpolation(QgisAlgorithm):
     INTERPOLATION_DATA = 'INTERPOLATION_DATA'
     DISTANCE_COEFFICIENT = 'DISTANCE_COEFFICIENT'
+    MAX_POINTS = 'MAX_POINTS'
+    SEARCH_RADIUS = 'SEARCH_RADIUS'
     PIXEL_SIZE = 'PIXEL_SIZE'
     COLUMNS = 'COLUMNS'
     ROWS = 'ROWS'
     EXTENT = 'EXTENT'
+    OUTPUT_GEOTIFF = 'OUTPUT_GEOTIFF'
     OUTPUT = 'OUTPUT'
 
     def icon(self):
@@ -71,6 +75,18 @@ class IdwInterpolation(QgisAlgorithm):
         self.addParameter(QgsProcessingParameterNumber(self.DISTANCE_COEFFICIENT,
                                                        self.tr('Distance coefficient P'), type=QgsProcessingParameterNumber.Double,
                                                        minValue=0.0, maxValue=99.99, defaultValue=2.0))
+
+        max_points_param = QgsProcessingParameterNumber(self.MAX_POINTS,
+                                                        self.tr('Maximum number of nearest points (0 = all points)'),
+                                                        minValue=0, defaultValue=0)
+        max_points_param.setFlags(max_points_param.flags() | QgsProcessingParameterDefinition.FlagAdvanced)
+        self.addParameter(max_points_param)
+
+        search_radius_param = QgsProcessingParameterNumber(self.SEARCH_RADIUS,
+                                                           self.tr('Search radius (0 = unlimited)'), type=QgsProcessingParameterNumber.Double,
+                                                           minValue=0.0, defaultValue=0.0)
+        search_radius_param.setFlags(search_radius_param.flags() | QgsProcessingParameterDefinition.FlagAdvanced)
+        self.addParameter(search_radius_param)
         self.addParameter(QgsProcessingParameterExtent(self.EXTENT,
                                                        self.tr('Extent'),
                                                        optional=False))
@@ -96,6 +112,12 @@ class IdwInterpolation(QgisAlgorithm):
         rows_param.setFlags(rows_param.flags() | QgsProcessingParameterDefinition.FlagHidden)
         self.addParameter(rows_param)
 
+        geotiff_param = QgsProcessingParameterBoolean(self.OUTPUT_GEOTIFF,
+                                                      self.tr('Write output as tiled GeoTIFF'),
+                                                      defaultValue=False)
+        geotiff_param.setFlags(geotiff_param.flags() | QgsProcessingParameterDefinition.FlagAdvanced)
+        self.addParameter(geotiff_param)
+
         self.addParameter(QgsProcessingParameterRasterDestination(self.OUTPUT,
                                                                   self.tr('Interpolated')))
 
@@ -108,9 +130,12 @@ class IdwInterpolation(QgisAlgorithm):
     def processAlgorithm(self, parameters, context, feedback):
         interpolationData = ParameterInterpolationData.parseValue(parameters[self.INTERPOLATION_DATA])
         coefficient = self.parameterAsDouble(parameters, self.DISTANCE_COEFFICIENT, context)
+        max_points = self.parameterAsInt(parameters, self.MAX_POINTS, context)
+        search_radius = self.parameterAsDouble(parameters, self.SEARCH_RADIUS, context)
         bbox = self.parameterAsExtent(parameters, self.EXTENT, context)
         pixel_size = self.parameterAsDouble(parameters, self.PIXEL_SIZE, context)
         output = self.parameterAsOutputLayer(parameters, self.OUTPUT, context)
+        write_geotiff = self.parameterAsBoolean(parameters, self.OUTPUT_GEOTIFF, context)
 
         columns = self.parameterAsInt(parameters, self.COLUMNS, context)
         rows = self.parameterAsInt(parameters, self.ROWS, context)
@@ -150,12 +175,16 @@ class IdwInterpolation(QgisAlgorithm):
 
         interpolator = QgsIDWInterpolator(layerData)
         interpolator.setDistanceCoefficient(coefficient)
+        interpolator.setMaximumNeighbors(max_points)
+        interpolator.setSearchRadius(search_radius)
 
         writer = QgsGridFileWriter(interpolator,
                                    output,
                                    bbox,
                                    columns,
                                    rows)
+        if write_geotiff:
+            writer.setOutputFormat(QgsGridFileWriter.GeoTiff)
 
         writer.writeFile(feedback)
         return {self.OUTPUT: output}
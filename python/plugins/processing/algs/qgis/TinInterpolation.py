@@ -30,6 +30,7 @@ from qgis.core import (QgsProcessingUtils,
                        QgsProcessing,
                        QgsProcessingParameterEnum,
                        QgsProcessingParameterNumber,
+                       QgsProcessingParameterBoolean,
                        QgsProcessingParameterExtent,
                        QgsProcessingParameterDefinition,
                        QgsProcessingParameterRasterDestination,
@@ -54,6 +55,7 @@ class TinInterpolation(QgisAlgorithm):
     COLUMNS = 'COLUMNS'
     ROWS = 'ROWS'
     EXTENT = 'EXTENT'
+    OUTPUT_GEOTIFF = 'OUTPUT_GEOTIFF'
     OUTPUT = 'OUTPUT'
     TRIANGULATION = 'TRIANGULATION'
 
@@ -105,6 +107,12 @@ class TinInterpolation(QgisAlgorithm):
         rows_param.setFlags(rows_param.flags() | QgsProcessingParameterDefinition.FlagHidden)
         self.addParameter(rows_param)
 
+        geotiff_param = QgsProcessingParameterBoolean(self.OUTPUT_GEOTIFF,
+                                                      self.tr('Write output as tiled GeoTIFF'),
+                                                      defaultValue=False)
+        geotiff_param.setFlags(geotiff_param.flags() | QgsProcessingParameterDefinition.FlagAdvanced)
+        self.addParameter(geotiff_param)
+
         self.addParameter(QgsProcessingParameterRasterDestination(self.OUTPUT,
                                                                   self.tr('Interpolated')))
 
@@ -127,6 +135,7 @@ class TinInterpolation(QgisAlgorithm):
         bbox = self.parameterAsExtent(parameters, self.EXTENT, context)
         pixel_size = self.parameterAsDouble(parameters, self.PIXEL_SIZE, context)
         output = self.parameterAsOutputLayer(parameters, self.OUTPUT, context)
+        write_geotiff = self.parameterAsBoolean(parameters, self.OUTPUT_GEOTIFF, context)
 
         columns = self.parameterAsInt(parameters, self.COLUMNS, context)
         rows = self.parameterAsInt(parameters, self.ROWS, context)
@@ -184,6 +193,8 @@ class TinInterpolation(QgisAlgorithm):
                                    bbox,
                                    columns,
                                    rows)
+        if write_geotiff:
+            writer.setOutputFormat(QgsGridFileWriter.GeoTiff)
 
         writer.writeFile(feedback)
         return {self.OUTPUT: output, self.TRIANGULATION: triangulation_dest_id}
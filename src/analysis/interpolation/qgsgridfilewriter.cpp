@@ -19,8 +19,22 @@
 #include "qgsinterpolator.h"
 #include "qgsvectorlayer.h"
 #include "qgsfeedback.h"
+#include "qgsogrutils.h"
 #include <QFile>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cpl_string.h>
+#include <gdal.h>
+
+//! Width and height of the blocks of GeoTIFF output
+static const int GEOTIFF_BLOCK_SIZE = 256;
+//! Value stored for cells which could not be interpolated
+static const double NODATA_VALUE = -9999;
 
 QgsGridFileWriter::QgsGridFileWriter( QgsInterpolator *i, const QString &outputPath, const QgsRectangle &extent, int nCols, int nRows )
   : mInterpolator( i )
@@ -33,6 +47,18 @@ QgsGridFileWriter::QgsGridFileWriter( QgsInterpolator *i, const QString &outputP
 {}
 
 int QgsGridFileWriter::writeFile( QgsFeedback *feedback )
+{
+  switch ( mOutputFormat )
+  {
+    case AsciiGrid:
+      return writeAsciiGrid( feedback );
+    case GeoTiff:
+      return writeGeoTiff( feedback );
+  }
+  return 1;
+}
+
+int QgsGridFileWriter::writeAsciiGrid( QgsFeedback *feedback )
 {
   QFile outputFile( mOutputFilePath );
 
@@ -51,37 +77,27 @@ int QgsGridFileWriter::writeFile( QgsFeedback *feedback )
   outStream.setRealNumberPrecision( 8 );
   writeHeader( outStream );
 
-  double currentYValue = mInterpolationExtent.yMaximum() - mCellSizeY / 2.0; //calculate value in the center of the cell
-  double currentXValue;
-  double interpolatedValue;
-
-  for ( int i = 0; i < mNumRows; ++i )
+  const int result = interpolateRows( feedback, [&outStream]( const double * values, const bool * valid, int count )
   {
-    currentXValue = mInterpolationExtent.xMinimum() + mCellSizeX / 2.0; //calculate value in the center of the cell
-    for ( int j = 0; j < mNumColumns; ++j )
+    for ( int j = 0; j < count; ++j )
     {
-      if ( mInterpolator->interpolatePoint( currentXValue, currentYValue, interpolatedValue, feedback ) == 0 )
+      if ( valid[j] )
       {
-        outStream << interpolatedValue << ' ';
+        outStream << values[j] << ' ';
       }
       else
       {
         outStream << "-9999 ";
       }
-      currentXValue += mCellSizeX;
     }
     outStream << endl;
-    currentYValue -= mCellSizeY;
+    return true;
+  } );
 
-    if ( feedback )
-    {
-      if ( feedback->isCanceled() )
-      {
-        outputFile.remove();
-        return 3;
-      }
-      feedback->setProgress( 100.0 * i / static_cast< double >( mNumRows ) );
-    }
+  if ( result != 0 )
+  {
+    outputFile.remove();
+    return result;
   }
 
   // create prj file
@@ -104,6 +120,164 @@ int QgsGridFileWriter::writeFile( QgsFeedback *feedback )
   return 0;
 }
 
+int QgsGridFileWriter::writeGeoTiff( QgsFeedback *feedback )
+{
+  GDALAllRegister();
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  if ( !driver )
+  {
+    return 1;
+  }
+
+  // rows are collected and written one row of tiles at a time, so that each block is only written once
+  char **options = nullptr;
+  options = CSLSetNameValue( options, "TILED", "YES" );
+  options = CSLSetNameValue( options, "BLOCKXSIZE", QByteArray::number( GEOTIFF_BLOCK_SIZE ).constData() );
+  options = CSLSetNameValue( options, "BLOCKYSIZE", QByteArray::number( GEOTIFF_BLOCK_SIZE ).constData() );
+  options = CSLSetNameValue( options, "BIGTIFF", "IF_SAFER" );
+  gdal::dataset_unique_ptr dataset( GDALCreate( driver, mOutputFilePath.toUtf8().constData(), mNumColumns, mNumRows, 1, GDT_Float32, options ) );
+  CSLDestroy( options );
+  if ( !dataset )
+  {
+    return 1;
+  }
+
+  if ( !mInterpolator )
+  {
+    gdal::fast_delete_and_close( dataset, driver, mOutputFilePath );
+    return 2;
+  }
+
+  double geoTransform[6] = { mInterpolationExtent.xMinimum(), mCellSizeX, 0, mInterpolationExtent.yMaximum(), 0, -mCellSizeY };
+  GDALSetGeoTransform( dataset.get(), geoTransform );
+  const QgsFeatureSource *source = mInterpolator->layerData().isEmpty() ? nullptr : mInterpolator->layerData().at( 0 ).source;
+  if ( source )
+    GDALSetProjection( dataset.get(), source->sourceCrs().toWkt().toUtf8().constData() );
+
+  GDALRasterBandH band = GDALGetRasterBand( dataset.get(), 1 );
+  GDALSetRasterNoDataValue( band, NODATA_VALUE );
+
+  const int blockRows = std::min( GEOTIFF_BLOCK_SIZE, std::max( mNumRows, 1 ) );
+  std::vector< float > block( static_cast< std::size_t >( blockRows ) * mNumColumns );
+  int blockStart = 0;
+  int blockRow = 0;
+  const int result = interpolateRows( feedback, [&]( const double * values, const bool * valid, int count )
+  {
+    float *line = block.data() + static_cast< std::size_t >( blockRow ) * count;
+    for ( int j = 0; j < count; ++j )
+      line[j] = valid[j] ? static_cast< float >( values[j] ) : static_cast< float >( NODATA_VALUE );
+
+    if ( ++blockRow == blockRows || blockStart + blockRow == mNumRows )
+    {
+      if ( GDALRasterIO( band, GF_Write, 0, blockStart, count, blockRow, block.data(), count, blockRow, GDT_Float32, 0, 0 ) != CE_None )
+        return false;
+      blockStart += blockRow;
+      blockRow = 0;
+    }
+    return true;
+  } );
+
+  if ( result != 0 )
+  {
+    gdal::fast_delete_and_close( dataset, driver, mOutputFilePath );
+    return result;
+  }
+
+  return 0;
+}
+
+int QgsGridFileWriter::interpolateRows( QgsFeedback *feedback, const std::function< bool( const double *, const bool *, int ) > &writeRow )
+{
+  // interpolators which support it compute batches of rows in parallel, rows are still written in order
+  const int threadCount = QThreadPool::globalInstance()->maxThreadCount();
+  const bool concurrent = mInterpolator->prepareConcurrentInterpolation( feedback ) && threadCount > 1;
+  if ( feedback && feedback->isCanceled() )
+  {
+    return 3;
+  }
+
+  // cell center coordinates, accumulated the same way for every row
+  std::vector< double > xValues( mNumColumns );
+  double currentXValue = mInterpolationExtent.xMinimum() + mCellSizeX / 2.0; //calculate value in the center of the cell
+  for ( int j = 0; j < mNumColumns; ++j )
+  {
+    xValues[j] = currentXValue;
+    currentXValue += mCellSizeX;
+  }
+  std::vector< double > yValues( mNumRows );
+  double currentYValue = mInterpolationExtent.yMaximum() - mCellSizeY / 2.0; //calculate value in the center of the cell
+  for ( int i = 0; i < mNumRows; ++i )
+  {
+    yValues[i] = currentYValue;
+    currentYValue -= mCellSizeY;
+  }
+
+  struct Row
+  {
+    int index;
+    std::vector< double > values;
+    std::unique_ptr< bool[] > valid;
+  };
+
+  const int batchRows = concurrent ? 4 * threadCount : 1;
+  std::vector< Row > batch( std::min( batchRows, std::max( mNumRows, 1 ) ) );
+  for ( Row &row : batch )
+  {
+    row.values.resize( mNumColumns );
+    row.valid.reset( new bool[ std::max( mNumColumns, 1 ) ] );
+  }
+
+  QgsInterpolator *interpolator = mInterpolator;
+  auto interpolateRow = [interpolator, &xValues, &yValues]( Row & row, QgsFeedback * rowFeedback )
+  {
+    const double y = yValues[ row.index ];
+    double interpolatedValue = 0;
+    for ( std::size_t j = 0; j < xValues.size(); ++j )
+    {
+      row.valid[j] = interpolator->interpolatePoint( xValues[j], y, interpolatedValue, rowFeedback ) == 0;
+      row.values[j] = interpolatedValue;
+    }
+  };
+
+  for ( int batchStart = 0; batchStart < mNumRows; batchStart += static_cast< int >( batch.size() ) )
+  {
+    const int batchCount = std::min( static_cast< int >( batch.size() ), mNumRows - batchStart );
+    for ( int k = 0; k < batchCount; ++k )
+      batch[k].index = batchStart + k;
+
+    if ( concurrent )
+    {
+      QtConcurrent::blockingMap( batch.begin(), batch.begin() + batchCount, [&interpolateRow]( Row & row )
+      {
+        interpolateRow( row, nullptr );
+      } );
+    }
+    else
+    {
+      for ( int k = 0; k < batchCount; ++k )
+        interpolateRow( batch[k], feedback );
+    }
+
+    for ( int k = 0; k < batchCount; ++k )
+    {
+      const Row &row = batch[k];
+      if ( !writeRow( row.values.data(), row.valid.get(), mNumColumns ) )
+        return 1;
+
+      if ( feedback )
+      {
+        if ( feedback->isCanceled() )
+        {
+          return 3;
+        }
+        feedback->setProgress( 100.0 * row.index / static_cast< double >( mNumRows ) );
+      }
+    }
+  }
+
+  return 0;
+}
+
 int QgsGridFileWriter::writeHeader( QTextStream &outStream )
 {
   outStream << "NCOLS " << mNumColumns << endl;
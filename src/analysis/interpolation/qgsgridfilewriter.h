@@ -22,20 +22,31 @@
 #include <QString>
 #include <QTextStream>
 #include "qgis_analysis.h"
+#include "qgis_sip.h"
+
+#include <functional>
 
 class QgsInterpolator;
 class QgsFeedback;
 
-//todo: extend such that writing to other file types is possible
-
 /**
  * \ingroup analysis
- * \brief A class that does interpolation to a grid and writes the results to an ascii grid.
+ * \brief A class that does interpolation to a grid and writes the results to an ascii grid or a GeoTIFF file.
 */
 class ANALYSIS_EXPORT QgsGridFileWriter
 {
   public:
 
+    /**
+     * Output file formats.
+     * \since QGIS 3.18
+     */
+    enum OutputFormat
+    {
+      AsciiGrid, //!< ESRI ASCII grid, with the CRS in a separate .prj file
+      GeoTiff, //!< Tiled GeoTIFF, written in blocks through GDAL
+    };
+
     /**
      * Constructor for QgsGridFileWriter, for the specified \a interpolator.
      *
@@ -54,10 +65,39 @@ class ANALYSIS_EXPORT QgsGridFileWriter
     */
     int writeFile( QgsFeedback *feedback = nullptr );
 
+    /**
+     * Sets the output file \a format. The default is an ascii grid.
+     *
+     * Interpolators supporting concurrent interpolation compute the rows in parallel
+     * with either format, GeoTIFF output is considerably faster to write and to read.
+     *
+     * \see outputFormat()
+     * \since QGIS 3.18
+     */
+    void setOutputFormat( OutputFormat format ) { mOutputFormat = format; }
+
+    /**
+     * Returns the output file format.
+     *
+     * \see setOutputFormat()
+     * \since QGIS 3.18
+     */
+    OutputFormat outputFormat() const { return mOutputFormat; }
+
   private:
 
     QgsGridFileWriter() = delete;
 
+    int writeAsciiGrid( QgsFeedback *feedback );
+    int writeGeoTiff( QgsFeedback *feedback );
+
+    /**
+     * Interpolates all rows from top to bottom and passes them in order to \a writeRow, together with
+     * flags telling which cells could be interpolated. Returns 0 in case of success, 1 if \a writeRow
+     * failed or 3 if the operation was canceled.
+     */
+    int interpolateRows( QgsFeedback *feedback, const std::function< bool( const double *values, const bool *valid, int count ) > &writeRow );
+
     int writeHeader( QTextStream &outStream );
 
     QgsInterpolator *mInterpolator = nullptr;
@@ -68,6 +108,8 @@ class ANALYSIS_EXPORT QgsGridFileWriter
 
     double mCellSizeX = 0;
     double mCellSizeY = 0;
+
+    OutputFormat mOutputFormat = AsciiGrid;
 };
 
 #endif
@@ -16,14 +16,49 @@
  ***************************************************************************/
 
 #include "qgsidwinterpolator.h"
+#include "qgsinterpolatorkdtree_p.h"
 #include "qgis.h"
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <vector>
 
 QgsIDWInterpolator::QgsIDWInterpolator( const QList<LayerData> &layerData )
   : QgsInterpolator( layerData )
 {}
 
+QgsIDWInterpolator::~QgsIDWInterpolator() = default;
+
+void QgsIDWInterpolator::setMaximumNeighbors( int count )
+{
+  mMaximumNeighbors = std::max( count, 0 );
+}
+
+void QgsIDWInterpolator::setSearchRadius( double radius )
+{
+  mSearchRadius = std::max( radius, 0.0 );
+}
+
+bool QgsIDWInterpolator::prepareConcurrentInterpolation( QgsFeedback *feedback )
+{
+  if ( !mDataIsCached && cacheBaseData( feedback ) != Success )
+    return false;
+
+  if ( usesNeighbors() )
+    buildIndex();
+
+  return true;
+}
+
+void QgsIDWInterpolator::buildIndex()
+{
+  // interpolatePoint() may be called from several threads, the index is only built by the first one
+  std::call_once( mIndexBuilt, [this]
+  {
+    mIndex.reset( new QgsInterpolatorKDTree( mCachedBaseData ) );
+  } );
+}
+
 int QgsIDWInterpolator::interpolatePoint( double x, double y, double &result, QgsFeedback *feedback )
 {
   if ( !mDataIsCached )
@@ -31,6 +66,48 @@ int QgsIDWInterpolator::interpolatePoint( double x, double y, double &result, Qg
     cacheBaseData( feedback );
   }
 
+  if ( usesNeighbors() )
+  {
+    buildIndex();
+
+    std::vector< QgsInterpolatorKDTree::Neighbor > neighbors;
+    neighbors.reserve( mMaximumNeighbors > 0 ? mMaximumNeighbors : 64 );
+    mIndex->nearest( x, y, mMaximumNeighbors, mSearchRadius, neighbors );
+
+    double sumCounter = 0;
+    double sumDenominator = 0;
+    int coincidentIndex = -1;
+    for ( const QgsInterpolatorKDTree::Neighbor &neighbor : neighbors )
+    {
+      const QgsInterpolatorVertexData &vertex = mCachedBaseData.at( neighbor.index );
+      const double distance = std::sqrt( neighbor.squaredDistance );
+      if ( qgsDoubleNear( distance, 0.0 ) )
+      {
+        // like the unrestricted interpolation, use the first coincident point in data order
+        if ( coincidentIndex < 0 || neighbor.index < coincidentIndex )
+          coincidentIndex = neighbor.index;
+        continue;
+      }
+      const double currentWeight = 1 / ( std::pow( distance, mDistanceCoefficient ) );
+      sumCounter += ( currentWeight * vertex.z );
+      sumDenominator += currentWeight;
+    }
+
+    if ( coincidentIndex >= 0 )
+    {
+      result = mCachedBaseData.at( coincidentIndex ).z;
+      return 0;
+    }
+
+    if ( sumDenominator == 0.0 )
+    {
+      return 1;
+    }
+
+    result = sumCounter / sumDenominator;
+    return 0;
+  }
+
   double sumCounter = 0;
   double sumDenominator = 0;
 
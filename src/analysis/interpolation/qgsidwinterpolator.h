@@ -21,6 +21,11 @@
 #include "qgsinterpolator.h"
 #include "qgis_analysis.h"
 
+#include <memory>
+#include <mutex>
+
+class QgsInterpolatorKDTree;
+
 /**
  * \ingroup analysis
  * \class QgsIDWInterpolator
@@ -35,8 +40,19 @@ class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
      */
     QgsIDWInterpolator( const QList<QgsInterpolator::LayerData> &layerData );
 
+    ~QgsIDWInterpolator() override;
+
     int interpolatePoint( double x, double y, double &result SIP_OUT, QgsFeedback *feedback = nullptr ) override;
 
+    /**
+     * Caches the base data and, if the interpolation is restricted with setMaximumNeighbors()
+     * or setSearchRadius(), builds the spatial index used to find the neighbors of a point.
+     * Returns FALSE if the base data could not be cached.
+     *
+     * \since QGIS 3.18
+     */
+    bool prepareConcurrentInterpolation( QgsFeedback *feedback = nullptr ) override;
+
     /**
      * Sets the distance \a coefficient, the parameter that sets how the values are
      * weighted with distance. Smaller values mean sharper peaks at the data points.
@@ -60,11 +76,70 @@ class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
     */
     double distanceCoefficient() const { return mDistanceCoefficient; }
 
+    /**
+     * Sets the maximum \a count of nearest points used to interpolate each value.
+     *
+     * The nearest points are found with a spatial index, so restricting the number of
+     * neighbors makes interpolation of large point sets considerably faster. A count
+     * less than or equal to 0 uses all points.
+     *
+     * \see maximumNeighbors()
+     * \see setSearchRadius()
+     * \since QGIS 3.18
+     */
+    void setMaximumNeighbors( int count );
+
+    /**
+     * Returns the maximum count of nearest points used to interpolate each value.
+     * The default of 0 uses all points.
+     *
+     * \see setMaximumNeighbors()
+     * \since QGIS 3.18
+     */
+    int maximumNeighbors() const { return mMaximumNeighbors; }
+
+    /**
+     * Sets the search \a radius (in map units) around each interpolated location. Only points
+     * within this distance are used to interpolate the value, and locations without any points
+     * in range are not interpolated. A radius less than or equal to 0 uses all points.
+     *
+     * \see searchRadius()
+     * \see setMaximumNeighbors()
+     * \since QGIS 3.18
+     */
+    void setSearchRadius( double radius );
+
+    /**
+     * Returns the search radius (in map units) around each interpolated location.
+     * The default of 0 uses all points.
+     *
+     * \see setSearchRadius()
+     * \since QGIS 3.18
+     */
+    double searchRadius() const { return mSearchRadius; }
+
   private:
 
     QgsIDWInterpolator() = delete;
+    QgsIDWInterpolator( const QgsIDWInterpolator &rh ) = delete;
+    QgsIDWInterpolator &operator=( const QgsIDWInterpolator &rh ) = delete;
+
+#ifdef SIP_RUN
+    QgsIDWInterpolator( const QgsIDWInterpolator &rh );
+#endif
+
+    //! Returns TRUE if the interpolation only uses the neighbors of each point
+    bool usesNeighbors() const { return mMaximumNeighbors > 0 || mSearchRadius > 0; }
+
+    //! Builds the spatial index of the cached base data, once
+    void buildIndex();
 
     double mDistanceCoefficient = 2.0;
+    int mMaximumNeighbors = 0;
+    double mSearchRadius = 0;
+
+    std::unique_ptr< QgsInterpolatorKDTree > mIndex;
+    std::once_flag mIndexBuilt;
 };
 
 #endif
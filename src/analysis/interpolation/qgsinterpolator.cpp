@@ -28,6 +28,11 @@ QgsInterpolator::QgsInterpolator( const QList<LayerData> &layerData )
 
 }
 
+bool QgsInterpolator::prepareConcurrentInterpolation( QgsFeedback * )
+{
+  return false;
+}
+
 QgsInterpolator::Result QgsInterpolator::cacheBaseData( QgsFeedback *feedback )
 {
   if ( mLayerData.empty() )
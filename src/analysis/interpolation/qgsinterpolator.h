@@ -128,6 +128,21 @@ class ANALYSIS_EXPORT QgsInterpolator
      */
     virtual int interpolatePoint( double x, double y, double &result SIP_OUT, QgsFeedback *feedback = nullptr ) = 0;
 
+    /**
+     * Prepares the interpolator for calls to interpolatePoint() from multiple threads at once,
+     * e.g. by caching the base data and building any search structures up front.
+     *
+     * An optional \a feedback argument may be specified to allow cancellation and
+     * progress reports while the data is prepared.
+     *
+     * Returns TRUE if interpolatePoint() may be called concurrently after a successful
+     * preparation. The default implementation returns FALSE, in which case points must
+     * be interpolated from a single thread.
+     *
+     * \since QGIS 3.18
+     */
+    virtual bool prepareConcurrentInterpolation( QgsFeedback *feedback = nullptr );
+
     //! \note not available in Python bindings
     QList<LayerData> layerData() const { return mLayerData; } SIP_SKIP
 
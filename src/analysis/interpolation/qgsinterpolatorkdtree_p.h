@@ -0,0 +1,185 @@
+/***************************************************************************
+  qgsinterpolatorkdtree_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSINTERPOLATORKDTREE_PRIVATE_H
+#define QGSINTERPOLATORKDTREE_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgsinterpolator.h"
+#include "kdbush.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * \ingroup analysis
+ * \brief Item of a QgsInterpolatorKDTree: a vertex position and its index in the cached interpolator data.
+ * \since QGIS 3.18
+ */
+struct QgsInterpolatorKDTreeData
+{
+  QgsInterpolatorKDTreeData( double x, double y, int index )
+    : coords( std::make_pair( x, y ) )
+    , index( index )
+  {}
+
+  std::pair< double, double > coords;
+  int index;
+};
+
+/**
+ * \ingroup analysis
+ * \brief Static KD-tree over interpolator vertices, supporting k-nearest neighbor and radius searches.
+ *
+ * Queries do not modify the tree and can run concurrently.
+ *
+ * \since QGIS 3.18
+ */
+class QgsInterpolatorKDTree : public kdbush::KDBush< std::pair< double, double >, QgsInterpolatorKDTreeData, std::size_t >
+{
+  public:
+
+    //! A vertex found by a query, with its squared distance to the query point
+    struct Neighbor
+    {
+      double squaredDistance;
+      int index;
+
+      bool operator<( const Neighbor &other ) const
+      {
+        return squaredDistance < other.squaredDistance || ( squaredDistance == other.squaredDistance && index < other.index );
+      }
+    };
+
+    explicit QgsInterpolatorKDTree( const QVector< QgsInterpolatorVertexData > &vertices )
+    {
+      points.reserve( vertices.size() );
+      for ( int i = 0; i < vertices.size(); ++i )
+        points.emplace_back( QgsInterpolatorKDTreeData( vertices.at( i ).x, vertices.at( i ).y, i ) );
+
+      if ( !points.empty() )
+        sortKD( 0, points.size() - 1, 0 );
+    }
+
+    /**
+     * Collects the vertices closest to the point (\a x, \a y) into \a neighbors.
+     *
+     * At most \a maxCount vertices are returned, or all of them if \a maxCount is not positive.
+     * Only vertices within \a maxDistance are considered, unless \a maxDistance is not positive.
+     * The neighbors are not sorted.
+     */
+    void nearest( double x, double y, int maxCount, double maxDistance, std::vector< Neighbor > &neighbors ) const
+    {
+      neighbors.clear();
+      if ( points.empty() )
+        return;
+
+      if ( maxCount <= 0 )
+      {
+        if ( maxDistance <= 0 )
+        {
+          for ( const QgsInterpolatorKDTreeData &point : points )
+            neighbors.push_back( Neighbor{ squaredDistance( point, x, y ), point.index } );
+        }
+        else
+        {
+          within( x, y, maxDistance, [&neighbors, x, y]( const QgsInterpolatorKDTreeData & point )
+          {
+            neighbors.push_back( Neighbor{ squaredDistance( point, x, y ), point.index } );
+          } );
+        }
+        return;
+      }
+
+      // neighbors is kept as a max-heap of the best candidates found so far
+      const double maxSquaredDistance = maxDistance > 0 ? maxDistance * maxDistance : std::numeric_limits< double >::infinity();
+      nearest( x, y, static_cast< std::size_t >( maxCount ), maxSquaredDistance, neighbors, 0, points.size() - 1, 0 );
+    }
+
+  private:
+
+    static double squaredDistance( const QgsInterpolatorKDTreeData &point, double x, double y )
+    {
+      const double dx = point.coords.first - x;
+      const double dy = point.coords.second - y;
+      return dx * dx + dy * dy;
+    }
+
+    void offer( const QgsInterpolatorKDTreeData &point, double x, double y, std::size_t maxCount, double maxSquaredDistance, std::vector< Neighbor > &neighbors ) const
+    {
+      const Neighbor candidate{ squaredDistance( point, x, y ), point.index };
+      if ( candidate.squaredDistance > maxSquaredDistance )
+        return;
+
+      if ( neighbors.size() < maxCount )
+      {
+        neighbors.push_back( candidate );
+        std::push_heap( neighbors.begin(), neighbors.end() );
+      }
+      else if ( candidate < neighbors.front() )
+      {
+        std::pop_heap( neighbors.begin(), neighbors.end() );
+        neighbors.back() = candidate;
+        std::push_heap( neighbors.begin(), neighbors.end() );
+      }
+    }
+
+    void nearest( double x, double y, std::size_t maxCount, double maxSquaredDistance, std::vector< Neighbor > &neighbors,
+                  std::size_t left, std::size_t right, std::uint8_t axis ) const
+    {
+      if ( right - left <= nodeSize )
+      {
+        for ( std::size_t i = left; i <= right; ++i )
+          offer( points[i], x, y, maxCount, maxSquaredDistance, neighbors );
+        return;
+      }
+
+      const std::size_t m = ( left + right ) >> 1;
+      offer( points[m], x, y, maxCount, maxSquaredDistance, neighbors );
+
+      // visit the half containing the query point first, then the other one if it can still hold closer vertices
+      const double delta = axis == 0 ? x - points[m].coords.first : y - points[m].coords.second;
+      const std::uint8_t nextAxis = ( axis + 1 ) % 2;
+      if ( delta < 0 )
+        nearest( x, y, maxCount, maxSquaredDistance, neighbors, left, m - 1, nextAxis );
+      else
+        nearest( x, y, maxCount, maxSquaredDistance, neighbors, m + 1, right, nextAxis );
+
+      const double bound = neighbors.size() < maxCount ? maxSquaredDistance : neighbors.front().squaredDistance;
+      if ( delta * delta <= bound )
+      {
+        if ( delta < 0 )
+          nearest( x, y, maxCount, maxSquaredDistance, neighbors, m + 1, right, nextAxis );
+        else
+          nearest( x, y, maxCount, maxSquaredDistance, neighbors, left, m - 1, nextAxis );
+      }
+    }
+};
+
+/// @endcond
+
+#endif // QGSINTERPOLATORKDTREE_PRIVATE_H
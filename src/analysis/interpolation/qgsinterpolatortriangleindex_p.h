@@ -0,0 +1,217 @@
+/***************************************************************************
+  qgsinterpolatortriangleindex_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSINTERPOLATORTRIANGLEINDEX_PRIVATE_H
+#define QGSINTERPOLATORTRIANGLEINDEX_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgsmeshdataprovider.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+ * \ingroup analysis
+ * \brief Read-only grid index over the triangles of a triangulation, for linear interpolation.
+ *
+ * Triangles are stored in the cells of a regular grid covered by their bounding box, so a
+ * point only has to be tested against the triangles of one cell. Unlike the triangulation,
+ * which walks from the last triangle it found, queries do not modify the index and can run
+ * concurrently.
+ *
+ * \since QGIS 3.18
+ */
+class QgsInterpolatorTriangleIndex
+{
+  public:
+
+    /**
+     * Indexes the triangular faces of \a mesh. Faces which are not triangles are ignored.
+     */
+    explicit QgsInterpolatorTriangleIndex( const QgsMesh &mesh )
+    {
+      mVertices.reserve( mesh.vertices.size() * 3 );
+      for ( const QgsMeshVertex &vertex : mesh.vertices )
+      {
+        mVertices.push_back( vertex.x() );
+        mVertices.push_back( vertex.y() );
+        mVertices.push_back( vertex.z() );
+      }
+
+      double xMin = std::numeric_limits< double >::max();
+      double yMin = std::numeric_limits< double >::max();
+      double xMax = std::numeric_limits< double >::lowest();
+      double yMax = std::numeric_limits< double >::lowest();
+      for ( const QgsMeshFace &face : mesh.faces )
+      {
+        if ( face.size() != 3 )
+          continue;
+
+        // degenerate triangles cannot be interpolated, their neighbors cover their points
+        const QgsMeshVertex &p1 = mesh.vertices.at( face.at( 0 ) );
+        const QgsMeshVertex &p2 = mesh.vertices.at( face.at( 1 ) );
+        const QgsMeshVertex &p3 = mesh.vertices.at( face.at( 2 ) );
+        if ( qgsDoubleNear( ( p2.x() - p1.x() ) * ( p3.y() - p1.y() ) - ( p2.y() - p1.y() ) * ( p3.x() - p1.x() ), 0.0, 0.0 ) )
+          continue;
+
+        for ( int vertex : face )
+        {
+          mTriangles.push_back( vertex );
+          xMin = std::min( xMin, x( vertex ) );
+          xMax = std::max( xMax, x( vertex ) );
+          yMin = std::min( yMin, y( vertex ) );
+          yMax = std::max( yMax, y( vertex ) );
+        }
+      }
+
+      const int triangleCount = static_cast< int >( mTriangles.size() / 3 );
+      if ( triangleCount == 0 )
+        return;
+
+      // about one triangle per cell
+      const double width = std::max( xMax - xMin, std::numeric_limits< double >::min() );
+      const double height = std::max( yMax - yMin, std::numeric_limits< double >::min() );
+      mCellSize = std::max( std::sqrt( width * height / triangleCount ), std::max( width, height ) / 4096 );
+      mXMin = xMin;
+      mYMin = yMin;
+      mColumns = static_cast< int >( width / mCellSize ) + 1;
+      mRows = static_cast< int >( height / mCellSize ) + 1;
+
+      // triangles by cell, counted first to lay them out contiguously
+      mCellOffsets.assign( static_cast< std::size_t >( mColumns ) * mRows + 1, 0 );
+      for ( int pass = 0; pass < 2; ++pass )
+      {
+        std::vector< int > next;
+        if ( pass == 1 )
+        {
+          for ( std::size_t i = 1; i < mCellOffsets.size(); ++i )
+            mCellOffsets[ i ] += mCellOffsets[ i - 1 ];
+          mCellTriangles.resize( mCellOffsets.back() );
+          next.assign( mCellOffsets.begin(), mCellOffsets.end() - 1 );
+        }
+
+        for ( int triangle = 0; triangle < triangleCount; ++triangle )
+        {
+          const int *vertices = mTriangles.data() + 3 * triangle;
+          const int column0 = column( std::min( { x( vertices[0] ), x( vertices[1] ), x( vertices[2] ) } ) );
+          const int column1 = column( std::max( { x( vertices[0] ), x( vertices[1] ), x( vertices[2] ) } ) );
+          const int row0 = row( std::min( { y( vertices[0] ), y( vertices[1] ), y( vertices[2] ) } ) );
+          const int row1 = row( std::max( { y( vertices[0] ), y( vertices[1] ), y( vertices[2] ) } ) );
+          for ( int r = row0; r <= row1; ++r )
+          {
+            for ( int c = column0; c <= column1; ++c )
+            {
+              const std::size_t cell = static_cast< std::size_t >( r ) * mColumns + c;
+              if ( pass == 0 )
+                mCellOffsets[ cell + 1 ]++;
+              else
+                mCellTriangles[ next[ cell ]++ ] = triangle;
+            }
+          }
+        }
+      }
+    }
+
+    /**
+     * Interpolates the value at \a px, \a py linearly in the triangle containing the point,
+     * as LinTriangleInterpolator does. Returns FALSE if the point is outside the triangulation.
+     */
+    bool interpolate( double px, double py, double &result ) const
+    {
+      if ( mCellOffsets.empty() )
+        return false;
+
+      const int c = static_cast< int >( std::floor( ( px - mXMin ) / mCellSize ) );
+      const int r = static_cast< int >( std::floor( ( py - mYMin ) / mCellSize ) );
+      if ( c < 0 || c >= mColumns || r < 0 || r >= mRows )
+        return false;
+
+      const std::size_t cell = static_cast< std::size_t >( r ) * mColumns + c;
+      for ( int i = mCellOffsets[ cell ]; i < mCellOffsets[ cell + 1 ]; ++i )
+      {
+        const int *vertices = mTriangles.data() + 3 * mCellTriangles[ i ];
+        if ( !contains( vertices, px, py ) )
+          continue;
+
+        const double x1 = x( vertices[0] ), y1 = y( vertices[0] ), z1 = z( vertices[0] );
+        const double x2 = x( vertices[1] ), y2 = y( vertices[1] ), z2 = z( vertices[1] );
+        const double x3 = x( vertices[2] ), y3 = y( vertices[2] ), z3 = z( vertices[2] );
+        const double a = ( z1 * ( y2 - y3 ) + z2 * ( y3 - y1 ) + z3 * ( y1 - y2 ) ) / ( ( x1 - x2 ) * ( y2 - y3 ) - ( x2 - x3 ) * ( y1 - y2 ) );
+        const double b = ( z1 * ( x2 - x3 ) + z2 * ( x3 - x1 ) + z3 * ( x1 - x2 ) ) / ( ( y1 - y2 ) * ( x2 - x3 ) - ( y2 - y3 ) * ( x1 - x2 ) );
+        const double constant = z1 - a * x1 - b * y1;
+        result = a * px + b * py + constant;
+        return true;
+      }
+      return false;
+    }
+
+  private:
+
+    double x( int vertex ) const { return mVertices[ 3 * static_cast< std::size_t >( vertex ) ]; }
+    double y( int vertex ) const { return mVertices[ 3 * static_cast< std::size_t >( vertex ) + 1 ]; }
+    double z( int vertex ) const { return mVertices[ 3 * static_cast< std::size_t >( vertex ) + 2 ]; }
+
+    int column( double value ) const { return std::min( static_cast< int >( ( value - mXMin ) / mCellSize ), mColumns - 1 ); }
+    int row( double value ) const { return std::min( static_cast< int >( ( value - mYMin ) / mCellSize ), mRows - 1 ); }
+
+    //! Returns TRUE if the point is inside the triangle or on its boundary, whatever its orientation
+    bool contains( const int *vertices, double px, double py ) const
+    {
+      const double x1 = x( vertices[0] ), y1 = y( vertices[0] );
+      const double x2 = x( vertices[1] ), y2 = y( vertices[1] );
+      const double x3 = x( vertices[2] ), y3 = y( vertices[2] );
+      const double d1 = ( x2 - x1 ) * ( py - y1 ) - ( y2 - y1 ) * ( px - x1 );
+      const double d2 = ( x3 - x2 ) * ( py - y2 ) - ( y3 - y2 ) * ( px - x2 );
+      const double d3 = ( x1 - x3 ) * ( py - y3 ) - ( y1 - y3 ) * ( px - x3 );
+
+      // points on an edge are accepted from both triangles, the interpolated values agree there
+      const double area = std::fabs( ( x2 - x1 ) * ( y3 - y1 ) - ( y2 - y1 ) * ( x3 - x1 ) );
+      const double tolerance = area * 1e-12;
+      const bool hasNegative = d1 < -tolerance || d2 < -tolerance || d3 < -tolerance;
+      const bool hasPositive = d1 > tolerance || d2 > tolerance || d3 > tolerance;
+      return !( hasNegative && hasPositive );
+    }
+
+    //! x, y and z of each vertex
+    std::vector< double > mVertices;
+    //! Vertex indices of each triangle
+    std::vector< int > mTriangles;
+
+    double mXMin = 0;
+    double mYMin = 0;
+    double mCellSize = 1;
+    int mColumns = 0;
+    int mRows = 0;
+    //! Triangles of cell i are mCellTriangles[mCellOffsets[i]] to mCellTriangles[mCellOffsets[i + 1] - 1]
+    std::vector< int > mCellOffsets;
+    std::vector< int > mCellTriangles;
+};
+
+/// @endcond
+
+#endif // QGSINTERPOLATORTRIANGLEINDEX_PRIVATE_H
@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgstininterpolator.h"
+#include "qgsinterpolatortriangleindex_p.h"
 #include "qgsfeatureiterator.h"
 #include "CloughTocherInterpolator.h"
 #include "qgsdualedgetriangulation.h"
@@ -46,8 +47,33 @@ QgsTinInterpolator::~QgsTinInterpolator()
   delete mTriangleInterpolator;
 }
 
+bool QgsTinInterpolator::prepareConcurrentInterpolation( QgsFeedback * )
+{
+  // the Clough-Tocher interpolator caches the patch of the last triangle it used
+  if ( mInterpolation == CloughTocher )
+    return false;
+
+  if ( !mIsInitialized )
+  {
+    initialize();
+  }
+
+  if ( !mTriangleInterpolator )
+    return false;
+
+  // the triangulation moves its start edge on each search, the index is only read
+  if ( !mTriangleIndex )
+    mTriangleIndex = qgis::make_unique< QgsInterpolatorTriangleIndex >( mTriangulation->triangulationToMesh() );
+  return true;
+}
+
 int QgsTinInterpolator::interpolatePoint( double x, double y, double &result, QgsFeedback * )
 {
+  if ( mTriangleIndex )
+  {
+    return mTriangleIndex->interpolate( x, y, result ) ? 0 : 2;
+  }
+
   if ( !mIsInitialized )
   {
     initialize();
@@ -22,12 +22,15 @@
 #include <QString>
 #include "qgis_analysis.h"
 
+#include <memory>
+
 class QgsFeatureSink;
 class QgsTriangulation;
 class TriangleInterpolator;
 class QgsFeature;
 class QgsFeedback;
 class QgsFields;
+class QgsInterpolatorTriangleIndex;
 
 /**
  * \ingroup analysis
@@ -55,6 +58,17 @@ class ANALYSIS_EXPORT QgsTinInterpolator: public QgsInterpolator
 
     int interpolatePoint( double x, double y, double &result SIP_OUT, QgsFeedback *feedback ) override;
 
+    /**
+     * Builds the triangulation and, for linear interpolation, a read-only index of its
+     * triangles which interpolatePoint() then searches instead of walking the triangulation.
+     *
+     * Returns FALSE for Clough-Tocher interpolation, which keeps the control points of the
+     * last triangle in the interpolator and so has to interpolate points from a single thread.
+     *
+     * \since QGIS 3.18
+     */
+    bool prepareConcurrentInterpolation( QgsFeedback *feedback = nullptr ) override;
+
     /**
      * Returns the fields output by features when saving the triangulation.
      * These fields should be used when creating
@@ -78,6 +92,8 @@ class ANALYSIS_EXPORT QgsTinInterpolator: public QgsInterpolator
   private:
     QgsTriangulation *mTriangulation = nullptr;
     TriangleInterpolator *mTriangleInterpolator = nullptr;
+    //! Triangles of a linear triangulation, for concurrent interpolation
+    std::unique_ptr< QgsInterpolatorTriangleIndex > mTriangleIndex;
     bool mIsInitialized;
     QgsFeedback *mFeedback = nullptr;
 
@@ -0,0 +1,148 @@
+/***************************************************************************
+  qgscompactgraph.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgscompactgraph.h"
+#include "qgsgraph.h"
+
+#include <algorithm>
+
+///@cond PRIVATE
+
+/**
+ * Groups edge indices by vertex using a counting sort, keeping edges of the same vertex in index order.
+ */
+static void buildRanges( const QVector< int > &edgeVertices, int vertexCount, QVector< int > &offsets, QVector< int > &edges )
+{
+  offsets.fill( 0, vertexCount + 1 );
+  for ( int vertex : edgeVertices )
+    offsets[ vertex + 1 ]++;
+  for ( int i = 0; i < vertexCount; ++i )
+    offsets[ i + 1 ] += offsets[ i ];
+
+  edges.resize( edgeVertices.size() );
+  QVector< int > next = offsets;
+  for ( int i = 0; i < edgeVertices.size(); ++i )
+    edges[ next[ edgeVertices.at( i ) ]++ ] = i;
+}
+
+///@endcond
+
+QgsCompactGraph::QgsCompactGraph( const QgsGraph *graph )
+{
+  const int vertexCount = graph->vertexCount();
+  mX.reserve( vertexCount );
+  mY.reserve( vertexCount );
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    const QgsPointXY point = graph->vertex( i ).point();
+    mX << point.x();
+    mY << point.y();
+  }
+
+  const int edgeCount = graph->edgeCount();
+  int strategyCount = 0;
+  for ( int i = 0; i < edgeCount; ++i )
+    strategyCount = std::max( strategyCount, graph->edge( i ).strategies().size() );
+
+  mEdgeFrom.reserve( edgeCount );
+  mEdgeTo.reserve( edgeCount );
+  mCosts.fill( QVector< double >( edgeCount, 0 ), strategyCount );
+  for ( int i = 0; i < edgeCount; ++i )
+  {
+    const QgsGraphEdge &edge = graph->edge( i );
+    mEdgeFrom << edge.fromVertex();
+    mEdgeTo << edge.toVertex();
+
+    const QVector< QVariant > strategies = edge.strategies();
+    for ( int j = 0; j < strategies.size(); ++j )
+      mCosts[ j ][ i ] = strategies.at( j ).toDouble();
+  }
+
+  buildEdgeRanges();
+}
+
+int QgsCompactGraph::findVertex( const QgsPointXY &point ) const
+{
+  const double x = point.x();
+  const double y = point.y();
+  const int count = mX.size();
+  const double *xData = mX.constData();
+  const double *yData = mY.constData();
+  for ( int i = 0; i < count; ++i )
+  {
+    // same comparison as QgsPointXY::operator==
+    if ( qgsDoubleNear( xData[ i ], x, 1E-8 ) && qgsDoubleNear( yData[ i ], y, 1E-8 ) )
+      return i;
+  }
+  return -1;
+}
+
+QgsGraph *QgsCompactGraph::toGraph() const
+{
+  QgsGraph *graph = new QgsGraph();
+  for ( int i = 0; i < mX.size(); ++i )
+    graph->addVertex( QgsPointXY( mX.at( i ), mY.at( i ) ) );
+
+  QVector< QVariant > strategies( mCosts.size() );
+  for ( int i = 0; i < mEdgeFrom.size(); ++i )
+  {
+    for ( int j = 0; j < mCosts.size(); ++j )
+      strategies[ j ] = mCosts.at( j ).at( i );
+    graph->addEdge( mEdgeFrom.at( i ), mEdgeTo.at( i ), strategies );
+  }
+  return graph;
+}
+
+void QgsCompactGraph::buildEdgeRanges()
+{
+  buildRanges( mEdgeFrom, mX.size(), mOutOffsets, mOutEdges );
+  buildRanges( mEdgeTo, mX.size(), mInOffsets, mInEdges );
+}
+
+//
+// QgsCompactGraphBuilder
+//
+
+QgsCompactGraphBuilder::QgsCompactGraphBuilder( const QgsCoordinateReferenceSystem &crs, bool otfEnabled, double topologyTolerance, const QString &ellipsoidID )
+  : QgsGraphBuilderInterface( crs, otfEnabled, topologyTolerance, ellipsoidID )
+{
+}
+
+void QgsCompactGraphBuilder::addVertex( int, const QgsPointXY &pt )
+{
+  mGraph.mX << pt.x();
+  mGraph.mY << pt.y();
+}
+
+void QgsCompactGraphBuilder::addEdge( int pt1id, const QgsPointXY &, int pt2id, const QgsPointXY &, const QVector< QVariant > &prop )
+{
+  const int edgeIdx = mGraph.mEdgeFrom.size();
+  mGraph.mEdgeFrom << pt1id;
+  mGraph.mEdgeTo << pt2id;
+
+  // strategies missing from earlier edges are stored as 0
+  while ( mGraph.mCosts.size() < prop.size() )
+    mGraph.mCosts << QVector< double >( edgeIdx, 0 );
+
+  for ( int i = 0; i < mGraph.mCosts.size(); ++i )
+    mGraph.mCosts[ i ] << ( i < prop.size() ? prop.at( i ).toDouble() : 0.0 );
+}
+
+QgsCompactGraph *QgsCompactGraphBuilder::graph()
+{
+  QgsCompactGraph *graph = new QgsCompactGraph( std::move( mGraph ) );
+  graph->buildEdgeRanges();
+  mGraph = QgsCompactGraph();
+  return graph;
+}
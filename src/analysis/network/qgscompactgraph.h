@@ -0,0 +1,208 @@
+/***************************************************************************
+  qgscompactgraph.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSCOMPACTGRAPH_H
+#define QGSCOMPACTGRAPH_H
+
+#include <QVector>
+
+#include "qgis_sip.h"
+#include "qgis_analysis.h"
+#include "qgspointxy.h"
+#include "qgsgraphbuilderinterface.h"
+
+class QgsGraph;
+
+/**
+ * \ingroup analysis
+ * \class QgsCompactGraph
+ * \brief Immutable graph stored in compressed sparse row form.
+ *
+ * Unlike QgsGraph, which keeps an object per vertex and edge along with a list of
+ * QVariant costs per edge, QgsCompactGraph stores vertex coordinates, edge end points
+ * and edge costs in flat arrays, with one array of double costs per strategy. The
+ * outgoing and incoming edges of a vertex are contiguous ranges of an edge index array.
+ * This needs roughly an order of magnitude less memory than QgsGraph for large networks
+ * and makes traversal cache friendly.
+ *
+ * Vertex and edge indices match the ones of a QgsGraph built from the same director,
+ * so results can be used interchangeably.
+ *
+ * Compact graphs are created with QgsCompactGraphBuilder or converted from a QgsGraph.
+ * Copies are cheap as the arrays are implicitly shared.
+ *
+ * \since QGIS 3.18
+ */
+class ANALYSIS_EXPORT QgsCompactGraph
+{
+  public:
+
+    /**
+     * Constructor for an empty QgsCompactGraph.
+     */
+    QgsCompactGraph() = default;
+
+    /**
+     * Constructor for QgsCompactGraph, copying the vertices, edges and costs of \a graph.
+     *
+     * Costs which cannot be converted to a number are stored as 0.
+     */
+    explicit QgsCompactGraph( const QgsGraph *graph );
+
+    /**
+     * Returns the number of vertices in the graph.
+     */
+    int vertexCount() const { return mX.size(); }
+
+    /**
+     * Returns the number of edges in the graph.
+     */
+    int edgeCount() const { return mEdgeFrom.size(); }
+
+    /**
+     * Returns the number of cost strategies stored for each edge.
+     */
+    int strategyCount() const { return mCosts.size(); }
+
+    /**
+     * Returns the point associated with the vertex at \a vertexIdx.
+     */
+    QgsPointXY vertexPoint( int vertexIdx ) const { return QgsPointXY( mX.at( vertexIdx ), mY.at( vertexIdx ) ); }
+
+    /**
+     * Finds the vertex located at \a point.
+     * Returns the vertex index, or -1 if no vertex matches.
+     */
+    int findVertex( const QgsPointXY &point ) const;
+
+    /**
+     * Returns the index of the vertex at the start of the edge at \a edgeIdx.
+     * \see edgeToVertex()
+     */
+    int edgeFromVertex( int edgeIdx ) const { return mEdgeFrom.at( edgeIdx ); }
+
+    /**
+     * Returns the index of the vertex at the end of the edge at \a edgeIdx.
+     * \see edgeFromVertex()
+     */
+    int edgeToVertex( int edgeIdx ) const { return mEdgeTo.at( edgeIdx ); }
+
+    /**
+     * Returns the cost of the edge at \a edgeIdx for the specified \a strategyIndex.
+     */
+    double edgeCost( int edgeIdx, int strategyIndex ) const { return mCosts.at( strategyIndex ).at( edgeIdx ); }
+
+    /**
+     * Returns the costs of all edges for the specified \a strategyIndex, indexed by edge.
+     */
+    QVector< double > strategyCosts( int strategyIndex ) const { return mCosts.value( strategyIndex ); }
+
+    /**
+     * Returns the number of edges leaving the vertex at \a vertexIdx.
+     * \see outgoingEdge()
+     */
+    int outgoingEdgeCount( int vertexIdx ) const { return mOutOffsets.at( vertexIdx + 1 ) - mOutOffsets.at( vertexIdx ); }
+
+    /**
+     * Returns the index of the \a i-th edge leaving the vertex at \a vertexIdx.
+     * \see outgoingEdgeCount()
+     */
+    int outgoingEdge( int vertexIdx, int i ) const { return mOutEdges.at( mOutOffsets.at( vertexIdx ) + i ); }
+
+    /**
+     * Returns the indices of the edges leaving the vertex at \a vertexIdx.
+     * \see incomingEdges()
+     */
+    QVector< int > outgoingEdges( int vertexIdx ) const { return mOutEdges.mid( mOutOffsets.at( vertexIdx ), outgoingEdgeCount( vertexIdx ) ); }
+
+    /**
+     * Returns the number of edges entering the vertex at \a vertexIdx.
+     * \see incomingEdge()
+     */
+    int incomingEdgeCount( int vertexIdx ) const { return mInOffsets.at( vertexIdx + 1 ) - mInOffsets.at( vertexIdx ); }
+
+    /**
+     * Returns the index of the \a i-th edge entering the vertex at \a vertexIdx.
+     * \see incomingEdgeCount()
+     */
+    int incomingEdge( int vertexIdx, int i ) const { return mInEdges.at( mInOffsets.at( vertexIdx ) + i ); }
+
+    /**
+     * Returns the indices of the edges entering the vertex at \a vertexIdx.
+     * \see outgoingEdges()
+     */
+    QVector< int > incomingEdges( int vertexIdx ) const { return mInEdges.mid( mInOffsets.at( vertexIdx ), incomingEdgeCount( vertexIdx ) ); }
+
+    /**
+     * Converts the compact graph to a QgsGraph, keeping vertex and edge indices.
+     */
+    QgsGraph *toGraph() const SIP_FACTORY;
+
+  private:
+
+    void buildEdgeRanges();
+
+    QVector< double > mX;
+    QVector< double > mY;
+    QVector< int > mEdgeFrom;
+    QVector< int > mEdgeTo;
+    QVector< QVector< double > > mCosts;
+
+    QVector< int > mOutOffsets;
+    QVector< int > mOutEdges;
+    QVector< int > mInOffsets;
+    QVector< int > mInEdges;
+
+    friend class QgsCompactGraphBuilder;
+    friend class QgsGraphRouter;
+};
+
+/**
+ * \ingroup analysis
+ * \class QgsCompactGraphBuilder
+ * \brief Graph builder creating a QgsCompactGraph, for use with a QgsGraphDirector
+ * such as QgsVectorLayerDirector.
+ *
+ * Edges are only collected while the director runs, the compressed layout is
+ * created once by graph().
+ *
+ * \since QGIS 3.18
+ */
+class ANALYSIS_EXPORT QgsCompactGraphBuilder : public QgsGraphBuilderInterface SIP_NODEFAULTCTORS
+{
+  public:
+
+    /**
+     * Constructor for QgsCompactGraphBuilder. See QgsGraphBuilderInterface for a description of the arguments.
+     */
+    QgsCompactGraphBuilder( const QgsCoordinateReferenceSystem &crs, bool otfEnabled = true, double topologyTolerance = 0.0, const QString &ellipsoidID = "WGS84" );
+
+    void addVertex( int id, const QgsPointXY &pt ) override;
+
+    void addEdge( int pt1id, const QgsPointXY &pt1, int pt2id, const QgsPointXY &pt2, const QVector< QVariant > &prop ) override;
+
+    /**
+     * Returns the generated graph and resets the builder.
+     */
+    QgsCompactGraph *graph() SIP_FACTORY;
+
+  private:
+
+    QgsCompactGraph mGraph;
+
+    QgsCompactGraphBuilder( const QgsCompactGraphBuilder & ) = delete;
+    QgsCompactGraphBuilder &operator=( const QgsCompactGraphBuilder & ) = delete;
+};
+
+#endif // QGSCOMPACTGRAPH_H
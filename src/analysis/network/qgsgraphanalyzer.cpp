@@ -13,14 +13,12 @@
 *                                                                          *
 ***************************************************************************/
 
-#include <limits>
-
-#include <QMap>
 #include <QVector>
-#include <QPair>
 
+#include "qgscompactgraph.h"
 #include "qgsgraph.h"
 #include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
 
 void QgsGraphAnalyzer::dijkstra( const QgsGraph *source, int startPointIdx, int criterionNum, QVector<int> *resultTree, QVector<double> *resultCost )
 {
@@ -30,62 +28,26 @@ void QgsGraphAnalyzer::dijkstra( const QgsGraph *source, int startPointIdx, int
     return;
   }
 
-  QVector< double > *result = nullptr;
-  if ( resultCost )
-  {
-    result = resultCost;
-  }
-  else
-  {
-    result = new QVector<double>();
-  }
+  QVector< int > tree;
+  QVector< double > cost;
 
-  result->clear();
-  result->insert( result->begin(), source->vertexCount(), std::numeric_limits<double>::infinity() );
-  ( *result )[ startPointIdx ] = 0.0;
+  QgsGraphRouter router( source, criterionNum );
+  router.shortestTree( startPointIdx, resultTree ? *resultTree : tree, resultCost ? *resultCost : cost );
+}
 
-  if ( resultTree )
+void QgsGraphAnalyzer::dijkstra( const QgsCompactGraph *source, int startPointIdx, int criterionNum, QVector<int> *resultTree, QVector<double> *resultCost )
+{
+  if ( startPointIdx < 0 || startPointIdx >= source->vertexCount() )
   {
-    resultTree->clear();
-    resultTree->insert( resultTree->begin(), source->vertexCount(), -1 );
+    // invalid start point
+    return;
   }
 
-  // QMultiMap< cost, vertexIdx > not_begin
-  // I use it and don't create any struct or class
-  QMultiMap< double, int > not_begin;
-  QMultiMap< double, int >::iterator it;
-
-  not_begin.insert( 0.0, startPointIdx );
+  QVector< int > tree;
+  QVector< double > cost;
 
-  while ( !not_begin.empty() )
-  {
-    it = not_begin.begin();
-    double curCost = it.key();
-    int curVertex = it.value();
-    not_begin.erase( it );
-
-    // edge index list
-    const QgsGraphEdgeIds &outgoingEdges = source->vertex( curVertex ).outgoingEdges();
-    for ( int edgeId : outgoingEdges )
-    {
-      const QgsGraphEdge &arc = source->edge( edgeId );
-      double cost = arc.cost( criterionNum ).toDouble() + curCost;
-
-      if ( cost < ( *result )[ arc.toVertex()] )
-      {
-        ( *result )[ arc.toVertex()] = cost;
-        if ( resultTree )
-        {
-          ( *resultTree )[ arc.toVertex()] = edgeId;
-        }
-        not_begin.insert( cost, arc.toVertex() );
-      }
-    }
-  }
-  if ( !resultCost )
-  {
-    delete result;
-  }
+  QgsGraphRouter router( source, criterionNum );
+  router.shortestTree( startPointIdx, resultTree ? *resultTree : tree, resultCost ? *resultCost : cost );
 }
 
 QgsGraph *QgsGraphAnalyzer::shortestTree( const QgsGraph *source, int startVertexIdx, int criterionNum )
@@ -123,3 +85,35 @@ QgsGraph *QgsGraphAnalyzer::shortestTree( const QgsGraph *source, int startVerte
 
   return treeResult;
 }
+
+QgsGraph *QgsGraphAnalyzer::shortestTree( const QgsCompactGraph *source, int startVertexIdx, int criterionNum )
+{
+  QgsGraph *treeResult = new QgsGraph();
+  if ( startVertexIdx < 0 || startVertexIdx >= source->vertexCount() )
+    return treeResult;
+
+  QVector<int> tree;
+  QgsGraphAnalyzer::dijkstra( source, startVertexIdx, criterionNum, &tree );
+
+  QVector<int> source2result( tree.size(), -1 );
+  source2result[ startVertexIdx ] = treeResult->addVertex( source->vertexPoint( startVertexIdx ) );
+  for ( int i = 0; i < source->vertexCount(); ++i )
+  {
+    if ( tree[ i ] != -1 )
+      source2result[ i ] = treeResult->addVertex( source->vertexPoint( i ) );
+  }
+
+  QVector< QVariant > strategies( source->strategyCount() );
+  for ( int i = 0; i < source->vertexCount(); ++i )
+  {
+    if ( tree[ i ] == -1 )
+      continue;
+
+    const int edge = tree[ i ];
+    for ( int j = 0; j < strategies.size(); ++j )
+      strategies[ j ] = source->edgeCost( edge, j );
+    treeResult->addEdge( source2result[ source->edgeFromVertex( edge ) ], source2result[ source->edgeToVertex( edge ) ], strategies );
+  }
+
+  return treeResult;
+}
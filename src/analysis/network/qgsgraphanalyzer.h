@@ -22,6 +22,7 @@
 #include "qgis_analysis.h"
 
 class QgsGraph;
+class QgsCompactGraph;
 
 /**
  * \ingroup analysis
@@ -41,9 +42,60 @@ class ANALYSIS_EXPORT QgsGraphAnalyzer
      * \param resultTree array that represents shortest path tree. resultTree[ vertexIndex ] == inboundingArcIndex if vertex reachable, otherwise resultTree[ vertexIndex ] == -1.
      * Note that the startVertexIdx will also have a value of -1 and may need special handling by callers.
      * \param resultCost array of the paths costs
+     *
+     * Edge costs may be negative: a vertex is searched again whenever a cheaper path to it is found,
+     * so the results are correct as long as the graph has no cycle with a negative total cost.
+     * The search does not end on such a graph.
      */
     static void SIP_PYALTERNATIVETYPE( SIP_PYLIST ) dijkstra( const QgsGraph *source, int startVertexIdx, int criterionNum, QVector<int> *resultTree = nullptr, QVector<double> *resultCost = nullptr );
 
+#ifdef SIP_RUN
+    % MethodCode
+    QVector< int > treeResult;
+    QVector< double > costResult;
+    QgsGraphAnalyzer::dijkstra( a0, a1, a2, &treeResult, &costResult );
+
+    PyObject *l1 = PyList_New( treeResult.size() );
+    if ( l1 == NULL )
+    {
+      return NULL;
+    }
+    PyObject *l2 = PyList_New( costResult.size() );
+    if ( l2 == NULL )
+    {
+      return NULL;
+    }
+    int i;
+    for ( i = 0; i < costResult.size(); ++i )
+    {
+      PyObject *Int = PyLong_FromLong( treeResult[i] );
+      PyList_SET_ITEM( l1, i, Int );
+      PyObject *Float = PyFloat_FromDouble( costResult[i] );
+      PyList_SET_ITEM( l2, i, Float );
+    }
+
+    sipRes = PyTuple_New( 2 );
+    PyTuple_SET_ITEM( sipRes, 0, l1 );
+    PyTuple_SET_ITEM( sipRes, 1, l2 );
+    % End
+#endif
+
+    /**
+     * Solve shortest path problem using Dijkstra algorithm on a compact graph.
+     * \param source source graph
+     * \param startVertexIdx index of the start vertex
+     * \param criterionNum index of the optimization strategy
+     * \param resultTree array that represents shortest path tree. resultTree[ vertexIndex ] == inboundingArcIndex if vertex reachable, otherwise resultTree[ vertexIndex ] == -1.
+     * Note that the startVertexIdx will also have a value of -1 and may need special handling by callers.
+     * \param resultCost array of the paths costs
+     *
+     * Edge costs may be negative: a vertex is searched again whenever a cheaper path to it is found,
+     * so the results are correct as long as the graph has no cycle with a negative total cost.
+     * The search does not end on such a graph.
+     * \since QGIS 3.18
+     */
+    static void SIP_PYALTERNATIVETYPE( SIP_PYLIST ) dijkstra( const QgsCompactGraph *source, int startVertexIdx, int criterionNum, QVector<int> *resultTree = nullptr, QVector<double> *resultCost = nullptr );
+
 #ifdef SIP_RUN
     % MethodCode
     QVector< int > treeResult;
@@ -82,6 +134,15 @@ class ANALYSIS_EXPORT QgsGraphAnalyzer
      * \param criterionNum index of the optimization strategy
      */
     static QgsGraph *shortestTree( const QgsGraph *source, int startVertexIdx, int criterionNum );
+
+    /**
+     * Returns shortest path tree with root-node in startVertexIdx, calculated on a compact graph.
+     * \param source source graph
+     * \param startVertexIdx index of the start vertex
+     * \param criterionNum index of the optimization strategy
+     * \since QGIS 3.18
+     */
+    static QgsGraph *shortestTree( const QgsCompactGraph *source, int startVertexIdx, int criterionNum ) SIP_FACTORY;
 };
 
 #endif // QGSGRAPHANALYZER_H
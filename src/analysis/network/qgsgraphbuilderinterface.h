@@ -28,6 +28,7 @@ class QgsPoint;
 #ifdef SIP_RUN
 % ModuleHeaderCode
 #include <qgsgraphbuilder.h>
+#include <qgscompactgraph.h>
 % End
 #endif
 
@@ -44,6 +45,8 @@ class ANALYSIS_EXPORT QgsGraphBuilderInterface
     SIP_CONVERT_TO_SUBCLASS_CODE
     if ( dynamic_cast< QgsGraphBuilder * >( sipCpp ) != NULL )
       sipType = sipType_QgsGraphBuilder;
+    else if ( dynamic_cast< QgsCompactGraphBuilder * >( sipCpp ) != NULL )
+      sipType = sipType_QgsCompactGraphBuilder;
     else
       sipType = NULL;
     SIP_END
@@ -0,0 +1,891 @@
+/***************************************************************************
+  qgsgraphcontractionhierarchy.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include <QDataStream>
+#include <QFile>
+
+#include "qgsfeedback.h"
+#include "qgsgraph.h"
+#include "qgsgraphcontractionhierarchy.h"
+#include "qgsgraphrouter_p.h"
+
+///@cond PRIVATE
+
+// "QGCH"
+static const quint32 CH_FILE_MAGIC = 0x51474348;
+static const qint32 CH_FILE_VERSION = 2;
+
+// bounds the witness searches which decide whether a shortcut is needed. A search which
+// gives up early only adds a superfluous shortcut, it never breaks correctness
+static const int WITNESS_SETTLE_LIMIT = 500;
+static const int SIMULATION_SETTLE_LIMIT = 50;
+
+struct QgsGraphHierarchyData
+{
+  int vertexCount = 0;
+  int edgeCount = 0;
+  int strategyIndex = 0;
+  quint64 fingerprint = 0;
+  int shortcutCount = 0;
+
+  //! Contraction order of each vertex
+  std::vector< int > rank;
+
+  //! Arcs leading to higher ranked vertices, grouped by their start vertex
+  QgsGraphAdjacency up;
+  //! Arcs coming from higher ranked vertices, grouped by their end vertex
+  QgsGraphAdjacency down;
+
+  //! Start and end vertex of each arc
+  std::vector< int > arcFrom;
+  std::vector< int > arcTo;
+  //! Original graph edge for each arc, or -1 for shortcuts
+  std::vector< int > arcEdge;
+  //! For shortcuts, the two arcs they replace
+  std::vector< int > arcFirst;
+  std::vector< int > arcSecond;
+};
+
+static quint64 graphFingerprint( const QgsGraph *graph, int strategyIndex )
+{
+  // FNV-1a over the graph topology, coordinates and costs
+  quint64 hash = 14695981039346656037ULL;
+  auto add = [&hash]( const void *data, size_t size )
+  {
+    const unsigned char *bytes = static_cast< const unsigned char * >( data );
+    for ( size_t i = 0; i < size; ++i )
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  const qint32 vertexCount = graph->vertexCount();
+  const qint32 edgeCount = graph->edgeCount();
+  add( &vertexCount, sizeof( vertexCount ) );
+  add( &edgeCount, sizeof( edgeCount ) );
+  add( &strategyIndex, sizeof( strategyIndex ) );
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    const QgsPointXY point = graph->vertex( i ).point();
+    const double xy[2] = { point.x(), point.y() };
+    add( xy, sizeof( xy ) );
+  }
+  for ( int i = 0; i < edgeCount; ++i )
+  {
+    const QgsGraphEdge &edge = graph->edge( i );
+    const qint32 ends[2] = { edge.fromVertex(), edge.toVertex() };
+    const double cost = edge.cost( strategyIndex ).toDouble();
+    add( ends, sizeof( ends ) );
+    add( &cost, sizeof( cost ) );
+  }
+  return hash;
+}
+
+/**
+ * Mutable graph used while contracting vertices.
+ */
+class QgsGraphContractionBuilder
+{
+  public:
+
+    struct Arc
+    {
+      int from;
+      int to;
+      double cost;
+      int edge;
+      int first;
+      int second;
+    };
+
+    QgsGraphContractionBuilder( const QgsGraph *graph, int strategyIndex )
+      : mOut( graph->vertexCount() )
+      , mIn( graph->vertexCount() )
+      , mContractedNeighbors( graph->vertexCount(), 0 )
+      , mIsTarget( graph->vertexCount(), false )
+      , mLevels( graph->vertexCount(), 0 )
+    {
+      for ( int i = 0; i < graph->edgeCount(); ++i )
+      {
+        const QgsGraphEdge &edge = graph->edge( i );
+        addArc( edge.fromVertex(), edge.toVertex(), edge.cost( strategyIndex ).toDouble(), i, -1, -1 );
+      }
+    }
+
+    int vertexCount() const { return static_cast< int >( mOut.size() ); }
+
+    /**
+     * Returns the arcs which were not replaced by a cheaper one, with the shortcut children
+     * renumbered accordingly. Shortcuts always follow the arcs they are made of.
+     */
+    std::vector< Arc > arcs() const
+    {
+      std::vector< int > index( mArcs.size(), -1 );
+      std::vector< Arc > arcs;
+      arcs.reserve( mArcs.size() );
+      for ( std::size_t i = 0; i < mArcs.size(); ++i )
+      {
+        if ( mReplaced[ i ] )
+          continue;
+
+        Arc arc = mArcs[ i ];
+        if ( arc.edge == -1 )
+        {
+          arc.first = index[ arc.first ];
+          arc.second = index[ arc.second ];
+        }
+        index[ i ] = static_cast< int >( arcs.size() );
+        arcs.push_back( arc );
+      }
+      return arcs;
+    }
+
+    //! Returns the uncontracted neighbors of the last contracted vertex
+    const std::vector< int > &neighbors() const { return mNeighbors; }
+
+    /**
+     * Returns the contraction priority of vertex \a v, lower values are contracted first.
+     */
+    double priority( int v )
+    {
+      const int removed = static_cast< int >( mOut[ v ].size() + mIn[ v ].size() );
+      const int added = contract( v, true );
+      return 4 * ( added - removed ) + 2 * mContractedNeighbors[ v ] + mLevels[ v ];
+    }
+
+    /**
+     * Contracts vertex \a v, adding shortcuts for any shortest path running through it.
+     * If \a simulate is TRUE no shortcut is added. Returns the number of shortcuts required.
+     */
+    int contract( int v, bool simulate )
+    {
+      int shortcuts = 0;
+      mNewArcs.clear();
+
+      const std::vector< int > &incoming = mIn[ v ];
+      const std::vector< int > &outgoing = mOut[ v ];
+
+      double maxOutgoing = 0;
+      for ( int out : outgoing )
+        maxOutgoing = std::max( maxOutgoing, mArcs[ out ].cost );
+
+      for ( int in : incoming )
+      {
+        const int u = mArcs[ in ].from;
+        const double viaCost = mArcs[ in ].cost;
+        witnessSearch( u, v, viaCost + maxOutgoing, simulate ? SIMULATION_SETTLE_LIMIT : WITNESS_SETTLE_LIMIT );
+
+        for ( int out : outgoing )
+        {
+          const int w = mArcs[ out ].to;
+          if ( w == u )
+            continue;
+
+          const double shortcutCost = viaCost + mArcs[ out ].cost;
+          if ( mWitness.cost( w ) <= shortcutCost )
+            continue;
+
+          shortcuts++;
+          if ( !simulate )
+            mNewArcs.push_back( { u, w, shortcutCost, -1, in, out } );
+        }
+      }
+
+      if ( !simulate )
+      {
+        // detach the vertex, so that the lists only hold arcs between uncontracted vertices
+        mNeighbors.clear();
+        for ( int arc : mOut[ v ] )
+        {
+          const int w = mArcs[ arc ].to;
+          removeArc( mIn[ w ], arc );
+          mNeighbors.push_back( w );
+        }
+        for ( int arc : mIn[ v ] )
+        {
+          const int u = mArcs[ arc ].from;
+          removeArc( mOut[ u ], arc );
+          mNeighbors.push_back( u );
+        }
+        std::sort( mNeighbors.begin(), mNeighbors.end() );
+        mNeighbors.erase( std::unique( mNeighbors.begin(), mNeighbors.end() ), mNeighbors.end() );
+        for ( int neighbor : mNeighbors )
+        {
+          mContractedNeighbors[ neighbor ]++;
+          mLevels[ neighbor ] = std::max( mLevels[ neighbor ], mLevels[ v ] + 1 );
+        }
+        std::vector< int >().swap( mOut[ v ] );
+        std::vector< int >().swap( mIn[ v ] );
+
+        for ( const Arc &arc : mNewArcs )
+          addArc( arc.from, arc.to, arc.cost, -1, arc.first, arc.second );
+      }
+      return shortcuts;
+    }
+
+  private:
+
+    static void removeArc( std::vector< int > &arcs, int arc )
+    {
+      auto it = std::find( arcs.begin(), arcs.end(), arc );
+      if ( it != arcs.end() )
+      {
+        *it = arcs.back();
+        arcs.pop_back();
+      }
+    }
+
+    void addArc( int from, int to, double cost, int edge, int first, int second )
+    {
+      if ( from == to )
+        return;
+
+      // keep a single arc between each pair of vertices. The lists only hold arcs
+      // between uncontracted vertices, so the existing arc is not part of any shortcut yet
+      int existingArc = -1;
+      for ( int arc : mOut[ from ] )
+      {
+        if ( mArcs[ arc ].to == to )
+        {
+          existingArc = arc;
+          break;
+        }
+      }
+
+      if ( existingArc != -1 )
+      {
+        Arc &existing = mArcs[ existingArc ];
+        if ( cost >= existing.cost )
+          return;
+
+        if ( std::max( first, second ) < existingArc )
+        {
+          existing.cost = cost;
+          existing.edge = edge;
+          existing.first = first;
+          existing.second = second;
+          return;
+        }
+
+        // shortcuts always follow the arcs they are made of, replace the arc by a new one
+        mReplaced[ existingArc ] = true;
+        removeArc( mOut[ from ], existingArc );
+        removeArc( mIn[ to ], existingArc );
+      }
+
+      const int index = static_cast< int >( mArcs.size() );
+      mArcs.push_back( { from, to, cost, edge, first, second } );
+      mReplaced.push_back( false );
+      mOut[ from ].push_back( index );
+      mIn[ to ].push_back( index );
+    }
+
+    /**
+     * Runs a bounded Dijkstra search from \a source over the uncontracted vertices, avoiding \a excluded.
+     * The search stops early once all the successors of \a excluded are settled.
+     */
+    void witnessSearch( int source, int excluded, double maxCost, int settleLimit )
+    {
+      mWitness.reset( vertexCount() );
+      mWitness.update( source, 0, -1 );
+      mWitness.heap.push( source, 0 );
+
+      int targets = 0;
+      for ( int arc : mOut[ excluded ] )
+      {
+        const int target = mArcs[ arc ].to;
+        if ( target != source && !mIsTarget[ target ] )
+        {
+          mIsTarget[ target ] = true;
+          targets++;
+        }
+      }
+
+      int settled = 0;
+      while ( !mWitness.heap.isEmpty() && settled < settleLimit && targets > 0 )
+      {
+        if ( mWitness.heap.topKey() > maxCost )
+          break;
+
+        const int vertex = mWitness.heap.pop();
+        mWitness.settle( vertex );
+        settled++;
+        if ( mIsTarget[ vertex ] )
+          targets--;
+
+        const double vertexCost = mWitness.cost( vertex );
+        for ( int arc : mOut[ vertex ] )
+        {
+          const int next = mArcs[ arc ].to;
+          if ( next == excluded )
+            continue;
+
+          const double nextCost = vertexCost + mArcs[ arc ].cost;
+          if ( nextCost < mWitness.cost( next ) )
+          {
+            mWitness.update( next, nextCost, arc );
+            mWitness.heap.push( next, nextCost );
+          }
+        }
+      }
+
+      for ( int arc : mOut[ excluded ] )
+        mIsTarget[ mArcs[ arc ].to ] = false;
+    }
+
+    std::vector< Arc > mArcs;
+    //! Arcs which were replaced by a cheaper arc between the same vertices
+    std::vector< bool > mReplaced;
+    std::vector< Arc > mNewArcs;
+    std::vector< std::vector< int > > mOut;
+    std::vector< std::vector< int > > mIn;
+    std::vector< int > mNeighbors;
+    std::vector< int > mContractedNeighbors;
+    std::vector< bool > mIsTarget;
+    std::vector< int > mLevels;
+    QgsGraphSearchSpace mWitness;
+};
+
+static void buildUpwardAdjacency( const std::vector< QgsGraphContractionBuilder::Arc > &arcs, const std::vector< int > &rank, bool up, QgsGraphAdjacency &adjacency )
+{
+  const int vertexCount = static_cast< int >( rank.size() );
+  std::vector< int > counts( vertexCount + 1, 0 );
+  for ( const QgsGraphContractionBuilder::Arc &arc : arcs )
+  {
+    if ( up && rank[ arc.from ] < rank[ arc.to ] )
+      counts[ arc.from + 1 ]++;
+    else if ( !up && rank[ arc.from ] > rank[ arc.to ] )
+      counts[ arc.to + 1 ]++;
+  }
+  for ( int i = 0; i < vertexCount; ++i )
+    counts[ i + 1 ] += counts[ i ];
+
+  adjacency.offsets = counts;
+  adjacency.edges.resize( counts.back() );
+  adjacency.vertices.resize( counts.back() );
+  adjacency.costs.resize( counts.back() );
+  for ( int i = 0; i < static_cast< int >( arcs.size() ); ++i )
+  {
+    const QgsGraphContractionBuilder::Arc &arc = arcs[ i ];
+    int slot = -1;
+    int other = -1;
+    if ( up && rank[ arc.from ] < rank[ arc.to ] )
+    {
+      slot = counts[ arc.from ]++;
+      other = arc.to;
+    }
+    else if ( !up && rank[ arc.from ] > rank[ arc.to ] )
+    {
+      slot = counts[ arc.to ]++;
+      other = arc.from;
+    }
+    else
+    {
+      continue;
+    }
+    adjacency.edges[ slot ] = i;
+    adjacency.vertices[ slot ] = other;
+    adjacency.costs[ slot ] = arc.cost;
+  }
+}
+
+/**
+ * Runs an unbounded Dijkstra search from \a start over the upward (or downward, if \a forward
+ * is FALSE) arcs of the hierarchy, appending the settled vertices to \a settled.
+ */
+static void upwardSearch( const QgsGraphHierarchyData &data, QgsGraphSearchSpace &space, int start, bool forward, std::vector< int > &settled )
+{
+  const QgsGraphAdjacency &adjacency = forward ? data.up : data.down;
+  space.reset( data.vertexCount );
+  space.update( start, 0, -1 );
+  space.heap.push( start, 0 );
+  while ( !space.heap.isEmpty() )
+  {
+    const int vertex = space.heap.pop();
+    space.settle( vertex );
+    settled.push_back( vertex );
+
+    const double vertexCost = space.cost( vertex );
+    for ( int i = adjacency.offsets[ vertex ]; i < adjacency.offsets[ vertex + 1 ]; ++i )
+    {
+      const int next = adjacency.vertices[ i ];
+      const double nextCost = vertexCost + adjacency.costs[ i ];
+      if ( nextCost < space.cost( next ) )
+      {
+        space.update( next, nextCost, adjacency.edges[ i ] );
+        space.heap.push( next, nextCost );
+      }
+    }
+  }
+}
+
+template <typename T>
+static void writeVector( QDataStream &stream, const std::vector< T > &values )
+{
+  stream << static_cast< qint64 >( values.size() );
+  for ( const T &value : values )
+    stream << value;
+}
+
+template <typename T>
+static bool readVector( QDataStream &stream, std::vector< T > &values, qint64 expectedSize )
+{
+  qint64 size = 0;
+  stream >> size;
+  if ( stream.status() != QDataStream::Ok || size < 0 || ( expectedSize >= 0 && size != expectedSize ) )
+    return false;
+
+  // arithmetic values are streamed with their own size, a corrupted size must not allocate more than the file holds
+  static_assert( std::is_arithmetic< T >::value, "only vectors of arithmetic values can be read" );
+  if ( !stream.device() || size > stream.device()->bytesAvailable() / static_cast< qint64 >( sizeof( T ) ) )
+    return false;
+
+  values.resize( size );
+  for ( T &value : values )
+    stream >> value;
+  return stream.status() == QDataStream::Ok;
+}
+
+static void writeAdjacency( QDataStream &stream, const QgsGraphAdjacency &adjacency )
+{
+  writeVector( stream, adjacency.offsets );
+  writeVector( stream, adjacency.edges );
+  writeVector( stream, adjacency.vertices );
+  writeVector( stream, adjacency.costs );
+}
+
+static bool readAdjacency( QDataStream &stream, QgsGraphAdjacency &adjacency, int vertexCount, qint64 arcCount )
+{
+  if ( !readVector( stream, adjacency.offsets, vertexCount + 1 ) )
+    return false;
+
+  const qint64 size = adjacency.offsets.back();
+  if ( size < 0 )
+    return false;
+  if ( !readVector( stream, adjacency.edges, size )
+       || !readVector( stream, adjacency.vertices, size )
+       || !readVector( stream, adjacency.costs, size ) )
+    return false;
+
+  // guard queries against corrupted files
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    if ( adjacency.offsets[ i ] < 0 || adjacency.offsets[ i ] > adjacency.offsets[ i + 1 ] )
+      return false;
+  }
+  for ( qint64 i = 0; i < size; ++i )
+  {
+    if ( adjacency.vertices[ i ] < 0 || adjacency.vertices[ i ] >= vertexCount || adjacency.edges[ i ] < 0 || adjacency.edges[ i ] >= arcCount )
+      return false;
+  }
+  return true;
+}
+
+///@endcond
+
+QgsGraphContractionHierarchy::QgsGraphContractionHierarchy()
+  : mForward( new QgsGraphSearchSpace() )
+  , mBackward( new QgsGraphSearchSpace() )
+{
+}
+
+QgsGraphContractionHierarchy::QgsGraphContractionHierarchy( const QgsGraphContractionHierarchy &other )
+  : mData( other.mData )
+  , mForward( new QgsGraphSearchSpace() )
+  , mBackward( new QgsGraphSearchSpace() )
+{
+}
+
+QgsGraphContractionHierarchy &QgsGraphContractionHierarchy::operator=( const QgsGraphContractionHierarchy &other )
+{
+  if ( this != &other )
+  {
+    mData = other.mData;
+    mForward.reset( new QgsGraphSearchSpace() );
+    mBackward.reset( new QgsGraphSearchSpace() );
+  }
+  return *this;
+}
+
+QgsGraphContractionHierarchy::~QgsGraphContractionHierarchy() = default;
+
+bool QgsGraphContractionHierarchy::build( const QgsGraph *graph, int strategyIndex, QgsFeedback *feedback )
+{
+  mData.reset();
+
+  const int vertexCount = graph->vertexCount();
+  QgsGraphContractionBuilder builder( graph, strategyIndex );
+
+  // contracting a vertex only changes the priority of its neighbors, which are
+  // updated in the queue right after each contraction
+  QgsGraphIndexedHeap queue;
+  queue.resize( vertexCount );
+  for ( int i = 0; i < vertexCount; ++i )
+  {
+    queue.push( i, builder.priority( i ) );
+    if ( feedback && feedback->isCanceled() )
+      return false;
+  }
+
+  std::vector< int > rank( vertexCount, 0 );
+  int contracted = 0;
+  const double step = vertexCount > 0 ? 100.0 / vertexCount : 1;
+  while ( !queue.isEmpty() )
+  {
+    const int vertex = queue.pop();
+
+    builder.contract( vertex, false );
+    rank[ vertex ] = contracted++;
+
+    for ( int neighbor : builder.neighbors() )
+      queue.update( neighbor, builder.priority( neighbor ) );
+
+    if ( feedback && contracted % 1000 == 0 )
+    {
+      if ( feedback->isCanceled() )
+        return false;
+      feedback->setProgress( contracted * step );
+    }
+  }
+
+  std::shared_ptr< QgsGraphHierarchyData > data = std::make_shared< QgsGraphHierarchyData >();
+  data->vertexCount = vertexCount;
+  data->edgeCount = graph->edgeCount();
+  data->strategyIndex = strategyIndex;
+  data->fingerprint = graphFingerprint( graph, strategyIndex );
+
+  const std::vector< QgsGraphContractionBuilder::Arc > arcs = builder.arcs();
+  data->arcFrom.reserve( arcs.size() );
+  data->arcTo.reserve( arcs.size() );
+  data->arcEdge.reserve( arcs.size() );
+  data->arcFirst.reserve( arcs.size() );
+  data->arcSecond.reserve( arcs.size() );
+  for ( const QgsGraphContractionBuilder::Arc &arc : arcs )
+  {
+    data->arcFrom.push_back( arc.from );
+    data->arcTo.push_back( arc.to );
+    data->arcEdge.push_back( arc.edge );
+    data->arcFirst.push_back( arc.first );
+    data->arcSecond.push_back( arc.second );
+    if ( arc.edge == -1 )
+      data->shortcutCount++;
+  }
+
+  buildUpwardAdjacency( arcs, rank, true, data->up );
+  buildUpwardAdjacency( arcs, rank, false, data->down );
+  data->rank = std::move( rank );
+
+  mData = data;
+  if ( feedback )
+    feedback->setProgress( 100 );
+  return true;
+}
+
+bool QgsGraphContractionHierarchy::isValid() const
+{
+  return static_cast< bool >( mData );
+}
+
+bool QgsGraphContractionHierarchy::isBuiltFor( const QgsGraph *graph, int strategyIndex ) const
+{
+  if ( !mData || mData->vertexCount != graph->vertexCount() || mData->edgeCount != graph->edgeCount() || mData->strategyIndex != strategyIndex )
+    return false;
+
+  return mData->fingerprint == graphFingerprint( graph, strategyIndex );
+}
+
+int QgsGraphContractionHierarchy::vertexCount() const
+{
+  return mData ? mData->vertexCount : 0;
+}
+
+int QgsGraphContractionHierarchy::shortcutCount() const
+{
+  return mData ? mData->shortcutCount : 0;
+}
+
+QVector< int > QgsGraphContractionHierarchy::shortestPath( int fromVertexIdx, int toVertexIdx, double *cost )
+{
+  QVector< int > path;
+  double pathCost = std::numeric_limits< double >::infinity();
+
+  if ( !mData || fromVertexIdx < 0 || fromVertexIdx >= mData->vertexCount || toVertexIdx < 0 || toVertexIdx >= mData->vertexCount )
+  {
+    if ( cost )
+      *cost = pathCost;
+    return path;
+  }
+  if ( fromVertexIdx == toVertexIdx )
+  {
+    if ( cost )
+      *cost = 0;
+    return path;
+  }
+
+  const QgsGraphHierarchyData &data = *mData;
+  QgsGraphSearchSpace &forward = *mForward;
+  QgsGraphSearchSpace &backward = *mBackward;
+  forward.reset( data.vertexCount );
+  backward.reset( data.vertexCount );
+  forward.update( fromVertexIdx, 0, -1 );
+  forward.heap.push( fromVertexIdx, 0 );
+  backward.update( toVertexIdx, 0, -1 );
+  backward.heap.push( toVertexIdx, 0 );
+
+  int meetingVertex = -1;
+  while ( forward.heap.topKey() < pathCost || backward.heap.topKey() < pathCost )
+  {
+    const bool forwardStep = forward.heap.topKey() <= backward.heap.topKey();
+    QgsGraphSearchSpace &space = forwardStep ? forward : backward;
+    const QgsGraphSearchSpace &other = forwardStep ? backward : forward;
+    const QgsGraphAdjacency &adjacency = forwardStep ? data.up : data.down;
+
+    const int vertex = space.heap.pop();
+    space.settle( vertex );
+
+    const double vertexCost = space.cost( vertex );
+    const double total = vertexCost + other.cost( vertex );
+    if ( total < pathCost )
+    {
+      pathCost = total;
+      meetingVertex = vertex;
+    }
+
+    for ( int i = adjacency.offsets[ vertex ]; i < adjacency.offsets[ vertex + 1 ]; ++i )
+    {
+      const int next = adjacency.vertices[ i ];
+      const double nextCost = vertexCost + adjacency.costs[ i ];
+      if ( nextCost < space.cost( next ) )
+      {
+        space.update( next, nextCost, adjacency.edges[ i ] );
+        space.heap.push( next, nextCost );
+      }
+    }
+  }
+
+  if ( meetingVertex != -1 )
+  {
+    std::vector< int > arcs;
+    int vertex = meetingVertex;
+    while ( vertex != fromVertexIdx )
+    {
+      const int arc = forward.edge( vertex );
+      arcs.push_back( arc );
+      vertex = data.arcFrom[ arc ];
+    }
+    std::reverse( arcs.begin(), arcs.end() );
+    vertex = meetingVertex;
+    while ( vertex != toVertexIdx )
+    {
+      const int arc = backward.edge( vertex );
+      arcs.push_back( arc );
+      vertex = data.arcTo[ arc ];
+    }
+
+    // unpack shortcuts into the original graph edges
+    std::vector< int > stack;
+    for ( int arc : arcs )
+    {
+      stack.push_back( arc );
+      while ( !stack.empty() )
+      {
+        const int current = stack.back();
+        stack.pop_back();
+        if ( data.arcEdge[ current ] != -1 )
+        {
+          path.push_back( data.arcEdge[ current ] );
+        }
+        else
+        {
+          stack.push_back( data.arcSecond[ current ] );
+          stack.push_back( data.arcFirst[ current ] );
+        }
+      }
+    }
+  }
+
+  if ( cost )
+    *cost = pathCost;
+  return path;
+}
+
+QVector< double > QgsGraphContractionHierarchy::costMatrix( const QVector< int > &sources, const QVector< int > &targets, QgsFeedback *feedback )
+{
+  QVector< double > matrix( sources.size() * targets.size(), std::numeric_limits< double >::infinity() );
+  if ( !mData || matrix.isEmpty() )
+    return matrix;
+
+  const QgsGraphHierarchyData &data = *mData;
+  const int targetCount = targets.size();
+  const double step = 100.0 / ( sources.size() + targetCount );
+
+  // backward upward searches from every target leave (target, cost) entries in the
+  // buckets of the vertices they reach. A forward upward search from a source then
+  // only has to scan the buckets of the vertices it settles
+  struct BucketEntry
+  {
+    int vertex;
+    int target;
+    double cost;
+  };
+  std::vector< BucketEntry > entries;
+  std::vector< int > settled;
+  for ( int j = 0; j < targetCount; ++j )
+  {
+    if ( feedback && feedback->isCanceled() )
+      return matrix;
+
+    const int target = targets.at( j );
+    if ( target < 0 || target >= data.vertexCount )
+      continue;
+
+    settled.clear();
+    upwardSearch( data, *mBackward, target, false, settled );
+    for ( int vertex : settled )
+      entries.push_back( { vertex, j, mBackward->cost( vertex ) } );
+
+    if ( feedback )
+      feedback->setProgress( j * step );
+  }
+
+  std::stable_sort( entries.begin(), entries.end(), []( const BucketEntry & a, const BucketEntry & b ) { return a.vertex < b.vertex; } );
+  std::vector< int > bucketOffsets( data.vertexCount + 1, 0 );
+  for ( const BucketEntry &entry : entries )
+    bucketOffsets[ entry.vertex + 1 ]++;
+  for ( int i = 0; i < data.vertexCount; ++i )
+    bucketOffsets[ i + 1 ] += bucketOffsets[ i ];
+
+  for ( int i = 0; i < sources.size(); ++i )
+  {
+    if ( feedback && feedback->isCanceled() )
+      return matrix;
+
+    const int source = sources.at( i );
+    if ( source < 0 || source >= data.vertexCount )
+      continue;
+
+    settled.clear();
+    upwardSearch( data, *mForward, source, true, settled );
+    double *row = matrix.data() + static_cast< qint64 >( i ) * targetCount;
+    for ( int vertex : settled )
+    {
+      const double sourceCost = mForward->cost( vertex );
+      for ( int k = bucketOffsets[ vertex ]; k < bucketOffsets[ vertex + 1 ]; ++k )
+      {
+        const BucketEntry &entry = entries[ k ];
+        const double total = sourceCost + entry.cost;
+        if ( total < row[ entry.target ] )
+          row[ entry.target ] = total;
+      }
+    }
+
+    if ( feedback )
+      feedback->setProgress( ( targetCount + i ) * step );
+  }
+
+  return matrix;
+}
+
+bool QgsGraphContractionHierarchy::writeToFile( const QString &path ) const
+{
+  if ( !mData )
+    return false;
+
+  QFile file( path );
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    return false;
+
+  const QgsGraphHierarchyData &data = *mData;
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_0 );
+  stream << CH_FILE_MAGIC << CH_FILE_VERSION;
+  stream << static_cast< qint32 >( data.vertexCount ) << static_cast< qint32 >( data.edgeCount )
+         << static_cast< qint32 >( data.strategyIndex ) << data.fingerprint << static_cast< qint32 >( data.shortcutCount );
+  writeVector( stream, data.rank );
+  writeVector( stream, data.arcFrom );
+  writeVector( stream, data.arcTo );
+  writeVector( stream, data.arcEdge );
+  writeVector( stream, data.arcFirst );
+  writeVector( stream, data.arcSecond );
+  writeAdjacency( stream, data.up );
+  writeAdjacency( stream, data.down );
+
+  return stream.status() == QDataStream::Ok;
+}
+
+bool QgsGraphContractionHierarchy::readFromFile( const QString &path )
+{
+  mData.reset();
+
+  QFile file( path );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_0 );
+
+  quint32 magic = 0;
+  qint32 version = 0;
+  stream >> magic >> version;
+  if ( magic != CH_FILE_MAGIC || version != CH_FILE_VERSION )
+    return false;
+
+  std::shared_ptr< QgsGraphHierarchyData > data = std::make_shared< QgsGraphHierarchyData >();
+  qint32 vertexCount = 0;
+  qint32 edgeCount = 0;
+  qint32 strategyIndex = 0;
+  qint32 shortcutCount = 0;
+  stream >> vertexCount >> edgeCount >> strategyIndex >> data->fingerprint >> shortcutCount;
+  if ( stream.status() != QDataStream::Ok || vertexCount < 0 || edgeCount < 0 )
+    return false;
+
+  data->vertexCount = vertexCount;
+  data->edgeCount = edgeCount;
+  data->strategyIndex = strategyIndex;
+  data->shortcutCount = shortcutCount;
+
+  if ( !readVector( stream, data->rank, vertexCount ) || !readVector( stream, data->arcFrom, -1 ) )
+    return false;
+
+  const qint64 arcCount = static_cast< qint64 >( data->arcFrom.size() );
+  if ( !readVector( stream, data->arcTo, arcCount )
+       || !readVector( stream, data->arcEdge, arcCount )
+       || !readVector( stream, data->arcFirst, arcCount )
+       || !readVector( stream, data->arcSecond, arcCount ) )
+    return false;
+
+  for ( qint64 i = 0; i < arcCount; ++i )
+  {
+    if ( data->arcFrom[ i ] < 0 || data->arcFrom[ i ] >= vertexCount || data->arcTo[ i ] < 0 || data->arcTo[ i ] >= vertexCount )
+      return false;
+    // shortcuts follow the arcs they are made of, so that unpacking them always ends
+    if ( data->arcEdge[ i ] == -1 && ( data->arcFirst[ i ] < 0 || data->arcFirst[ i ] >= i
+                                       || data->arcSecond[ i ] < 0 || data->arcSecond[ i ] >= i ) )
+      return false;
+    if ( data->arcEdge[ i ] < -1 || data->arcEdge[ i ] >= edgeCount )
+      return false;
+  }
+
+  if ( !readAdjacency( stream, data->up, vertexCount, arcCount ) || !readAdjacency( stream, data->down, vertexCount, arcCount ) )
+    return false;
+
+  mData = data;
+  return true;
+}
@@ -0,0 +1,144 @@
+/***************************************************************************
+  qgsgraphcontractionhierarchy.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSGRAPHCONTRACTIONHIERARCHY_H
+#define QGSGRAPHCONTRACTIONHIERARCHY_H
+
+#include <QVector>
+#include <QString>
+#include <memory>
+
+#include "qgis_sip.h"
+#include "qgis_analysis.h"
+
+class QgsGraph;
+class QgsFeedback;
+struct QgsGraphHierarchyData;
+class QgsGraphSearchSpace;
+
+/**
+ * \ingroup analysis
+ * \class QgsGraphContractionHierarchy
+ * \brief Contraction hierarchy built from an immutable QgsGraph, for fast repeated
+ * shortest path and many-to-many cost queries.
+ *
+ * Building the hierarchy contracts the graph vertices one at a time, adding
+ * shortcut edges which preserve shortest path costs between the remaining vertices.
+ * Queries then only search upwards in the vertex order from both ends, which
+ * visits a tiny fraction of the graph compared to a plain Dijkstra search.
+ *
+ * The preprocessing is expensive, so a built hierarchy can be written to disk with
+ * writeToFile() and reused later with readFromFile(). isBuiltFor() checks whether
+ * a hierarchy matches a given graph and strategy.
+ *
+ * Like QgsGraphRouter, a hierarchy is not thread safe but copies share the
+ * preprocessed data and can be queried concurrently.
+ *
+ * \since QGIS 3.18
+ */
+class ANALYSIS_EXPORT QgsGraphContractionHierarchy
+{
+  public:
+
+    /**
+     * Constructor for an empty, invalid QgsGraphContractionHierarchy.
+     * \see build()
+     * \see readFromFile()
+     */
+    QgsGraphContractionHierarchy();
+
+    /**
+     * Copy constructor. The copy shares the hierarchy data but gets its own scratch arrays.
+     */
+    QgsGraphContractionHierarchy( const QgsGraphContractionHierarchy &other );
+
+    /**
+     * Assignment operator. The copy shares the hierarchy data but gets its own scratch arrays.
+     */
+    QgsGraphContractionHierarchy &operator=( const QgsGraphContractionHierarchy &other ) SIP_SKIP;
+
+    ~QgsGraphContractionHierarchy();
+
+    /**
+     * Builds the hierarchy for the specified \a graph and edge cost \a strategyIndex.
+     *
+     * The optional \a feedback argument is used for progress reports and cancellation.
+     * Returns FALSE if the build was canceled, in which case the hierarchy is left invalid.
+     */
+    bool build( const QgsGraph *graph, int strategyIndex, QgsFeedback *feedback = nullptr );
+
+    /**
+     * Returns TRUE if the hierarchy has been built or read from a file.
+     */
+    bool isValid() const;
+
+    /**
+     * Returns TRUE if the hierarchy was built for a graph identical to \a graph
+     * (same vertices, edges and costs) using the same \a strategyIndex.
+     */
+    bool isBuiltFor( const QgsGraph *graph, int strategyIndex ) const;
+
+    /**
+     * Returns the number of vertices of the graph the hierarchy was built for.
+     */
+    int vertexCount() const;
+
+    /**
+     * Returns the number of shortcut edges added while building the hierarchy.
+     */
+    int shortcutCount() const;
+
+    /**
+     * Calculates the shortest path from \a fromVertexIdx to \a toVertexIdx.
+     *
+     * Returns the indices of the edges in the original graph making up the path,
+     * in travel order. An empty list is returned if the destination is unreachable
+     * or equal to the origin, in which case \a cost is set to infinity or 0 respectively.
+     */
+    QVector< int > shortestPath( int fromVertexIdx, int toVertexIdx, double *cost SIP_OUT = nullptr );
+
+    /**
+     * Calculates the costs of the shortest paths from every vertex in \a sources
+     * to every vertex in \a targets.
+     *
+     * The result is stored row by row, i.e. the cost from sources[i] to targets[j] is
+     * found at index i * targets.size() + j. Unreachable pairs and invalid vertex indices
+     * have an infinite cost.
+     *
+     * The optional \a feedback argument is used for progress reports and cancellation.
+     */
+    QVector< double > costMatrix( const QVector< int > &sources, const QVector< int > &targets, QgsFeedback *feedback = nullptr );
+
+    /**
+     * Writes the hierarchy to the file at \a path.
+     * Returns FALSE if the hierarchy is not valid or the file could not be written.
+     * \see readFromFile()
+     */
+    bool writeToFile( const QString &path ) const;
+
+    /**
+     * Reads a hierarchy previously written with writeToFile() from the file at \a path.
+     * Returns FALSE if the file could not be read, in which case the hierarchy is left invalid.
+     * \see writeToFile()
+     */
+    bool readFromFile( const QString &path );
+
+  private:
+
+    std::shared_ptr< const QgsGraphHierarchyData > mData;
+    std::unique_ptr< QgsGraphSearchSpace > mForward;
+    std::unique_ptr< QgsGraphSearchSpace > mBackward;
+};
+
+#endif // QGSGRAPHCONTRACTIONHIERARCHY_H
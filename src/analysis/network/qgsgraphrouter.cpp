@@ -0,0 +1,421 @@
+/***************************************************************************
+  qgsgraphrouter.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include "qgscompactgraph.h"
+#include "qgsgraph.h"
+#include "qgsgraphrouter.h"
+#include "qgsgraphrouter_p.h"
+
+///@cond PRIVATE
+struct QgsGraphRouterData
+{
+  int vertexCount = 0;
+  // edge ends and costs for the router strategy, by edge index
+  QVector< int > edgeFrom;
+  QVector< int > edgeTo;
+  QVector< double > costs;
+  // edges leaving each vertex v are outEdges[outOffsets[v]] to outEdges[outOffsets[v + 1] - 1]
+  QVector< int > outOffsets;
+  QVector< int > outEdges;
+
+  // arrays only used by backward searches and A*. Compact graphs share them,
+  // for a QgsGraph they are built on first use
+  mutable std::once_flag backwardBuilt;
+  mutable QVector< int > inOffsets;
+  mutable QVector< int > inEdges;
+
+  const QgsGraph *graph = nullptr;
+  mutable std::once_flag heuristicBuilt;
+  mutable QVector< double > x;
+  mutable QVector< double > y;
+  // smallest cost per unit of straight line length, used to scale the A* heuristic
+  mutable double heuristicScale = 0;
+};
+
+//! Edges of the router graph in one search direction
+struct QgsGraphRouterEdges
+{
+  const int *offsets = nullptr;
+  const int *edges = nullptr;
+  //! Vertex reached through each edge, by edge index
+  const int *vertices = nullptr;
+  const double *costs = nullptr;
+};
+
+/**
+ * Groups edge indices by vertex using a counting sort, keeping edges of the same vertex in index order.
+ */
+static void buildRanges( const QVector< int > &edgeVertices, int vertexCount, QVector< int > &offsets, QVector< int > &edges )
+{
+  offsets.fill( 0, vertexCount + 1 );
+  for ( int vertex : edgeVertices )
+    offsets[ vertex + 1 ]++;
+  for ( int i = 0; i < vertexCount; ++i )
+    offsets[ i + 1 ] += offsets[ i ];
+
+  edges.resize( edgeVertices.size() );
+  QVector< int > next = offsets;
+  for ( int i = 0; i < edgeVertices.size(); ++i )
+    edges[ next[ edgeVertices.at( i ) ]++ ] = i;
+}
+
+static QgsGraphRouterEdges routerEdges( const QgsGraphRouterData &data, bool backward )
+{
+  QgsGraphRouterEdges edges;
+  if ( backward )
+  {
+    std::call_once( data.backwardBuilt, [&data]
+    {
+      if ( data.inOffsets.isEmpty() )
+        buildRanges( data.edgeTo, data.vertexCount, data.inOffsets, data.inEdges );
+    } );
+    edges.offsets = data.inOffsets.constData();
+    edges.edges = data.inEdges.constData();
+    edges.vertices = data.edgeFrom.constData();
+  }
+  else
+  {
+    edges.offsets = data.outOffsets.constData();
+    edges.edges = data.outEdges.constData();
+    edges.vertices = data.edgeTo.constData();
+  }
+  edges.costs = data.costs.constData();
+  return edges;
+}
+
+static void buildHeuristic( const QgsGraphRouterData &data )
+{
+  std::call_once( data.heuristicBuilt, [&data]
+  {
+    if ( data.graph )
+    {
+      data.x.reserve( data.vertexCount );
+      data.y.reserve( data.vertexCount );
+      for ( int i = 0; i < data.vertexCount; ++i )
+      {
+        const QgsPointXY point = data.graph->vertex( i ).point();
+        data.x << point.x();
+        data.y << point.y();
+      }
+    }
+
+    double scale = std::numeric_limits< double >::infinity();
+    for ( int i = 0; i < data.edgeFrom.size(); ++i )
+    {
+      const int from = data.edgeFrom.at( i );
+      const int to = data.edgeTo.at( i );
+      const double length = std::hypot( data.x.at( to ) - data.x.at( from ), data.y.at( to ) - data.y.at( from ) );
+      if ( length > 0 )
+        scale = std::min( scale, data.costs.at( i ) / length );
+    }
+    // any path is at least as expensive as its straight line length multiplied by the
+    // smallest cost per length unit, so this scale keeps the heuristic admissible
+    data.heuristicScale = std::isfinite( scale ) && scale > 0 ? scale : 0;
+  } );
+}
+///@endcond
+
+QgsGraphRouter::QgsGraphRouter( const QgsGraph *graph, int strategyIndex )
+  : mForward( new QgsGraphSearchSpace() )
+  , mBackward( new QgsGraphSearchSpace() )
+{
+  std::shared_ptr< QgsGraphRouterData > data = std::make_shared< QgsGraphRouterData >();
+  data->vertexCount = graph->vertexCount();
+  data->graph = graph;
+
+  const int edgeCount = graph->edgeCount();
+  data->edgeFrom.reserve( edgeCount );
+  data->edgeTo.reserve( edgeCount );
+  data->costs.reserve( edgeCount );
+  for ( int i = 0; i < edgeCount; ++i )
+  {
+    const QgsGraphEdge &edge = graph->edge( i );
+    data->edgeFrom << edge.fromVertex();
+    data->edgeTo << edge.toVertex();
+    data->costs << edge.cost( strategyIndex ).toDouble();
+  }
+
+  // edges are appended to the vertex lists of the graph, so grouping them by vertex gives the same lists
+  buildRanges( data->edgeFrom, data->vertexCount, data->outOffsets, data->outEdges );
+  mData = data;
+}
+
+QgsGraphRouter::QgsGraphRouter( const QgsCompactGraph *graph, int strategyIndex )
+  : mForward( new QgsGraphSearchSpace() )
+  , mBackward( new QgsGraphSearchSpace() )
+{
+  // the arrays of the compact graph are implicitly shared, searches run over them without copies
+  std::shared_ptr< QgsGraphRouterData > data = std::make_shared< QgsGraphRouterData >();
+  data->vertexCount = graph->vertexCount();
+  data->edgeFrom = graph->mEdgeFrom;
+  data->edgeTo = graph->mEdgeTo;
+  data->costs = graph->strategyCosts( strategyIndex );
+  if ( data->costs.size() != graph->edgeCount() )
+    data->costs.fill( 0, graph->edgeCount() );
+  data->outOffsets = graph->mOutOffsets;
+  data->outEdges = graph->mOutEdges;
+  data->inOffsets = graph->mInOffsets;
+  data->inEdges = graph->mInEdges;
+  data->x = graph->mX;
+  data->y = graph->mY;
+  mData = data;
+}
+
+QgsGraphRouter::QgsGraphRouter( const QgsGraphRouter &other )
+  : mData( other.mData )
+  , mForward( new QgsGraphSearchSpace() )
+  , mBackward( new QgsGraphSearchSpace() )
+  , mAlgorithm( other.mAlgorithm )
+{
+}
+
+QgsGraphRouter &QgsGraphRouter::operator=( const QgsGraphRouter &other )
+{
+  if ( this != &other )
+  {
+    mData = other.mData;
+    mForward.reset( new QgsGraphSearchSpace() );
+    mBackward.reset( new QgsGraphSearchSpace() );
+    mAlgorithm = other.mAlgorithm;
+    mSettledCount = 0;
+  }
+  return *this;
+}
+
+QgsGraphRouter::~QgsGraphRouter() = default;
+
+int QgsGraphRouter::vertexCount() const
+{
+  return mData->vertexCount;
+}
+
+QVector< int > QgsGraphRouter::shortestPath( int fromVertexIdx, int toVertexIdx, double *cost )
+{
+  mSettledCount = 0;
+  QVector< int > path;
+  double pathCost = std::numeric_limits< double >::infinity();
+
+  const QgsGraphRouterData &data = *mData;
+  if ( fromVertexIdx < 0 || fromVertexIdx >= data.vertexCount || toVertexIdx < 0 || toVertexIdx >= data.vertexCount )
+  {
+    // invalid vertices
+  }
+  else if ( fromVertexIdx == toVertexIdx )
+  {
+    pathCost = 0;
+  }
+  else if ( mAlgorithm == BidirectionalDijkstra )
+  {
+    int meetingVertex = -1;
+    pathCost = bidirectionalPath( fromVertexIdx, toVertexIdx, meetingVertex );
+    if ( meetingVertex != -1 )
+    {
+      int vertex = meetingVertex;
+      while ( vertex != fromVertexIdx )
+      {
+        const int edge = mForward->edge( vertex );
+        path.push_front( edge );
+        vertex = data.edgeFrom[ edge ];
+      }
+      vertex = meetingVertex;
+      while ( vertex != toVertexIdx )
+      {
+        const int edge = mBackward->edge( vertex );
+        path.push_back( edge );
+        vertex = data.edgeTo[ edge ];
+      }
+    }
+  }
+  else
+  {
+    pathCost = dijkstraPath( fromVertexIdx, toVertexIdx, mAlgorithm == AStar );
+    if ( std::isfinite( pathCost ) )
+    {
+      int vertex = toVertexIdx;
+      while ( vertex != fromVertexIdx )
+      {
+        const int edge = mForward->edge( vertex );
+        path.push_back( edge );
+        vertex = data.edgeFrom[ edge ];
+      }
+      std::reverse( path.begin(), path.end() );
+    }
+  }
+
+  if ( cost )
+    *cost = pathCost;
+  return path;
+}
+
+bool QgsGraphRouter::shortestTree( int startVertexIdx, QVector<int> &resultTree, QVector<double> &resultCost, Direction direction, double maxCost )
+{
+  mSettledCount = 0;
+  const QgsGraphRouterData &data = *mData;
+  if ( startVertexIdx < 0 || startVertexIdx >= data.vertexCount )
+    return false;
+
+  const QgsGraphRouterEdges adjacency = routerEdges( data, direction == Backward );
+  QgsGraphSearchSpace &space = *mForward;
+  space.reset( data.vertexCount );
+  space.update( startVertexIdx, 0, -1 );
+  space.heap.push( startVertexIdx, 0 );
+
+  const bool limited = maxCost >= 0;
+  while ( !space.heap.isEmpty() )
+  {
+    if ( limited && space.heap.topKey() > maxCost )
+      break;
+
+    const int vertex = space.heap.pop();
+    space.settle( vertex );
+    mSettledCount++;
+
+    const double vertexCost = space.cost( vertex );
+    for ( int i = adjacency.offsets[ vertex ]; i < adjacency.offsets[ vertex + 1 ]; ++i )
+    {
+      const int edge = adjacency.edges[ i ];
+      const int next = adjacency.vertices[ edge ];
+      const double nextCost = vertexCost + adjacency.costs[ edge ];
+      if ( nextCost < space.cost( next ) )
+      {
+        space.update( next, nextCost, edge );
+        space.heap.push( next, nextCost );
+      }
+    }
+  }
+
+  resultTree.fill( -1, data.vertexCount );
+  resultCost.fill( std::numeric_limits< double >::infinity(), data.vertexCount );
+  for ( int i = 0; i < data.vertexCount; ++i )
+  {
+    if ( space.isSettled( i ) )
+    {
+      resultTree[ i ] = space.edge( i );
+      resultCost[ i ] = space.cost( i );
+    }
+  }
+  return true;
+}
+
+double QgsGraphRouter::dijkstraPath( int fromVertexIdx, int toVertexIdx, bool useHeuristic )
+{
+  const QgsGraphRouterData &data = *mData;
+  const QgsGraphRouterEdges adjacency = routerEdges( data, false );
+  QgsGraphSearchSpace &space = *mForward;
+  space.reset( data.vertexCount );
+
+  double scale = 0;
+  const double *x = nullptr;
+  const double *y = nullptr;
+  double targetX = 0;
+  double targetY = 0;
+  if ( useHeuristic )
+  {
+    buildHeuristic( data );
+    scale = data.heuristicScale;
+    x = data.x.constData();
+    y = data.y.constData();
+    targetX = x[ toVertexIdx ];
+    targetY = y[ toVertexIdx ];
+  }
+  auto heuristic = [scale, x, y, targetX, targetY]( int vertex ) -> double
+  {
+    return scale > 0 ? scale * std::hypot( x[ vertex ] - targetX, y[ vertex ] - targetY ) : 0.0;
+  };
+
+  space.update( fromVertexIdx, 0, -1 );
+  space.heap.push( fromVertexIdx, heuristic( fromVertexIdx ) );
+  while ( !space.heap.isEmpty() )
+  {
+    const int vertex = space.heap.pop();
+    space.settle( vertex );
+    mSettledCount++;
+    if ( vertex == toVertexIdx )
+      return space.cost( vertex );
+
+    const double vertexCost = space.cost( vertex );
+    for ( int i = adjacency.offsets[ vertex ]; i < adjacency.offsets[ vertex + 1 ]; ++i )
+    {
+      const int edge = adjacency.edges[ i ];
+      const int next = adjacency.vertices[ edge ];
+      const double nextCost = vertexCost + adjacency.costs[ edge ];
+      if ( nextCost < space.cost( next ) )
+      {
+        space.update( next, nextCost, edge );
+        space.heap.push( next, nextCost + heuristic( next ) );
+      }
+    }
+  }
+  return std::numeric_limits< double >::infinity();
+}
+
+double QgsGraphRouter::bidirectionalPath( int fromVertexIdx, int toVertexIdx, int &meetingVertex )
+{
+  const QgsGraphRouterData &data = *mData;
+  QgsGraphSearchSpace &forward = *mForward;
+  QgsGraphSearchSpace &backward = *mBackward;
+  const QgsGraphRouterEdges forwardEdges = routerEdges( data, false );
+  const QgsGraphRouterEdges backwardEdges = routerEdges( data, true );
+  forward.reset( data.vertexCount );
+  backward.reset( data.vertexCount );
+
+  forward.update( fromVertexIdx, 0, -1 );
+  forward.heap.push( fromVertexIdx, 0 );
+  backward.update( toVertexIdx, 0, -1 );
+  backward.heap.push( toVertexIdx, 0 );
+
+  double best = std::numeric_limits< double >::infinity();
+  meetingVertex = -1;
+  while ( !forward.heap.isEmpty() || !backward.heap.isEmpty() )
+  {
+    // no unsettled vertex can improve on the best path found so far
+    if ( forward.heap.topKey() + backward.heap.topKey() >= best )
+      break;
+
+    const bool forwardStep = forward.heap.topKey() <= backward.heap.topKey();
+    QgsGraphSearchSpace &space = forwardStep ? forward : backward;
+    const QgsGraphSearchSpace &other = forwardStep ? backward : forward;
+    const QgsGraphRouterEdges &adjacency = forwardStep ? forwardEdges : backwardEdges;
+
+    const int vertex = space.heap.pop();
+    space.settle( vertex );
+    mSettledCount++;
+
+    const double vertexCost = space.cost( vertex );
+    for ( int i = adjacency.offsets[ vertex ]; i < adjacency.offsets[ vertex + 1 ]; ++i )
+    {
+      const int edge = adjacency.edges[ i ];
+      const int next = adjacency.vertices[ edge ];
+      const double nextCost = vertexCost + adjacency.costs[ edge ];
+      if ( nextCost < space.cost( next ) )
+      {
+        space.update( next, nextCost, edge );
+        space.heap.push( next, nextCost );
+      }
+
+      const double total = space.cost( next ) + other.cost( next );
+      if ( total < best )
+      {
+        best = total;
+        meetingVertex = next;
+      }
+    }
+  }
+  return best;
+}
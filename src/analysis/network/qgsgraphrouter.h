@@ -0,0 +1,164 @@
+/***************************************************************************
+  qgsgraphrouter.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSGRAPHROUTER_H
+#define QGSGRAPHROUTER_H
+
+#include <QVector>
+#include <memory>
+
+#include "qgis_sip.h"
+#include "qgis_analysis.h"
+
+class QgsGraph;
+class QgsCompactGraph;
+struct QgsGraphRouterData;
+class QgsGraphSearchSpace;
+
+/**
+ * \ingroup analysis
+ * \class QgsGraphRouter
+ * \brief Shortest path engine for repeated queries over an immutable QgsGraph.
+ *
+ * On construction the router flattens the edges of the graph and their costs for
+ * a single strategy into contiguous arrays, and afterwards runs searches over
+ * them using an indexed d-ary heap. The arrays only needed by backward searches
+ * and A* are built by the first query using them. Scratch arrays are kept between
+ * queries, so running many queries with the same router does not reallocate them.
+ *
+ * Point to point queries can be solved with plain Dijkstra, bidirectional Dijkstra
+ * or A* (see setAlgorithm()). The A* heuristic is the straight line distance to the
+ * destination vertex scaled by the smallest cost per unit of length found in the
+ * graph, which keeps it admissible for any strategy and any graph CRS.
+ *
+ * A router is not thread safe. Copies of a router share the flattened graph but
+ * have their own scratch arrays, so a copy per thread can be used to run queries
+ * concurrently.
+ *
+ * The source graph must not be modified or deleted while the router is in use.
+ *
+ * \since QGIS 3.18
+ */
+class ANALYSIS_EXPORT QgsGraphRouter
+{
+  public:
+
+    //! Algorithm used for point to point queries
+    enum Algorithm
+    {
+      Dijkstra, //!< Unidirectional Dijkstra search, stopped once the destination is settled
+      BidirectionalDijkstra, //!< Dijkstra searches from both ends, stopped once they meet
+      AStar, //!< A* search guided by a straight line distance heuristic
+    };
+
+    //! Direction of a shortest path tree
+    enum Direction
+    {
+      Forward, //!< Tree of paths from the start vertex to all other vertices
+      Backward, //!< Tree of paths from all other vertices to the start vertex
+    };
+
+    /**
+     * Constructor for QgsGraphRouter, for the specified \a graph and edge cost \a strategyIndex.
+     */
+    QgsGraphRouter( const QgsGraph *graph, int strategyIndex );
+
+    /**
+     * Constructor for QgsGraphRouter, for the specified compact \a graph and edge cost \a strategyIndex.
+     *
+     * Vertex and edge indices used by the router are the ones of the compact graph.
+     * The router shares the arrays of the compact graph instead of copying them.
+     */
+    QgsGraphRouter( const QgsCompactGraph *graph, int strategyIndex );
+
+    /**
+     * Copy constructor. The copy shares the graph data but gets its own scratch arrays.
+     */
+    QgsGraphRouter( const QgsGraphRouter &other );
+
+    /**
+     * Assignment operator. The copy shares the graph data but gets its own scratch arrays.
+     */
+    QgsGraphRouter &operator=( const QgsGraphRouter &other ) SIP_SKIP;
+
+    ~QgsGraphRouter();
+
+    /**
+     * Returns the algorithm used by shortestPath().
+     * \see setAlgorithm()
+     */
+    Algorithm algorithm() const { return mAlgorithm; }
+
+    /**
+     * Sets the \a algorithm used by shortestPath(). The default is A*.
+     * \see algorithm()
+     */
+    void setAlgorithm( Algorithm algorithm ) { mAlgorithm = algorithm; }
+
+    /**
+     * Returns the number of vertices in the routed graph.
+     */
+    int vertexCount() const;
+
+    /**
+     * Calculates the shortest path from \a fromVertexIdx to \a toVertexIdx.
+     *
+     * Returns the graph edge indices making up the path, in travel order. An empty
+     * list is returned if the destination is unreachable or equal to the origin,
+     * in which case \a cost is set to infinity or 0 respectively.
+     *
+     * The search stops as soon as the destination is reached, edge costs must not be negative.
+     */
+    QVector< int > shortestPath( int fromVertexIdx, int toVertexIdx, double *cost SIP_OUT = nullptr );
+
+    /**
+     * Calculates a shortest path tree rooted at \a startVertexIdx.
+     *
+     * For a Forward tree, \a resultTree[ v ] is the index of the edge entering vertex v
+     * on the shortest path from the start vertex. For a Backward tree it is the index of
+     * the edge leaving vertex v on the shortest path towards the start vertex. Unreachable
+     * vertices and the start vertex itself have a value of -1.
+     *
+     * \a resultCost receives the path cost for each vertex, or infinity for unreachable
+     * vertices.
+     *
+     * Edge costs may be negative, as long as the graph has no cycle with a negative total cost.
+     *
+     * If \a maxCost is not negative the search stops once all vertices reachable within
+     * this cost have been found, and vertices beyond it are reported as unreachable.
+     *
+     * Returns FALSE if \a startVertexIdx is not a valid vertex index.
+     */
+    bool shortestTree( int startVertexIdx, QVector< int > &resultTree SIP_OUT, QVector< double > &resultCost SIP_OUT,
+                       Direction direction = Forward, double maxCost = -1 );
+
+    /**
+     * Returns the number of vertices settled by the last query. This is mainly useful
+     * to compare the efficiency of the different algorithms.
+     */
+    int settledVertexCount() const { return mSettledCount; }
+
+  private:
+
+    double dijkstraPath( int fromVertexIdx, int toVertexIdx, bool useHeuristic );
+    double bidirectionalPath( int fromVertexIdx, int toVertexIdx, int &meetingVertex );
+
+    std::shared_ptr< const QgsGraphRouterData > mData;
+    std::unique_ptr< QgsGraphSearchSpace > mForward;
+    std::unique_ptr< QgsGraphSearchSpace > mBackward;
+    Algorithm mAlgorithm = AStar;
+    int mSettledCount = 0;
+};
+
+#endif // QGSGRAPHROUTER_H
@@ -0,0 +1,325 @@
+/***************************************************************************
+  qgsgraphrouter_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSGRAPHROUTER_PRIVATE_H
+#define QGSGRAPHROUTER_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * \ingroup analysis
+ * \brief Indexed d-ary min-heap of vertex indices keyed by cost.
+ *
+ * Every vertex has at most one entry in the heap, and its key can be decreased
+ * in place. Positions are tracked in a vertex-indexed array, so the heap must
+ * be resized to the graph vertex count before use.
+ *
+ * \since QGIS 3.18
+ */
+class QgsGraphIndexedHeap
+{
+  public:
+
+    /**
+     * Resizes the heap to handle vertex indices in the range [0, \a vertexCount).
+     * Any existing entries are discarded.
+     */
+    void resize( int vertexCount )
+    {
+      mPositions.assign( vertexCount, -1 );
+      mKeys.clear();
+      mVertices.clear();
+    }
+
+    /**
+     * Returns the number of vertices which can be stored in the heap.
+     */
+    int capacity() const { return static_cast< int >( mPositions.size() ); }
+
+    /**
+     * Removes all entries from the heap. Cost is proportional to the number of
+     * entries currently stored, not the vertex count.
+     */
+    void clear()
+    {
+      for ( int vertex : mVertices )
+        mPositions[ vertex ] = -1;
+      mKeys.clear();
+      mVertices.clear();
+    }
+
+    /**
+     * Returns TRUE if the heap contains no entries.
+     */
+    bool isEmpty() const { return mVertices.empty(); }
+
+    /**
+     * Returns TRUE if \a vertex is currently stored in the heap.
+     */
+    bool contains( int vertex ) const { return mPositions[ vertex ] != -1; }
+
+    /**
+     * Inserts \a vertex with the given \a key, or decreases its key if it is
+     * already stored in the heap with a larger key.
+     */
+    void push( int vertex, double key )
+    {
+      int pos = mPositions[ vertex ];
+      if ( pos == -1 )
+      {
+        pos = static_cast< int >( mVertices.size() );
+        mVertices.push_back( vertex );
+        mKeys.push_back( key );
+        mPositions[ vertex ] = pos;
+      }
+      else if ( key < mKeys[ pos ] )
+      {
+        mKeys[ pos ] = key;
+      }
+      else
+      {
+        return;
+      }
+      siftUp( pos );
+    }
+
+    /**
+     * Inserts \a vertex with the given \a key, or changes its key if it is
+     * already stored in the heap.
+     */
+    void update( int vertex, double key )
+    {
+      const int pos = mPositions[ vertex ];
+      if ( pos == -1 )
+      {
+        push( vertex, key );
+        return;
+      }
+
+      const double previous = mKeys[ pos ];
+      mKeys[ pos ] = key;
+      if ( key < previous )
+        siftUp( pos );
+      else
+        siftDown( pos );
+    }
+
+    /**
+     * Returns the smallest key stored in the heap, or infinity if the heap is empty.
+     */
+    double topKey() const
+    {
+      return mKeys.empty() ? std::numeric_limits< double >::infinity() : mKeys.front();
+    }
+
+    /**
+     * Removes the entry with the smallest key and returns its vertex.
+     *
+     * The heap must not be empty.
+     */
+    int pop()
+    {
+      const int top = mVertices.front();
+      mPositions[ top ] = -1;
+
+      const int last = static_cast< int >( mVertices.size() ) - 1;
+      if ( last > 0 )
+      {
+        mVertices[ 0 ] = mVertices[ last ];
+        mKeys[ 0 ] = mKeys[ last ];
+        mPositions[ mVertices[ 0 ] ] = 0;
+      }
+      mVertices.pop_back();
+      mKeys.pop_back();
+
+      if ( !mVertices.empty() )
+        siftDown( 0 );
+      return top;
+    }
+
+  private:
+
+    static constexpr int ARITY = 4;
+
+    void siftUp( int pos )
+    {
+      const int vertex = mVertices[ pos ];
+      const double key = mKeys[ pos ];
+      while ( pos > 0 )
+      {
+        const int parent = ( pos - 1 ) / ARITY;
+        if ( mKeys[ parent ] <= key )
+          break;
+        mVertices[ pos ] = mVertices[ parent ];
+        mKeys[ pos ] = mKeys[ parent ];
+        mPositions[ mVertices[ pos ] ] = pos;
+        pos = parent;
+      }
+      mVertices[ pos ] = vertex;
+      mKeys[ pos ] = key;
+      mPositions[ vertex ] = pos;
+    }
+
+    void siftDown( int pos )
+    {
+      const int size = static_cast< int >( mVertices.size() );
+      const int vertex = mVertices[ pos ];
+      const double key = mKeys[ pos ];
+      while ( true )
+      {
+        const int first = pos * ARITY + 1;
+        if ( first >= size )
+          break;
+
+        int best = first;
+        const int end = std::min( first + ARITY, size );
+        for ( int child = first + 1; child < end; ++child )
+        {
+          if ( mKeys[ child ] < mKeys[ best ] )
+            best = child;
+        }
+        if ( key <= mKeys[ best ] )
+          break;
+
+        mVertices[ pos ] = mVertices[ best ];
+        mKeys[ pos ] = mKeys[ best ];
+        mPositions[ mVertices[ pos ] ] = pos;
+        pos = best;
+      }
+      mVertices[ pos ] = vertex;
+      mKeys[ pos ] = key;
+      mPositions[ vertex ] = pos;
+    }
+
+    std::vector< double > mKeys;
+    std::vector< int > mVertices;
+    std::vector< int > mPositions;
+};
+
+/**
+ * \ingroup analysis
+ * \brief Flattened, read-only adjacency of a graph in one direction.
+ *
+ * The edges leaving (or entering, for backward adjacency) vertex v are stored
+ * at indices [offsets[v], offsets[v + 1]).
+ *
+ * \since QGIS 3.18
+ */
+struct QgsGraphAdjacency
+{
+  //! Start index of each vertex' edges, with one extra trailing entry
+  std::vector< int > offsets;
+  //! Original QgsGraph edge index
+  std::vector< int > edges;
+  //! Vertex at the other end of the edge
+  std::vector< int > vertices;
+  //! Edge cost for the router strategy
+  std::vector< double > costs;
+};
+
+/**
+ * \ingroup analysis
+ * \brief Reusable per-query scratch arrays for one search direction.
+ *
+ * Arrays are sized once for the graph and invalidated between queries by
+ * bumping a stamp, so consecutive queries do not have to reinitialize them.
+ *
+ * \since QGIS 3.18
+ */
+class QgsGraphSearchSpace
+{
+  public:
+
+    /**
+     * Prepares the search space for a new query on a graph with \a vertexCount vertices.
+     */
+    void reset( int vertexCount )
+    {
+      if ( static_cast< int >( mStamps.size() ) != vertexCount )
+      {
+        mStamps.assign( vertexCount, 0 );
+        mCosts.resize( vertexCount );
+        mEdges.resize( vertexCount );
+        mSettled.assign( vertexCount, 0 );
+        mStamp = 0;
+      }
+      if ( heap.capacity() != vertexCount )
+        heap.resize( vertexCount );
+      else
+        heap.clear();
+
+      // stamp 0 marks untouched vertices, so a wrap around needs a full reset
+      if ( ++mStamp == 0 )
+      {
+        std::fill( mStamps.begin(), mStamps.end(), 0 );
+        std::fill( mSettled.begin(), mSettled.end(), 0 );
+        mStamp = 1;
+      }
+    }
+
+    //! Returns the tentative cost for \a vertex, or infinity if it was not reached yet
+    double cost( int vertex ) const
+    {
+      return mStamps[ vertex ] == mStamp ? mCosts[ vertex ] : std::numeric_limits< double >::infinity();
+    }
+
+    //! Returns the edge through which \a vertex was reached, or -1
+    int edge( int vertex ) const
+    {
+      return mStamps[ vertex ] == mStamp ? mEdges[ vertex ] : -1;
+    }
+
+    //! Records a tentative \a cost for \a vertex reached through \a edge
+    void update( int vertex, double cost, int edge )
+    {
+      mStamps[ vertex ] = mStamp;
+      mCosts[ vertex ] = cost;
+      mEdges[ vertex ] = edge;
+    }
+
+    //! Marks \a vertex as settled
+    void settle( int vertex ) { mSettled[ vertex ] = mStamp; }
+
+    //! Returns TRUE if \a vertex was settled in the current query
+    bool isSettled( int vertex ) const { return mSettled[ vertex ] == mStamp; }
+
+    QgsGraphIndexedHeap heap;
+
+  private:
+
+    std::vector< double > mCosts;
+    std::vector< int > mEdges;
+    std::vector< unsigned int > mStamps;
+    std::vector< unsigned int > mSettled;
+    unsigned int mStamp = 0;
+};
+
+/// @endcond
+
+#endif // QGSGRAPHROUTER_PRIVATE_H
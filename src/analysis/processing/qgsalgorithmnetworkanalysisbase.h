@@ -27,6 +27,13 @@
 #include "qgsgraphbuilder.h"
 #include "qgsvectorlayerdirector.h"
 #include "qgsapplication.h"
+#include "qgsprocessingfeedback.h"
+
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <vector>
 
 ///@cond PRIVATE
 
@@ -60,6 +67,67 @@ class QgsNetworkAnalysisAlgorithmBase : public QgsProcessingAlgorithm
      */
     void loadPoints( QgsFeatureSource *source, QVector< QgsPointXY > &points, QHash< int, QgsAttributes > &attributes, QgsProcessingContext &context, QgsProcessingFeedback *feedback );
 
+    /**
+     * Runs independent per origin calculations for the origins in [0, \a count) concurrently
+     * on the global thread pool.
+     *
+     * Origins are processed in batches split into one contiguous chunk per thread. Each chunk calls
+     * \a createWorker once to get its own scratch state (e.g. a copy of a QgsGraphRouter), then
+     * \a compute( worker, index ) for each of its origins. Results are passed to \a consume( index, result )
+     * on the calling thread in origin order, so outputs do not depend on the thread count.
+     *
+     * \a compute must only read shared state. Processing stops early if \a feedback is canceled.
+     */
+    template <typename Result, typename WorkerFactory, typename Compute, typename Consume>
+    void processOriginsInParallel( int count, const WorkerFactory &createWorker, const Compute &compute, const Consume &consume, QgsProcessingFeedback *feedback )
+    {
+      const int threads = std::max( 1, QThreadPool::globalInstance()->maxThreadCount() );
+      // bounds the memory held by results waiting to be consumed
+      const int batchSize = threads * 16;
+      const double step = count > 0 ? 100.0 / count : 1;
+
+      std::vector< Result > results;
+      for ( int batchStart = 0; batchStart < count; batchStart += batchSize )
+      {
+        if ( feedback->isCanceled() )
+          break;
+
+        const int batchEnd = std::min( count, batchStart + batchSize );
+        results.clear();
+        results.resize( batchEnd - batchStart );
+
+        auto runChunk = [&]( int chunkStart, int chunkEnd )
+        {
+          auto worker = createWorker();
+          for ( int i = chunkStart; i < chunkEnd && !feedback->isCanceled(); ++i )
+            results[ i - batchStart ] = compute( worker, i );
+        };
+
+        const int chunkCount = std::min( threads, batchEnd - batchStart );
+        if ( chunkCount <= 1 )
+        {
+          runChunk( batchStart, batchEnd );
+        }
+        else
+        {
+          std::vector< QFuture< void > > futures;
+          futures.reserve( chunkCount );
+          const int chunkSize = ( batchEnd - batchStart + chunkCount - 1 ) / chunkCount;
+          for ( int chunkStart = batchStart; chunkStart < batchEnd; chunkStart += chunkSize )
+            futures.push_back( QtConcurrent::run( runChunk, chunkStart, std::min( batchEnd, chunkStart + chunkSize ) ) );
+          for ( QFuture< void > &future : futures )
+            future.waitForFinished();
+        }
+
+        if ( feedback->isCanceled() )
+          break;
+
+        for ( int i = batchStart; i < batchEnd; ++i )
+          consume( i, results[ i - batchStart ] );
+        feedback->setProgress( batchEnd * step );
+      }
+    }
+
     std::unique_ptr< QgsFeatureSource > mNetwork;
     QgsVectorLayerDirector *mDirector = nullptr;
     std::unique_ptr< QgsGraphBuilder > mBuilder;
@@ -18,7 +18,7 @@
 #include "qgsalgorithmserviceareafromlayer.h"
 
 #include "qgsgeometryutils.h"
-#include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
 
 ///@cond PRIVATE
 
@@ -109,7 +109,7 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
   mDirector->makeGraph( mBuilder.get(), points, snappedPoints, feedback );
 
   feedback->pushInfo( QObject::tr( "Calculating service areas…" ) );
-  QgsGraph *graph = mBuilder->graph();
+  std::unique_ptr< QgsGraph > graph( mBuilder->graph() );
 
   QgsFields fields = startPoints->fields();
   fields.append( QgsField( QStringLiteral( "type" ), QVariant::String ) );
@@ -123,39 +123,51 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
   std::unique_ptr< QgsFeatureSink > linesSink( parameterAsSink( parameters, QStringLiteral( "OUTPUT_LINES" ), context, linesSinkId, fields,
       QgsWkbTypes::MultiLineString, mNetwork->sourceCrs() ) );
 
-  int idxStart;
-  QString origPoint;
-  QVector< int > tree;
-  QVector< double > costs;
+  // vertices beyond the travel cost are only needed to find the boundary points
+  const bool needBounds = pointsSink && includeBounds;
+  const double maxCost = needBounds ? -1 : travelCost;
 
-  int inboundEdgeIndex;
-  double startVertexCost, endVertexCost;
-  QgsPointXY startPoint, endPoint;
-  QgsGraphEdge edge;
+  struct Worker
+  {
+    QgsGraphRouter router;
+    QVector< int > tree;
+    QVector< double > costs;
+  };
 
-  QgsFeature feat;
-  QgsAttributes attributes;
+  struct ServiceArea
+  {
+    QgsGeometry within;
+    QgsGeometry upper;
+    QgsGeometry lower;
+    QgsGeometry lines;
+  };
+
+  // the graph is only read while calculating, each thread gets its own router scratch arrays
+  const QgsGraphRouter router( graph.get(), 0 );
+  auto createWorker = [&router]() -> Worker
+  {
+    return Worker{ router, QVector< int >(), QVector< double >() };
+  };
 
-  int step =  snappedPoints.size() > 0 ? 100.0 / snappedPoints.size() : 1;
-  for ( int i = 0; i < snappedPoints.size(); i++ )
+  auto calculateServiceArea = [&]( Worker & worker, int i ) -> ServiceArea
   {
-    if ( feedback->isCanceled() )
+    ServiceArea result;
+    const int idxStart = graph->findVertex( snappedPoints.at( i ) );
+    QVector< int > &tree = worker.tree;
+    QVector< double > &costs = worker.costs;
+    if ( !worker.router.shortestTree( idxStart, tree, costs, QgsGraphRouter::Forward, maxCost ) )
     {
-      break;
+      tree.clear();
+      costs.clear();
     }
 
-    idxStart = graph->findVertex( snappedPoints.at( i ) );
-    origPoint = points.at( i ).toString();
-
-    QgsGraphAnalyzer::dijkstra( graph, idxStart, 0, &tree, &costs );
-
     QgsMultiPointXY areaPoints;
     QgsMultiPolylineXY lines;
     QSet< int > vertices;
 
     for ( int j = 0; j < costs.size(); j++ )
     {
-      inboundEdgeIndex = tree.at( j );
+      const int inboundEdgeIndex = tree.at( j );
 
       if ( inboundEdgeIndex == -1 && j != idxStart )
       {
@@ -163,7 +175,7 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
         continue;
       }
 
-      startVertexCost = costs.at( j );
+      const double startVertexCost = costs.at( j );
       if ( startVertexCost > travelCost )
       {
         // vertex is too expensive, discard
@@ -171,15 +183,15 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
       }
 
       vertices.insert( j );
-      startPoint = graph->vertex( j ).point();
+      const QgsPointXY startPoint = graph->vertex( j ).point();
 
       // find all edges coming from this vertex
       const QList< int > outgoingEdges = graph->vertex( j ).outgoingEdges() ;
       for ( int edgeId : outgoingEdges )
       {
-        edge = graph->edge( edgeId );
-        endVertexCost = startVertexCost + edge.cost( 0 ).toDouble();
-        endPoint = graph->vertex( edge.toVertex() ).point();
+        const QgsGraphEdge &edge = graph->edge( edgeId );
+        const double endVertexCost = startVertexCost + edge.cost( 0 ).toDouble();
+        const QgsPointXY endPoint = graph->vertex( edge.toVertex() ).point();
         if ( endVertexCost <= travelCost )
         {
           // end vertex is cheap enough to include
@@ -206,51 +218,64 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
     {
       areaPoints.push_back( graph->vertex( v ).point() );
     }
+    result.within = QgsGeometry::fromMultiPointXY( areaPoints );
 
-    if ( pointsSink )
+    if ( needBounds )
     {
-      QgsGeometry geomPoints = QgsGeometry::fromMultiPointXY( areaPoints );
-      feat.setGeometry( geomPoints );
-      attributes = sourceAttributes.value( i + 1 );
-      attributes << QStringLiteral( "within" ) << origPoint;
-      feat.setAttributes( attributes );
-      pointsSink->addFeature( feat, QgsFeatureSink::FastInsert );
+      QgsMultiPointXY upperBoundary, lowerBoundary;
+      QVector< int > nodes;
+      nodes.reserve( costs.size() );
 
-      if ( includeBounds )
+      for ( int v = 0; v < costs.size(); v++ )
       {
-        QgsMultiPointXY upperBoundary, lowerBoundary;
-        QVector< int > nodes;
-        nodes.reserve( costs.size() );
-
-        int vertexId;
-        for ( int v = 0; v < costs.size(); v++ )
+        if ( costs.at( v ) > travelCost && tree.at( v ) != -1 )
         {
-          if ( costs.at( v ) > travelCost && tree.at( v ) != -1 )
+          const int vertexId = graph->edge( tree.at( v ) ).fromVertex();
+          if ( costs.at( vertexId ) <= travelCost )
           {
-            vertexId = graph->edge( tree.at( v ) ).fromVertex();
-            if ( costs.at( vertexId ) <= travelCost )
-            {
-              nodes.push_back( v );
-            }
+            nodes.push_back( v );
           }
-        } // costs
+        }
+      } // costs
 
-        for ( int n : qgis::as_const( nodes ) )
-        {
-          upperBoundary.push_back( graph->vertex( graph->edge( tree.at( n ) ).toVertex() ).point() );
-          lowerBoundary.push_back( graph->vertex( graph->edge( tree.at( n ) ).fromVertex() ).point() );
-        } // nodes
+      for ( int n : qgis::as_const( nodes ) )
+      {
+        upperBoundary.push_back( graph->vertex( graph->edge( tree.at( n ) ).toVertex() ).point() );
+        lowerBoundary.push_back( graph->vertex( graph->edge( tree.at( n ) ).fromVertex() ).point() );
+      } // nodes
 
-        QgsGeometry geomUpper = QgsGeometry::fromMultiPointXY( upperBoundary );
-        QgsGeometry geomLower = QgsGeometry::fromMultiPointXY( lowerBoundary );
+      result.upper = QgsGeometry::fromMultiPointXY( upperBoundary );
+      result.lower = QgsGeometry::fromMultiPointXY( lowerBoundary );
+    }
+
+    if ( linesSink )
+      result.lines = QgsGeometry::fromMultiPolylineXY( lines );
+
+    return result;
+  };
 
-        feat.setGeometry( geomUpper );
+  QgsFeature feat;
+  QgsAttributes attributes;
+  auto writeServiceArea = [&]( int i, const ServiceArea & area )
+  {
+    const QString origPoint = points.at( i ).toString();
+    if ( pointsSink )
+    {
+      feat.setGeometry( area.within );
+      attributes = sourceAttributes.value( i + 1 );
+      attributes << QStringLiteral( "within" ) << origPoint;
+      feat.setAttributes( attributes );
+      pointsSink->addFeature( feat, QgsFeatureSink::FastInsert );
+
+      if ( needBounds )
+      {
+        feat.setGeometry( area.upper );
         attributes = sourceAttributes.value( i + 1 );
         attributes << QStringLiteral( "upper" ) << origPoint;
         feat.setAttributes( attributes );
         pointsSink->addFeature( feat, QgsFeatureSink::FastInsert );
 
-        feat.setGeometry( geomLower );
+        feat.setGeometry( area.lower );
         attributes = sourceAttributes.value( i + 1 );
         attributes << QStringLiteral( "lower" ) << origPoint;
         feat.setAttributes( attributes );
@@ -260,16 +285,15 @@ QVariantMap QgsServiceAreaFromLayerAlgorithm::processAlgorithm( const QVariantMa
 
     if ( linesSink )
     {
-      QgsGeometry geomLines = QgsGeometry::fromMultiPolylineXY( lines );
-      feat.setGeometry( geomLines );
+      feat.setGeometry( area.lines );
       attributes = sourceAttributes.value( i + 1 );
       attributes << QStringLiteral( "lines" ) << origPoint;
       feat.setAttributes( attributes );
       linesSink->addFeature( feat, QgsFeatureSink::FastInsert );
     }
+  };
 
-    feedback->setProgress( i * step );
-  } // snappedPoints
+  processOriginsInParallel< ServiceArea >( snappedPoints.size(), createWorker, calculateServiceArea, writeServiceArea, feedback );
 
   QVariantMap outputs;
   if ( pointsSink )
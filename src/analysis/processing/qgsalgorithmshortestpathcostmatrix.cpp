@@ -0,0 +1,188 @@
+/***************************************************************************
+                         qgsalgorithmshortestpathcostmatrix.cpp
+                         ---------------------
+    begin                : March 2021
+    copyright            : (C) 2021 by QGIS contributors
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsalgorithmshortestpathcostmatrix.h"
+
+#include "qgsgraphcontractionhierarchy.h"
+
+#include <cmath>
+
+///@cond PRIVATE
+
+QString QgsShortestPathCostMatrixAlgorithm::name() const
+{
+  return QStringLiteral( "shortestpathcostmatrix" );
+}
+
+QString QgsShortestPathCostMatrixAlgorithm::displayName() const
+{
+  return QObject::tr( "Shortest path cost matrix (layer to layer)" );
+}
+
+QStringList QgsShortestPathCostMatrixAlgorithm::tags() const
+{
+  return QObject::tr( "network,path,shortest,fastest,matrix,origin,destination,od" ).split( ',' );
+}
+
+QString QgsShortestPathCostMatrixAlgorithm::shortHelpString() const
+{
+  return QObject::tr( "This algorithm computes the cost of the optimal (shortest or fastest) route from every start point "
+                      "to every end point, and outputs them as a table of origin and destination feature ids.\n\n"
+                      "Routes are computed using a contraction hierarchy of the network. Building the hierarchy "
+                      "is the most expensive step, so it can optionally be saved to a file and read back by later runs "
+                      "on the same network and points. A hierarchy file is only used if it matches the network graph, "
+                      "otherwise the hierarchy is rebuilt." );
+}
+
+QgsShortestPathCostMatrixAlgorithm *QgsShortestPathCostMatrixAlgorithm::createInstance() const
+{
+  return new QgsShortestPathCostMatrixAlgorithm();
+}
+
+void QgsShortestPathCostMatrixAlgorithm::initAlgorithm( const QVariantMap & )
+{
+  addCommonParams();
+  addParameter( new QgsProcessingParameterFeatureSource( QStringLiteral( "START_POINTS" ), QObject::tr( "Vector layer with start points" ), QList< int >() << QgsProcessing::TypeVectorPoint ) );
+  addParameter( new QgsProcessingParameterFeatureSource( QStringLiteral( "END_POINTS" ), QObject::tr( "Vector layer with end points" ), QList< int >() << QgsProcessing::TypeVectorPoint ) );
+
+  std::unique_ptr< QgsProcessingParameterFile > hierarchy = qgis::make_unique< QgsProcessingParameterFile >( QStringLiteral( "HIERARCHY" ),
+      QObject::tr( "Existing contraction hierarchy file" ), QgsProcessingParameterFile::File, QStringLiteral( "qch" ), QVariant(), true );
+  hierarchy->setFlags( hierarchy->flags() | QgsProcessingParameterDefinition::FlagAdvanced );
+  addParameter( hierarchy.release() );
+
+  addParameter( new QgsProcessingParameterFeatureSink( QStringLiteral( "OUTPUT" ), QObject::tr( "Cost matrix" ), QgsProcessing::TypeVector ) );
+
+  std::unique_ptr< QgsProcessingParameterFileDestination > hierarchyOutput = qgis::make_unique< QgsProcessingParameterFileDestination >( QStringLiteral( "HIERARCHY_OUTPUT" ),
+      QObject::tr( "Contraction hierarchy" ), QObject::tr( "Contraction hierarchy files" ) + QStringLiteral( " (*.qch)" ), QVariant(), true, false );
+  hierarchyOutput->setFlags( hierarchyOutput->flags() | QgsProcessingParameterDefinition::FlagAdvanced );
+  addParameter( hierarchyOutput.release() );
+}
+
+void QgsShortestPathCostMatrixAlgorithm::loadFeaturePoints( QgsFeatureSource *source, QVector< QgsPointXY > &points, QVector< QgsFeatureId > &ids, QgsProcessingContext &context, QgsProcessingFeedback *feedback )
+{
+  QgsFeature feat;
+  QgsFeatureIterator features = source->getFeatures( QgsFeatureRequest().setNoAttributes().setDestinationCrs( mNetwork->sourceCrs(), context.transformContext() ) );
+  while ( features.nextFeature( feat ) )
+  {
+    if ( feedback->isCanceled() )
+      break;
+
+    if ( !feat.hasGeometry() )
+      continue;
+
+    QgsGeometry geom = feat.geometry();
+    QgsAbstractGeometry::vertex_iterator it = geom.vertices_begin();
+    if ( it == geom.vertices_end() )
+      continue;
+
+    points.push_back( QgsPointXY( *it ) );
+    ids.push_back( feat.id() );
+  }
+}
+
+QVariantMap QgsShortestPathCostMatrixAlgorithm::processAlgorithm( const QVariantMap &parameters, QgsProcessingContext &context, QgsProcessingFeedback *feedback )
+{
+  loadCommonParams( parameters, context, feedback );
+
+  std::unique_ptr< QgsFeatureSource > startPoints( parameterAsSource( parameters, QStringLiteral( "START_POINTS" ), context ) );
+  if ( !startPoints )
+    throw QgsProcessingException( invalidSourceError( parameters, QStringLiteral( "START_POINTS" ) ) );
+
+  std::unique_ptr< QgsFeatureSource > endPoints( parameterAsSource( parameters, QStringLiteral( "END_POINTS" ), context ) );
+  if ( !endPoints )
+    throw QgsProcessingException( invalidSourceError( parameters, QStringLiteral( "END_POINTS" ) ) );
+
+  const QString hierarchyPath = parameterAsFile( parameters, QStringLiteral( "HIERARCHY" ), context );
+  const QString hierarchyOutputPath = parameterAsFileOutput( parameters, QStringLiteral( "HIERARCHY_OUTPUT" ), context );
+
+  QgsFields fields;
+  fields.append( QgsField( QStringLiteral( "origin_id" ), QVariant::LongLong ) );
+  fields.append( QgsField( QStringLiteral( "destination_id" ), QVariant::LongLong ) );
+  fields.append( QgsField( QStringLiteral( "cost" ), QVariant::Double ) );
+
+  QString dest;
+  std::unique_ptr< QgsFeatureSink > sink( parameterAsSink( parameters, QStringLiteral( "OUTPUT" ), context, dest, fields, QgsWkbTypes::NoGeometry, QgsCoordinateReferenceSystem() ) );
+  if ( !sink )
+    throw QgsProcessingException( invalidSinkError( parameters, QStringLiteral( "OUTPUT" ) ) );
+
+  feedback->pushInfo( QObject::tr( "Loading points…" ) );
+  QVector< QgsPointXY > points;
+  QVector< QgsFeatureId > startIds;
+  QVector< QgsFeatureId > endIds;
+  loadFeaturePoints( startPoints.get(), points, startIds, context, feedback );
+  const int startCount = points.size();
+  loadFeaturePoints( endPoints.get(), points, endIds, context, feedback );
+
+  feedback->pushInfo( QObject::tr( "Building graph…" ) );
+  QVector< QgsPointXY > snappedPoints;
+  mDirector->makeGraph( mBuilder.get(), points, snappedPoints, feedback );
+  std::unique_ptr< QgsGraph > graph( mBuilder->graph() );
+
+  QgsGraphContractionHierarchy hierarchy;
+  if ( !hierarchyPath.isEmpty() && hierarchy.readFromFile( hierarchyPath ) && hierarchy.isBuiltFor( graph.get(), 0 ) )
+  {
+    feedback->pushInfo( QObject::tr( "Using contraction hierarchy from %1" ).arg( hierarchyPath ) );
+  }
+  else
+  {
+    if ( !hierarchyPath.isEmpty() )
+      feedback->pushInfo( QObject::tr( "Contraction hierarchy from %1 does not match the network" ).arg( hierarchyPath ) );
+
+    feedback->pushInfo( QObject::tr( "Building contraction hierarchy…" ) );
+    if ( !hierarchy.build( graph.get(), 0, feedback ) )
+      return QVariantMap();
+  }
+
+  QVariantMap outputs;
+  if ( !hierarchyOutputPath.isEmpty() )
+  {
+    if ( !hierarchy.writeToFile( hierarchyOutputPath ) )
+      throw QgsProcessingException( QObject::tr( "Could not write contraction hierarchy to %1" ).arg( hierarchyOutputPath ) );
+    outputs.insert( QStringLiteral( "HIERARCHY_OUTPUT" ), hierarchyOutputPath );
+  }
+
+  QVector< int > sources;
+  sources.reserve( startCount );
+  for ( int i = 0; i < startCount; ++i )
+    sources << graph->findVertex( snappedPoints.at( i ) );
+  QVector< int > targets;
+  targets.reserve( points.size() - startCount );
+  for ( int i = startCount; i < points.size(); ++i )
+    targets << graph->findVertex( snappedPoints.at( i ) );
+
+  feedback->pushInfo( QObject::tr( "Calculating cost matrix…" ) );
+  const QVector< double > costs = hierarchy.costMatrix( sources, targets, feedback );
+  if ( feedback->isCanceled() )
+    return QVariantMap();
+
+  QgsFeature feat;
+  feat.setFields( fields );
+  int index = 0;
+  for ( int i = 0; i < sources.size(); ++i )
+  {
+    for ( int j = 0; j < targets.size(); ++j, ++index )
+    {
+      const double cost = costs.at( index );
+      feat.setAttributes( QgsAttributes() << startIds.at( i ) << endIds.at( j ) << ( std::isfinite( cost ) ? QVariant( cost / mMultiplier ) : QVariant() ) );
+      sink->addFeature( feat, QgsFeatureSink::FastInsert );
+    }
+  }
+
+  outputs.insert( QStringLiteral( "OUTPUT" ), dest );
+  return outputs;
+}
+
+///@endcond
@@ -17,7 +17,7 @@
 
 #include "qgsalgorithmshortestpathlayertopoint.h"
 
-#include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
 
 #include "qgsmessagelog.h"
 
@@ -92,8 +92,11 @@ QVariantMap QgsShortestPathLayerToPointAlgorithm::processAlgorithm( const QVaria
   int idxStart;
   int currentIdx;
 
+  // a single backward tree from the end point gives the paths from every start point
   QVector< int > tree;
   QVector< double > costs;
+  QgsGraphRouter router( graph, 0 );
+  router.shortestTree( idxEnd, tree, costs, QgsGraphRouter::Backward );
 
   QVector<QgsPointXY> route;
   double cost;
@@ -111,9 +114,8 @@ QVariantMap QgsShortestPathLayerToPointAlgorithm::processAlgorithm( const QVaria
     }
 
     idxStart = graph->findVertex( snappedPoints[i] );
-    QgsGraphAnalyzer::dijkstra( graph, idxStart, 0, &tree, &costs );
 
-    if ( tree.at( idxEnd ) == -1 )
+    if ( tree.at( idxStart ) == -1 )
     {
       feedback->reportError( QObject::tr( "There is no route from start point (%1) to end point (%2)." )
                              .arg( points[i].toString(),
@@ -127,13 +129,13 @@ QVariantMap QgsShortestPathLayerToPointAlgorithm::processAlgorithm( const QVaria
     }
 
     route.clear();
-    route.push_front( graph->vertex( idxEnd ).point() );
-    cost = costs.at( idxEnd );
-    currentIdx = idxEnd;
-    while ( currentIdx != idxStart )
+    route.push_back( graph->vertex( idxStart ).point() );
+    cost = costs.at( idxStart );
+    currentIdx = idxStart;
+    while ( currentIdx != idxEnd )
     {
-      currentIdx = graph->edge( tree.at( currentIdx ) ).fromVertex();
-      route.push_front( graph->vertex( currentIdx ).point() );
+      currentIdx = graph->edge( tree.at( currentIdx ) ).toVertex();
+      route.push_back( graph->vertex( currentIdx ).point() );
     }
 
     QgsGeometry geom = QgsGeometry::fromPolylineXY( route );
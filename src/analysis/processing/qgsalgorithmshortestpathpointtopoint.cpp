@@ -17,7 +17,7 @@
 
 #include "qgsalgorithmshortestpathpointtopoint.h"
 
-#include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
 
 ///@cond PRIVATE
 
@@ -84,22 +84,21 @@ QVariantMap QgsShortestPathPointToPointAlgorithm::processAlgorithm( const QVaria
   int idxStart = graph->findVertex( snappedPoints[0] );
   int idxEnd = graph->findVertex( snappedPoints[1] );
 
-  QVector< int > tree;
-  QVector< double > costs;
-  QgsGraphAnalyzer::dijkstra( graph, idxStart, 0, &tree, &costs );
+  QgsGraphRouter router( graph, 0 );
+  double cost = 0;
+  const QVector< int > path = router.shortestPath( idxStart, idxEnd, &cost );
 
-  if ( tree.at( idxEnd ) == -1 )
+  if ( path.isEmpty() )
   {
     throw QgsProcessingException( QObject::tr( "There is no route from start point to end point." ) );
   }
 
   QVector<QgsPointXY> route;
-  route.push_front( graph->vertex( idxEnd ).point() );
-  double cost = costs.at( idxEnd );
-  while ( idxEnd != idxStart )
+  route.reserve( path.size() + 1 );
+  route.push_back( graph->vertex( idxStart ).point() );
+  for ( int edgeId : path )
   {
-    idxEnd = graph->edge( tree.at( idxEnd ) ).fromVertex();
-    route.push_front( graph->vertex( idxEnd ).point() );
+    route.push_back( graph->vertex( graph->edge( edgeId ).toVertex() ).point() );
   }
 
   feedback->pushInfo( QObject::tr( "Writing results…" ) );
@@ -17,6 +17,7 @@
 
 #include "qgsaspectfilter.h"
 #include <cmath>
+#include <vector>
 
 QgsAspectFilter::QgsAspectFilter( const QString &inputFile, const QString &outputFile, const QString &outputFormat )
   : QgsDerivativeFilter( inputFile, outputFile, outputFormat )
@@ -44,3 +45,17 @@ float QgsAspectFilter::processNineCellWindow(
   }
 }
 
+void QgsAspectFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  std::vector< float > derX( count );
+  std::vector< float > derY( count );
+  calcFirstDerRow( scanLine1, scanLine2, scanLine3, derX.data(), derY.data(), count );
+
+  for ( int x = 0; x < count; ++x )
+  {
+    const float dx = derX[x];
+    const float dy = derY[x];
+    const float aspect = 180.0 + std::atan2( dx, dy ) * 180.0 / M_PI;
+    resultLine[x] = ( dx == mOutputNodataValue || dy == mOutputNodataValue || ( dx == 0.0 && dy == 0.0 ) ) ? mOutputNodataValue : aspect;
+  }
+}
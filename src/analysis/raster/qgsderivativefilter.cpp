@@ -17,6 +17,8 @@
 
 #include "qgsderivativefilter.h"
 
+#include <vector>
+
 QgsDerivativeFilter::QgsDerivativeFilter( const QString &inputFile, const QString &outputFile, const QString &outputFormat )
   : QgsNineCellFilter( inputFile, outputFile, outputFormat )
 {
@@ -161,3 +163,43 @@ float QgsDerivativeFilter::calcFirstDerY( float *x11, float *x21, float *x31, fl
 
 
 
+
+void QgsDerivativeFilter::calcFirstDerRow( float *scanLine1, float *scanLine2, float *scanLine3, float *derX, float *derY, int count )
+{
+  // first pass without any branch, using the basic formula for every cell. The terms are added in the same
+  // order as in calcFirstDerX/Y so that the results are identical when the whole window has data
+  std::vector< unsigned char > hasNodata( count );
+  for ( int x = 0; x < count; ++x )
+  {
+    const float *r1 = scanLine1 + x;
+    const float *r2 = scanLine2 + x;
+    const float *r3 = scanLine3 + x;
+
+    double sumX = ( r1[2] - r1[0] );
+    sumX += 2 * ( r2[2] - r2[0] );
+    sumX += ( r3[2] - r3[0] );
+    derX[x] = sumX / ( 8 * mCellSizeX ) * mZFactor;
+
+    double sumY = ( r1[0] - r3[0] );
+    sumY += 2 * ( r1[1] - r3[1] );
+    sumY += ( r1[2] - r3[2] );
+    derY[x] = sumY / ( 8 * mCellSizeY ) * mZFactor;
+
+    hasNodata[x] = ( r1[0] == mInputNodataValue ) | ( r1[1] == mInputNodataValue ) | ( r1[2] == mInputNodataValue )
+                   | ( r2[0] == mInputNodataValue ) | ( r2[1] == mInputNodataValue ) | ( r2[2] == mInputNodataValue )
+                   | ( r3[0] == mInputNodataValue ) | ( r3[1] == mInputNodataValue ) | ( r3[2] == mInputNodataValue );
+  }
+
+  // windows touching nodata (e.g. at the raster borders) go through the weighted formulas
+  for ( int x = 0; x < count; ++x )
+  {
+    if ( !hasNodata[x] )
+      continue;
+
+    float *r1 = scanLine1 + x;
+    float *r2 = scanLine2 + x;
+    float *r3 = scanLine3 + x;
+    derX[x] = calcFirstDerX( &r1[0], &r1[1], &r1[2], &r2[0], &r2[1], &r2[2], &r3[0], &r3[1], &r3[2] );
+    derY[x] = calcFirstDerY( &r1[0], &r1[1], &r1[2], &r2[0], &r2[1], &r2[2], &r3[0], &r3[1], &r3[2] );
+  }
+}
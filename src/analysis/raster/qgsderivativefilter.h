@@ -41,6 +41,17 @@ class ANALYSIS_EXPORT QgsDerivativeFilter : public QgsNineCellFilter
     float calcFirstDerX( float *x11, float *x21, float *x31, float *x12, float *x22, float *x32, float *x13, float *x23, float *x33 );
     //! Calculates the first order derivative in y-direction according to Horn (1981)
     float calcFirstDerY( float *x11, float *x21, float *x31, float *x12, float *x22, float *x32, float *x13, float *x23, float *x33 );
+
+    /**
+     * Calculates the first order derivatives in x- and y-direction for a whole row of cells,
+     * with the same results as calcFirstDerX() and calcFirstDerY().
+     *
+     * Scanlines are laid out as for processNineCellRow(). \a derX and \a derY receive \a count values.
+     *
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    void calcFirstDerRow( float *scanLine1, float *scanLine2, float *scanLine3, float *derX, float *derY, int count ) SIP_SKIP;
 };
 
 #endif // QGSDERIVATIVEFILTER_H
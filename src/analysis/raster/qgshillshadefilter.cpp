@@ -17,6 +17,7 @@
 
 #include "qgshillshadefilter.h"
 #include <cmath>
+#include <vector>
 
 QgsHillshadeFilter::QgsHillshadeFilter( const QString &inputFile, const QString &outputFile, const QString &outputFormat, double lightAzimuth,
                                         double lightAngle )
@@ -57,6 +58,25 @@ float QgsHillshadeFilter::processNineCellWindow( float *x11, float *x21, float *
                                       std::cos( mAzimuthRad - aspect_rad ) ) ) );
 }
 
+void QgsHillshadeFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  std::vector< float > derX( count );
+  std::vector< float > derY( count );
+  calcFirstDerRow( scanLine1, scanLine2, scanLine3, derX.data(), derY.data(), count );
+
+  for ( int x = 0; x < count; ++x )
+  {
+    const float dx = derX[x];
+    const float dy = derY[x];
+    const float slope_rad = std::atan( std::sqrt( dx * dx + dy * dy ) );
+    const float aspect_rad = ( dx == 0 && dy == 0 ) ? mAzimuthRad / 2.0f : static_cast< float >( M_PI + std::atan2( dx, dy ) );
+    const float shade = std::max( 0.0f, 255.0f * ( ( mCosZenithRad * std::cos( slope_rad ) ) +
+                                  ( mSinZenithRad * std::sin( slope_rad ) *
+                                    std::cos( mAzimuthRad - aspect_rad ) ) ) );
+    resultLine[x] = ( dx == mOutputNodataValue || dy == mOutputNodataValue ) ? mOutputNodataValue : shade;
+  }
+}
+
 void QgsHillshadeFilter::setLightAzimuth( float azimuth )
 {
   mLightAzimuth = azimuth;
@@ -36,6 +36,8 @@ class ANALYSIS_EXPORT QgsHillshadeFilter: public QgsDerivativeFilter
                                  float *x12, float *x22, float *x32,
                                  float *x13, float *x23, float *x33 ) override;
 
+    void processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count ) override SIP_SKIP;
+
     float lightAzimuth() const { return mLightAzimuth; }
     void setLightAzimuth( float azimuth );
     float lightAngle() const { return mLightAngle; }
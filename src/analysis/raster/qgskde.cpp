@@ -17,9 +17,23 @@
 #include "qgsfeaturesource.h"
 #include "qgsfeatureiterator.h"
 #include "qgsgeometry.h"
+#include "qgssettings.h"
+
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <numeric>
 
 #define NO_DATA -9999
 
+//! Width and height of the tiles of the in-memory surface
+static const int TILE_SIZE = 256;
+//! Default maximum number of cells of the in-memory surface (64 MB of floats), larger rasters are updated in the output file for each point
+static const qint64 DEFAULT_MAX_IN_MEMORY_CELLS = 16 * 1024 * 1024;
+//! Number of pending points which triggers an update of the in-memory surface
+static const std::size_t MAX_PENDING_POINTS = 1024 * 1024;
+
 QgsKernelDensityEstimation::QgsKernelDensityEstimation( const QgsKernelDensityEstimation::Parameters &parameters, const QString &outputFile, const QString &outputFormat )
   : mSource( parameters.source )
   , mOutputFile( outputFile )
@@ -85,8 +99,14 @@ QgsKernelDensityEstimation::Result QgsKernelDensityEstimation::prepare()
 
   int rows = std::max( std::ceil( mBounds.height() / mPixelSize ) + 1, 1.0 );
   int cols = std::max( std::ceil( mBounds.width() / mPixelSize ) + 1, 1.0 );
+  mRows = rows;
+  mColumns = cols;
+
+  // the in-memory surface is written completely by finalise(), so the file does not need to be filled first
+  const qint64 maxInMemoryCells = QgsSettings().value( QStringLiteral( "qgis/kde_max_in_memory_cells" ), DEFAULT_MAX_IN_MEMORY_CELLS ).toLongLong();
+  mInMemory = static_cast< qint64 >( rows ) * cols <= maxInMemoryCells;
 
-  if ( !createEmptyLayer( driver, mBounds, rows, cols ) )
+  if ( !createEmptyLayer( driver, mBounds, rows, cols, !mInMemory ) )
     return FileCreationError;
 
   // open the raster in GA_Update mode
@@ -101,6 +121,17 @@ QgsKernelDensityEstimation::Result QgsKernelDensityEstimation::prepare()
   if ( mRadiusField < 0 )
     mBufferSize = radiusSizeInPixels( mRadius );
 
+  mSurface.clear();
+  mPendingPoints.clear();
+  mTilePoints.clear();
+  if ( mInMemory )
+  {
+    mSurface.assign( static_cast< std::size_t >( rows ) * cols, NO_DATA );
+    mTileColumns = ( cols + TILE_SIZE - 1 ) / TILE_SIZE;
+    mTileRows = ( rows + TILE_SIZE - 1 ) / TILE_SIZE;
+    mTilePoints.resize( static_cast< std::size_t >( mTileColumns ) * mTileRows );
+  }
+
   return Success;
 }
 
@@ -161,6 +192,29 @@ QgsKernelDensityEstimation::Result QgsKernelDensityEstimation::addFeature( const
     unsigned int yPosition = ( ( ( *pointIt ).y() - mBounds.yMinimum() ) / mPixelSize ) - buffer;
     unsigned int yPositionIO = ( ( mBounds.yMaximum() - ( *pointIt ).y() ) / mPixelSize ) - buffer;
 
+    if ( mInMemory )
+    {
+      // windows which are not completely inside the raster are skipped, like they are rejected by GDALRasterIO
+      const int xOffset = static_cast< int >( xPosition );
+      const int yOffset = static_cast< int >( yPositionIO );
+      if ( xOffset < 0 || yOffset < 0 || blockSize > mColumns - xOffset || blockSize > mRows - yOffset )
+      {
+        result = RasterIoError;
+        continue;
+      }
+
+      const int pointIndex = static_cast< int >( mPendingPoints.size() );
+      mPendingPoints.push_back( PendingPoint{ ( *pointIt ).x(), ( *pointIt ).y(), radius, weight, yPosition, xOffset, yOffset, blockSize } );
+      for ( int tileRow = yOffset / TILE_SIZE; tileRow <= ( yOffset + blockSize - 1 ) / TILE_SIZE; ++tileRow )
+      {
+        for ( int tileColumn = xOffset / TILE_SIZE; tileColumn <= ( xOffset + blockSize - 1 ) / TILE_SIZE; ++tileColumn )
+          mTilePoints[ static_cast< std::size_t >( tileRow ) * mTileColumns + tileColumn ].push_back( pointIndex );
+      }
+
+      if ( mPendingPoints.size() >= MAX_PENDING_POINTS )
+        addPendingPoints();
+      continue;
+    }
 
     // get the data
     float *dataBuffer = ( float * ) CPLMalloc( sizeof( float ) * blockSize * blockSize );
@@ -207,9 +261,114 @@ QgsKernelDensityEstimation::Result QgsKernelDensityEstimation::addFeature( const
 
 QgsKernelDensityEstimation::Result QgsKernelDensityEstimation::finalise()
 {
+  Result result = Success;
+  if ( mInMemory && mRasterBandH )
+  {
+    addPendingPoints();
+
+    // write one row of tiles at a time
+    for ( int row = 0; row < mRows; row += TILE_SIZE )
+    {
+      const int rowCount = std::min( TILE_SIZE, mRows - row );
+      if ( GDALRasterIO( mRasterBandH, GF_Write, 0, row, mColumns, rowCount, mSurface.data() + static_cast< std::size_t >( row ) * mColumns,
+                         mColumns, rowCount, GDT_Float32, 0, 0 ) != CE_None )
+      {
+        result = RasterIoError;
+        break;
+      }
+    }
+    mSurface.clear();
+    mSurface.shrink_to_fit();
+  }
+
   mDatasetH.reset();
   mRasterBandH = nullptr;
-  return Success;
+  return result;
+}
+
+void QgsKernelDensityEstimation::addPendingPoints()
+{
+  if ( mPendingPoints.empty() )
+    return;
+
+  std::vector< int > tiles;
+  for ( int i = 0; i < static_cast< int >( mTilePoints.size() ); ++i )
+  {
+    if ( !mTilePoints[i].empty() )
+      tiles.push_back( i );
+  }
+
+  // tiles do not overlap, and each tile adds its points in the order they were added, so that
+  // the float sums are the same as when adding the points one after the other
+  QtConcurrent::blockingMap( tiles, [this]( int tileIndex )
+  {
+    addPendingPointsToTile( tileIndex, mTilePoints[ tileIndex ] );
+  } );
+
+  mPendingPoints.clear();
+  for ( int tileIndex : tiles )
+    mTilePoints[ tileIndex ].clear();
+}
+
+void QgsKernelDensityEstimation::addPendingPointsToTile( int tileIndex, const std::vector< int > &points )
+{
+  const int tileLeft = ( tileIndex % mTileColumns ) * TILE_SIZE;
+  const int tileTop = ( tileIndex / mTileColumns ) * TILE_SIZE;
+  const int tileRight = std::min( tileLeft + TILE_SIZE, mColumns );
+  const int tileBottom = std::min( tileTop + TILE_SIZE, mRows );
+
+  // squared distances along each axis, shared by all the pixels of a column or row of the kernel window
+  std::vector< double > dx2;
+  std::vector< double > dy2;
+
+  for ( int pointIndex : points )
+  {
+    const PendingPoint &point = mPendingPoints[ pointIndex ];
+    const int left = std::max( point.xOffset, tileLeft );
+    const int right = std::min( point.xOffset + point.blockSize, tileRight );
+    const int top = std::max( point.yOffset, tileTop );
+    const int bottom = std::min( point.yOffset + point.blockSize, tileBottom );
+
+    // same pixel centroids as when updating the output file for a single point
+    dx2.resize( right - left );
+    for ( int column = left; column < right; ++column )
+    {
+      const unsigned int xp = static_cast< unsigned int >( column );
+      const double pixelCentroidX = ( xp + 0.5 ) * mPixelSize + mBounds.xMinimum();
+      dx2[ column - left ] = std::pow( pixelCentroidX - point.x, 2.0 );
+    }
+    dy2.resize( bottom - top );
+    for ( int row = top; row < bottom; ++row )
+    {
+      const unsigned int yp = point.yPosition + static_cast< unsigned int >( row - point.yOffset );
+      const double pixelCentroidY = ( yp + 0.5 ) * mPixelSize + mBounds.yMinimum();
+      dy2[ row - top ] = std::pow( pixelCentroidY - point.y, 2.0 );
+    }
+
+    for ( int row = top; row < bottom; ++row )
+    {
+      float *line = mSurface.data() + static_cast< std::size_t >( row ) * mColumns;
+      const double rowDistance = dy2[ row - top ];
+      for ( int column = left; column < right; ++column )
+      {
+        const double distance = std::sqrt( dx2[ column - left ] + rowDistance );
+
+        // is pixel outside search bandwidth of feature?
+        if ( distance > point.radius )
+        {
+          continue;
+        }
+
+        const double pixelValue = point.weight * calculateKernelValue( distance, point.radius, mShape, mOutputValues );
+        float &value = line[ column ];
+        if ( value == NO_DATA )
+        {
+          value = 0;
+        }
+        value += pixelValue;
+      }
+    }
+  }
 }
 
 int QgsKernelDensityEstimation::radiusSizeInPixels( double radius ) const
@@ -222,7 +381,7 @@ int QgsKernelDensityEstimation::radiusSizeInPixels( double radius ) const
   return buffer;
 }
 
-bool QgsKernelDensityEstimation::createEmptyLayer( GDALDriverH driver, const QgsRectangle &bounds, int rows, int columns ) const
+bool QgsKernelDensityEstimation::createEmptyLayer( GDALDriverH driver, const QgsRectangle &bounds, int rows, int columns, bool fillNoData ) const
 {
   double geoTransform[6] = { bounds.xMinimum(), mPixelSize, 0, bounds.yMaximum(), 0, -mPixelSize };
   gdal::dataset_unique_ptr emptyDataset( GDALCreate( driver, mOutputFile.toUtf8(), columns, rows, 1, GDT_Float32, nullptr ) );
@@ -243,6 +402,9 @@ bool QgsKernelDensityEstimation::createEmptyLayer( GDALDriverH driver, const Qgs
   if ( GDALSetRasterNoDataValue( poBand, NO_DATA ) != CE_None )
     return false;
 
+  if ( !fillNoData )
+    return true;
+
   float *line = static_cast< float * >( CPLMalloc( sizeof( float ) * columns ) );
   for ( int i = 0; i < columns; i++ )
   {
@@ -19,6 +19,7 @@
 #include "qgsrectangle.h"
 #include "qgsogrutils.h"
 #include <QString>
+#include <vector>
 
 // GDAL includes
 #include <gdal.h>
@@ -34,6 +35,14 @@ class QgsFeature;
  * \class QgsKernelDensityEstimation
  * \ingroup analysis
  * \brief Performs Kernel Density Estimation ("heatmap") calculations on a vector layer.
+ *
+ * Since QGIS 3.18, the surface is accumulated in memory unless the output raster is very large.
+ * Added points are binned into tiles, the kernels of each batch of points are evaluated for all
+ * tiles in parallel and the output file is written once when finalise() is called. The results
+ * are identical to writing each point's kernel directly to the output file, which is still used
+ * for rasters too large to be held in memory. The maximum number of cells of the in-memory surface
+ * is read from the "qgis/kde_max_in_memory_cells" setting, and defaults to 16777216 (64 MB).
+ *
  * \since QGIS 3.0
  */
 class ANALYSIS_EXPORT QgsKernelDensityEstimation
@@ -151,6 +160,29 @@ class ANALYSIS_EXPORT QgsKernelDensityEstimation
 
     QgsRectangle calculateBounds() const;
 
+#ifndef SIP_RUN
+    //! A point added to the in-memory surface, waiting for its kernel to be evaluated
+    struct PendingPoint
+    {
+      double x;
+      double y;
+      double radius;
+      double weight;
+      //! Unclamped row of the lower left pixel of the kernel window, counted from the bottom of the raster
+      unsigned int yPosition;
+      //! Column of the upper left pixel of the kernel window
+      int xOffset;
+      //! Row of the upper left pixel of the kernel window
+      int yOffset;
+      int blockSize;
+    };
+#endif
+
+    //! Adds the kernels of all pending points to the in-memory surface, processing tiles in parallel
+    void addPendingPoints();
+    //! Adds the kernels of the pending points listed in \a points to the tile at \a tileIndex
+    void addPendingPointsToTile( int tileIndex, const std::vector< int > &points );
+
     QgsFeatureSource *mSource = nullptr;
 
     QString mOutputFile;
@@ -171,8 +203,21 @@ class ANALYSIS_EXPORT QgsKernelDensityEstimation
     gdal::dataset_unique_ptr mDatasetH;
     GDALRasterBandH mRasterBandH;
 
-    //! Creates a new raster layer and initializes it to the no data value
-    bool createEmptyLayer( GDALDriverH driver, const QgsRectangle &bounds, int rows, int columns ) const;
+    int mRows = 0;
+    int mColumns = 0;
+
+    //! TRUE if the surface is accumulated in memory and written by finalise()
+    bool mInMemory = false;
+    //! In-memory surface, row by row from the top
+    std::vector< float > mSurface;
+    int mTileColumns = 0;
+    int mTileRows = 0;
+    std::vector< PendingPoint > mPendingPoints;
+    //! Indices of the pending points overlapping each tile
+    std::vector< std::vector< int > > mTilePoints;
+
+    //! Creates a new raster layer and initializes it to the no data value if \a fillNoData is TRUE
+    bool createEmptyLayer( GDALDriverH driver, const QgsRectangle &bounds, int rows, int columns, bool fillNoData = true ) const;
     int radiusSizeInPixels( double radius ) const;
 
 #ifdef SIP_RUN
@@ -30,7 +30,11 @@
 #include <QFile>
 #include <QDebug>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include <algorithm>
 #include <iterator>
+#include <numeric>
 
 
 
@@ -84,6 +88,17 @@ int QgsNineCellFilter::processRaster( QgsFeedback *feedback )
 #endif
 }
 
+void QgsNineCellFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  for ( int xIndex = 0; xIndex < count; ++xIndex )
+  {
+    // cells(x, y) x11, x21, x31, x12, x22, x32, x13, x23, x33
+    resultLine[ xIndex ] = processNineCellWindow( &scanLine1[ xIndex ], &scanLine1[ xIndex + 1 ], &scanLine1[ xIndex + 2 ],
+                           &scanLine2[ xIndex ], &scanLine2[ xIndex + 1 ], &scanLine2[ xIndex + 2 ],
+                           &scanLine3[ xIndex ], &scanLine3[ xIndex + 1 ], &scanLine3[ xIndex + 2 ] );
+  }
+}
+
 gdal::dataset_unique_ptr QgsNineCellFilter::openInputFile( int &nCellsX, int &nCellsY )
 {
   gdal::dataset_unique_ptr inputDataset( GDALOpen( mInputFile.toUtf8().constData(), GA_ReadOnly ) );
@@ -401,91 +416,96 @@ int QgsNineCellFilter::processRasterCPU( QgsFeedback *feedback )
     return 6;
   }
 
-  //keep only three scanlines in memory at a time, make room for initial and final nodata
-  std::size_t bufferSize( sizeof( float ) * ( xSize + 2 ) );
-  float *scanLine1 = ( float * ) CPLMalloc( bufferSize );
-  float *scanLine2 = ( float * ) CPLMalloc( bufferSize );
-  float *scanLine3 = ( float * ) CPLMalloc( bufferSize );
+  // The raster is processed in tiles of full rows. Each tile is read with one row of halo above and
+  // below it, and its rows are then calculated concurrently while the next tile is being read.
+  // Datasets are only accessed from this thread, as GDAL handles are not thread safe
+  const int threadCount = std::max( 1, QThreadPool::globalInstance()->maxThreadCount() );
+  const int tileRows = std::min( ySize, std::max( 16, 4 * threadCount ) );
+  const std::size_t stride = static_cast< std::size_t >( xSize ) + 2;
 
-  float *resultLine = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+  struct Tile
+  {
+    int firstRow = 0;
+    int rowCount = 0;
+    //! tileRows + 2 rows of xSize + 2 values, values outside the layer extent are set to (input) nodata
+    std::vector< float > input;
+    std::vector< float > output;
+    std::vector< int > rows;
+  };
+  Tile tiles[2];
+  for ( Tile &tile : tiles )
+  {
+    tile.input.resize( stride * ( tileRows + 2 ) );
+    tile.output.resize( static_cast< std::size_t >( xSize ) * tileRows );
+  }
 
-  //values outside the layer extent (if the 3x3 window is on the border) are sent to the processing method as (input) nodata values
-  for ( int yIndex = 0; yIndex < ySize; ++yIndex )
+  auto readTile = [&]( Tile & tile, int firstRow )
   {
-    if ( feedback && feedback->isCanceled() )
+    tile.firstRow = firstRow;
+    tile.rowCount = std::min( tileRows, ySize - firstRow );
+    tile.rows.resize( tile.rowCount );
+    std::iota( tile.rows.begin(), tile.rows.end(), 0 );
+
+    // tile row i + 1 holds raster row firstRow + i
+    const int readFirst = std::max( 0, firstRow - 1 );
+    const int readLast = std::min( ySize - 1, firstRow + tile.rowCount );
+    std::fill( tile.input.begin(), tile.input.end(), mInputNodataValue );
+    float *target = tile.input.data() + stride * ( readFirst - firstRow + 1 ) + 1;
+    if ( GDALRasterIO( rasterBand, GF_Read, 0, readFirst, xSize, readLast - readFirst + 1, target, xSize, readLast - readFirst + 1,
+                       GDT_Float32, 0, static_cast< GSpacing >( stride * sizeof( float ) ) ) != CE_None )
     {
-      break;
+      QgsDebugMsg( QStringLiteral( "Raster IO Error" ) );
     }
+  };
 
-    if ( feedback )
+  auto writeTile = [&]( Tile & tile )
+  {
+    if ( GDALRasterIO( outputRasterBand, GF_Write, 0, tile.firstRow, xSize, tile.rowCount, tile.output.data(), xSize, tile.rowCount,
+                       GDT_Float32, 0, 0 ) != CE_None )
     {
-      feedback->setProgress( 100.0 * static_cast< double >( yIndex ) / ySize );
+      QgsDebugMsg( QStringLiteral( "Raster IO Error" ) );
     }
+  };
 
-    if ( yIndex == 0 )
-    {
-      //fill scanline 1 with (input) nodata for the values above the first row and feed scanline2 with the first row
-      for ( int a = 0; a < xSize + 2 ; ++a )
-      {
-        scanLine1[a] = mInputNodataValue;
-      }
-      // Read scanline2
-      if ( GDALRasterIO( rasterBand, GF_Read, 0, 0, xSize, 1, &scanLine2[1], xSize, 1, GDT_Float32, 0, 0 ) != CE_None )
-      {
-        QgsDebugMsg( QStringLiteral( "Raster IO Error" ) );
-      }
-    }
-    else
+  QFuture< void > pending;
+  int pendingTile = -1;
+  int current = 0;
+  for ( int firstRow = 0; firstRow < ySize; firstRow += tileRows )
+  {
+    if ( feedback && feedback->isCanceled() )
     {
-      //normally fetch only scanLine3 and release scanline 1 if we move forward one row
-      CPLFree( scanLine1 );
-      scanLine1 = scanLine2;
-      scanLine2 = scanLine3;
-      scanLine3 = ( float * ) CPLMalloc( bufferSize );
+      break;
     }
 
-    // Read scanline 3
-    if ( yIndex == ySize - 1 ) //fill the row below the bottom with nodata values
-    {
-      for ( int a = 0; a < xSize + 2; ++a )
-      {
-        scanLine3[a] = mInputNodataValue;
-      }
-    }
-    else
+    if ( feedback )
     {
-      if ( GDALRasterIO( rasterBand, GF_Read, 0, yIndex + 1, xSize, 1, &scanLine3[1], xSize, 1, GDT_Float32, 0, 0 ) != CE_None )
-      {
-        QgsDebugMsg( QStringLiteral( "Raster IO Error" ) );
-      }
+      feedback->setProgress( 100.0 * static_cast< double >( firstRow ) / ySize );
     }
-    // Set first and last extra columns to nodata
-    scanLine1[0] = scanLine1[xSize + 1] = mInputNodataValue;
-    scanLine2[0] = scanLine2[xSize + 1] = mInputNodataValue;
-    scanLine3[0] = scanLine3[xSize + 1] = mInputNodataValue;
-
 
+    Tile &tile = tiles[ current ];
+    readTile( tile, firstRow );
 
-    // j is the x axis index, skip 0 and last cell that have been filled with nodata
-    for ( int xIndex = 0; xIndex < xSize ; ++xIndex )
+    if ( pendingTile != -1 )
     {
-      // cells(x, y) x11, x21, x31, x12, x22, x32, x13, x23, x33
-      resultLine[ xIndex ] = processNineCellWindow( &scanLine1[ xIndex ], &scanLine1[ xIndex + 1 ], &scanLine1[ xIndex + 2 ],
-                             &scanLine2[ xIndex ], &scanLine2[ xIndex + 1 ], &scanLine2[ xIndex + 2 ],
-                             &scanLine3[ xIndex ], &scanLine3[ xIndex + 1 ], &scanLine3[ xIndex + 2 ] );
-
+      pending.waitForFinished();
+      writeTile( tiles[ pendingTile ] );
     }
 
-    if ( GDALRasterIO( outputRasterBand, GF_Write, 0, yIndex, xSize, 1, resultLine, xSize, 1, GDT_Float32, 0, 0 ) != CE_None )
+    pending = QtConcurrent::map( tile.rows.begin(), tile.rows.end(), [this, &tile, stride, xSize]( int row )
     {
-      QgsDebugMsg( QStringLiteral( "Raster IO Error" ) );
-    }
+      float *scanLine1 = tile.input.data() + stride * row;
+      processNineCellRow( scanLine1, scanLine1 + stride, scanLine1 + 2 * stride, tile.output.data() + static_cast< std::size_t >( xSize ) * row, xSize );
+    } );
+    pendingTile = current;
+    current = 1 - current;
   }
 
-  CPLFree( resultLine );
-  CPLFree( scanLine1 );
-  CPLFree( scanLine2 );
-  CPLFree( scanLine3 );
+  if ( pendingTile != -1 )
+  {
+    pending.waitForFinished();
+    if ( !feedback || !feedback->isCanceled() )
+      writeTile( tiles[ pendingTile ] );
+  }
 
   if ( feedback && feedback->isCanceled() )
   {
@@ -22,6 +22,7 @@
 #include "gdal.h"
 #include "qgis_analysis.h"
 #include "qgsogrutils.h"
+#include "qgis_sip.h"
 
 class QgsFeedback;
 
@@ -81,6 +82,25 @@ class ANALYSIS_EXPORT QgsNineCellFilter
                                          float *x12, float *x22, float *x32,
                                          float *x13, float *x23, float *x33 ) = 0;
 
+    /**
+     * Calculates the output values for a whole row of cells.
+     *
+     * \a scanLine1, \a scanLine2 and \a scanLine3 are the rows above, at and below the processed row.
+     * Each holds \a count + 2 values: the first and last ones are the neighbours of the first and last
+     * cells, set to the input nodata value. \a resultLine receives the \a count output values.
+     *
+     * The default implementation calls processNineCellWindow() for every cell. Subclasses can override it
+     * with a loop free of virtual calls which the compiler is able to vectorize, as long as the results are
+     * the same.
+     *
+     * Rows are processed concurrently by several threads, so implementations of this method and
+     * processNineCellWindow() must not modify the filter.
+     *
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    virtual void processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count ) SIP_SKIP;
+
   private:
     //default constructor forbidden. We need input file, output file and format obligatory
     QgsNineCellFilter() = delete;
@@ -0,0 +1,338 @@
+/***************************************************************************
+  qgsrastercalcprogram.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsrastercalcprogram_p.h"
+#include "qgsrastercalcnode.h"
+
+#include <algorithm>
+#include <cmath>
+
+///@cond PRIVATE
+
+// The loops below mirror the cell by cell rules of QgsRasterMatrix, so that compiled
+// and tree evaluation give the same results
+
+template <typename F>
+static void unaryLoop( const double *values, double *out, int count, double nodata, F f )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    const double value = values[i];
+    out[i] = value == nodata ? nodata : f( value );
+  }
+}
+
+template <typename F>
+static void binaryLoop( const double *left, const double *right, double *out, int count, double nodata, F f )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    const double value1 = left[i];
+    const double value2 = right[i];
+    out[i] = ( value1 == nodata || value2 == nodata ) ? nodata : f( value1, value2 );
+  }
+}
+
+static bool powerIsValid( double base, double power )
+{
+  return !( ( base == 0 && power < 0 ) || ( base < 0 && ( power - std::floor( power ) ) > 0 ) );
+}
+
+///@endcond
+
+QgsRasterCalcProgram::QgsRasterCalcProgram( const QgsRasterCalcNode *node )
+{
+  if ( !node )
+    return;
+
+  mResult = compile( node, 0 );
+  mValid = mResult.index >= 0;
+}
+
+QgsRasterCalcProgram::Operand QgsRasterCalcProgram::compile( const QgsRasterCalcNode *node, int depth )
+{
+  Operand result;
+  switch ( node->mType )
+  {
+    case QgsRasterCalcNode::tNumber:
+      result.type = OperandType::Constant;
+      result.index = static_cast< int >( mConstants.size() );
+      mConstants.push_back( node->mNumber );
+      return result;
+
+    case QgsRasterCalcNode::tRasterRef:
+      result.type = OperandType::Input;
+      result.index = mRasterNames.indexOf( node->mRasterName );
+      if ( result.index == -1 )
+      {
+        result.index = mRasterNames.size();
+        mRasterNames << node->mRasterName;
+      }
+      return result;
+
+    case QgsRasterCalcNode::tMatrix:
+      return result;
+
+    case QgsRasterCalcNode::tOperator:
+      break;
+  }
+
+  Operation operation = Operation::Add;
+  bool binary = true;
+  switch ( node->mOperator )
+  {
+    case QgsRasterCalcNode::opPLUS:
+      operation = Operation::Add;
+      break;
+    case QgsRasterCalcNode::opMINUS:
+      operation = Operation::Subtract;
+      break;
+    case QgsRasterCalcNode::opMUL:
+      operation = Operation::Multiply;
+      break;
+    case QgsRasterCalcNode::opDIV:
+      operation = Operation::Divide;
+      break;
+    case QgsRasterCalcNode::opPOW:
+      operation = Operation::Power;
+      break;
+    case QgsRasterCalcNode::opEQ:
+      operation = Operation::Equal;
+      break;
+    case QgsRasterCalcNode::opNE:
+      operation = Operation::NotEqual;
+      break;
+    case QgsRasterCalcNode::opGT:
+      operation = Operation::GreaterThan;
+      break;
+    case QgsRasterCalcNode::opLT:
+      operation = Operation::LessThan;
+      break;
+    case QgsRasterCalcNode::opGE:
+      operation = Operation::GreaterEqual;
+      break;
+    case QgsRasterCalcNode::opLE:
+      operation = Operation::LessEqual;
+      break;
+    case QgsRasterCalcNode::opAND:
+      operation = Operation::And;
+      break;
+    case QgsRasterCalcNode::opOR:
+      operation = Operation::Or;
+      break;
+    case QgsRasterCalcNode::opMAX:
+      operation = Operation::Max;
+      break;
+    case QgsRasterCalcNode::opMIN:
+      operation = Operation::Min;
+      break;
+    case QgsRasterCalcNode::opSQRT:
+      operation = Operation::SquareRoot;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opSIN:
+      operation = Operation::Sin;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opCOS:
+      operation = Operation::Cos;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opTAN:
+      operation = Operation::Tan;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opASIN:
+      operation = Operation::ASin;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opACOS:
+      operation = Operation::ACos;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opATAN:
+      operation = Operation::ATan;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opSIGN:
+      operation = Operation::ChangeSign;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opLOG:
+      operation = Operation::Log;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opLOG10:
+      operation = Operation::Log10;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opABS:
+      operation = Operation::Abs;
+      binary = false;
+      break;
+    case QgsRasterCalcNode::opNONE:
+      return result;
+  }
+
+  if ( !node->mLeft || ( binary && !node->mRight ) )
+    return result;
+
+  const Operand left = compile( node->mLeft, depth );
+  if ( left.index < 0 )
+    return result;
+
+  Operand right;
+  if ( binary )
+  {
+    // keep the left result alive while the right subtree is calculated
+    right = compile( node->mRight, left.type == OperandType::Scratch ? depth + 1 : depth );
+    if ( right.index < 0 )
+      return result;
+  }
+
+  mInstructions.push_back( Instruction{ operation, depth, left, right } );
+  mScratchCount = std::max( mScratchCount, depth + 1 );
+
+  result.type = OperandType::Scratch;
+  result.index = depth;
+  return result;
+}
+
+void QgsRasterCalcProgram::evaluate( const double *const *inputs, double *result, int count, double nodataValue ) const
+{
+  if ( !mValid )
+  {
+    std::fill( result, result + count, nodataValue );
+    return;
+  }
+
+  // scratch arrays first, followed by one array per constant
+  std::vector< double > buffers( ( mScratchCount + mConstants.size() ) * CHUNK_SIZE );
+  double *scratch = buffers.data();
+  double *constants = scratch + static_cast< std::size_t >( mScratchCount ) * CHUNK_SIZE;
+  for ( std::size_t i = 0; i < mConstants.size(); ++i )
+    std::fill( constants + i * CHUNK_SIZE, constants + ( i + 1 ) * CHUNK_SIZE, mConstants[i] );
+
+  const double nodata = nodataValue;
+  for ( int offset = 0; offset < count; offset += CHUNK_SIZE )
+  {
+    const int n = std::min( count - offset, static_cast< int >( CHUNK_SIZE ) );
+
+    auto data = [ = ]( const Operand & operand ) -> const double *
+    {
+      switch ( operand.type )
+      {
+        case OperandType::Input:
+          return inputs[ operand.index ] + offset;
+        case OperandType::Constant:
+          return constants + static_cast< std::size_t >( operand.index ) * CHUNK_SIZE;
+        case OperandType::Scratch:
+          break;
+      }
+      return scratch + static_cast< std::size_t >( operand.index ) * CHUNK_SIZE;
+    };
+
+    for ( const Instruction &instruction : mInstructions )
+    {
+      const double *left = data( instruction.left );
+      const double *right = instruction.right.index >= 0 ? data( instruction.right ) : nullptr;
+      double *out = scratch + static_cast< std::size_t >( instruction.target ) * CHUNK_SIZE;
+
+      switch ( instruction.operation )
+      {
+        case Operation::Add:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a + b; } );
+          break;
+        case Operation::Subtract:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a - b; } );
+          break;
+        case Operation::Multiply:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a * b; } );
+          break;
+        case Operation::Divide:
+          binaryLoop( left, right, out, n, nodata, [nodata]( double a, double b ) { return b == 0 ? nodata : a / b; } );
+          break;
+        case Operation::Power:
+          binaryLoop( left, right, out, n, nodata, [nodata]( double a, double b ) { return powerIsValid( a, b ) ? std::pow( a, b ) : nodata; } );
+          break;
+        case Operation::Equal:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a == b ? 1.0 : 0.0; } );
+          break;
+        case Operation::NotEqual:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a == b ? 0.0 : 1.0; } );
+          break;
+        case Operation::GreaterThan:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a > b ? 1.0 : 0.0; } );
+          break;
+        case Operation::LessThan:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a < b ? 1.0 : 0.0; } );
+          break;
+        case Operation::GreaterEqual:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a >= b ? 1.0 : 0.0; } );
+          break;
+        case Operation::LessEqual:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a <= b ? 1.0 : 0.0; } );
+          break;
+        case Operation::And:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a && b ? 1.0 : 0.0; } );
+          break;
+        case Operation::Or:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return a || b ? 1.0 : 0.0; } );
+          break;
+        case Operation::Max:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return std::max( a, b ); } );
+          break;
+        case Operation::Min:
+          binaryLoop( left, right, out, n, nodata, []( double a, double b ) { return std::min( a, b ); } );
+          break;
+        case Operation::SquareRoot:
+          unaryLoop( left, out, n, nodata, [nodata]( double a ) { return a < 0 ? nodata : std::sqrt( a ); } );
+          break;
+        case Operation::Sin:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::sin( a ); } );
+          break;
+        case Operation::Cos:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::cos( a ); } );
+          break;
+        case Operation::Tan:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::tan( a ); } );
+          break;
+        case Operation::ASin:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::asin( a ); } );
+          break;
+        case Operation::ACos:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::acos( a ); } );
+          break;
+        case Operation::ATan:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::atan( a ); } );
+          break;
+        case Operation::ChangeSign:
+          unaryLoop( left, out, n, nodata, []( double a ) { return -a; } );
+          break;
+        case Operation::Log:
+          unaryLoop( left, out, n, nodata, [nodata]( double a ) { return a <= 0 ? nodata : std::log( a ); } );
+          break;
+        case Operation::Log10:
+          unaryLoop( left, out, n, nodata, [nodata]( double a ) { return a <= 0 ? nodata : std::log10( a ); } );
+          break;
+        case Operation::Abs:
+          unaryLoop( left, out, n, nodata, []( double a ) { return std::fabs( a ); } );
+          break;
+      }
+    }
+
+    const double *values = data( mResult );
+    std::copy( values, values + n, result + offset );
+  }
+}
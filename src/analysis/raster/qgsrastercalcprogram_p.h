@@ -0,0 +1,162 @@
+/***************************************************************************
+  qgsrastercalcprogram_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSRASTERCALCPROGRAM_PRIVATE_H
+#define QGSRASTERCALCPROGRAM_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_analysis.h"
+
+#include <QStringList>
+#include <vector>
+
+class QgsRasterCalcNode;
+
+/**
+ * \ingroup analysis
+ * \brief Raster calculator expression compiled into a flat list of array operations.
+ *
+ * The QgsRasterCalcNode tree is translated once into instructions working on
+ * fixed size chunks of cells. Raster references read directly from the caller's
+ * input arrays and intermediate results live in a small set of reusable scratch
+ * arrays, so evaluating an expression does not allocate a QgsRasterMatrix per
+ * operator and keeps a chunk in cache while all operators are applied to it.
+ * Each operator is a plain loop over the chunk which the compiler can vectorize.
+ *
+ * Results are identical to QgsRasterCalcNode::calculate(): a cell is nodata if any
+ * operand is nodata, and invalid operations (division by zero, square root or
+ * logarithm of negative values, invalid powers) give nodata.
+ *
+ * Expressions containing matrix nodes are not supported.
+ *
+ * evaluate() does not modify the program and can be called concurrently.
+ *
+ * \since QGIS 3.18
+ */
+class ANALYSIS_EXPORT QgsRasterCalcProgram
+{
+  public:
+
+    /**
+     * Compiles the expression tree starting at \a node.
+     * \see isValid()
+     */
+    explicit QgsRasterCalcProgram( const QgsRasterCalcNode *node );
+
+    /**
+     * Returns TRUE if the expression could be compiled.
+     */
+    bool isValid() const { return mValid; }
+
+    /**
+     * Returns the names of the rasters referenced by the expression. The input arrays
+     * passed to evaluate() must follow the same order.
+     */
+    QStringList rasterNames() const { return mRasterNames; }
+
+    /**
+     * Evaluates the expression for \a count cells.
+     *
+     * \a inputs holds one array of \a count values for each of the rasterNames(), with
+     * nodata cells set to \a nodataValue. The results are stored in \a result.
+     */
+    void evaluate( const double *const *inputs, double *result, int count, double nodataValue ) const;
+
+  private:
+
+    //! Number of cells processed by each instruction at a time
+    static constexpr int CHUNK_SIZE = 256;
+
+    enum class Operation
+    {
+      Add,
+      Subtract,
+      Multiply,
+      Divide,
+      Power,
+      Equal,
+      NotEqual,
+      GreaterThan,
+      LessThan,
+      GreaterEqual,
+      LessEqual,
+      And,
+      Or,
+      Max,
+      Min,
+      SquareRoot,
+      Sin,
+      Cos,
+      Tan,
+      ASin,
+      ACos,
+      ATan,
+      ChangeSign,
+      Log,
+      Log10,
+      Abs,
+    };
+
+    enum class OperandType
+    {
+      Input,
+      Constant,
+      Scratch,
+    };
+
+    struct Operand
+    {
+      OperandType type = OperandType::Scratch;
+      int index = -1;
+    };
+
+    //! Applies an operation to the left (and right) operands, storing the result in a scratch array
+    struct Instruction
+    {
+      Operation operation;
+      int target;
+      Operand left;
+      Operand right;
+    };
+
+    /**
+     * Emits the instructions for the subtree at \a node, using scratch arrays from \a depth upwards
+     * for intermediate results. Returns the operand holding the result of the subtree, or an
+     * operand with a negative index if the subtree cannot be compiled.
+     */
+    Operand compile( const QgsRasterCalcNode *node, int depth );
+
+    bool mValid = false;
+    QStringList mRasterNames;
+    std::vector< double > mConstants;
+    std::vector< Instruction > mInstructions;
+    int mScratchCount = 0;
+    Operand mResult;
+};
+
+/// @endcond
+
+#endif // QGSRASTERCALCPROGRAM_PRIVATE_H
@@ -21,12 +21,18 @@
 #include "qgsrasterinterface.h"
 #include "qgsrasterlayer.h"
 #include "qgsrastermatrix.h"
+#include "qgsrastercalcprogram_p.h"
 #include "qgsrasterprojector.h"
 #include "qgsfeedback.h"
 #include "qgsogrutils.h"
 #include "qgsproject.h"
 
 #include <QFile>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <numeric>
 
 #include <cpl_string.h>
 #include <gdalwarper.h>
@@ -160,93 +166,153 @@ QgsRasterCalculator::Result QgsRasterCalculator::processCalculation( QgsFeedback
   GDALSetRasterNoDataValue( outputRasterBand, outputNodataValue );
 
 
-  // Take the fast route (process one line at a time) if we can
+  // Take the fast route (process tiles of rows in parallel) if we can
   if ( ! requiresMatrix )
   {
-    // Map of raster names -> blocks
-    std::map<QString, std::unique_ptr<QgsRasterBlock>> inputBlocks;
-    std::map<QString, QgsRasterCalculatorEntry> uniqueRasterEntries;
-    const QList<const QgsRasterCalcNode *> rasterRefNodes = calcNode->findNodes( QgsRasterCalcNode::Type::tRasterRef );
-    for ( const QgsRasterCalcNode *r : rasterRefNodes )
+    // The expression is compiled once and evaluated on chunks of cells, without creating
+    // a raster matrix for every node
+    const QgsRasterCalcProgram program( calcNode.get() );
+    std::vector< QgsRasterCalculatorEntry > inputEntries;
+    const QStringList rasterNames = program.rasterNames();
+    for ( const QString &rasterName : rasterNames )
     {
-      QString layerRef( r->toString().remove( 0, 1 ) );
-      layerRef.chop( 1 );
-      if ( ! inputBlocks.count( layerRef ) )
+      auto entryIt = std::find_if( mRasterEntries.constBegin(), mRasterEntries.constEnd(), [&rasterName]( const QgsRasterCalculatorEntry & entry )
       {
-        for ( const QgsRasterCalculatorEntry &ref : qgis::as_const( mRasterEntries ) )
-        {
-          if ( ref.ref == layerRef )
-          {
-            uniqueRasterEntries[layerRef] = ref;
-            inputBlocks[layerRef ] = qgis::make_unique<QgsRasterBlock>();
-          }
-        }
-      }
+        return entry.ref == rasterName;
+      } );
+      if ( entryIt == mRasterEntries.constEnd() )
+        break;
+      inputEntries.push_back( *entryIt );
     }
 
-    //read / write line by line
-    QMap<QString, QgsRasterBlock * > _rasterData;
-    // Cast to float
-    std::vector<float> castedResult( static_cast<size_t>( mNumOutputColumns ), 0 );
-    auto rowHeight = mOutputRectangle.height() / mNumOutputRows;
-    for ( size_t row = 0; row < static_cast<size_t>( mNumOutputRows ); ++row )
+    if ( !program.isValid() || inputEntries.size() != static_cast< std::size_t >( rasterNames.size() ) )
     {
-      if ( feedback )
-      {
-        feedback->setProgress( 100.0 * static_cast< double >( row ) / mNumOutputRows );
-      }
+      //delete the dataset without closing (because it is faster)
+      gdal::fast_delete_and_close( outputDataset, outputDriver, mOutputFile );
+      return CalculationError;
+    }
 
-      if ( feedback && feedback->isCanceled() )
-      {
-        break;
-      }
+    // Providers are only accessed from this thread: the input blocks of a tile are read while the
+    // rows of the previous tile are being calculated by the thread pool
+    const int threadCount = std::max( 1, QThreadPool::globalInstance()->maxThreadCount() );
+    const int tileRows = std::min( mNumOutputRows, std::max( 4 * threadCount, ( 1 << 20 ) / std::max( 1, mNumOutputColumns ) ) );
+    const std::size_t nColumns = static_cast< std::size_t >( mNumOutputColumns );
+
+    struct Tile
+    {
+      int firstRow = 0;
+      int rowCount = 0;
+      std::vector< std::unique_ptr< QgsRasterBlock > > blocks;
+      std::vector< float > result;
+      std::vector< int > rows;
+    };
+    Tile tiles[2];
+    for ( Tile &tile : tiles )
+    {
+      tile.blocks.resize( inputEntries.size() );
+      tile.result.resize( nColumns * tileRows );
+    }
+
+    const double rowHeight = mOutputRectangle.height() / mNumOutputRows;
+    auto readTile = [&]( Tile & tile, int firstRow )
+    {
+      tile.firstRow = firstRow;
+      tile.rowCount = std::min( tileRows, mNumOutputRows - firstRow );
+      tile.rows.resize( tile.rowCount );
+      std::iota( tile.rows.begin(), tile.rows.end(), 0 );
 
-      // Calculates the rect for a single row read
+      // Calculates the rect for the tile rows
       QgsRectangle rect( mOutputRectangle );
-      rect.setYMaximum( rect.yMaximum() - rowHeight * row );
-      rect.setYMinimum( rect.yMaximum() - rowHeight );
+      rect.setYMaximum( rect.yMaximum() - rowHeight * firstRow );
+      rect.setYMinimum( rect.yMaximum() - rowHeight * tile.rowCount );
 
-      // Read rows into input blocks
-      for ( auto &layerRef : inputBlocks )
+      for ( std::size_t i = 0; i < inputEntries.size(); ++i )
       {
-        QgsRasterCalculatorEntry ref = uniqueRasterEntries[layerRef.first];
+        const QgsRasterCalculatorEntry &ref = inputEntries[i];
         if ( ref.raster->crs() != mOutputCrs )
         {
           QgsRasterProjector proj;
           proj.setCrs( ref.raster->crs(), mOutputCrs, mTransformContext );
           proj.setInput( ref.raster->dataProvider() );
           proj.setPrecision( QgsRasterProjector::Exact );
-          layerRef.second.reset( proj.block( ref.bandNumber, rect, mNumOutputColumns, 1 ) );
+          tile.blocks[i].reset( proj.block( ref.bandNumber, rect, mNumOutputColumns, tile.rowCount ) );
         }
         else
         {
-          layerRef.second.reset( ref.raster->dataProvider()->block( ref.bandNumber, rect, mNumOutputColumns, 1 ) );
+          tile.blocks[i].reset( ref.raster->dataProvider()->block( ref.bandNumber, rect, mNumOutputColumns, tile.rowCount ) );
         }
       }
+    };
 
-      // 1 row X mNumOutputColumns matrix
-      QgsRasterMatrix resultMatrix( mNumOutputColumns, 1, nullptr, outputNodataValue );
-
-      _rasterData.clear();
-      for ( const auto &layerRef : inputBlocks )
+    auto writeTile = [&]( Tile & tile )
+    {
+      if ( GDALRasterIO( outputRasterBand, GF_Write, 0, tile.firstRow, mNumOutputColumns, tile.rowCount, tile.result.data(), mNumOutputColumns, tile.rowCount, GDT_Float32, 0, 0 ) != CE_None )
       {
-        _rasterData.insert( layerRef.first, layerRef.second.get() );
+        QgsDebugMsg( QStringLiteral( "RasterIO error!" ) );
       }
+    };
 
-      if ( calcNode->calculate( _rasterData, resultMatrix, 0 ) )
+    auto calculateRow = [&program, nColumns, outputNodataValue]( Tile & tile, int row )
+    {
+      //convert input raster values to double, also convert input no data to result no data
+      std::vector< double > values( nColumns * ( tile.blocks.size() + 1 ) );
+      std::vector< const double * > inputs( tile.blocks.size() );
+      bool isNoData = false;
+      for ( std::size_t i = 0; i < tile.blocks.size(); ++i )
       {
-        std::copy( resultMatrix.data(), resultMatrix.data() + mNumOutputColumns, castedResult.begin() );
-        if ( GDALRasterIO( outputRasterBand, GF_Write, 0, row, mNumOutputColumns, 1, castedResult.data(), mNumOutputColumns, 1, GDT_Float32, 0, 0 ) != CE_None )
+        const QgsRasterBlock *block = tile.blocks[i].get();
+        double *data = values.data() + i * nColumns;
+        for ( std::size_t col = 0; col < nColumns; ++col )
         {
-          QgsDebugMsg( QStringLiteral( "RasterIO error!" ) );
+          const double value = block->valueAndNoData( row, static_cast< int >( col ), isNoData );
+          data[ col ] = isNoData ? outputNodataValue : value;
         }
+        inputs[i] = data;
       }
-      else
+
+      double *result = values.data() + tile.blocks.size() * nColumns;
+      program.evaluate( inputs.data(), result, static_cast< int >( nColumns ), outputNodataValue );
+      // Cast to float
+      std::copy( result, result + nColumns, tile.result.begin() + row * nColumns );
+    };
+
+    QFuture< void > pending;
+    int pendingTile = -1;
+    int current = 0;
+    for ( int firstRow = 0; firstRow < mNumOutputRows; firstRow += tileRows )
+    {
+      if ( feedback )
       {
-        //delete the dataset without closing (because it is faster)
-        gdal::fast_delete_and_close( outputDataset, outputDriver, mOutputFile );
-        return CalculationError;
+        feedback->setProgress( 100.0 * static_cast< double >( firstRow ) / mNumOutputRows );
       }
+
+      if ( feedback && feedback->isCanceled() )
+      {
+        break;
+      }
+
+      Tile &tile = tiles[ current ];
+      readTile( tile, firstRow );
+
+      if ( pendingTile != -1 )
+      {
+        pending.waitForFinished();
+        writeTile( tiles[ pendingTile ] );
+      }
+
+      pending = QtConcurrent::map( tile.rows.begin(), tile.rows.end(), [&calculateRow, &tile]( int row )
+      {
+        calculateRow( tile, row );
+      } );
+      pendingTile = current;
+      current = 1 - current;
+    }
+
+    if ( pendingTile != -1 )
+    {
+      pending.waitForFinished();
+      if ( !feedback || !feedback->isCanceled() )
+        writeTile( tiles[ pendingTile ] );
     }
 
     if ( feedback )
@@ -84,3 +84,34 @@ float QgsRuggednessFilter::processNineCellWindow( float *x11, float *x21, float
   return std::sqrt( sum );
 }
 
+void QgsRuggednessFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  const float nodata = mInputNodataValue;
+  // squared difference to the centre cell, or 0 for nodata neighbours
+  auto term = [nodata]( float value, float centre ) -> float
+  {
+    return value != nodata ? ( value - centre ) * ( value - centre ) : 0.0f;
+  };
+
+  for ( int x = 0; x < count; ++x )
+  {
+    const float *r1 = scanLine1 + x;
+    const float *r2 = scanLine2 + x;
+    const float *r3 = scanLine3 + x;
+    const float centre = r2[1];
+
+    // same summation order as processNineCellWindow
+    double sum = 0;
+    sum += term( r1[0], centre );
+    sum += term( r1[1], centre );
+    sum += term( r1[2], centre );
+    sum += term( r2[0], centre );
+    sum += term( r2[2], centre );
+    sum += term( r3[0], centre );
+    sum += term( r3[1], centre );
+    sum += term( r3[2], centre );
+
+    const float ruggedness = std::sqrt( sum );
+    resultLine[x] = centre == nodata ? mOutputNodataValue : ruggedness;
+  }
+}
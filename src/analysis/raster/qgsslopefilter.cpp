@@ -17,6 +17,7 @@
 
 #include "qgsslopefilter.h"
 #include <cmath>
+#include <vector>
 
 QgsSlopeFilter::QgsSlopeFilter( const QString &inputFile, const QString &outputFile, const QString &outputFormat )
   : QgsDerivativeFilter( inputFile, outputFile, outputFormat )
@@ -40,3 +41,17 @@ float QgsSlopeFilter::processNineCellWindow(
   return std::atan( std::sqrt( derX * derX + derY * derY ) ) * 180.0 / M_PI;
 }
 
+void QgsSlopeFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  std::vector< float > derX( count );
+  std::vector< float > derY( count );
+  calcFirstDerRow( scanLine1, scanLine2, scanLine3, derX.data(), derY.data(), count );
+
+  for ( int x = 0; x < count; ++x )
+  {
+    const float dx = derX[x];
+    const float dy = derY[x];
+    const float slope = std::atan( std::sqrt( dx * dx + dy * dy ) ) * 180.0 / M_PI;
+    resultLine[x] = ( dx == mOutputNodataValue || dy == mOutputNodataValue ) ? mOutputNodataValue : slope;
+  }
+}
@@ -34,6 +34,8 @@ class ANALYSIS_EXPORT QgsSlopeFilter: public QgsDerivativeFilter
                                  float *x12, float *x22, float *x32,
                                  float *x13, float *x23, float *x33 ) override;
 
+    void processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count ) override SIP_SKIP;
+
 
 #ifdef HAVE_OPENCL
   private:
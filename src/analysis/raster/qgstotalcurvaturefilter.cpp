@@ -41,3 +41,25 @@ float QgsTotalCurvatureFilter::processNineCellWindow( float *x11, float *x21, fl
 
   return dxx * dxx + 2 * dxy * dxy + dyy * dyy;
 }
+
+void QgsTotalCurvatureFilter::processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count )
+{
+  const double cellSizeAvg = ( mCellSizeX + mCellSizeY ) / 2.0;
+  for ( int x = 0; x < count; ++x )
+  {
+    const float *r1 = scanLine1 + x;
+    const float *r2 = scanLine2 + x;
+    const float *r3 = scanLine3 + x;
+
+    const bool hasNodata = ( r1[0] == mInputNodataValue ) | ( r1[1] == mInputNodataValue ) | ( r1[2] == mInputNodataValue )
+                           | ( r2[0] == mInputNodataValue ) | ( r2[1] == mInputNodataValue ) | ( r2[2] == mInputNodataValue )
+                           | ( r3[0] == mInputNodataValue ) | ( r3[1] == mInputNodataValue ) | ( r3[2] == mInputNodataValue );
+
+    const double dxx = ( r2[2] - 2 * r2[1] + r2[0] ) / ( mCellSizeX * mCellSizeX );
+    const double dxy = ( -r1[0] + r1[2] + r3[0] - r3[2] ) / ( 4 * cellSizeAvg * cellSizeAvg );
+    const double dyy = ( r1[1] - 2 * r2[1] + r3[1] ) / ( mCellSizeY * mCellSizeY );
+    const float curvature = dxx * dxx + 2 * dxy * dxy + dyy * dyy;
+
+    resultLine[x] = hasNodata ? mOutputNodataValue : curvature;
+  }
+}
@@ -35,6 +35,8 @@ class ANALYSIS_EXPORT QgsTotalCurvatureFilter: public QgsNineCellFilter
     float processNineCellWindow( float *x11, float *x21, float *x31,
                                  float *x12, float *x22, float *x32,
                                  float *x13, float *x23, float *x33 ) override;
+
+    void processNineCellRow( float *scanLine1, float *scanLine2, float *scanLine3, float *resultLine, int count ) override SIP_SKIP;
 };
 
 #endif // QGSTOTALCURVATUREFILTER_H
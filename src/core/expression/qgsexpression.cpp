@@ -24,6 +24,7 @@
 #include "qgsproject.h"
 #include "qgsexpressioncontextutils.h"
 #include "qgsexpression_p.h"
+#include "qgsexpressionset.h"
 
 #include <QRegularExpression>
 
@@ -54,6 +55,7 @@ void QgsExpression::setExpression( const QString &expression )
   d->mEvalErrorString = QString();
   d->mExp = expression;
   d->mIsPrepared = false;
+  d->mProgram.reset();
 }
 
 QString QgsExpression::expression() const
@@ -342,7 +344,11 @@ bool QgsExpression::prepare( const QgsExpressionContext *context )
 
   initGeomCalculator( context );
   d->mIsPrepared = true;
-  return d->mRootNode->prepare( this, context );
+  const bool prepared = d->mRootNode->prepare( this, context );
+  d->mProgram = qgis::make_unique<QgsExpressionProgram>( d->mRootNode, context );
+  if ( context && context->expressionSet() )
+    context->expressionSet()->addExpression( *this, context );
+  return prepared;
 }
 
 QVariant QgsExpression::evaluate()
@@ -370,9 +376,58 @@ QVariant QgsExpression::evaluate( const QgsExpressionContext *context )
   {
     prepare( context );
   }
+  if ( d->mProgram )
+  {
+    // the program does not evaluate the root node through QgsExpressionNode::eval(), so results of
+    // identical expressions prepared in the same expression set are looked up here
+    QgsExpressionSet *set = context ? context->expressionSet() : nullptr;
+    QVariant result;
+    if ( set && set->cachedResult( d->mRootNode, context, result ) )
+      return result;
+
+    result = d->mProgram->evaluate( this, context );
+    if ( set && d->mEvalErrorString.isEmpty() )
+      set->storeResult( d->mRootNode, context, result );
+    return result;
+  }
   return d->mRootNode->eval( this, context );
 }
 
+QVariantList QgsExpression::evaluateFeatures( const QList<QgsFeature> &features, QgsExpressionContext *context )
+{
+  QVariantList results;
+  d->mEvalErrorString = QString();
+  if ( !d->mRootNode )
+  {
+    d->mEvalErrorString = tr( "No root node! Parsing failed?" );
+    return results;
+  }
+
+  QgsExpressionContext defaultContext;
+  if ( !context )
+    context = &defaultContext;
+
+  if ( ! d->mIsPrepared )
+  {
+    prepare( context );
+  }
+
+  if ( d->mProgram )
+    return d->mProgram->evaluate( features, this, context );
+
+  results.reserve( features.size() );
+  for ( const QgsFeature &feature : features )
+  {
+    context->setFeature( feature );
+    const QVariant value = d->mRootNode->eval( this, context );
+    if ( hasEvalError() )
+      break;
+
+    results << value;
+  }
+  return results;
+}
+
 bool QgsExpression::hasEvalError() const
 {
   return !d->mEvalErrorString.isNull();
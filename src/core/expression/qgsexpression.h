@@ -342,6 +342,21 @@ class CORE_EXPORT QgsExpression
      */
     QVariant evaluate( const QgsExpressionContext *context );
 
+    /**
+     * Evaluates the expression for each of the specified \a features and returns the results,
+     * in the same order.
+     *
+     * Each feature is set on the \a context in turn, which holds the last evaluated feature
+     * afterwards. Evaluating a batch of features avoids the per call overhead of evaluate().
+     *
+     * Evaluation stops at the first feature raising an error. In that case hasEvalError()
+     * returns TRUE and the returned list only contains the results of the features preceding it.
+     *
+     * \note prepare() should be called before calling this method.
+     * \since QGIS 3.18
+     */
+    QVariantList evaluateFeatures( const QList<QgsFeature> &features, QgsExpressionContext *context );
+
     //! Returns TRUE if an error occurred when evaluating last input
     bool hasEvalError() const;
     //! Returns evaluation error
@@ -0,0 +1,671 @@
+/***************************************************************************
+  qgsexpressioncolumnfilter.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsexpressioncolumnfilter_p.h"
+#include "qgsexpression.h"
+#include "qgsexpressionutils.h"
+
+#include <cmath>
+#include <limits>
+
+///@cond PRIVATE
+
+void QgsExpressionColumnFilter::Column::resize( int size )
+{
+  switch ( type )
+  {
+    case ColumnType::Integer:
+      integers.resize( size );
+      break;
+    case ColumnType::Double:
+      doubles.resize( size );
+      break;
+    case ColumnType::String:
+      strings.resize( size );
+      break;
+    case ColumnType::Null:
+    case ColumnType::Logic:
+      break;
+  }
+  flags.resize( size );
+}
+
+bool QgsExpressionColumnFilter::Column::isNull( int i ) const
+{
+  switch ( type )
+  {
+    case ColumnType::Null:
+      return true;
+    case ColumnType::Logic:
+      return flags[i * stride] == QgsExpressionUtils::Unknown;
+    case ColumnType::Integer:
+    case ColumnType::Double:
+    case ColumnType::String:
+      break;
+  }
+  return flags[i * stride];
+}
+
+std::unique_ptr< QgsExpressionColumnFilter > QgsExpressionColumnFilter::create( const QgsExpression &expression, const QgsFields &fields )
+{
+  if ( !expression.rootNode() || expression.hasParserError() )
+    return nullptr;
+
+  std::unique_ptr< QgsExpressionColumnFilter > filter( new QgsExpressionColumnFilter() );
+  filter->mResult = filter->compile( expression.rootNode(), fields );
+  // QVariant::toBool() is not the three-valued logic conversion for strings
+  if ( filter->mResult < 0 || filter->mColumns[filter->mResult].type == ColumnType::String )
+    return nullptr;
+
+  return filter;
+}
+
+bool QgsExpressionColumnFilter::evaluate( const QgsFeatureList &features, QVector< bool > &matches )
+{
+  const int size = features.size();
+  for ( const Instruction &instruction : qgis::as_const( mInstructions ) )
+  {
+    if ( instruction.target >= 0 )
+      mColumns[instruction.target].resize( size );
+
+    switch ( instruction.operation )
+    {
+      case Operation::LoadField:
+        if ( !loadField( instruction, features ) )
+          return false;
+        break;
+      case Operation::Arithmetic:
+        evaluateArithmetic( instruction, size );
+        break;
+      case Operation::Compare:
+        evaluateCompare( instruction, size );
+        break;
+      case Operation::Logic:
+        evaluateLogic( instruction, size );
+        break;
+      case Operation::Is:
+        evaluateIs( instruction, size );
+        break;
+      case Operation::In:
+        evaluateIn( instruction, size );
+        break;
+      case Operation::Not:
+        evaluateNot( instruction, size );
+        break;
+      case Operation::Minus:
+        if ( !evaluateMinus( instruction, size ) )
+          return false;
+        break;
+    }
+  }
+
+  // same conversion as QVariant::toBool() on the result of the expression tree
+  const Column &result = mColumns[mResult];
+  matches.resize( size );
+  for ( int i = 0; i < size; ++i )
+  {
+    switch ( result.type )
+    {
+      case ColumnType::Logic:
+        matches[i] = result.flags[i * result.stride] == QgsExpressionUtils::True;
+        break;
+      case ColumnType::Integer:
+        matches[i] = !result.isNull( i ) && result.integers[i * result.stride] != 0;
+        break;
+      case ColumnType::Double:
+        matches[i] = !result.isNull( i ) && result.doubles[i * result.stride] != 0.0;
+        break;
+      case ColumnType::Null:
+      case ColumnType::String:
+        matches[i] = false;
+        break;
+    }
+  }
+  return true;
+}
+
+int QgsExpressionColumnFilter::compile( const QgsExpressionNode *node, const QgsFields &fields )
+{
+  if ( node->hasCachedStaticValue() )
+    return addConstant( node->cachedStaticValue() );
+
+  switch ( node->nodeType() )
+  {
+    case QgsExpressionNode::ntLiteral:
+      return addConstant( static_cast< const QgsExpressionNodeLiteral * >( node )->value() );
+
+    case QgsExpressionNode::ntColumnRef:
+    {
+      // same field lookup as QgsExpressionNodeColumnRef
+      Instruction instruction;
+      instruction.operation = Operation::LoadField;
+      instruction.argument = fields.lookupField( static_cast< const QgsExpressionNodeColumnRef * >( node )->name() );
+      if ( instruction.argument < 0 )
+        return -1;
+
+      switch ( fields.at( instruction.argument ).type() )
+      {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+          return addInstruction( instruction, ColumnType::Integer );
+        case QVariant::Double:
+          return addInstruction( instruction, ColumnType::Double );
+        case QVariant::String:
+          return addInstruction( instruction, ColumnType::String );
+        default:
+          return -1;
+      }
+    }
+
+    case QgsExpressionNode::ntUnaryOperator:
+    {
+      const QgsExpressionNodeUnaryOperator *unary = static_cast< const QgsExpressionNodeUnaryOperator * >( node );
+      Instruction instruction;
+      instruction.left = compile( unary->operand(), fields );
+      if ( instruction.left < 0 )
+        return -1;
+
+      const ColumnType type = mColumns[instruction.left].type;
+      if ( unary->op() == QgsExpressionNodeUnaryOperator::uoNot )
+      {
+        if ( type == ColumnType::String )
+          return -1;
+        instruction.operation = Operation::Not;
+        return addInstruction( instruction, ColumnType::Logic );
+      }
+
+      if ( type != ColumnType::Integer && type != ColumnType::Double )
+        return -1;
+      instruction.operation = Operation::Minus;
+      return addInstruction( instruction, type );
+    }
+
+    case QgsExpressionNode::ntBinaryOperator:
+      return compileBinary( static_cast< const QgsExpressionNodeBinaryOperator * >( node ), fields );
+
+    case QgsExpressionNode::ntInOperator:
+      return compileIn( static_cast< const QgsExpressionNodeInOperator * >( node ), fields );
+
+    case QgsExpressionNode::ntFunction:
+    case QgsExpressionNode::ntCondition:
+    case QgsExpressionNode::ntIndexOperator:
+      break;
+  }
+  return -1;
+}
+
+int QgsExpressionColumnFilter::compileBinary( const QgsExpressionNodeBinaryOperator *node, const QgsFields &fields )
+{
+  Instruction instruction;
+  instruction.binaryOperator = node->op();
+  instruction.left = compile( node->opLeft(), fields );
+  if ( instruction.left < 0 )
+    return -1;
+  instruction.right = compile( node->opRight(), fields );
+  if ( instruction.right < 0 )
+    return -1;
+
+  const Column &left = mColumns[instruction.left];
+  const Column &right = mColumns[instruction.right];
+  const bool hasNull = left.type == ColumnType::Null || right.type == ColumnType::Null;
+  const bool numeric = left.isNumeric() && right.isNumeric();
+
+  switch ( node->op() )
+  {
+    case QgsExpressionNodeBinaryOperator::boAnd:
+    case QgsExpressionNodeBinaryOperator::boOr:
+      if ( left.type == ColumnType::String || right.type == ColumnType::String )
+        return -1;
+      instruction.operation = Operation::Logic;
+      return addInstruction( instruction, ColumnType::Logic );
+
+    case QgsExpressionNodeBinaryOperator::boPlus:
+    case QgsExpressionNodeBinaryOperator::boMinus:
+    case QgsExpressionNodeBinaryOperator::boMul:
+    case QgsExpressionNodeBinaryOperator::boDiv:
+    case QgsExpressionNodeBinaryOperator::boMod:
+    case QgsExpressionNodeBinaryOperator::boPow:
+      if ( hasNull )
+        return addConstant( QVariant() );
+      if ( !numeric )
+        return -1;
+      instruction.operation = Operation::Arithmetic;
+      // the expression tree uses integer arithmetic for integer operands, except for divisions and powers
+      if ( left.type == ColumnType::Integer && right.type == ColumnType::Integer
+           && node->op() != QgsExpressionNodeBinaryOperator::boDiv && node->op() != QgsExpressionNodeBinaryOperator::boPow )
+        return addInstruction( instruction, ColumnType::Integer );
+      return addInstruction( instruction, ColumnType::Double );
+
+    case QgsExpressionNodeBinaryOperator::boEQ:
+    case QgsExpressionNodeBinaryOperator::boNE:
+    case QgsExpressionNodeBinaryOperator::boLT:
+    case QgsExpressionNodeBinaryOperator::boGT:
+    case QgsExpressionNodeBinaryOperator::boLE:
+    case QgsExpressionNodeBinaryOperator::boGE:
+      if ( hasNull )
+        return addLogicConstant( QgsExpressionUtils::Unknown );
+      if ( !numeric && ( left.type != ColumnType::String || right.type != ColumnType::String ) )
+        return -1;
+      instruction.operation = Operation::Compare;
+      return addInstruction( instruction, ColumnType::Logic );
+
+    case QgsExpressionNodeBinaryOperator::boIs:
+    case QgsExpressionNodeBinaryOperator::boIsNot:
+      if ( !hasNull && !numeric && ( left.type != ColumnType::String || right.type != ColumnType::String ) )
+        return -1;
+      instruction.operation = Operation::Is;
+      instruction.negate = node->op() == QgsExpressionNodeBinaryOperator::boIsNot;
+      return addInstruction( instruction, ColumnType::Logic );
+
+    default:
+      break;
+  }
+  return -1;
+}
+
+int QgsExpressionColumnFilter::compileIn( const QgsExpressionNodeInOperator *node, const QgsFields &fields )
+{
+  const QList< QgsExpressionNode * > items = node->list()->list();
+  if ( items.isEmpty() )
+    return addLogicConstant( node->isNotIn() ? QgsExpressionUtils::True : QgsExpressionUtils::False );
+
+  Instruction instruction;
+  instruction.operation = Operation::In;
+  instruction.negate = node->isNotIn();
+  instruction.left = compile( node->node(), fields );
+  if ( instruction.left < 0 )
+    return -1;
+
+  const ColumnType type = mColumns[instruction.left].type;
+  if ( type == ColumnType::Null )
+    return addLogicConstant( QgsExpressionUtils::Unknown );
+  if ( type == ColumnType::Logic )
+    return -1;
+
+  // only lists of constant values of the same kind as the operand are supported
+  QVector< int > values;
+  for ( const QgsExpressionNode *item : items )
+  {
+    QVariant value;
+    if ( item->hasCachedStaticValue() )
+      value = item->cachedStaticValue();
+    else if ( item->nodeType() == QgsExpressionNode::ntLiteral )
+      value = static_cast< const QgsExpressionNodeLiteral * >( item )->value();
+    else
+      return -1;
+
+    const int column = addConstant( value );
+    if ( column < 0 )
+      return -1;
+
+    const ColumnType valueType = mColumns[column].type;
+    if ( valueType == ColumnType::Null )
+      instruction.hasNull = true;
+    else if ( ( type == ColumnType::String ) != ( valueType == ColumnType::String ) || valueType == ColumnType::Logic )
+      return -1;
+    else
+      values << column;
+  }
+
+  instruction.argument = mInValues.size();
+  instruction.count = values.size();
+  mInValues << values;
+  return addInstruction( instruction, ColumnType::Logic );
+}
+
+int QgsExpressionColumnFilter::addConstant( const QVariant &value )
+{
+  Column column;
+  column.stride = 0;
+  column.flags.resize( 1 );
+
+  if ( value.isNull() )
+  {
+    // a NULL string is concatenated by +, keep these to the expression tree
+    if ( value.type() == QVariant::String )
+      return -1;
+    column.type = ColumnType::Null;
+  }
+  else
+  {
+    switch ( value.type() )
+    {
+      case QVariant::ULongLong:
+        if ( value.toULongLong() > static_cast< qulonglong >( std::numeric_limits< qint64 >::max() ) )
+          return -1;
+        FALLTHROUGH
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+        column.type = ColumnType::Integer;
+        column.integers.push_back( value.toLongLong() );
+        break;
+      case QVariant::Double:
+        column.type = ColumnType::Double;
+        column.doubles.push_back( value.toDouble() );
+        break;
+      case QVariant::String:
+        column.type = ColumnType::String;
+        column.strings << value.toString();
+        break;
+      case QVariant::Bool:
+        column.type = ColumnType::Logic;
+        column.flags[0] = value.toBool() ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  mColumns.push_back( column );
+  return static_cast< int >( mColumns.size() ) - 1;
+}
+
+int QgsExpressionColumnFilter::addLogicConstant( char value )
+{
+  Column column;
+  column.type = ColumnType::Logic;
+  column.stride = 0;
+  column.flags.push_back( value );
+  mColumns.push_back( column );
+  return static_cast< int >( mColumns.size() ) - 1;
+}
+
+int QgsExpressionColumnFilter::addInstruction( const Instruction &instruction, ColumnType type )
+{
+  Column column;
+  column.type = type;
+  mColumns.push_back( column );
+
+  Instruction added = instruction;
+  added.target = static_cast< int >( mColumns.size() ) - 1;
+  mInstructions << added;
+  return added.target;
+}
+
+bool QgsExpressionColumnFilter::loadField( const Instruction &instruction, const QgsFeatureList &features )
+{
+  Column &column = mColumns[instruction.target];
+  int i = 0;
+  for ( const QgsFeature &feature : features )
+  {
+    // the expression tree reports an evaluation error for invalid features
+    if ( !feature.isValid() )
+      return false;
+
+    const QVariant value = feature.attribute( instruction.argument );
+    column.flags[i] = value.isNull();
+    if ( !column.flags[i] )
+    {
+      switch ( column.type )
+      {
+        case ColumnType::Integer:
+          if ( value.type() != QVariant::Int && value.type() != QVariant::UInt && value.type() != QVariant::LongLong
+               && ( value.type() != QVariant::ULongLong || value.toULongLong() > static_cast< qulonglong >( std::numeric_limits< qint64 >::max() ) ) )
+            return false;
+          column.integers[i] = value.toLongLong();
+          break;
+        case ColumnType::Double:
+          if ( value.type() != QVariant::Double )
+            return false;
+          column.doubles[i] = value.toDouble();
+          break;
+        case ColumnType::String:
+          if ( value.type() != QVariant::String )
+            return false;
+          column.strings[i] = value.toString();
+          break;
+        case ColumnType::Null:
+        case ColumnType::Logic:
+          return false;
+      }
+    }
+    ++i;
+  }
+  return true;
+}
+
+void QgsExpressionColumnFilter::evaluateArithmetic( const Instruction &instruction, int size )
+{
+  const Column &left = mColumns[instruction.left];
+  const Column &right = mColumns[instruction.right];
+  Column &target = mColumns[instruction.target];
+
+  if ( target.type == ColumnType::Integer )
+  {
+    for ( int i = 0; i < size; ++i )
+    {
+      const qint64 l = left.integers[i * left.stride];
+      const qint64 r = right.integers[i * right.stride];
+      target.flags[i] = left.flags[i * left.stride] || right.flags[i * right.stride]
+                        || ( instruction.binaryOperator == QgsExpressionNodeBinaryOperator::boMod && r == 0 );
+      if ( target.flags[i] )
+        continue;
+
+      switch ( instruction.binaryOperator )
+      {
+        case QgsExpressionNodeBinaryOperator::boPlus:
+          target.integers[i] = l + r;
+          break;
+        case QgsExpressionNodeBinaryOperator::boMinus:
+          target.integers[i] = l - r;
+          break;
+        case QgsExpressionNodeBinaryOperator::boMul:
+          target.integers[i] = l * r;
+          break;
+        default:
+          target.integers[i] = l % r;
+          break;
+      }
+    }
+    return;
+  }
+
+  for ( int i = 0; i < size; ++i )
+  {
+    const double l = left.number( i );
+    const double r = right.number( i );
+    // division by zero silently returns NULL, as in the expression tree
+    target.flags[i] = left.flags[i * left.stride] || right.flags[i * right.stride]
+                      || ( ( instruction.binaryOperator == QgsExpressionNodeBinaryOperator::boDiv || instruction.binaryOperator == QgsExpressionNodeBinaryOperator::boMod ) && r == 0. );
+    if ( target.flags[i] )
+      continue;
+
+    switch ( instruction.binaryOperator )
+    {
+      case QgsExpressionNodeBinaryOperator::boPlus:
+        target.doubles[i] = l + r;
+        break;
+      case QgsExpressionNodeBinaryOperator::boMinus:
+        target.doubles[i] = l - r;
+        break;
+      case QgsExpressionNodeBinaryOperator::boMul:
+        target.doubles[i] = l * r;
+        break;
+      case QgsExpressionNodeBinaryOperator::boDiv:
+        target.doubles[i] = l / r;
+        break;
+      case QgsExpressionNodeBinaryOperator::boMod:
+        target.doubles[i] = std::fmod( l, r );
+        break;
+      default:
+        target.doubles[i] = std::pow( l, r );
+        break;
+    }
+  }
+}
+
+void QgsExpressionColumnFilter::evaluateCompare( const Instruction &instruction, int size )
+{
+  const Column &left = mColumns[instruction.left];
+  const Column &right = mColumns[instruction.right];
+  Column &target = mColumns[instruction.target];
+  const bool numeric = left.isNumeric();
+
+  for ( int i = 0; i < size; ++i )
+  {
+    if ( left.flags[i * left.stride] || right.flags[i * right.stride] )
+    {
+      target.flags[i] = QgsExpressionUtils::Unknown;
+      continue;
+    }
+
+    const double diff = numeric ? left.number( i ) - right.number( i )
+                        : QString::compare( left.strings[i * left.stride], right.strings[i * right.stride] );
+    bool result = false;
+    switch ( instruction.binaryOperator )
+    {
+      case QgsExpressionNodeBinaryOperator::boEQ:
+        result = qgsDoubleNear( diff, 0.0 );
+        break;
+      case QgsExpressionNodeBinaryOperator::boNE:
+        result = !qgsDoubleNear( diff, 0.0 );
+        break;
+      case QgsExpressionNodeBinaryOperator::boLT:
+        result = diff < 0;
+        break;
+      case QgsExpressionNodeBinaryOperator::boGT:
+        result = diff > 0;
+        break;
+      case QgsExpressionNodeBinaryOperator::boLE:
+        result = diff <= 0;
+        break;
+      default:
+        result = diff >= 0;
+        break;
+    }
+    target.flags[i] = result ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+  }
+}
+
+void QgsExpressionColumnFilter::evaluateLogic( const Instruction &instruction, int size )
+{
+  const Column &left = mColumns[instruction.left];
+  const Column &right = mColumns[instruction.right];
+  Column &target = mColumns[instruction.target];
+  const bool isAnd = instruction.binaryOperator == QgsExpressionNodeBinaryOperator::boAnd;
+
+  for ( int i = 0; i < size; ++i )
+  {
+    const int l = logicValue( left, i );
+    const int r = logicValue( right, i );
+    target.flags[i] = isAnd ? QgsExpressionUtils::AND[l][r] : QgsExpressionUtils::OR[l][r];
+  }
+}
+
+void QgsExpressionColumnFilter::evaluateIs( const Instruction &instruction, int size )
+{
+  const Column &left = mColumns[instruction.left];
+  const Column &right = mColumns[instruction.right];
+  Column &target = mColumns[instruction.target];
+
+  for ( int i = 0; i < size; ++i )
+  {
+    const bool leftNull = left.isNull( i );
+    const bool rightNull = right.isNull( i );
+    bool equal = false;
+    if ( leftNull || rightNull )
+      equal = leftNull && rightNull;
+    else if ( left.isNumeric() )
+      equal = qgsDoubleNear( left.number( i ), right.number( i ) );
+    else
+      equal = QString::compare( left.strings[i * left.stride], right.strings[i * right.stride] ) == 0;
+
+    target.flags[i] = equal != instruction.negate ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+  }
+}
+
+void QgsExpressionColumnFilter::evaluateIn( const Instruction &instruction, int size )
+{
+  const Column &operand = mColumns[instruction.left];
+  Column &target = mColumns[instruction.target];
+  const bool numeric = operand.isNumeric();
+
+  for ( int i = 0; i < size; ++i )
+  {
+    if ( operand.flags[i * operand.stride] )
+    {
+      target.flags[i] = QgsExpressionUtils::Unknown;
+      continue;
+    }
+
+    bool found = false;
+    for ( int j = 0; j < instruction.count && !found; ++j )
+    {
+      const Column &value = mColumns[mInValues.at( instruction.argument + j )];
+      if ( numeric )
+        found = qgsDoubleNear( operand.number( i ), value.number( 0 ) );
+      else
+        found = QString::compare( operand.strings[i * operand.stride], value.strings[0] ) == 0;
+    }
+
+    if ( found )
+      target.flags[i] = instruction.negate ? QgsExpressionUtils::False : QgsExpressionUtils::True;
+    else if ( instruction.hasNull )
+      target.flags[i] = QgsExpressionUtils::Unknown;
+    else
+      target.flags[i] = instruction.negate ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+  }
+}
+
+void QgsExpressionColumnFilter::evaluateNot( const Instruction &instruction, int size )
+{
+  const Column &operand = mColumns[instruction.left];
+  Column &target = mColumns[instruction.target];
+  for ( int i = 0; i < size; ++i )
+    target.flags[i] = QgsExpressionUtils::NOT[static_cast< int >( logicValue( operand, i ) )];
+}
+
+bool QgsExpressionColumnFilter::evaluateMinus( const Instruction &instruction, int size )
+{
+  const Column &operand = mColumns[instruction.left];
+  Column &target = mColumns[instruction.target];
+  for ( int i = 0; i < size; ++i )
+  {
+    if ( operand.flags[i * operand.stride] )
+      return false;
+
+    target.flags[i] = 0;
+    if ( target.type == ColumnType::Integer )
+      target.integers[i] = -operand.integers[i * operand.stride];
+    else
+      target.doubles[i] = -operand.doubles[i * operand.stride];
+  }
+  return true;
+}
+
+char QgsExpressionColumnFilter::logicValue( const Column &column, int i )
+{
+  switch ( column.type )
+  {
+    case ColumnType::Logic:
+      return column.flags[i * column.stride];
+    case ColumnType::Integer:
+      if ( column.flags[i * column.stride] )
+        return QgsExpressionUtils::Unknown;
+      return column.integers[i * column.stride] != 0 ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+    case ColumnType::Double:
+      if ( column.flags[i * column.stride] )
+        return QgsExpressionUtils::Unknown;
+      return !qgsDoubleNear( column.doubles[i * column.stride], 0.0 ) ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+    case ColumnType::Null:
+    case ColumnType::String:
+      break;
+  }
+  return QgsExpressionUtils::Unknown;
+}
+
+///@endcond
@@ -0,0 +1,168 @@
+/***************************************************************************
+  qgsexpressioncolumnfilter_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSEXPRESSIONCOLUMNFILTER_PRIVATE_H
+#define QGSEXPRESSIONCOLUMNFILTER_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_core.h"
+#include "qgsexpressionnodeimpl.h"
+#include "qgsfeature.h"
+#include "qgsfields.h"
+
+#include <QString>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+class QgsExpression;
+
+/**
+ * \ingroup core
+ * \brief Evaluates a filter expression for a batch of features at once, one column at a time.
+ *
+ * The referenced attributes of the features are first copied into typed arrays (integer,
+ * double or string values with a NULL mask), then each operator of the expression is
+ * applied to whole arrays in turn, giving a three-valued logic array for the filter.
+ *
+ * Only expressions made of field references, constants, arithmetic, comparisons, AND, OR,
+ * NOT, IS and IN lists of constants over numeric and string fields are supported, which
+ * covers the usual attribute filters. Their results are identical to the evaluation of the
+ * expression tree, as none of these operators can raise an evaluation error on values of
+ * the supported types.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsExpressionColumnFilter
+{
+  public:
+
+    /**
+     * Compiles \a expression for features with the given \a fields.
+     * Returns NULLPTR if the expression cannot be evaluated column by column.
+     */
+    static std::unique_ptr< QgsExpressionColumnFilter > create( const QgsExpression &expression, const QgsFields &fields );
+
+    /**
+     * Evaluates the filter for a batch of \a features, setting the matching items of \a matches
+     * to TRUE.
+     *
+     * Returns FALSE if an attribute value does not have the type of its field (e.g. a string in
+     * an integer field), in which case the batch must be evaluated feature by feature.
+     */
+    bool evaluate( const QgsFeatureList &features, QVector< bool > &matches );
+
+  private:
+
+    enum class ColumnType
+    {
+      Null, //!< NULL constant
+      Integer,
+      Double,
+      String,
+      Logic, //!< Three-valued logic values, see QgsExpressionUtils::TVL
+    };
+
+    //! Typed values of a node for the features of a batch, or a single value for constants
+    struct Column
+    {
+      ColumnType type = ColumnType::Null;
+      //! 0 for constants, which hold a single value used for all features
+      int stride = 1;
+      std::vector< qint64 > integers;
+      std::vector< double > doubles;
+      QVector< QString > strings;
+      //! NULL mask for integer, double and string values, three-valued logic values for logic columns
+      std::vector< char > flags;
+
+      bool isNumeric() const { return type == ColumnType::Integer || type == ColumnType::Double; }
+      double number( int i ) const { return type == ColumnType::Integer ? static_cast< double >( integers[i * stride] ) : doubles[i * stride]; }
+      bool isNull( int i ) const;
+      void resize( int size );
+    };
+
+    enum class Operation
+    {
+      LoadField,
+      Arithmetic,
+      Compare,
+      Logic,
+      Is,
+      In,
+      Not,
+      Minus,
+    };
+
+    struct Instruction
+    {
+      Operation operation;
+      int target = -1;
+      int left = -1;
+      int right = -1;
+      //! Field index or first IN value, depending on the operation
+      int argument = -1;
+      int count = 0;
+      QgsExpressionNodeBinaryOperator::BinaryOperator binaryOperator = QgsExpressionNodeBinaryOperator::boEQ;
+      bool negate = false;
+      //! TRUE if an IN list contains NULL
+      bool hasNull = false;
+    };
+
+    QgsExpressionColumnFilter() = default;
+
+    //! Compiles \a node, returns its column or -1 if the node is not supported
+    int compile( const QgsExpressionNode *node, const QgsFields &fields );
+    int compileBinary( const QgsExpressionNodeBinaryOperator *node, const QgsFields &fields );
+    int compileIn( const QgsExpressionNodeInOperator *node, const QgsFields &fields );
+    //! Adds a constant column for \a value, returns -1 for unsupported types
+    int addConstant( const QVariant &value );
+    //! Adds a constant logic column for a QgsExpressionUtils::TVL \a value
+    int addLogicConstant( char value );
+    int addInstruction( const Instruction &instruction, ColumnType type );
+
+    bool loadField( const Instruction &instruction, const QgsFeatureList &features );
+    void evaluateArithmetic( const Instruction &instruction, int size );
+    void evaluateCompare( const Instruction &instruction, int size );
+    void evaluateLogic( const Instruction &instruction, int size );
+    void evaluateIs( const Instruction &instruction, int size );
+    void evaluateIn( const Instruction &instruction, int size );
+    void evaluateNot( const Instruction &instruction, int size );
+    //! Returns FALSE for NULL operands, which the expression tree reports as an evaluation error
+    bool evaluateMinus( const Instruction &instruction, int size );
+    //! Returns the three-valued logic value of item \a i of a numeric or logic column
+    static char logicValue( const Column &column, int i );
+
+    std::vector< Column > mColumns;
+    QVector< Instruction > mInstructions;
+    //! Columns of the values of IN lists
+    QVector< int > mInValues;
+    int mResult = -1;
+};
+
+/// @endcond
+
+#endif // QGSEXPRESSIONCOLUMNFILTER_PRIVATE_H
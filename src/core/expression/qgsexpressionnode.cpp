@@ -15,6 +15,8 @@
 
 #include "qgsexpressionnode.h"
 #include "qgsexpression.h"
+#include "qgsexpressioncontext.h"
+#include "qgsexpressionset.h"
 
 
 QVariant QgsExpressionNode::eval( QgsExpression *parent, const QgsExpressionContext *context )
@@ -23,6 +25,19 @@ QVariant QgsExpressionNode::eval( QgsExpression *parent, const QgsExpressionCont
   {
     return mCachedStaticValue;
   }
+  else if ( mExpressionSetKey >= 0 && context && context->expressionSet() )
+  {
+    // subexpression shared with other expressions, evaluated once per feature
+    QgsExpressionSet *set = context->expressionSet();
+    QVariant res;
+    if ( set->cachedResult( this, context, res ) )
+      return res;
+
+    res = evalNode( parent, context );
+    if ( !parent->hasEvalError() )
+      set->storeResult( this, context, res );
+    return res;
+  }
   else
   {
     QVariant res = evalNode( parent, context );
@@ -34,9 +49,21 @@ bool QgsExpressionNode::prepare( QgsExpression *parent, const QgsExpressionConte
 {
   if ( isStatic( parent, context ) )
   {
+    // static values of identical subexpressions are shared by the expressions of a set
+    QgsExpressionSet *set = context ? context->expressionSet() : nullptr;
+    if ( set && set->cachedStaticValue( this, context, mCachedStaticValue ) )
+    {
+      mHasCachedValue = true;
+      return true;
+    }
+
     mCachedStaticValue = evalNode( parent, context );
     if ( !parent->hasEvalError() )
+    {
       mHasCachedValue = true;
+      if ( set )
+        set->storeStaticValue( this, context, mCachedStaticValue );
+    }
     else
       mHasCachedValue = false;
     return true;
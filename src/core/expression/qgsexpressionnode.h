@@ -360,6 +360,13 @@ class CORE_EXPORT QgsExpressionNode SIP_ABSTRACT
 
     bool mHasCachedValue = false;
     QVariant mCachedStaticValue;
+
+    //! Identifier of the QgsExpressionSet the node is registered in
+    mutable quint64 mExpressionSetId = 0;
+    //! Index of the node's subexpression in the QgsExpressionSet, -1 if the node is not registered
+    mutable int mExpressionSetKey = -1;
+
+    friend class QgsExpressionSet;
 };
 
 Q_DECLARE_METATYPE( QgsExpressionNode * )
@@ -109,6 +109,11 @@ QVariant QgsExpressionNodeUnaryOperator::evalNode( QgsExpression *parent, const
   QVariant val = mOperand->eval( parent, context );
   ENSURE_NO_EVAL_ERROR
 
+  return evalOperand( val, parent );
+}
+
+QVariant QgsExpressionNodeUnaryOperator::evalOperand( const QVariant &val, QgsExpression *parent )
+{
   switch ( mOp )
   {
     case uoNot:
@@ -215,6 +220,11 @@ QVariant QgsExpressionNodeBinaryOperator::evalNode( QgsExpression *parent, const
   QVariant vR = mOpRight->eval( parent, context );
   ENSURE_NO_EVAL_ERROR
 
+  return evalOperands( vL, vR, parent, context );
+}
+
+QVariant QgsExpressionNodeBinaryOperator::evalOperands( const QVariant &vL, const QVariant &vR, QgsExpression *parent, const QgsExpressionContext *context )
+{
   switch ( mOp )
   {
     case boPlus:
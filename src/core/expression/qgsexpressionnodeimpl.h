@@ -78,10 +78,16 @@ class CORE_EXPORT QgsExpressionNodeUnaryOperator : public QgsExpressionNode
     QString text() const;
 
   private:
+
+    //! Applies the operator to the evaluated operand value \a val
+    QVariant evalOperand( const QVariant &val, QgsExpression *parent );
+
     UnaryOperator mOp;
     QgsExpressionNode *mOperand = nullptr;
 
     static const char *UNARY_OPERATOR_TEXT[];
+
+    friend class QgsExpressionProgram;
 };
 
 /**
@@ -199,11 +205,16 @@ class CORE_EXPORT QgsExpressionNodeBinaryOperator : public QgsExpressionNode
      */
     QDateTime computeDateTimeFromInterval( const QDateTime &d, QgsInterval *i );
 
+    //! Applies the operator to the evaluated operand values \a vL and \a vR
+    QVariant evalOperands( const QVariant &vL, const QVariant &vR, QgsExpression *parent, const QgsExpressionContext *context );
+
     BinaryOperator mOp;
     QgsExpressionNode *mOpLeft = nullptr;
     QgsExpressionNode *mOpRight = nullptr;
 
     static const char *BINARY_OPERATOR_TEXT[];
+
+    friend class QgsExpressionProgram;
 };
 
 /**
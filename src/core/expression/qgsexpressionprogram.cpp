@@ -0,0 +1,796 @@
+/***************************************************************************
+  qgsexpressionprogram.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsexpressionprogram_p.h"
+#include "qgsexpression.h"
+#include "qgsexpressioncontext.h"
+#include "qgsexpressionutils.h"
+#include "qgsfeature.h"
+
+#include <cmath>
+
+///@cond PRIVATE
+
+//
+// QgsExpressionProgram::Value
+//
+
+void QgsExpressionProgram::Value::setVariant( const QVariant &value )
+{
+  variant = value;
+  if ( value.isNull() )
+  {
+    type = ValueType::Null;
+    return;
+  }
+
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+      type = ValueType::Integer;
+      integer = value.toLongLong();
+      break;
+
+    case QVariant::Double:
+      // non finite values cannot be converted to double by the tree either
+      number = value.toDouble();
+      type = std::isfinite( number ) ? ValueType::Double : ValueType::Variant;
+      break;
+
+    case QVariant::String:
+      type = ValueType::String;
+      string = value.toString();
+      break;
+
+    default:
+      type = ValueType::Variant;
+      break;
+  }
+}
+
+void QgsExpressionProgram::Value::setNull()
+{
+  type = ValueType::Null;
+  variant = QVariant();
+}
+
+void QgsExpressionProgram::Value::setBoolean( bool value )
+{
+  type = ValueType::Boolean;
+  integer = value ? 1 : 0;
+  variant = QVariant();
+}
+
+void QgsExpressionProgram::Value::setInteger( qlonglong value )
+{
+  type = ValueType::Integer;
+  integer = value;
+  variant = QVariant();
+}
+
+void QgsExpressionProgram::Value::setDouble( double value )
+{
+  type = ValueType::Double;
+  number = value;
+  variant = QVariant();
+}
+
+void QgsExpressionProgram::Value::setString( const QString &value )
+{
+  type = ValueType::String;
+  string = value;
+  variant = QVariant();
+}
+
+QVariant QgsExpressionProgram::Value::toVariant() const
+{
+  switch ( type )
+  {
+    case ValueType::Boolean:
+      return integer ? TVL_True : TVL_False;
+
+    case ValueType::Integer:
+      return variant.isValid() ? variant : QVariant( integer );
+
+    case ValueType::Double:
+      return variant.isValid() ? variant : QVariant( number );
+
+    case ValueType::String:
+      return variant.isValid() ? variant : QVariant( string );
+
+    case ValueType::Null:
+    case ValueType::Variant:
+      break;
+  }
+  return variant;
+}
+
+bool QgsExpressionProgram::Value::isStringType() const
+{
+  return type == ValueType::String || ( type == ValueType::Null && variant.type() == QVariant::String );
+}
+
+//
+// QgsExpressionProgram
+//
+
+QgsExpressionProgram::QgsExpressionProgram( QgsExpressionNode *root, const QgsExpressionContext *context )
+{
+  mResult = compile( root, context );
+  mInitialRegisters = mRegisters;
+}
+
+QVariant QgsExpressionProgram::evaluate( QgsExpression *parent, const QgsExpressionContext *context )
+{
+  // the registers of the program are used unless another evaluation is already running,
+  // e.g. for an expression shared between threads
+  if ( mBusy.test_and_set( std::memory_order_acquire ) )
+  {
+    QVector< Value > registers = mInitialRegisters;
+    return run( registers, parent, context );
+  }
+
+  const QVariant result = run( mRegisters, parent, context );
+  mBusy.clear( std::memory_order_release );
+  return result;
+}
+
+QVariantList QgsExpressionProgram::evaluate( const QList<QgsFeature> &features, QgsExpression *parent, QgsExpressionContext *context )
+{
+  QVariantList results;
+  results.reserve( features.size() );
+
+  // the registers are claimed once for the whole batch
+  const bool busy = mBusy.test_and_set( std::memory_order_acquire );
+  QVector< Value > ownRegisters;
+  if ( busy )
+    ownRegisters = mInitialRegisters;
+  QVector< Value > &registers = busy ? ownRegisters : mRegisters;
+
+  for ( const QgsFeature &feature : features )
+  {
+    context->setFeature( feature );
+    const QVariant value = run( registers, parent, context );
+    if ( parent->hasEvalError() )
+      break;
+
+    results << value;
+  }
+
+  if ( !busy )
+    mBusy.clear( std::memory_order_release );
+  return results;
+}
+
+int QgsExpressionProgram::addRegister()
+{
+  mRegisters.append( Value() );
+  return mRegisters.size() - 1;
+}
+
+int QgsExpressionProgram::addConstant( const QVariant &value )
+{
+  const int index = addRegister();
+  mRegisters[index].setVariant( value );
+  return index;
+}
+
+static bool constantValue( const QgsExpressionNode *node, QVariant &value )
+{
+  if ( node->hasCachedStaticValue() )
+  {
+    value = node->cachedStaticValue();
+    return true;
+  }
+  if ( node->nodeType() == QgsExpressionNode::ntLiteral )
+  {
+    value = static_cast< const QgsExpressionNodeLiteral * >( node )->value();
+    return true;
+  }
+  return false;
+}
+
+int QgsExpressionProgram::compile( QgsExpressionNode *node, const QgsExpressionContext *context )
+{
+  QVariant value;
+  if ( constantValue( node, value ) )
+    return addConstant( value );
+
+  switch ( node->nodeType() )
+  {
+    case QgsExpressionNode::ntColumnRef:
+    {
+      // same field lookup as QgsExpressionNodeColumnRef::prepareNode()
+      const QString name = static_cast< QgsExpressionNodeColumnRef * >( node )->name();
+      int fieldIndex = -1;
+      if ( context && context->hasVariable( QgsExpressionContext::EXPR_FIELDS ) )
+      {
+        const QgsFields fields = qvariant_cast<QgsFields>( context->variable( QgsExpressionContext::EXPR_FIELDS ) );
+        fieldIndex = fields.lookupField( name );
+        if ( fieldIndex == -1 && context->hasFeature() )
+          fieldIndex = context->feature().fieldNameIndex( name );
+      }
+      if ( fieldIndex < 0 )
+        return evaluateNodeThroughTree( node );
+
+      Instruction instruction;
+      instruction.operation = Operation::LoadField;
+      instruction.target = addRegister();
+      instruction.argument = fieldIndex;
+      instruction.node = node;
+      mInstructions << instruction;
+      return instruction.target;
+    }
+
+    case QgsExpressionNode::ntUnaryOperator:
+    {
+      QgsExpressionNodeUnaryOperator *unary = static_cast< QgsExpressionNodeUnaryOperator * >( node );
+      Instruction instruction;
+      instruction.operation = unary->op() == QgsExpressionNodeUnaryOperator::uoNot ? Operation::Not : Operation::Minus;
+      instruction.left = compile( unary->operand(), context );
+      instruction.target = addRegister();
+      instruction.node = node;
+      mInstructions << instruction;
+      return instruction.target;
+    }
+
+    case QgsExpressionNode::ntBinaryOperator:
+      return compileBinary( static_cast< QgsExpressionNodeBinaryOperator * >( node ), context );
+
+    case QgsExpressionNode::ntInOperator:
+      return compileIn( static_cast< QgsExpressionNodeInOperator * >( node ), context );
+
+    case QgsExpressionNode::ntCondition:
+      return compileCondition( static_cast< QgsExpressionNodeCondition * >( node ), context );
+
+    case QgsExpressionNode::ntLiteral:
+    case QgsExpressionNode::ntFunction:
+    case QgsExpressionNode::ntIndexOperator:
+      break;
+  }
+  return evaluateNodeThroughTree( node );
+}
+
+int QgsExpressionProgram::compileBinary( QgsExpressionNodeBinaryOperator *node, const QgsExpressionContext *context )
+{
+  const QgsExpressionNodeBinaryOperator::BinaryOperator op = node->op();
+  switch ( op )
+  {
+    case QgsExpressionNodeBinaryOperator::boRegexp:
+    case QgsExpressionNodeBinaryOperator::boLike:
+    case QgsExpressionNodeBinaryOperator::boNotLike:
+    case QgsExpressionNodeBinaryOperator::boILike:
+    case QgsExpressionNodeBinaryOperator::boNotILike:
+      // pattern matching is left to the tree, which caches the compiled patterns
+      return evaluateNodeThroughTree( node );
+
+    default:
+      break;
+  }
+
+  const int left = compile( node->opLeft(), context );
+  const int target = addRegister();
+
+  // AND and OR do not evaluate their right operand when the left one decides the result
+  int shortcut = -1;
+  if ( op == QgsExpressionNodeBinaryOperator::boAnd || op == QgsExpressionNodeBinaryOperator::boOr )
+  {
+    Instruction instruction;
+    instruction.operation = op == QgsExpressionNodeBinaryOperator::boAnd ? Operation::JumpIfFalse : Operation::JumpIfTrue;
+    instruction.left = left;
+    instruction.target = target;
+    shortcut = mInstructions.size();
+    mInstructions << instruction;
+  }
+
+  Instruction instruction;
+  instruction.operation = Operation::Binary;
+  instruction.binaryOperator = op;
+  instruction.left = left;
+  instruction.right = compile( node->opRight(), context );
+  instruction.target = target;
+  instruction.node = node;
+  mInstructions << instruction;
+
+  if ( shortcut >= 0 )
+    mInstructions[shortcut].argument = mInstructions.size();
+
+  return target;
+}
+
+int QgsExpressionProgram::compileIn( QgsExpressionNodeInOperator *node, const QgsExpressionContext *context )
+{
+  // only lists of constant values are compiled, which covers the usual "field" IN ( ... ) filters
+  const QList< QgsExpressionNode * > items = node->list()->list();
+  QVariantList values;
+  for ( const QgsExpressionNode *item : items )
+  {
+    QVariant value;
+    if ( !constantValue( item, value ) )
+      return evaluateNodeThroughTree( node );
+    values << value;
+  }
+
+  if ( values.isEmpty() )
+    return addConstant( node->isNotIn() ? TVL_True : TVL_False );
+
+  Instruction instruction;
+  instruction.operation = Operation::In;
+  instruction.left = compile( node->node(), context );
+  instruction.argument = mInValues.size();
+  instruction.right = values.size();
+  for ( const QVariant &value : qgis::as_const( values ) )
+    mInValues << addConstant( value );
+  instruction.target = addRegister();
+  instruction.node = node;
+  mInstructions << instruction;
+  return instruction.target;
+}
+
+int QgsExpressionProgram::compileCondition( QgsExpressionNodeCondition *node, const QgsExpressionContext *context )
+{
+  const int target = addRegister();
+  QVector< int > jumpsToEnd;
+
+  const QgsExpressionNodeCondition::WhenThenList conditions = node->conditions();
+  for ( const QgsExpressionNodeCondition::WhenThen *condition : conditions )
+  {
+    Instruction test;
+    test.operation = Operation::JumpIfNotTrue;
+    test.left = compile( condition->whenExp(), context );
+    const int testIndex = mInstructions.size();
+    mInstructions << test;
+
+    Instruction move;
+    move.operation = Operation::Move;
+    move.left = compile( condition->thenExp(), context );
+    move.target = target;
+    mInstructions << move;
+
+    Instruction jump;
+    jump.operation = Operation::Jump;
+    jumpsToEnd << mInstructions.size();
+    mInstructions << jump;
+
+    mInstructions[testIndex].argument = mInstructions.size();
+  }
+
+  if ( node->elseExp() )
+  {
+    Instruction move;
+    move.operation = Operation::Move;
+    move.left = compile( node->elseExp(), context );
+    move.target = target;
+    mInstructions << move;
+  }
+  else
+  {
+    Instruction null;
+    null.operation = Operation::LoadNull;
+    null.target = target;
+    mInstructions << null;
+  }
+
+  for ( int jump : qgis::as_const( jumpsToEnd ) )
+    mInstructions[jump].argument = mInstructions.size();
+
+  return target;
+}
+
+int QgsExpressionProgram::evaluateNodeThroughTree( QgsExpressionNode *node )
+{
+  Instruction instruction;
+  instruction.operation = Operation::EvaluateNode;
+  instruction.target = addRegister();
+  instruction.node = node;
+  mInstructions << instruction;
+  mTreeNodeCount++;
+  return instruction.target;
+}
+
+QVariant QgsExpressionProgram::run( QVector< Value > &registers, QgsExpression *parent, const QgsExpressionContext *context )
+{
+  Value *r = registers.data();
+  const Instruction *instructions = mInstructions.constData();
+  const int instructionCount = mInstructions.size();
+
+  QgsFeature feature;
+  bool hasFeature = false;
+
+  int i = 0;
+  while ( i < instructionCount )
+  {
+    const Instruction &instruction = instructions[i++];
+    switch ( instruction.operation )
+    {
+      case Operation::LoadField:
+        if ( !hasFeature )
+        {
+          if ( context )
+            feature = context->feature();
+          hasFeature = true;
+        }
+        if ( feature.isValid() )
+        {
+          r[instruction.target].setVariant( feature.attribute( instruction.argument ) );
+          break;
+        }
+        // the tree reports the missing feature
+        FALLTHROUGH
+
+      case Operation::EvaluateNode:
+        r[instruction.target].setVariant( instruction.node->eval( parent, context ) );
+        if ( parent->hasEvalError() )
+          return QVariant();
+        break;
+
+      case Operation::Move:
+        r[instruction.target] = r[instruction.left];
+        break;
+
+      case Operation::LoadNull:
+        r[instruction.target].setNull();
+        break;
+
+      case Operation::Jump:
+        i = instruction.argument;
+        break;
+
+      case Operation::JumpIfTrue:
+      case Operation::JumpIfFalse:
+      {
+        const int value = logicValue( r[instruction.left], parent );
+        if ( parent->hasEvalError() )
+          return QVariant();
+        const QgsExpressionUtils::TVL shortcut = instruction.operation == Operation::JumpIfTrue ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+        if ( value == shortcut )
+        {
+          r[instruction.target].setBoolean( value == QgsExpressionUtils::True );
+          i = instruction.argument;
+        }
+        break;
+      }
+
+      case Operation::JumpIfNotTrue:
+      {
+        const int value = logicValue( r[instruction.left], parent );
+        if ( parent->hasEvalError() )
+          return QVariant();
+        if ( value != QgsExpressionUtils::True )
+          i = instruction.argument;
+        break;
+      }
+
+      case Operation::Not:
+      {
+        const int value = logicValue( r[instruction.left], parent );
+        if ( parent->hasEvalError() )
+          return QVariant();
+        const QgsExpressionUtils::TVL result = QgsExpressionUtils::NOT[value];
+        if ( result == QgsExpressionUtils::Unknown )
+          r[instruction.target].setNull();
+        else
+          r[instruction.target].setBoolean( result == QgsExpressionUtils::True );
+        break;
+      }
+
+      case Operation::Minus:
+      {
+        const Value &operand = r[instruction.left];
+        if ( operand.isInteger() )
+        {
+          r[instruction.target].setInteger( -operand.integer );
+        }
+        else if ( operand.type == ValueType::Double )
+        {
+          r[instruction.target].setDouble( -operand.number );
+        }
+        else
+        {
+          QgsExpressionNodeUnaryOperator *minus = static_cast< QgsExpressionNodeUnaryOperator * >( instruction.node );
+          r[instruction.target].setVariant( minus->evalOperand( operand.toVariant(), parent ) );
+          if ( parent->hasEvalError() )
+            return QVariant();
+        }
+        break;
+      }
+
+      case Operation::Binary:
+        if ( !evaluateBinary( r, instruction, parent, context ) )
+          return QVariant();
+        break;
+
+      case Operation::In:
+      {
+        const bool notIn = static_cast< const QgsExpressionNodeInOperator * >( instruction.node )->isNotIn();
+        const Value &needle = r[instruction.left];
+        Value &result = r[instruction.target];
+        if ( needle.type == ValueType::Null )
+        {
+          result.setNull();
+          break;
+        }
+
+        bool found = false;
+        bool listHasNull = false;
+        for ( int k = 0; k < instruction.right; ++k )
+        {
+          const Value &item = r[mInValues.at( instruction.argument + k )];
+          if ( item.type == ValueType::Null )
+            listHasNull = true;
+          else if ( inEqual( needle, item, parent ) )
+          {
+            found = true;
+            break;
+          }
+        }
+
+        if ( found )
+          result.setBoolean( !notIn );
+        else if ( listHasNull )
+          result.setNull();
+        else
+          result.setBoolean( notIn );
+        break;
+      }
+    }
+  }
+
+  return r[mResult].toVariant();
+}
+
+int QgsExpressionProgram::logicValue( const Value &value, QgsExpression *parent )
+{
+  switch ( value.type )
+  {
+    case ValueType::Null:
+      return QgsExpressionUtils::Unknown;
+
+    case ValueType::Boolean:
+    case ValueType::Integer:
+      return value.integer != 0 ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+
+    case ValueType::Double:
+      return !qgsDoubleNear( value.number, 0.0 ) ? QgsExpressionUtils::True : QgsExpressionUtils::False;
+
+    case ValueType::String:
+    case ValueType::Variant:
+      break;
+  }
+  return QgsExpressionUtils::getTVLValue( value.toVariant(), parent );
+}
+
+bool QgsExpressionProgram::inEqual( const Value &left, const Value &right, QgsExpression *parent )
+{
+  if ( left.isNumeric() && right.isNumeric() )
+    return qgsDoubleNear( left.toDouble(), right.toDouble() );
+  if ( left.type == ValueType::String && right.type == ValueType::String )
+    return QString::compare( left.string, right.string ) == 0;
+
+  // mixed types, as QgsExpressionNodeInOperator::evalNode()
+  const QVariant v1 = left.toVariant();
+  const QVariant v2 = right.toVariant();
+  if ( ( v1.type() != QVariant::String || v2.type() != QVariant::String ) &&
+       QgsExpressionUtils::isDoubleSafe( v1 ) && QgsExpressionUtils::isDoubleSafe( v2 ) )
+  {
+    return qgsDoubleNear( QgsExpressionUtils::getDoubleValue( v1, parent ), QgsExpressionUtils::getDoubleValue( v2, parent ) );
+  }
+  return QString::compare( QgsExpressionUtils::getStringValue( v1, parent ), QgsExpressionUtils::getStringValue( v2, parent ) ) == 0;
+}
+
+bool QgsExpressionProgram::compare( QgsExpressionNodeBinaryOperator::BinaryOperator op, double diff )
+{
+  switch ( op )
+  {
+    case QgsExpressionNodeBinaryOperator::boEQ:
+      return qgsDoubleNear( diff, 0.0 );
+    case QgsExpressionNodeBinaryOperator::boNE:
+      return !qgsDoubleNear( diff, 0.0 );
+    case QgsExpressionNodeBinaryOperator::boLT:
+      return diff < 0;
+    case QgsExpressionNodeBinaryOperator::boGT:
+      return diff > 0;
+    case QgsExpressionNodeBinaryOperator::boLE:
+      return diff <= 0;
+    case QgsExpressionNodeBinaryOperator::boGE:
+      return diff >= 0;
+    default:
+      Q_ASSERT( false );
+      return false;
+  }
+}
+
+bool QgsExpressionProgram::evaluateBinary( Value *registers, const Instruction &instruction, QgsExpression *parent, const QgsExpressionContext *context )
+{
+  const Value &left = registers[instruction.left];
+  const Value &right = registers[instruction.right];
+  Value &result = registers[instruction.target];
+  const QgsExpressionNodeBinaryOperator::BinaryOperator op = instruction.binaryOperator;
+
+  // each case either computes the result as QgsExpressionNodeBinaryOperator::evalNode() would, or
+  // breaks out of the switch to hand unusual operand types over to the tree implementation
+  switch ( op )
+  {
+    case QgsExpressionNodeBinaryOperator::boAnd:
+    case QgsExpressionNodeBinaryOperator::boOr:
+    {
+      const int l = logicValue( left, parent );
+      const int r = logicValue( right, parent );
+      if ( parent->hasEvalError() )
+        return false;
+      const QgsExpressionUtils::TVL value = op == QgsExpressionNodeBinaryOperator::boAnd ? QgsExpressionUtils::AND[l][r] : QgsExpressionUtils::OR[l][r];
+      if ( value == QgsExpressionUtils::Unknown )
+        result.setNull();
+      else
+        result.setBoolean( value == QgsExpressionUtils::True );
+      return true;
+    }
+
+    case QgsExpressionNodeBinaryOperator::boPlus:
+      if ( left.isStringType() && right.isStringType() )
+      {
+        result.setString( ( left.type == ValueType::Null ? QString() : left.string ) + ( right.type == ValueType::Null ? QString() : right.string ) );
+        return true;
+      }
+      FALLTHROUGH
+    case QgsExpressionNodeBinaryOperator::boMinus:
+    case QgsExpressionNodeBinaryOperator::boMul:
+    case QgsExpressionNodeBinaryOperator::boDiv:
+    case QgsExpressionNodeBinaryOperator::boMod:
+      if ( left.type == ValueType::Null || right.type == ValueType::Null )
+      {
+        result.setNull();
+        return true;
+      }
+      if ( !left.isNumeric() || !right.isNumeric() )
+        break;
+
+      if ( op != QgsExpressionNodeBinaryOperator::boDiv && left.isInteger() && right.isInteger() )
+      {
+        const qlonglong x = left.integer;
+        const qlonglong y = right.integer;
+        switch ( op )
+        {
+          case QgsExpressionNodeBinaryOperator::boPlus:
+            result.setInteger( x + y );
+            break;
+          case QgsExpressionNodeBinaryOperator::boMinus:
+            result.setInteger( x - y );
+            break;
+          case QgsExpressionNodeBinaryOperator::boMul:
+            result.setInteger( x * y );
+            break;
+          default:
+            if ( y == 0 )
+              result.setNull();
+            else
+              result.setInteger( x % y );
+            break;
+        }
+      }
+      else
+      {
+        const double x = left.toDouble();
+        const double y = right.toDouble();
+        switch ( op )
+        {
+          case QgsExpressionNodeBinaryOperator::boPlus:
+            result.setDouble( x + y );
+            break;
+          case QgsExpressionNodeBinaryOperator::boMinus:
+            result.setDouble( x - y );
+            break;
+          case QgsExpressionNodeBinaryOperator::boMul:
+            result.setDouble( x * y );
+            break;
+          case QgsExpressionNodeBinaryOperator::boDiv:
+            if ( y == 0. )
+              result.setNull();
+            else
+              result.setDouble( x / y );
+            break;
+          default:
+            if ( y == 0. )
+              result.setNull();
+            else
+              result.setDouble( std::fmod( x, y ) );
+            break;
+        }
+      }
+      return true;
+
+    case QgsExpressionNodeBinaryOperator::boIntDiv:
+      if ( !left.isNumeric() || !right.isNumeric() )
+        break;
+      if ( right.toDouble() == 0. )
+        result.setNull();
+      else
+        result.setInteger( qlonglong( std::floor( left.toDouble() / right.toDouble() ) ) );
+      return true;
+
+    case QgsExpressionNodeBinaryOperator::boPow:
+      if ( left.type == ValueType::Null || right.type == ValueType::Null )
+      {
+        result.setNull();
+        return true;
+      }
+      if ( !left.isNumeric() || !right.isNumeric() )
+        break;
+      result.setDouble( std::pow( left.toDouble(), right.toDouble() ) );
+      return true;
+
+    case QgsExpressionNodeBinaryOperator::boEQ:
+    case QgsExpressionNodeBinaryOperator::boNE:
+    case QgsExpressionNodeBinaryOperator::boLT:
+    case QgsExpressionNodeBinaryOperator::boGT:
+    case QgsExpressionNodeBinaryOperator::boLE:
+    case QgsExpressionNodeBinaryOperator::boGE:
+      if ( left.type == ValueType::Null || right.type == ValueType::Null )
+      {
+        result.setNull();
+        return true;
+      }
+      if ( left.isNumeric() && right.isNumeric() )
+      {
+        result.setBoolean( compare( op, left.toDouble() - right.toDouble() ) );
+        return true;
+      }
+      if ( left.type == ValueType::String && right.type == ValueType::String )
+      {
+        result.setBoolean( compare( op, QString::compare( left.string, right.string ) ) );
+        return true;
+      }
+      break;
+
+    case QgsExpressionNodeBinaryOperator::boIs:
+    case QgsExpressionNodeBinaryOperator::boIsNot:
+    {
+      bool equal = false;
+      if ( left.type == ValueType::Null || right.type == ValueType::Null )
+        equal = left.type == right.type;
+      else if ( left.isNumeric() && right.isNumeric() )
+        equal = qgsDoubleNear( left.toDouble(), right.toDouble() );
+      else if ( left.type == ValueType::String && right.type == ValueType::String )
+        equal = QString::compare( left.string, right.string ) == 0;
+      else
+        break;
+      result.setBoolean( equal == ( op == QgsExpressionNodeBinaryOperator::boIs ) );
+      return true;
+    }
+
+    case QgsExpressionNodeBinaryOperator::boConcat:
+      if ( left.type == ValueType::Null || right.type == ValueType::Null )
+        result.setNull();
+      else
+        result.setString( ( left.type == ValueType::String ? left.string : left.toVariant().toString() )
+                          + ( right.type == ValueType::String ? right.string : right.toVariant().toString() ) );
+      return true;
+
+    case QgsExpressionNodeBinaryOperator::boRegexp:
+    case QgsExpressionNodeBinaryOperator::boLike:
+    case QgsExpressionNodeBinaryOperator::boNotLike:
+    case QgsExpressionNodeBinaryOperator::boILike:
+    case QgsExpressionNodeBinaryOperator::boNotILike:
+      break;
+  }
+
+  // the operands are already evaluated, only the operator of the tree node is applied
+  QgsExpressionNodeBinaryOperator *node = static_cast< QgsExpressionNodeBinaryOperator * >( instruction.node );
+  result.setVariant( node->evalOperands( left.toVariant(), right.toVariant(), parent, context ) );
+  return !parent->hasEvalError();
+}
+
+///@endcond
@@ -0,0 +1,198 @@
+/***************************************************************************
+  qgsexpressionprogram_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSEXPRESSIONPROGRAM_PRIVATE_H
+#define QGSEXPRESSIONPROGRAM_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_core.h"
+#include "qgsexpressionnodeimpl.h"
+
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <atomic>
+
+class QgsExpression;
+class QgsExpressionContext;
+class QgsFeature;
+
+/**
+ * \ingroup core
+ * \brief A prepared expression lowered into a flat list of register instructions.
+ *
+ * Each node of the expression tree gets a register holding a tagged value: NULL, integer,
+ * double, string or any other QVariant. Literals and static nodes are stored in their
+ * registers once at compile time. Field references read the attribute straight from the
+ * evaluated feature, and operators, IN lists of constant values and CASE conditions work
+ * on the unboxed values without walking the tree or converting every intermediate result
+ * to and from QVariant.
+ *
+ * Nodes without a typed implementation (functions, LIKE, index operators...) are evaluated
+ * through the expression tree and their result is stored in the node's register. Operators
+ * meeting operand types without a typed implementation (dates, lists, geometries...) fall
+ * back to the tree implementation of the operator, so results and evaluation errors are
+ * identical to QgsExpressionNode::eval().
+ *
+ * The program refers to the nodes of the expression it was compiled from and must be
+ * discarded when that tree changes.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsExpressionProgram
+{
+  public:
+
+    /**
+     * Compiles the prepared expression tree starting at \a root. Field references are
+     * resolved against the fields of the \a context used to prepare the expression.
+     */
+    QgsExpressionProgram( QgsExpressionNode *root, const QgsExpressionContext *context );
+
+    /**
+     * Evaluates the program for the feature set on the \a context. Evaluation errors
+     * are reported to \a parent.
+     */
+    QVariant evaluate( QgsExpression *parent, const QgsExpressionContext *context );
+
+    /**
+     * Evaluates the program for each of the \a features, which are set on the \a context
+     * in turn. Evaluation stops at the first error, which is reported to \a parent, and
+     * the results of the preceding features are returned.
+     */
+    QVariantList evaluate( const QList< QgsFeature > &features, QgsExpression *parent, QgsExpressionContext *context );
+
+    //! QgsExpressionProgram cannot be copied
+    QgsExpressionProgram( const QgsExpressionProgram &other ) = delete;
+    //! QgsExpressionProgram cannot be copied
+    QgsExpressionProgram &operator=( const QgsExpressionProgram &other ) = delete;
+
+    //! Returns the number of registers used by the program
+    int registerCount() const { return mRegisters.size(); }
+
+    //! Returns the number of nodes evaluated through the expression tree
+    int treeNodeCount() const { return mTreeNodeCount; }
+
+  private:
+
+    enum class ValueType
+    {
+      Null,
+      Boolean, //!< Three-valued logic result, an integer 0 or 1 as returned by the tree
+      Integer,
+      Double,
+      String,
+      Variant, //!< Any other type, only handled by the tree implementation
+    };
+
+    //! Tagged register value
+    struct Value
+    {
+      ValueType type = ValueType::Null;
+      qlonglong integer = 0;
+      double number = 0.0;
+      QString string;
+      //! Original value for values read from a feature or the tree, invalid for computed ones
+      QVariant variant;
+
+      void setVariant( const QVariant &value );
+      void setNull();
+      void setBoolean( bool value );
+      void setInteger( qlonglong value );
+      void setDouble( double value );
+      void setString( const QString &value );
+
+      QVariant toVariant() const;
+      bool isNumeric() const { return type == ValueType::Boolean || type == ValueType::Integer || type == ValueType::Double; }
+      bool isInteger() const { return type == ValueType::Boolean || type == ValueType::Integer; }
+      double toDouble() const { return type == ValueType::Double ? number : static_cast< double >( integer ); }
+      //! Returns TRUE for strings, including NULL string values
+      bool isStringType() const;
+    };
+
+    enum class Operation
+    {
+      LoadField,
+      EvaluateNode,
+      Move,
+      LoadNull,
+      Jump,
+      JumpIfTrue, //!< Jumps if the three-valued logic value of the operand is true
+      JumpIfFalse, //!< Jumps if the three-valued logic value of the operand is false
+      JumpIfNotTrue, //!< Jumps if the three-valued logic value of the operand is false or unknown
+      Not,
+      Minus,
+      Binary,
+      In,
+    };
+
+    struct Instruction
+    {
+      Operation operation;
+      int target = -1;
+      int left = -1;
+      int right = -1;
+      //! Field index, jump destination or first IN value, depending on the operation
+      int argument = -1;
+      QgsExpressionNodeBinaryOperator::BinaryOperator binaryOperator = QgsExpressionNodeBinaryOperator::boEQ;
+      QgsExpressionNode *node = nullptr;
+    };
+
+    //! Compiles \a node, returns its register
+    int compile( QgsExpressionNode *node, const QgsExpressionContext *context );
+    int compileBinary( QgsExpressionNodeBinaryOperator *node, const QgsExpressionContext *context );
+    int compileIn( QgsExpressionNodeInOperator *node, const QgsExpressionContext *context );
+    int compileCondition( QgsExpressionNodeCondition *node, const QgsExpressionContext *context );
+    int evaluateNodeThroughTree( QgsExpressionNode *node );
+    int addRegister();
+    int addConstant( const QVariant &value );
+
+    QVariant run( QVector< Value > &registers, QgsExpression *parent, const QgsExpressionContext *context );
+
+    //! Returns the three-valued logic value of \a value, as QgsExpressionUtils::getTVLValue()
+    static int logicValue( const Value &value, QgsExpression *parent );
+    //! Returns TRUE if \a left and \a right are equal for IN, as QgsExpressionNodeInOperator
+    static bool inEqual( const Value &left, const Value &right, QgsExpression *parent );
+    //! Evaluates a binary operator, returns FALSE on evaluation errors
+    static bool evaluateBinary( Value *registers, const Instruction &instruction, QgsExpression *parent, const QgsExpressionContext *context );
+    static bool compare( QgsExpressionNodeBinaryOperator::BinaryOperator op, double diff );
+
+    QVector< Instruction > mInstructions;
+    //! Registers with the constants set, for evaluations which cannot use mRegisters
+    QVector< Value > mInitialRegisters;
+    QVector< Value > mRegisters;
+    //! Set while an evaluation uses mRegisters
+    std::atomic_flag mBusy = ATOMIC_FLAG_INIT;
+    //! Registers of the values of IN lists
+    QVector< int > mInValues;
+    int mResult = -1;
+    int mTreeNodeCount = 0;
+};
+
+/// @endcond
+
+#endif // QGSEXPRESSIONPROGRAM_PRIVATE_H
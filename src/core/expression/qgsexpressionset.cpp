@@ -0,0 +1,251 @@
+/***************************************************************************
+  qgsexpressionset.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsexpressionset.h"
+#include "qgsexpression.h"
+#include "qgsexpressioncontext.h"
+#include "qgsexpressionnode.h"
+#include "qgsexpressionnodeimpl.h"
+
+#include <QAtomicInteger>
+#include <QDataStream>
+
+#include <algorithm>
+
+QgsExpressionSet::QgsExpressionSet()
+{
+  static QAtomicInteger< quint64 > sNextId( 1 );
+  mId = sNextId.fetchAndAddRelaxed( 1 );
+}
+
+void QgsExpressionSet::addExpression( const QgsExpression &expression, const QgsExpressionContext *context )
+{
+  if ( !expression.rootNode() )
+    return;
+
+  ++mExpressionCount;
+  const QList< const QgsExpressionNode * > nodes = expression.rootNode()->nodes();
+  for ( const QgsExpressionNode *node : nodes )
+  {
+    if ( node->mExpressionSetId == mId )
+      continue;
+
+    const bool cacheable = node->nodeType() != QgsExpressionNode::ntLiteral
+                           && node->nodeType() != QgsExpressionNode::ntColumnRef
+                           && !node->hasCachedStaticValue()
+                           && node->referencedVariables().isEmpty()
+                           && !usesVolatileFunction( node, context );
+    if ( !cacheable )
+    {
+      node->mExpressionSetId = 0;
+      node->mExpressionSetKey = -1;
+      continue;
+    }
+
+    const QByteArray key = nodeKey( node );
+    int index = mKeys.value( key, -1 );
+    if ( index < 0 )
+    {
+      index = mSubexpressions.size();
+      mKeys.insert( key, index );
+      mSubexpressions.append( Subexpression() );
+    }
+    mSubexpressions[index].nodeCount++;
+    node->mExpressionSetId = mId;
+    node->mExpressionSetKey = index;
+  }
+}
+
+int QgsExpressionSet::sharedSubexpressionCount() const
+{
+  return static_cast< int >( std::count_if( mSubexpressions.constBegin(), mSubexpressions.constEnd(), []( const Subexpression & subexpression )
+  {
+    return subexpression.nodeCount > 1;
+  } ) );
+}
+
+bool QgsExpressionSet::cachedResult( const QgsExpressionNode *node, const QgsExpressionContext *context, QVariant &value )
+{
+  if ( node->mExpressionSetId != mId )
+    return false;
+
+  const Subexpression &subexpression = mSubexpressions.at( node->mExpressionSetKey );
+  if ( subexpression.nodeCount < 2 || !subexpression.hasResult || subexpression.feature != context->feature() )
+    return false;
+
+  value = subexpression.result;
+  ++mCacheHits;
+  return true;
+}
+
+void QgsExpressionSet::storeResult( const QgsExpressionNode *node, const QgsExpressionContext *context, const QVariant &value )
+{
+  if ( node->mExpressionSetId != mId )
+    return;
+
+  Subexpression &subexpression = mSubexpressions[node->mExpressionSetKey];
+  if ( subexpression.nodeCount < 2 )
+    return;
+
+  // keeping a copy of the feature is cheap, and features are only compared in depth when their data is not shared
+  subexpression.feature = context->feature();
+  subexpression.result = value;
+  subexpression.hasResult = true;
+}
+
+bool QgsExpressionSet::cachedStaticValue( const QgsExpressionNode *node, const QgsExpressionContext *context, QVariant &value )
+{
+  if ( node->nodeType() == QgsExpressionNode::ntLiteral || usesVolatileFunction( node, context ) )
+    return false;
+
+  const auto it = mStaticValues.constFind( nodeKey( node ) );
+  if ( it == mStaticValues.constEnd() || it->variables != variableValues( node, context ) )
+    return false;
+
+  value = it->value;
+  ++mCacheHits;
+  return true;
+}
+
+void QgsExpressionSet::storeStaticValue( const QgsExpressionNode *node, const QgsExpressionContext *context, const QVariant &value )
+{
+  if ( node->nodeType() == QgsExpressionNode::ntLiteral || usesVolatileFunction( node, context ) )
+    return;
+
+  StaticValue staticValue;
+  staticValue.variables = variableValues( node, context );
+  staticValue.value = value;
+  mStaticValues.insert( nodeKey( node ), staticValue );
+}
+
+QByteArray QgsExpressionSet::nodeKey( const QgsExpressionNode *node )
+{
+  // unlike dump(), which rounds numbers to a few digits, the key holds the exact type and value of literals
+  QByteArray key;
+  QDataStream stream( &key, QIODevice::WriteOnly );
+  writeNodeKey( node, stream );
+  return key;
+}
+
+void QgsExpressionSet::writeNodeKey( const QgsExpressionNode *node, QDataStream &stream )
+{
+  if ( !node )
+  {
+    stream << static_cast< qint32 >( -1 );
+    return;
+  }
+
+  stream << static_cast< qint32 >( node->nodeType() );
+  switch ( node->nodeType() )
+  {
+    case QgsExpressionNode::ntUnaryOperator:
+    {
+      const QgsExpressionNodeUnaryOperator *unary = static_cast< const QgsExpressionNodeUnaryOperator * >( node );
+      stream << static_cast< qint32 >( unary->op() );
+      writeNodeKey( unary->operand(), stream );
+      break;
+    }
+
+    case QgsExpressionNode::ntBinaryOperator:
+    {
+      const QgsExpressionNodeBinaryOperator *binary = static_cast< const QgsExpressionNodeBinaryOperator * >( node );
+      stream << static_cast< qint32 >( binary->op() );
+      writeNodeKey( binary->opLeft(), stream );
+      writeNodeKey( binary->opRight(), stream );
+      break;
+    }
+
+    case QgsExpressionNode::ntInOperator:
+    {
+      const QgsExpressionNodeInOperator *in = static_cast< const QgsExpressionNodeInOperator * >( node );
+      stream << in->isNotIn();
+      writeNodeKey( in->node(), stream );
+      writeNodeListKey( in->list()->list(), in->list()->names(), stream );
+      break;
+    }
+
+    case QgsExpressionNode::ntFunction:
+    {
+      const QgsExpressionNodeFunction *function = static_cast< const QgsExpressionNodeFunction * >( node );
+      stream << static_cast< qint32 >( function->fnIndex() );
+      if ( function->args() )
+        writeNodeListKey( function->args()->list(), function->args()->names(), stream );
+      else
+        writeNodeListKey( QList< QgsExpressionNode * >(), QStringList(), stream );
+      break;
+    }
+
+    case QgsExpressionNode::ntLiteral:
+      stream << static_cast< const QgsExpressionNodeLiteral * >( node )->value();
+      break;
+
+    case QgsExpressionNode::ntColumnRef:
+      stream << static_cast< const QgsExpressionNodeColumnRef * >( node )->name();
+      break;
+
+    case QgsExpressionNode::ntCondition:
+    {
+      const QgsExpressionNodeCondition *condition = static_cast< const QgsExpressionNodeCondition * >( node );
+      const QgsExpressionNodeCondition::WhenThenList conditions = condition->conditions();
+      stream << static_cast< qint32 >( conditions.count() );
+      for ( const QgsExpressionNodeCondition::WhenThen *whenThen : conditions )
+      {
+        writeNodeKey( whenThen->whenExp(), stream );
+        writeNodeKey( whenThen->thenExp(), stream );
+      }
+      writeNodeKey( condition->elseExp(), stream );
+      break;
+    }
+
+    case QgsExpressionNode::ntIndexOperator:
+    {
+      const QgsExpressionNodeIndexOperator *index = static_cast< const QgsExpressionNodeIndexOperator * >( node );
+      writeNodeKey( index->container(), stream );
+      writeNodeKey( index->index(), stream );
+      break;
+    }
+  }
+}
+
+void QgsExpressionSet::writeNodeListKey( const QList< QgsExpressionNode * > &nodes, const QStringList &names, QDataStream &stream )
+{
+  stream << static_cast< qint32 >( nodes.count() ) << names;
+  for ( const QgsExpressionNode *node : nodes )
+    writeNodeKey( node, stream );
+}
+
+bool QgsExpressionSet::usesVolatileFunction( const QgsExpressionNode *node, const QgsExpressionContext *context )
+{
+  const QSet< QString > functions = node->referencedFunctions();
+  for ( const QString &function : functions )
+  {
+    if ( function == QLatin1String( "rand" ) || function == QLatin1String( "randf" ) || function == QLatin1String( "uuid" )
+         || function == QLatin1String( "now" ) || function == QLatin1String( "eval" ) || function == QLatin1String( "var" )
+         || function == QLatin1String( "$area" ) || function == QLatin1String( "$length" ) || function == QLatin1String( "$perimeter" )
+         || ( context && context->hasFunction( function ) ) )
+      return true;
+  }
+  return false;
+}
+
+QVariantList QgsExpressionSet::variableValues( const QgsExpressionNode *node, const QgsExpressionContext *context )
+{
+  QStringList names = qgis::setToList( node->referencedVariables() );
+  std::sort( names.begin(), names.end() );
+
+  QVariantList values;
+  for ( const QString &name : qgis::as_const( names ) )
+    values << ( context ? context->variable( name ) : QVariant() );
+  return values;
+}
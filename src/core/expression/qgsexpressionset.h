@@ -0,0 +1,139 @@
+/***************************************************************************
+  qgsexpressionset.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSEXPRESSIONSET_H
+#define QGSEXPRESSIONSET_H
+
+#define SIP_NO_FILE
+
+#include "qgis_core.h"
+#include "qgsfeature.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+class QgsExpression;
+class QgsExpressionContext;
+class QgsExpressionNode;
+class QDataStream;
+
+/**
+ * \ingroup core
+ * \brief Shares the evaluation of common subexpressions between all the expressions prepared with
+ * an expression context.
+ *
+ * Once a set is attached to a QgsExpressionContext with QgsExpressionContext::setExpressionSet(),
+ * every expression prepared with this context is registered in the set. Subexpressions appearing
+ * in several registered expressions, like identical filters of the rules of a rule-based renderer
+ * and labeling or the same function call in many data defined properties, are then evaluated once
+ * per feature: further evaluations for the same feature return the cached result.
+ *
+ * Static subexpressions, which are evaluated once when preparing an expression, are shared in the
+ * same way, keyed by the values of the variables they reference.
+ *
+ * Field references and literals are never cached, neither are subexpressions referencing variables
+ * (whose values may change for the same feature, e.g. \@geometry_part_num), non deterministic
+ * functions like rand() or now(), functions depending on the units of their expression like $area,
+ * and functions provided by the context scopes. Simple operators compiled by QgsExpression::prepare()
+ * are only shared as whole expressions.
+ *
+ * A set must only be used from one thread at a time, it is not copied with its expression context.
+ *
+ * \note not available in Python bindings
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsExpressionSet
+{
+  public:
+
+    QgsExpressionSet();
+
+    //! QgsExpressionSet cannot be copied
+    QgsExpressionSet( const QgsExpressionSet &other ) = delete;
+    //! QgsExpressionSet cannot be copied
+    QgsExpressionSet &operator=( const QgsExpressionSet &other ) = delete;
+
+    /**
+     * Registers the subexpressions of a prepared \a expression. This is called by QgsExpression::prepare()
+     * for expressions prepared with a \a context the set is attached to.
+     */
+    void addExpression( const QgsExpression &expression, const QgsExpressionContext *context );
+
+    //! Returns the number of registered expressions
+    int expressionCount() const { return mExpressionCount; }
+
+    //! Returns the number of distinct cached subexpressions used by more than one expression
+    int sharedSubexpressionCount() const;
+
+    //! Returns the number of evaluations served from the cache
+    long long cacheHits() const { return mCacheHits; }
+
+    /**
+     * Retrieves in \a value the result of the shared subexpression of \a node for the feature of the \a context.
+     * Returns FALSE if the result has not been cached.
+     */
+    bool cachedResult( const QgsExpressionNode *node, const QgsExpressionContext *context, QVariant &value );
+
+    //! Caches the result \a value of the shared subexpression of \a node for the feature of the \a context
+    void storeResult( const QgsExpressionNode *node, const QgsExpressionContext *context, const QVariant &value );
+
+    /**
+     * Retrieves in \a value the static value of an identical \a node prepared with the same values of its
+     * variables. Returns FALSE if no such value is available.
+     */
+    bool cachedStaticValue( const QgsExpressionNode *node, const QgsExpressionContext *context, QVariant &value );
+
+    //! Stores the static \a value of a \a node prepared with the \a context
+    void storeStaticValue( const QgsExpressionNode *node, const QgsExpressionContext *context, const QVariant &value );
+
+  private:
+
+    struct Subexpression
+    {
+      //! Number of registered nodes sharing the subexpression
+      int nodeCount = 0;
+      bool hasResult = false;
+      QgsFeature feature;
+      QVariant result;
+    };
+
+    struct StaticValue
+    {
+      QVariantList variables;
+      QVariant value;
+    };
+
+    //! Returns a key identifying \a node, equal for nodes of identical structure and literal values
+    static QByteArray nodeKey( const QgsExpressionNode *node );
+    static void writeNodeKey( const QgsExpressionNode *node, QDataStream &stream );
+    static void writeNodeListKey( const QList< QgsExpressionNode * > &nodes, const QStringList &names, QDataStream &stream );
+    //! Returns TRUE if \a node calls a function whose result may change for the same feature
+    static bool usesVolatileFunction( const QgsExpressionNode *node, const QgsExpressionContext *context );
+    //! Returns the values of the variables referenced by \a node, sorted by name
+    static QVariantList variableValues( const QgsExpressionNode *node, const QgsExpressionContext *context );
+
+    //! Unique identifier, allowing nodes to keep their registration without referencing the set
+    quint64 mId = 0;
+    int mExpressionCount = 0;
+    QHash< QByteArray, int > mKeys;
+    QVector< Subexpression > mSubexpressions;
+    QHash< QByteArray, StaticValue > mStaticValues;
+    long long mCacheHits = 0;
+};
+
+#endif // QGSEXPRESSIONSET_H
@@ -266,8 +266,12 @@ void QgsLabelingEngine::processProvider( QgsAbstractLabelProvider *provider, Qgs
 
 void QgsLabelingEngine::registerLabels( QgsRenderContext &context )
 {
+  QElapsedTimer t;
+  t.start();
+
   const QgsLabelingEngineSettings &settings = mMapSettings.labelingEngineSettings();
 
+  mRenderProfile = QgsLabelingRenderProfile();
   mPal = qgis::make_unique< pal::Pal >();
 
   mPal->setMaximumLineCandidatesPerMapUnit( settings.maximumLineCandidatesPerCm() / context.convertToMapUnits( 10, QgsUnitTypes::RenderMillimeters ) );
@@ -275,6 +279,8 @@ void QgsLabelingEngine::registerLabels( QgsRenderContext &context )
 
   mPal->setShowPartialLabels( settings.testFlag( QgsLabelingEngineSettings::UsePartialCandidates ) );
   mPal->setPlacementVersion( settings.placementVersion() );
+  if ( settings.testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) && mPreviousPlacements.isCompatible( mMapSettings ) )
+    mPal->setPreviousPlacements( mPreviousPlacements );
 
   // for each provider: get labels and register them in PAL
   for ( QgsAbstractLabelProvider *provider : qgis::as_const( mProviders ) )
@@ -286,6 +292,8 @@ void QgsLabelingEngine::registerLabels( QgsRenderContext &context )
     }
     processProvider( provider, context, *mPal );
   }
+
+  mRenderProfile.setRegistrationTime( t.nsecsElapsed() / 1e6 );
 }
 
 void QgsLabelingEngine::solve( QgsRenderContext &context )
@@ -355,6 +363,16 @@ void QgsLabelingEngine::solve( QgsRenderContext &context )
     return;
   }
 
+  mRenderProfile.setCandidatesTime( t.nsecsElapsed() / 1e6 );
+  if ( mProblem )
+  {
+    int candidateCount = 0;
+    for ( int i = 0; i < static_cast< int >( mProblem->featureCount() ); i++ )
+      candidateCount += mProblem->featureCandidateCount( i );
+    mRenderProfile.setFeatureCount( static_cast< int >( mProblem->featureCount() ) );
+    mRenderProfile.setCandidateCount( candidateCount );
+  }
+
   if ( context.renderingStopped() )
   {
     return; // it has been canceled
@@ -390,11 +408,28 @@ void QgsLabelingEngine::solve( QgsRenderContext &context )
   }
 
   // find the solution
+  QElapsedTimer solveTimer;
+  solveTimer.start();
   mLabels = mPal->solveProblem( mProblem.get(), settings.testFlag( QgsLabelingEngineSettings::UseAllLabels ), settings.testFlag( QgsLabelingEngineSettings::DrawUnplacedLabels ) ? &mUnlabeled : nullptr );
 
+  mRenderProfile.setSolveTime( solveTimer.nsecsElapsed() / 1e6 );
+  mRenderProfile.setLabelCount( mLabels.size() );
+
   // sort labels
   std::sort( mLabels.begin(), mLabels.end(), QgsLabelSorter( mMapSettings ) );
 
+  // remember the solution, so that the next render can keep labels in place
+  mPlacements = QgsLabelPlacementCache();
+  if ( settings.testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) )
+  {
+    mPlacements = QgsLabelPlacementCache( mMapSettings );
+    for ( pal::LabelPosition *label : qgis::as_const( mLabels ) )
+    {
+      pal::FeaturePart *part = label->getFeaturePart();
+      mPlacements.addPlacement( part->layer()->provider(), part->featureId(), QgsLabelPlacementCache::Placement{ label->getX(), label->getY(), label->getAlpha() } );
+    }
+  }
+
   QgsDebugMsgLevel( QStringLiteral( "LABELING work:  %1 ms ... labels# %2" ).arg( t.elapsed() ).arg( mLabels.size() ), 4 );
 }
 
@@ -515,6 +550,9 @@ void QgsLabelingEngine::drawLabels( QgsRenderContext &context, const QString &la
   // Reset composition mode for further drawing operations
   painter->setCompositionMode( QPainter::CompositionMode_SourceOver );
 
+  // staged render engines draw labels once per layer
+  mRenderProfile.setDrawTime( mRenderProfile.drawTime() + t.nsecsElapsed() / 1e6 );
+
   QgsDebugMsgLevel( QStringLiteral( "LABELING draw:  %1 ms" ).arg( t.elapsed() ), 4 );
 }
 
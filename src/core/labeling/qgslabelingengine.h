@@ -24,6 +24,8 @@
 #include "qgspallabeling.h"
 #include "qgslabelingenginesettings.h"
 #include "qgslabeling.h"
+#include "qgslabelplacementcache.h"
+#include "qgsrenderprofile.h"
 
 class QgsLabelingEngine;
 
@@ -265,6 +267,34 @@ class CORE_EXPORT QgsLabelingEngine
     //! For internal use by the providers
     QgsLabelingResults *results() const { return mResults.get(); }
 
+    /**
+     * Sets the label \a placements of a previous render of the map. If they were calculated
+     * for the same scale, rotation and CRS, labels are kept at their previous position when possible.
+     *
+     * Previous placements are only used if the QgsLabelingEngineSettings::KeepPreviousPlacements
+     * flag is set in the map settings.
+     *
+     * \see placements()
+     * \since QGIS 3.18
+     */
+    void setPreviousPlacements( const QgsLabelPlacementCache &placements ) { mPreviousPlacements = placements; }
+
+    /**
+     * Returns the label placements of the solution, once the labeling job has run. Placements
+     * are only recorded if the QgsLabelingEngineSettings::KeepPreviousPlacements flag is set.
+     *
+     * \see setPreviousPlacements()
+     * \since QGIS 3.18
+     */
+    QgsLabelPlacementCache placements() const { return mPlacements; }
+
+    /**
+     * Returns the timings of the labeling stages and the label counts of the last run of the engine.
+     *
+     * \since QGIS 3.18
+     */
+    QgsLabelingRenderProfile renderProfile() const { return mRenderProfile; }
+
   protected:
     void processProvider( QgsAbstractLabelProvider *provider, QgsRenderContext &context, pal::Pal &p );
 
@@ -322,6 +352,11 @@ class CORE_EXPORT QgsLabelingEngine
     QList<pal::LabelPosition *> mUnlabeled;
     QList<pal::LabelPosition *> mLabels;
 
+    QgsLabelPlacementCache mPreviousPlacements;
+    QgsLabelPlacementCache mPlacements;
+
+    QgsLabelingRenderProfile mRenderProfile;
+
 };
 
 /**
@@ -0,0 +1,49 @@
+/***************************************************************************
+  qgslabelplacementcache.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgslabelplacementcache.h"
+#include "qgslabelingengine.h"
+#include "qgsmapsettings.h"
+
+QgsLabelPlacementCache::QgsLabelPlacementCache( const QgsMapSettings &settings )
+  : mValid( true )
+  , mMapUnitsPerPixel( settings.mapUnitsPerPixel() )
+  , mRotation( settings.rotation() )
+  , mDestinationCrs( settings.destinationCrs() )
+{
+}
+
+bool QgsLabelPlacementCache::isCompatible( const QgsMapSettings &settings ) const
+{
+  return mValid
+         && qgsDoubleNear( mMapUnitsPerPixel, settings.mapUnitsPerPixel(), mMapUnitsPerPixel * 1e-6 )
+         && qgsDoubleNear( mRotation, settings.rotation() )
+         && mDestinationCrs == settings.destinationCrs();
+}
+
+void QgsLabelPlacementCache::addPlacement( const QgsAbstractLabelProvider *provider, QgsFeatureId id, const Placement &placement )
+{
+  mPlacements[ key( provider, id ) ].append( placement );
+}
+
+QVector< QgsLabelPlacementCache::Placement > QgsLabelPlacementCache::placements( const QgsAbstractLabelProvider *provider, QgsFeatureId id ) const
+{
+  return mPlacements.value( key( provider, id ) );
+}
+
+QString QgsLabelPlacementCache::key( const QgsAbstractLabelProvider *provider, QgsFeatureId id )
+{
+  // the name tells apart label and diagram providers of the same layer
+  return QStringLiteral( "%1|%2|%3|%4" ).arg( provider->layerId(), provider->providerId(), provider->name() ).arg( id );
+}
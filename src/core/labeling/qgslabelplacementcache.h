@@ -0,0 +1,104 @@
+/***************************************************************************
+  qgslabelplacementcache.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSLABELPLACEMENTCACHE_H
+#define QGSLABELPLACEMENTCACHE_H
+
+#define SIP_NO_FILE
+
+#include "qgis_core.h"
+#include "qgsfeatureid.h"
+#include "qgscoordinatereferencesystem.h"
+
+#include <QHash>
+#include <QVector>
+
+class QgsAbstractLabelProvider;
+class QgsMapSettings;
+
+/**
+ * \ingroup core
+ * \class QgsLabelPlacementCache
+ * \brief Label positions chosen by a labeling solution, in map coordinates.
+ *
+ * The placements of a render are passed to the labeling engine of the next render
+ * of the same map (see QgsMapRendererCache::labelPlacements()), which then prefers
+ * the candidates closest to the previous positions. This keeps labels at the same
+ * place while the map is panned, instead of letting them jump between equivalent
+ * candidates.
+ *
+ * Placements are only reused by renders at the same scale, rotation and destination CRS,
+ * and when the QgsLabelingEngineSettings::KeepPreviousPlacements flag is set.
+ *
+ * \note not available in Python bindings
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsLabelPlacementCache
+{
+  public:
+
+    //! Position of a placed label (or of one part of a multi-part label)
+    struct Placement
+    {
+      //! X coordinate of the label's anchor corner
+      double x;
+      //! Y coordinate of the label's anchor corner
+      double y;
+      //! Angle of the label, in radians
+      double angle;
+    };
+
+    /**
+     * Constructor for an invalid QgsLabelPlacementCache.
+     */
+    QgsLabelPlacementCache() = default;
+
+    /**
+     * Constructor for an empty QgsLabelPlacementCache, storing placements calculated for the map \a settings.
+     */
+    explicit QgsLabelPlacementCache( const QgsMapSettings &settings );
+
+    /**
+     * Returns TRUE if the placements can be reused for a render using the map \a settings.
+     */
+    bool isCompatible( const QgsMapSettings &settings ) const;
+
+    /**
+     * Returns TRUE if no placement is stored.
+     */
+    bool isEmpty() const { return mPlacements.isEmpty(); }
+
+    /**
+     * Stores the \a placement of a label of the feature with the specified \a id, registered by \a provider.
+     */
+    void addPlacement( const QgsAbstractLabelProvider *provider, QgsFeatureId id, const Placement &placement );
+
+    /**
+     * Returns the placements stored for the labels of the feature with the specified \a id, registered by \a provider.
+     */
+    QVector< Placement > placements( const QgsAbstractLabelProvider *provider, QgsFeatureId id ) const;
+
+  private:
+
+    static QString key( const QgsAbstractLabelProvider *provider, QgsFeatureId id );
+
+    bool mValid = false;
+    double mMapUnitsPerPixel = 0;
+    double mRotation = 0;
+    QgsCoordinateReferenceSystem mDestinationCrs;
+
+    QHash< QString, QVector< Placement > > mPlacements;
+};
+
+#endif // QGSLABELPLACEMENTCACHE_H
@@ -44,9 +44,23 @@
 #include "qgssettings.h"
 #include <cfloat>
 #include <list>
+#include <limits>
+
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 using namespace pal;
 
+///@cond PRIVATE
+struct Pal::LayerCandidates
+{
+  Layer *layer = nullptr;
+  std::vector< FeaturePart * > selfObstacles;
+  std::list< std::unique_ptr< Feats > > features;
+  std::vector< std::unique_ptr< LabelPosition > > positionsWithNoCandidates;
+};
+///@endcond
+
 Pal::Pal()
 {
   QgsSettings settings;
@@ -116,7 +130,6 @@ std::unique_ptr<Problem> Pal::extract( const QgsRectangle &extent, const QgsGeom
 
   // prepare map boundary
   geos::unique_ptr mapBoundaryGeos( QgsGeos::asGeos( mapBoundary ) );
-  geos::prepared_unique_ptr mapBoundaryPrepared( GEOSPrepare_r( QgsGeos::getGEOSHandler(), mapBoundaryGeos.get() ) );
 
   int obstacleCount = 0;
 
@@ -128,6 +141,8 @@ std::unique_ptr<Problem> Pal::extract( const QgsRectangle &extent, const QgsGeom
   QStringList layersWithFeaturesInBBox;
 
   QMutexLocker palLocker( &mMutex );
+
+  std::vector< std::unique_ptr< LayerCandidates > > layerCandidates;
   for ( const auto &it : mLayers )
   {
     Layer *layer = it.second.get();
@@ -141,104 +156,54 @@ std::unique_ptr<Problem> Pal::extract( const QgsRectangle &extent, const QgsGeom
     if ( !layer->active() )
       continue;
 
-    // check for connected features with the same label text and join them
-    if ( layer->mergeConnectedLines() )
-      layer->joinConnectedFeatures();
-
-    if ( isCanceled() )
-      return nullptr;
+    std::unique_ptr< LayerCandidates > candidates = qgis::make_unique< LayerCandidates >();
+    candidates->layer = layer;
+    layerCandidates.emplace_back( std::move( candidates ) );
+  }
 
-    layer->chopFeaturesAtRepeatDistance();
+  // generate the candidates of each layer concurrently. A layer only touches its own features,
+  // the shared spatial indices are filled afterwards in layer order
+  auto createLayerCandidates = [&mapBoundaryGeos, this]( std::unique_ptr< LayerCandidates > &candidates )
+  {
+    createCandidates( *candidates, mapBoundaryGeos.get() );
+  };
+  if ( layerCandidates.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1 )
+  {
+    QtConcurrent::blockingMap( layerCandidates.begin(), layerCandidates.end(), createLayerCandidates );
+  }
+  else
+  {
+    for ( std::unique_ptr< LayerCandidates > &candidates : layerCandidates )
+      createLayerCandidates( candidates );
+  }
 
-    if ( isCanceled() )
-      return nullptr;
+  if ( isCanceled() )
+    return nullptr;
 
-    QMutexLocker locker( &layer->mMutex );
+  for ( const std::unique_ptr< LayerCandidates > &candidates : layerCandidates )
+  {
+    Layer *layer = candidates->layer;
 
-    // generate candidates for all features
-    for ( FeaturePart *featurePart : qgis::as_const( layer->mFeatureParts ) )
+    // Holes of the features are obstacles
+    for ( FeaturePart *selfObstacle : candidates->selfObstacles )
     {
-      if ( isCanceled() )
-        break;
+      obstacles.insert( selfObstacle, selfObstacle->boundingBox() );
+      allObstacleParts.emplace_back( selfObstacle );
+    }
 
-      // Holes of the feature are obstacles
-      for ( int i = 0; i < featurePart->getNumSelfObstacles(); i++ )
+    for ( std::unique_ptr< Feats > &feat : candidates->features )
+    {
+      for ( std::unique_ptr< LabelPosition > &candidate : feat->candidates )
       {
-        FeaturePart *selfObstacle =  featurePart->getSelfObstacle( i );
-        obstacles.insert( selfObstacle, selfObstacle->boundingBox() );
-        allObstacleParts.emplace_back( selfObstacle );
-
-        if ( !featurePart->getSelfObstacle( i )->getHoleOf() )
-        {
-          //ERROR: SHOULD HAVE A PARENT!!!!!
-        }
+        candidate->insertIntoIndex( allCandidatesFirstRound );
       }
+      features.emplace_back( std::move( feat ) );
+    }
 
-      // generate candidates for the feature part
-      std::vector< std::unique_ptr< LabelPosition > > candidates = featurePart->createCandidates( this );
-
-      if ( isCanceled() )
-        break;
-
-      // purge candidates that are outside the bbox
-      candidates.erase( std::remove_if( candidates.begin(), candidates.end(), [&mapBoundaryPrepared, this]( std::unique_ptr< LabelPosition > &candidate )
-      {
-        if ( showPartialLabels() )
-          return !candidate->intersects( mapBoundaryPrepared.get() );
-        else
-          return !candidate->within( mapBoundaryPrepared.get() );
-      } ), candidates.end() );
-
-      if ( isCanceled() )
-        break;
-
-      if ( !candidates.empty() )
-      {
-        for ( std::unique_ptr< LabelPosition > &candidate : candidates )
-        {
-          candidate->insertIntoIndex( allCandidatesFirstRound );
-        }
-
-        std::sort( candidates.begin(), candidates.end(), CostCalculator::candidateSortGrow );
-
-        // valid features are added to fFeats
-        std::unique_ptr< Feats > ft = qgis::make_unique< Feats >();
-        ft->feature = featurePart;
-        ft->shape = nullptr;
-        ft->candidates = std::move( candidates );
-        ft->priority = featurePart->calculatePriority();
-        features.emplace_back( std::move( ft ) );
-      }
-      else
-      {
-        // no candidates, so generate a default "point on surface" one
-        std::unique_ptr< LabelPosition > unplacedPosition = featurePart->createCandidatePointOnSurface( featurePart );
-        if ( !unplacedPosition )
-          continue;
+    for ( std::unique_ptr< LabelPosition > &position : candidates->positionsWithNoCandidates )
+      prob->positionsWithNoCandidates()->emplace_back( std::move( position ) );
 
-        if ( layer->displayAll() )
-        {
-          // if we are displaying all labels, we throw the default candidate in too
-          unplacedPosition->insertIntoIndex( allCandidatesFirstRound );
-          candidates.emplace_back( std::move( unplacedPosition ) );
-
-          // valid features are added to fFeats
-          std::unique_ptr< Feats > ft = qgis::make_unique< Feats >();
-          ft->feature = featurePart;
-          ft->shape = nullptr;
-          ft->candidates = std::move( candidates );
-          ft->priority = featurePart->calculatePriority();
-          features.emplace_back( std::move( ft ) );
-        }
-        else
-        {
-          // not displaying all labels for this layer, so it goes into the unlabeled feature list
-          prob->positionsWithNoCandidates()->emplace_back( std::move( unplacedPosition ) );
-        }
-      }
-    }
-    if ( isCanceled() )
-      return nullptr;
+    QMutexLocker locker( &layer->mMutex );
 
     // collate all layer obstacles
     for ( FeaturePart *obstaclePart : qgis::as_const( layer->mObstacleParts ) )
@@ -385,6 +350,10 @@ std::unique_ptr<Problem> Pal::extract( const QgsRectangle &extent, const QgsGeom
       // calculate final costs
       CostCalculator::finalizeCandidatesCosts( feat.get(), bbx, bby );
 
+      // keep the label where it was in the previous render, if possible
+      if ( !mPreviousPlacements.isEmpty() )
+        preferPreviousPlacement( feat.get() );
+
       // sort candidates list, best label to worst
       std::sort( feat->candidates.begin(), feat->candidates.end(), CostCalculator::candidateSortGrow );
 
@@ -472,6 +441,130 @@ std::unique_ptr<Problem> Pal::extract( const QgsRectangle &extent, const QgsGeom
   return prob;
 }
 
+void Pal::createCandidates( LayerCandidates &candidates, const GEOSGeometry *mapBoundary )
+{
+  Layer *layer = candidates.layer;
+
+  // check for connected features with the same label text and join them
+  if ( layer->mergeConnectedLines() )
+    layer->joinConnectedFeatures();
+
+  if ( isCanceled() )
+    return;
+
+  layer->chopFeaturesAtRepeatDistance();
+
+  if ( isCanceled() )
+    return;
+
+  // prepared geometries cache internal structures on first use, so each layer uses its own one
+  geos::prepared_unique_ptr mapBoundaryPrepared( GEOSPrepare_r( QgsGeos::getGEOSHandler(), mapBoundary ) );
+
+  QMutexLocker locker( &layer->mMutex );
+
+  // generate candidates for all features
+  for ( FeaturePart *featurePart : qgis::as_const( layer->mFeatureParts ) )
+  {
+    if ( isCanceled() )
+      break;
+
+    // Holes of the feature are obstacles
+    for ( int i = 0; i < featurePart->getNumSelfObstacles(); i++ )
+    {
+      candidates.selfObstacles.emplace_back( featurePart->getSelfObstacle( i ) );
+    }
+
+    // generate candidates for the feature part
+    std::vector< std::unique_ptr< LabelPosition > > featureCandidates = featurePart->createCandidates( this );
+
+    if ( isCanceled() )
+      break;
+
+    // purge candidates that are outside the bbox
+    featureCandidates.erase( std::remove_if( featureCandidates.begin(), featureCandidates.end(), [&mapBoundaryPrepared, this]( std::unique_ptr< LabelPosition > &candidate )
+    {
+      if ( showPartialLabels() )
+        return !candidate->intersects( mapBoundaryPrepared.get() );
+      else
+        return !candidate->within( mapBoundaryPrepared.get() );
+    } ), featureCandidates.end() );
+
+    if ( isCanceled() )
+      break;
+
+    if ( !featureCandidates.empty() )
+    {
+      std::sort( featureCandidates.begin(), featureCandidates.end(), CostCalculator::candidateSortGrow );
+
+      // valid features are added to fFeats
+      std::unique_ptr< Feats > ft = qgis::make_unique< Feats >();
+      ft->feature = featurePart;
+      ft->shape = nullptr;
+      ft->candidates = std::move( featureCandidates );
+      ft->priority = featurePart->calculatePriority();
+      candidates.features.emplace_back( std::move( ft ) );
+    }
+    else
+    {
+      // no candidates, so generate a default "point on surface" one
+      std::unique_ptr< LabelPosition > unplacedPosition = featurePart->createCandidatePointOnSurface( featurePart );
+      if ( !unplacedPosition )
+        continue;
+
+      if ( layer->displayAll() )
+      {
+        // if we are displaying all labels, we throw the default candidate in too
+        featureCandidates.emplace_back( std::move( unplacedPosition ) );
+
+        // valid features are added to fFeats
+        std::unique_ptr< Feats > ft = qgis::make_unique< Feats >();
+        ft->feature = featurePart;
+        ft->shape = nullptr;
+        ft->candidates = std::move( featureCandidates );
+        ft->priority = featurePart->calculatePriority();
+        candidates.features.emplace_back( std::move( ft ) );
+      }
+      else
+      {
+        // not displaying all labels for this layer, so it goes into the unlabeled feature list
+        candidates.positionsWithNoCandidates.emplace_back( std::move( unplacedPosition ) );
+      }
+    }
+  }
+}
+
+void Pal::preferPreviousPlacement( Feats *feat ) const
+{
+  const QVector< QgsLabelPlacementCache::Placement > placements = mPreviousPlacements.placements( feat->feature->layer()->provider(), feat->feature->featureId() );
+  if ( placements.isEmpty() )
+    return;
+
+  LabelPosition *closest = nullptr;
+  double closestDistance = std::numeric_limits< double >::max();
+  for ( std::unique_ptr< LabelPosition > &candidate : feat->candidates )
+  {
+    // candidates further than half the label height from the previous position are different placements
+    const double tolerance = candidate->getHeight() / 2;
+    for ( const QgsLabelPlacementCache::Placement &placement : placements )
+    {
+      if ( std::fabs( candidate->getAlpha() - placement.angle ) > 0.1 )
+        continue;
+
+      const double dx = candidate->getX() - placement.x;
+      const double dy = candidate->getY() - placement.y;
+      const double distance = dx * dx + dy * dy;
+      if ( distance <= tolerance * tolerance && distance < closestDistance )
+      {
+        closest = candidate.get();
+        closestDistance = distance;
+      }
+    }
+  }
+
+  if ( closest )
+    closest->setCost( 0 );
+}
+
 void Pal::registerCancellationCallback( Pal::FnIsCanceled fnCanceled, void *context )
 {
   fnIsCanceled = fnCanceled;
@@ -38,6 +38,7 @@
 #include "qgsgeos.h"
 #include "qgspallabeling.h"
 #include "qgslabelingenginesettings.h"
+#include "qgslabelplacementcache.h"
 #include <QList>
 #include <iostream>
 #include <ctime>
@@ -56,6 +57,7 @@ namespace pal
   class PalStat;
   class Problem;
   class PointSet;
+  class Feats;
 
   //! Search method to use
   enum SearchMethod
@@ -205,6 +207,14 @@ namespace pal
        */
       void setPlacementVersion( QgsLabelingEngineSettings::PlacementEngineVersion placementVersion );
 
+      /**
+       * Sets the label \a placements of a previous solution. For features with a previous
+       * placement, the candidate closest to it is preferred over the other candidates.
+       *
+       * \since QGIS 3.18
+       */
+      void setPreviousPlacements( const QgsLabelPlacementCache &placements ) { mPreviousPlacements = placements; }
+
       /**
        * Returns the global candidates limit for point features, or 0 if no global limit is in effect.
        *
@@ -273,6 +283,8 @@ namespace pal
 
       QgsLabelingEngineSettings::PlacementEngineVersion mPlacementVersion = QgsLabelingEngineSettings::PlacementEngineVersion2;
 
+      QgsLabelPlacementCache mPreviousPlacements;
+
       //! Callback that may be called from PAL to check whether the job has not been canceled in meanwhile
       FnIsCanceled fnIsCanceled = nullptr;
       //! Application-specific context for the cancellation check function
@@ -285,6 +297,24 @@ namespace pal
        */
       std::unique_ptr< Problem > extract( const QgsRectangle &extent, const QgsGeometry &mapBoundary );
 
+      //! Features, candidates and obstacles generated for a single layer
+      struct LayerCandidates;
+
+      /**
+       * Generates the candidates for all features of the layer of \a candidates, discarding
+       * candidates outside the \a mapBoundary geometry.
+       *
+       * Only the layer's own features are modified, so candidates for different layers
+       * can be generated concurrently.
+       */
+      void createCandidates( LayerCandidates &candidates, const GEOSGeometry *mapBoundary );
+
+      /**
+       * Gives the lowest cost to the candidate of \a feat closest to the feature's previous placement,
+       * if there is one near enough.
+       */
+      void preferPreviousPlacement( Feats *feat ) const;
+
       /**
        * \brief Choose the size of popmusic subpart's
        * \param r subpart size
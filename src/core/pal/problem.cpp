@@ -37,9 +37,14 @@
 #include "util.h"
 #include "priorityqueue.h"
 #include "internalexception.h"
+#include <algorithm>
+#include <atomic>
 #include <cfloat>
 #include <limits> //for std::numeric_limits<int>::max()
 
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
 #include "qgslabelingengine.h"
 
 using namespace pal;
@@ -55,8 +60,8 @@ inline void delete_chain( Chain *chain )
 }
 
 Problem::Problem( const QgsRectangle &extent )
-  : mAllCandidatesIndex( extent )
-  , mActiveCandidatesIndex( extent )
+  : mExtent( extent )
+  , mAllCandidatesIndex( extent )
 {
 
 }
@@ -137,55 +142,173 @@ void Problem::reduce()
   delete[] ok;
 }
 
-void ignoreLabel( const LabelPosition *lp, PriorityQueue &list, PalRtree< LabelPosition > &candidatesIndex )
+///@cond PRIVATE
+
+/**
+ * Returns the representative feature of the set containing \a feature, halving the path on the way.
+ */
+static int findRoot( std::vector< int > &parents, int feature )
 {
-  if ( list.isIn( lp->getId() ) )
+  while ( parents[feature] != feature )
+  {
+    parents[feature] = parents[parents[feature]];
+    feature = parents[feature];
+  }
+  return feature;
+}
+
+///@endcond
+
+std::vector< std::unique_ptr< Problem::Component > > Problem::createComponents()
+{
+  // union-find over the features, linking features whose remaining candidates may be in
+  // conflict. This uses the same index queries as the solver, so a component never reaches
+  // candidates of another one and the components can be solved from different threads
+  std::vector< int > parents( mFeatureCount );
+  for ( std::size_t i = 0; i < mFeatureCount; i++ )
+    parents[i] = static_cast< int >( i );
+
+  double amin[2];
+  double amax[2];
+  for ( std::size_t i = 0; i < mFeatureCount; i++ )
+  {
+    for ( int j = 0; j < mFeatNbLp[i]; j++ )
+    {
+      const LabelPosition *lp = mLabelPositions.at( mFeatStartId[i] + j ).get();
+      lp->getBoundingBox( amin, amax );
+      mAllCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&parents, i]( const LabelPosition * lp2 )->bool
+      {
+        const int root1 = findRoot( parents, static_cast< int >( i ) );
+        const int root2 = findRoot( parents, lp2->getProblemFeatureId() );
+        if ( root1 != root2 )
+          parents[std::max( root1, root2 )] = std::min( root1, root2 );
+        return true;
+      } );
+    }
+  }
+
+  // components are ordered by their first feature, so that their costs are always summed in the same order
+  std::vector< std::unique_ptr< Component > > components;
+  std::vector< int > componentIds( mFeatureCount, -1 );
+  mFeatLocalIds.assign( mFeatureCount, -1 );
+  mCandidateLocalIds.assign( mLabelPositions.size(), -1 );
+  for ( std::size_t i = 0; i < mFeatureCount; i++ )
   {
-    list.remove( lp->getId() );
+    const int root = findRoot( parents, static_cast< int >( i ) );
+    if ( componentIds[root] == -1 )
+    {
+      componentIds[root] = static_cast< int >( components.size() );
+      components.emplace_back( qgis::make_unique< Component >( mExtent ) );
+    }
+
+    Component &component = *components[componentIds[root]];
+    mFeatLocalIds[i] = static_cast< int >( component.features.size() );
+    component.features.push_back( static_cast< int >( i ) );
+    for ( int j = 0; j < mFeatNbLp[i]; j++ )
+    {
+      mCandidateLocalIds[mFeatStartId[i] + j] = static_cast< int >( component.candidates.size() );
+      component.candidates.push_back( mFeatStartId[i] + j );
+    }
+  }
+
+  return components;
+}
+
+void Problem::solveComponents( bool chainSearch )
+{
+  mSol.init( mFeatureCount );
+
+  std::vector< std::unique_ptr< Component > > components = createComponents();
+
+  // each component only touches its own features, candidates and solution entries
+  std::atomic< bool > queueEmpty( false );
+  auto solve = [this, chainSearch, &queueEmpty]( std::unique_ptr< Component > &component )
+  {
+    try
+    {
+      if ( chainSearch )
+      {
+        chain_search( *component );
+      }
+      else
+      {
+        init_sol_falp( *component );
+        solution_cost( *component );
+      }
+    }
+    catch ( InternalException::Empty & )
+    {
+      queueEmpty = true;
+    }
+  };
+
+  if ( components.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1 )
+  {
+    QtConcurrent::blockingMap( components.begin(), components.end(), solve );
+  }
+  else
+  {
+    for ( std::unique_ptr< Component > &component : components )
+      solve( component );
+  }
+
+  if ( queueEmpty )
+    throw InternalException::Empty();
+
+  mSol.totalCost = 0;
+  for ( const std::unique_ptr< Component > &component : components )
+    mSol.totalCost += component->totalCost;
+}
+
+void ignoreLabel( const LabelPosition *lp, PriorityQueue &list, PalRtree< LabelPosition > &candidatesIndex, const std::vector< int > &localIds )
+{
+  if ( list.isIn( localIds[lp->getId()] ) )
+  {
+    list.remove( localIds[lp->getId()] );
 
     double amin[2];
     double amax[2];
     lp->getBoundingBox( amin, amax );
-    candidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [lp, &list]( const LabelPosition * lp2 )->bool
+    candidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [lp, &list, &localIds]( const LabelPosition * lp2 )->bool
     {
-      if ( lp2->getId() != lp->getId() && list.isIn( lp2->getId() ) && lp2->isInConflict( lp ) )
+      if ( lp2->getId() != lp->getId() && list.isIn( localIds[lp2->getId()] ) && lp2->isInConflict( lp ) )
       {
-        list.decreaseKey( lp2->getId() );
+        list.decreaseKey( localIds[lp2->getId()] );
       }
       return true;
     } );
   }
 }
 
+void Problem::init_sol_falp()
+{
+  solveComponents( false );
+}
+
 /* Better initial solution
  * Step one FALP (Yamamoto, Camara, Lorena 2005)
  */
-void Problem::init_sol_falp()
+void Problem::init_sol_falp( Component &component )
 {
-  int label;
-
-  mSol.init( mFeatureCount );
-
-  PriorityQueue list( mTotalCandidates, mAllNblp, true );
+  const int candidateCount = static_cast< int >( component.candidates.size() );
+  PriorityQueue list( candidateCount, candidateCount, true );
 
   double amin[2];
   double amax[2];
 
   LabelPosition *lp = nullptr;
 
-  for ( int i = 0; i < static_cast< int >( mFeatureCount ); i++ )
-    for ( int j = 0; j < mFeatNbLp[i]; j++ )
+  for ( int label = 0; label < candidateCount; label++ )
+  {
+    try
     {
-      label = mFeatStartId[i] + j;
-      try
-      {
-        list.insert( label, mLabelPositions.at( label )->getNumOverlaps() );
-      }
-      catch ( pal::InternalException::Full & )
-      {
-        continue;
-      }
+      list.insert( label, mLabelPositions.at( component.candidates[label] )->getNumOverlaps() );
     }
+    catch ( pal::InternalException::Full & )
+    {
+      continue;
+    }
+  }
 
   while ( list.getSize() > 0 ) // O (log size)
   {
@@ -194,21 +317,16 @@ void Problem::init_sol_falp()
       return;
     }
 
-    label = list.getBest();   // O (log size)
+    const int label = component.candidates[list.getBest()];   // O (log size)
 
     lp = mLabelPositions[ label ].get();
 
-    if ( lp->getId() != label )
-    {
-      //error
-    }
-
     int probFeatId = lp->getProblemFeatureId();
     mSol.activeLabelIds[probFeatId] = label;
 
     for ( int i = mFeatStartId[probFeatId]; i < mFeatStartId[probFeatId] + mFeatNbLp[probFeatId]; i++ )
     {
-      ignoreLabel( mLabelPositions[ i ].get(), list, mAllCandidatesIndex );
+      ignoreLabel( mLabelPositions[ i ].get(), list, mAllCandidatesIndex, mCandidateLocalIds );
     }
 
 
@@ -226,10 +344,10 @@ void Problem::init_sol_falp()
 
     for ( const LabelPosition *conflict : conflictingPositions )
     {
-      ignoreLabel( conflict, list, mAllCandidatesIndex );
+      ignoreLabel( conflict, list, mAllCandidatesIndex, mCandidateLocalIds );
     }
 
-    mActiveCandidatesIndex.insert( lp, QgsRectangle( amin[0], amin[1], amax[0], amax[1] ) );
+    component.activeCandidatesIndex.insert( lp, QgsRectangle( amin[0], amin[1], amax[0], amax[1] ) );
   }
 
   if ( mDisplayAll )
@@ -239,7 +357,7 @@ void Problem::init_sol_falp()
     LabelPosition *retainedLabel = nullptr;
     int p;
 
-    for ( std::size_t i = 0; i < mFeatureCount; i++ ) // forearch hidden feature
+    for ( int i : component.features ) // forearch hidden feature
     {
       if ( mSol.activeLabelIds[i] == -1 )
       {
@@ -253,7 +371,7 @@ void Problem::init_sol_falp()
           lp->getBoundingBox( amin, amax );
 
 
-          mActiveCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&lp]( const LabelPosition * lp2 )->bool
+          component.activeCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&lp]( const LabelPosition * lp2 )->bool
           {
             if ( lp->isInConflict( lp2 ) )
             {
@@ -270,14 +388,14 @@ void Problem::init_sol_falp()
         }
         mSol.activeLabelIds[i] = retainedLabel->getId();
 
-        retainedLabel->insertIntoIndex( mActiveCandidatesIndex );
+        retainedLabel->insertIntoIndex( component.activeCandidatesIndex );
 
       }
     }
   }
 }
 
-inline Chain *Problem::chain( int seed )
+inline Chain *Problem::chain( Component &component, int seed )
 {
   int lid;
 
@@ -297,7 +415,10 @@ inline Chain *Problem::chain( int seed )
   QLinkedList<ElemTrans *> currentChain;
   QLinkedList<int> conflicts;
 
-  std::vector< int > tmpsol( mSol.activeLabelIds );
+  // solution of the component, indexed by the local feature ids
+  std::vector< int > tmpsol( component.features.size() );
+  for ( std::size_t i = 0; i < component.features.size(); i++ )
+    tmpsol[i] = mSol.activeLabelIds[component.features[i]];
 
   LabelPosition *lp = nullptr;
 
@@ -314,17 +435,17 @@ inline Chain *Problem::chain( int seed )
     retainedLabel = -2;
 
     // sol[seed] is ejected
-    if ( tmpsol[seed] == -1 )
+    if ( tmpsol[mFeatLocalIds[seed]] == -1 )
       delta -= mInactiveCost[seed];
     else
-      delta -= mLabelPositions.at( tmpsol[seed] )->cost();
+      delta -= mLabelPositions.at( tmpsol[mFeatLocalIds[seed]] )->cost();
 
     for ( int i = -1; i < seedNbLp; i++ )
     {
       try
       {
         // Skip active label !
-        if ( !( tmpsol[seed] == -1 && i == -1 ) && i + mFeatStartId[seed] != tmpsol[seed] )
+        if ( !( tmpsol[mFeatLocalIds[seed]] == -1 && i == -1 ) && i + mFeatStartId[seed] != tmpsol[mFeatLocalIds[seed]] )
         {
           if ( i != -1 ) // new_label
           {
@@ -336,7 +457,7 @@ inline Chain *Problem::chain( int seed )
             // evaluate conflicts graph in solution after moving seed's label
 
             lp->getBoundingBox( amin, amax );
-            mActiveCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [lp, &delta_tmp, &conflicts, &currentChain, this]( const LabelPosition * lp2 ) -> bool
+            component.activeCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [lp, &delta_tmp, &conflicts, &currentChain, this]( const LabelPosition * lp2 ) -> bool
             {
               if ( lp2->isInConflict( lp ) )
               {
@@ -518,22 +639,22 @@ inline Chain *Problem::chain( int seed )
     {
       ElemTrans *et = new ElemTrans();
       et->feat  = seed;
-      et->old_label = tmpsol[seed];
+      et->old_label = tmpsol[mFeatLocalIds[seed]];
       et->new_label = retainedLabel;
       currentChain.append( et );
 
       if ( et->old_label != -1 )
       {
-        mLabelPositions.at( et->old_label )->removeFromIndex( mActiveCandidatesIndex );
+        mLabelPositions.at( et->old_label )->removeFromIndex( component.activeCandidatesIndex );
       }
 
       if ( et->new_label != -1 )
       {
-        mLabelPositions.at( et->new_label )->insertIntoIndex( mActiveCandidatesIndex );
+        mLabelPositions.at( et->new_label )->insertIntoIndex( component.activeCandidatesIndex );
       }
 
 
-      tmpsol[seed] = retainedLabel;
+      tmpsol[mFeatLocalIds[seed]] = retainedLabel;
       // cppcheck-suppress invalidFunctionArg
       delta += mLabelPositions.at( retainedLabel )->cost();
       seed = next_seed;
@@ -546,12 +667,12 @@ inline Chain *Problem::chain( int seed )
 
     if ( et->new_label != -1 )
     {
-      mLabelPositions.at( et->new_label )->removeFromIndex( mActiveCandidatesIndex );
+      mLabelPositions.at( et->new_label )->removeFromIndex( component.activeCandidatesIndex );
     }
 
     if ( et->old_label != -1 )
     {
-      mLabelPositions.at( et->old_label )->insertIntoIndex( mActiveCandidatesIndex );
+      mLabelPositions.at( et->old_label )->insertIntoIndex( component.activeCandidatesIndex );
     }
   }
 
@@ -564,22 +685,26 @@ void Problem::chain_search()
   if ( mFeatureCount == 0 )
     return;
 
+  solveComponents( true );
+}
+
+void Problem::chain_search( Component &component )
+{
+  const int featureCount = static_cast< int >( component.features.size() );
+
   int i;
   int seed;
-  bool *ok = new bool[mFeatureCount];
+  std::vector< bool > ok( featureCount, false );
   int fid;
   int lid;
-  int popit = 0;
 
   Chain *retainedChain = nullptr;
 
-  std::fill( ok, ok + mFeatureCount, false );
-
   //initialization();
-  init_sol_falp();
+  init_sol_falp( component );
 
   //check_solution();
-  solution_cost();
+  solution_cost( component );
 
   int iter = 0;
 
@@ -591,9 +716,9 @@ void Problem::chain_search()
 
     //check_solution();
 
-    for ( seed = ( iter + 1 ) % mFeatureCount;
+    for ( seed = ( iter + 1 ) % featureCount;
           ok[seed] && seed != iter;
-          seed = ( seed + 1 ) % mFeatureCount )
+          seed = ( seed + 1 ) % featureCount )
       ;
 
     // All seeds are OK
@@ -602,8 +727,8 @@ void Problem::chain_search()
       break;
     }
 
-    iter = ( iter + 1 ) % mFeatureCount;
-    retainedChain = chain( seed );
+    iter = ( iter + 1 ) % featureCount;
+    retainedChain = chain( component, component.features[seed] );
 
     if ( retainedChain && retainedChain->delta < - EPSILON )
     {
@@ -616,13 +741,13 @@ void Problem::chain_search()
         if ( mSol.activeLabelIds[fid] >= 0 )
         {
           LabelPosition *old = mLabelPositions[ mSol.activeLabelIds[fid] ].get();
-          old->removeFromIndex( mActiveCandidatesIndex );
+          old->removeFromIndex( component.activeCandidatesIndex );
           old->getBoundingBox( amin, amax );
-          mAllCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&ok, old]( const LabelPosition * lp ) ->bool
+          mAllCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&ok, old, this]( const LabelPosition * lp ) ->bool
           {
             if ( old->isInConflict( lp ) )
             {
-              ok[lp->getProblemFeatureId()] = false;
+              ok[mFeatLocalIds[lp->getProblemFeatureId()]] = false;
             }
 
             return true;
@@ -633,12 +758,12 @@ void Problem::chain_search()
 
         if ( mSol.activeLabelIds[fid] >= 0 )
         {
-          mLabelPositions.at( lid )->insertIntoIndex( mActiveCandidatesIndex );
+          mLabelPositions.at( lid )->insertIntoIndex( component.activeCandidatesIndex );
         }
 
-        ok[fid] = false;
+        ok[mFeatLocalIds[fid]] = false;
       }
-      mSol.totalCost += retainedChain->delta;
+      component.totalCost += retainedChain->delta;
     }
     else
     {
@@ -647,11 +772,9 @@ void Problem::chain_search()
     }
 
     delete_chain( retainedChain );
-    popit++;
   }
 
-  solution_cost();
-  delete[] ok;
+  solution_cost( component );
 }
 
 QList<LabelPosition *> Problem::getSolution( bool returnInactive, QList<LabelPosition *> *unlabeled )
@@ -695,37 +818,37 @@ QList<LabelPosition *> Problem::getSolution( bool returnInactive, QList<LabelPos
   return finalLabelPlacements;
 }
 
-void Problem::solution_cost()
+void Problem::solution_cost( Component &component )
 {
-  mSol.totalCost = 0.0;
+  component.totalCost = 0.0;
 
   LabelPosition *lp = nullptr;
 
   double amin[2];
   double amax[2];
 
-  for ( std::size_t i = 0; i < mFeatureCount; i++ )
+  for ( int i : component.features )
   {
     if ( mSol.activeLabelIds[i] == -1 )
     {
-      mSol.totalCost += mInactiveCost[i];
+      component.totalCost += mInactiveCost[i];
     }
     else
     {
       lp = mLabelPositions[ mSol.activeLabelIds[i] ].get();
 
       lp->getBoundingBox( amin, amax );
-      mActiveCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&lp, this]( const LabelPosition * lp2 )->bool
+      component.activeCandidatesIndex.intersects( QgsRectangle( amin[0], amin[1], amax[0], amax[1] ), [&lp, &component, this]( const LabelPosition * lp2 )->bool
       {
         if ( lp->isInConflict( lp2 ) )
         {
-          mSol.totalCost += mInactiveCost[lp2->getProblemFeatureId()] + lp2->cost();
+          component.totalCost += mInactiveCost[lp2->getProblemFeatureId()] + lp2->cost();
         }
 
         return true;
       } );
 
-      mSol.totalCost += lp->cost();
+      component.totalCost += lp->cost();
     }
   }
 }
@@ -115,6 +115,8 @@ namespace pal
 
       /**
        * \brief Test with very-large scale neighborhood
+       *
+       * The conflict graph is split into independent components, which are solved concurrently.
        */
       void chain_search();
 
@@ -135,6 +137,11 @@ namespace pal
       /* useful only for postscript post-conversion*/
       //void toFile(char *label_file);
 
+      /**
+       * Calculates an initial solution using the FALP heuristic, without improving it with chain_search().
+       *
+       * The conflict graph is split into independent components, which are solved concurrently.
+       */
       void init_sol_falp();
 
       /**
@@ -192,8 +199,9 @@ namespace pal
 
       std::vector< std::unique_ptr< LabelPosition > > mLabelPositions;
 
+      QgsRectangle mExtent;
+
       PalRtree<LabelPosition> mAllCandidatesIndex;
-      PalRtree<LabelPosition> mActiveCandidatesIndex;
 
       std::vector< std::unique_ptr< LabelPosition > > mPositionsWithNoCandidates;
 
@@ -217,14 +225,55 @@ namespace pal
           }
       };
 
+      /**
+       * Group of features whose candidates can only be in conflict with candidates of
+       * the same group. Components are solved independently from each other.
+       */
+      struct Component
+      {
+        explicit Component( const QgsRectangle &extent )
+          : activeCandidatesIndex( extent )
+        {}
+
+        //! Problem feature ids, in increasing order
+        std::vector< int > features;
+
+        //! Ids of the remaining candidates of all features, in increasing order
+        std::vector< int > candidates;
+
+        PalRtree<LabelPosition> activeCandidatesIndex;
+
+        double totalCost = 0;
+      };
+
       Sol mSol;
       double mNbOverlap = 0.0;
 
-      Chain *chain( int seed );
+      //! Index of each feature inside its component
+      std::vector< int > mFeatLocalIds;
+
+      //! Index of each remaining candidate inside its component, or -1 for removed candidates
+      std::vector< int > mCandidateLocalIds;
+
+      /**
+       * Splits the features into components, linking features whose candidates
+       * have intersecting bounding boxes.
+       */
+      std::vector< std::unique_ptr< Component > > createComponents();
+
+      /**
+       * Calculates the solution for all components, concurrently if possible. If \a chainSearch
+       * is FALSE only the initial FALP solution is calculated.
+       */
+      void solveComponents( bool chainSearch );
+
+      void init_sol_falp( Component &component );
+      void chain_search( Component &component );
+      Chain *chain( Component &component, int seed );
 
       Pal *pal = nullptr;
 
-      void solution_cost();
+      void solution_cost( Component &component );
   };
 
 } // namespace
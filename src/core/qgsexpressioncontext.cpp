@@ -591,3 +591,8 @@ void QgsExpressionContext::clearCachedValues() const
 {
   mCachedValues.clear();
 }
+
+void QgsExpressionContext::setExpressionSet( const std::shared_ptr< QgsExpressionSet > &set )
+{
+  mExpressionSet = set;
+}
@@ -25,6 +25,10 @@
 #include "qgsexpressionfunction.h"
 #include "qgsfeature.h"
 
+#include <memory>
+
+class QgsExpressionSet;
+
 /**
  * \ingroup core
  * \class QgsScopedExpressionFunction
@@ -715,6 +719,27 @@ class CORE_EXPORT QgsExpressionContext
      */
     void clearCachedValues() const;
 
+    /**
+     * Attaches an expression \a set to the context. Expressions prepared with the context are then
+     * registered in the set, which evaluates their common subexpressions once per feature.
+     *
+     * The set is not copied with the context.
+     *
+     * \see expressionSet()
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    void setExpressionSet( const std::shared_ptr< QgsExpressionSet > &set ) SIP_SKIP;
+
+    /**
+     * Returns the expression set attached to the context, or NULLPTR if none.
+     *
+     * \see setExpressionSet()
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    QgsExpressionSet *expressionSet() const SIP_SKIP { return mExpressionSet.get(); }
+
     //! Inbuilt variable name for fields storage
     static const QString EXPR_FIELDS;
     //! Inbuilt variable name for value original value variable
@@ -745,6 +770,8 @@ class CORE_EXPORT QgsExpressionContext
     // Cache is mutable because we want to be able to add cached values to const contexts
     mutable QMap< QString, QVariant > mCachedValues;
 
+    std::shared_ptr< QgsExpressionSet > mExpressionSet;
+
 };
 
 #endif // QGSEXPRESSIONCONTEXT_H
@@ -18,12 +18,17 @@
 #include "qgssimplifymethod.h"
 #include "qgsexception.h"
 #include "qgsexpressionsorter.h"
+#include "qgsexpressioncolumnfilter_p.h"
+
+#include <algorithm>
 
 QgsAbstractFeatureIterator::QgsAbstractFeatureIterator( const QgsFeatureRequest &request )
   : mRequest( request )
 {
 }
 
+QgsAbstractFeatureIterator::~QgsAbstractFeatureIterator() = default;
+
 bool QgsAbstractFeatureIterator::nextFeature( QgsFeature &f )
 {
   bool dataOk = false;
@@ -73,6 +78,29 @@ bool QgsAbstractFeatureIterator::nextFeature( QgsFeature &f )
 
 bool QgsAbstractFeatureIterator::nextFeatureFilterExpression( QgsFeature &f )
 {
+  // a limit usually stops the iteration early, don't fetch features ahead of it
+  if ( mRequest.limit() < 0 )
+  {
+    for ( ;; )
+    {
+      while ( mFilterBatchIndex < mFilterBatch.size() )
+      {
+        const int index = mFilterBatchIndex++;
+        if ( mFilterBatchMatches.at( index ) )
+        {
+          f = mFilterBatch.at( index );
+          return true;
+        }
+      }
+
+      if ( mColumnFilterPrepared && !mColumnFilter )
+        break;
+
+      if ( !fetchFilterBatch() )
+        return false;
+    }
+  }
+
   while ( fetchFeature( f ) )
   {
     mRequest.expressionContext()->setFeature( f );
@@ -82,6 +110,57 @@ bool QgsAbstractFeatureIterator::nextFeatureFilterExpression( QgsFeature &f )
   return false;
 }
 
+bool QgsAbstractFeatureIterator::fetchFilterBatch()
+{
+  clearFilterBatch();
+
+  QgsFeature feature;
+  if ( !mColumnFilterPrepared )
+  {
+    if ( !fetchFeature( feature ) )
+      return false;
+
+    mColumnFilterPrepared = true;
+    mFilterBatch << feature;
+
+    const QgsExpressionContext *context = mRequest.expressionContext();
+    const QgsFields fields = context->hasVariable( QgsExpressionContext::EXPR_FIELDS )
+                             ? qvariant_cast<QgsFields>( context->variable( QgsExpressionContext::EXPR_FIELDS ) )
+                             : feature.fields();
+    mColumnFilter = QgsExpressionColumnFilter::create( *mRequest.filterExpression(), fields );
+  }
+
+  if ( mColumnFilter )
+  {
+    // start with small batches, for callers which only read the first features
+    mFilterBatchSize = mFilterBatchSize == 0 ? 32 : std::min( 2 * mFilterBatchSize, 1024 );
+    while ( mFilterBatch.size() < mFilterBatchSize && fetchFeature( feature ) )
+      mFilterBatch << feature;
+  }
+
+  if ( mFilterBatch.isEmpty() )
+    return false;
+
+  if ( !mColumnFilter || !mColumnFilter->evaluate( mFilterBatch, mFilterBatchMatches ) )
+  {
+    // attribute values which don't have the type of their field, or an unsupported expression
+    mFilterBatchMatches.resize( mFilterBatch.size() );
+    for ( int i = 0; i < mFilterBatch.size(); ++i )
+    {
+      mRequest.expressionContext()->setFeature( mFilterBatch.at( i ) );
+      mFilterBatchMatches[i] = mRequest.filterExpression()->evaluate( mRequest.expressionContext() ).toBool();
+    }
+  }
+  return true;
+}
+
+void QgsAbstractFeatureIterator::clearFilterBatch()
+{
+  mFilterBatch.clear();
+  mFilterBatchMatches.clear();
+  mFilterBatchIndex = 0;
+}
+
 bool QgsAbstractFeatureIterator::nextFeatureFilterFids( QgsFeature &f )
 {
   while ( fetchFeature( f ) )
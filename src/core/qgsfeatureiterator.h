@@ -20,6 +20,7 @@
 #include "qgsindexedfeature.h"
 
 class QgsFeedback;
+class QgsExpressionColumnFilter;
 
 /**
  * \ingroup core
@@ -41,7 +42,7 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     QgsAbstractFeatureIterator( const QgsFeatureRequest &request );
 
     //! destructor makes sure that the iterator is closed properly
-    virtual ~QgsAbstractFeatureIterator() = default;
+    virtual ~QgsAbstractFeatureIterator();
 
     //! fetch next feature, return TRUE on success
     virtual bool nextFeature( QgsFeature &f );
@@ -202,6 +203,24 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     QList<QgsIndexedFeature> mCachedFeatures;
     QList<QgsIndexedFeature>::ConstIterator mFeatureIterator;
 
+    //! Column by column evaluation of the filter expression, NULLPTR if not supported by the expression
+    std::unique_ptr< QgsExpressionColumnFilter > mColumnFilter;
+    bool mColumnFilterPrepared = false;
+    //! Features fetched ahead by nextFeatureFilterExpression() and whether they match the filter expression
+    QgsFeatureList mFilterBatch;
+    QVector< bool > mFilterBatchMatches;
+    int mFilterBatchIndex = 0;
+    int mFilterBatchSize = 0;
+
+    /**
+     * Fetches the next batch of features and evaluates the filter expression for all of them.
+     * Returns FALSE if there are no more features.
+     */
+    bool fetchFilterBatch();
+
+    //! Discards the features fetched ahead, e.g. when rewinding
+    void clearFilterBatch();
+
     //! returns whether the iterator supports simplify geometries on provider side
     virtual bool providerCanSimplify( QgsSimplifyMethod::MethodType methodType ) const;
 
@@ -379,7 +398,10 @@ inline bool QgsFeatureIterator::nextFeature( QgsFeature &f )
 inline bool QgsFeatureIterator::rewind()
 {
   if ( mIter )
+  {
     mIter->mFetchedCount = 0;
+    mIter->clearFilterBatch();
+  }
 
   return mIter ? mIter->rewind() : false;
 }
@@ -387,7 +409,10 @@ inline bool QgsFeatureIterator::rewind()
 inline bool QgsFeatureIterator::close()
 {
   if ( mIter )
+  {
     mIter->mFetchedCount = 0;
+    mIter->clearFilterBatch();
+  }
 
   return mIter ? mIter->close() : false;
 }
@@ -18,16 +18,48 @@
 #include "qgsmaplayer.h"
 #include "qgsmaplayerlistutils.h"
 #include "qgsapplication.h"
+#include "qgsmapsettings.h"
+#include "qgsmaplayerstyle.h"
+#include "qgsvectorlayer.h"
+#include "qgsrenderer.h"
+#include "qgsrasterlayer.h"
+#include "qgsrasterrenderer.h"
+#include "qgsrendercontext.h"
+#include "qgssymbolbleed_p.h"
+#include "qgsexpressioncontextutils.h"
+#include "qgsproviderregistry.h"
+#include "qgsdataprovider.h"
+#include "qgsgeometry.h"
 
 #include <QImage>
 #include <QPainter>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtConcurrentRun>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+
+//! Width and height of cached tiles, in pixels
+static const int TILE_SIZE = 256;
+
+//! Default maximum memory used by tiles, in kilobytes
+static const int DEFAULT_TILE_CACHE_MEMORY = 64 * 1024;
 
 QgsMapRendererCache::QgsMapRendererCache()
 {
+  mTiles.setMaxCost( DEFAULT_TILE_CACHE_MEMORY );
   clear();
 }
 
+QgsMapRendererCache::~QgsMapRendererCache()
+{
+  waitForTileWrites();
+}
+
 void QgsMapRendererCache::clear()
 {
   QMutexLocker lock( &mMutex );
@@ -39,17 +71,10 @@ void QgsMapRendererCache::clearInternal()
   mExtent.setMinimal();
   mScale = 0;
 
-  // make sure we are disconnected from all layers
-  for ( const QgsWeakMapLayerPointer &layer : qgis::as_const( mConnectedLayers ) )
-  {
-    if ( layer.data() )
-    {
-      disconnect( layer.data(), &QgsMapLayer::repaintRequested, this, &QgsMapRendererCache::layerRequestedRepaint );
-      disconnect( layer.data(), &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerRequestedRepaint );
-    }
-  }
+  // tiles stored on disk are kept, so stay connected to their layers to remove them on repaint
   mCachedImages.clear();
-  mConnectedLayers.clear();
+  mTiles.clear();
+  dropUnusedConnections();
 }
 
 void QgsMapRendererCache::dropUnusedConnections()
@@ -61,7 +86,13 @@ void QgsMapRendererCache::dropUnusedConnections()
     if ( layer.data() )
     {
       disconnect( layer.data(), &QgsMapLayer::repaintRequested, this, &QgsMapRendererCache::layerRequestedRepaint );
-      disconnect( layer.data(), &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerRequestedRepaint );
+      disconnect( layer.data(), &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerWillBeDeleted );
+      if ( QgsVectorLayer *vl = qobject_cast< QgsVectorLayer * >( layer.data() ) )
+      {
+        disconnect( vl, &QgsVectorLayer::featuresEdited, this, &QgsMapRendererCache::layerFeaturesEdited );
+        disconnect( vl, &QgsMapLayer::styleChanged, this, &QgsMapRendererCache::layerStyleChanged );
+        disconnect( vl, &QgsMapLayer::rendererChanged, this, &QgsMapRendererCache::layerStyleChanged );
+      }
     }
   }
 
@@ -81,6 +112,11 @@ QSet<QgsWeakMapLayerPointer > QgsMapRendererCache::dependentLayers() const
         result << l;
     }
   }
+  for ( const QgsWeakMapLayerPointer &l : mTileScopeLayers )
+  {
+    if ( l.data() )
+      result << l;
+  }
   return result;
 }
 
@@ -163,7 +199,13 @@ void QgsMapRendererCache::setCacheImageWithParameters( const QString &cacheKey,
       if ( !mConnectedLayers.contains( QgsWeakMapLayerPointer( layer ) ) )
       {
         connect( layer, &QgsMapLayer::repaintRequested, this, &QgsMapRendererCache::layerRequestedRepaint );
-        connect( layer, &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerRequestedRepaint );
+        connect( layer, &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerWillBeDeleted );
+        if ( QgsVectorLayer *vl = qobject_cast< QgsVectorLayer * >( layer ) )
+        {
+          connect( vl, &QgsVectorLayer::featuresEdited, this, &QgsMapRendererCache::layerFeaturesEdited );
+          connect( vl, &QgsMapLayer::styleChanged, this, &QgsMapRendererCache::layerStyleChanged );
+          connect( vl, &QgsMapLayer::rendererChanged, this, &QgsMapRendererCache::layerStyleChanged );
+        }
         mConnectedLayers << layer;
       }
     }
@@ -181,7 +223,8 @@ bool QgsMapRendererCache::hasCacheImage( const QString &cacheKey ) const
   {
     const CacheParameters &params = it.value();
     return ( params.cachedExtent == mExtent &&
-             params.cachedMtp.transform() == mMtp.transform() );
+             params.cachedMtp.transform() == mMtp.transform() &&
+             params.dirtyExtent.isNull() && params.dirtyFeatureIds.isEmpty() );
   }
   else
   {
@@ -189,6 +232,36 @@ bool QgsMapRendererCache::hasCacheImage( const QString &cacheKey ) const
   }
 }
 
+bool QgsMapRendererCache::hasDirtyCacheImage( const QString &cacheKey ) const
+{
+  QMutexLocker lock( &mMutex );
+
+  auto it = mCachedImages.constFind( cacheKey );
+  if ( it != mCachedImages.constEnd() )
+  {
+    const CacheParameters &params = it.value();
+    return ( params.cachedExtent == mExtent &&
+             params.cachedMtp.transform() == mMtp.transform() &&
+             ( !params.dirtyExtent.isNull() || !params.dirtyFeatureIds.isEmpty() ) );
+  }
+  else
+  {
+    return false;
+  }
+}
+
+QgsRectangle QgsMapRendererCache::dirtyExtent( const QString &cacheKey ) const
+{
+  QMutexLocker lock( &mMutex );
+  return mCachedImages.value( cacheKey ).dirtyExtent;
+}
+
+QgsFeatureIds QgsMapRendererCache::dirtyFeatureIds( const QString &cacheKey ) const
+{
+  QMutexLocker lock( &mMutex );
+  return mCachedImages.value( cacheKey ).dirtyFeatureIds;
+}
+
 bool QgsMapRendererCache::hasAnyCacheImage( const QString &cacheKey, double minimumScaleThreshold, double maximumScaleThreshold ) const
 {
   auto it = mCachedImages.constFind( cacheKey );
@@ -282,10 +355,70 @@ QList< QgsMapLayer * > QgsMapRendererCache::dependentLayers( const QString &cach
 void QgsMapRendererCache::layerRequestedRepaint()
 {
   QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
-  invalidateCacheForLayer( layer );
+  invalidateCacheForLayerPrivate( layer, true, true );
+}
+
+void QgsMapRendererCache::layerWillBeDeleted()
+{
+  QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
+  invalidateCacheForLayerPrivate( layer, false );
+}
+
+void QgsMapRendererCache::layerFeaturesEdited( const QgsRectangle &extent, const QgsFeatureIds &providerFeatureIds )
+{
+  QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
+  if ( !layer )
+    return;
+
+  QMutexLocker lock( &mMutex );
+
+  auto it = mCachedImages.find( layer->id() );
+  if ( it == mCachedImages.end() || !it.value().dependentLayers.contains( layer ) )
+    return;
+
+  if ( extent.isNull() && providerFeatureIds.isEmpty() )
+  {
+    // unknown area, the whole layer needs to be redrawn
+    mCachedImages.erase( it );
+    dropUnusedConnections();
+    return;
+  }
+
+  it.value().dirtyExtent.combineExtentWith( extent );
+  it.value().dirtyFeatureIds.unite( providerFeatureIds );
+  it.value().editedSinceRepaint = true;
+}
+
+void QgsMapRendererCache::layerStyleChanged()
+{
+  QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
+  if ( !layer )
+    return;
+
+  QMutexLocker lock( &mMutex );
+
+  // a repaint following a style change must not be taken for one following edits
+  auto it = mCachedImages.find( layer->id() );
+  if ( it != mCachedImages.end() )
+    it.value().editedSinceRepaint = false;
+}
+
+void QgsMapRendererCache::layerTileScopeChanged()
+{
+  QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
+  if ( !layer )
+    return;
+
+  QMutexLocker lock( &mMutex );
+  mLayerTileScopes.remove( layer->id() );
 }
 
 void QgsMapRendererCache::invalidateCacheForLayer( QgsMapLayer *layer )
+{
+  invalidateCacheForLayerPrivate( layer, true );
+}
+
+void QgsMapRendererCache::invalidateCacheForLayerPrivate( QgsMapLayer *layer, bool removeDiskTiles, bool keepEditedImage )
 {
   if ( !layer )
     return;
@@ -302,8 +435,30 @@ void QgsMapRendererCache::invalidateCacheForLayer( QgsMapLayer *layer )
       continue;
     }
 
+    // repaint following edits: the image can still be updated by redrawing its dirty extent
+    if ( keepEditedImage && it.value().editedSinceRepaint && it.key() == layer->id() )
+    {
+      it.value().editedSinceRepaint = false;
+      ++it;
+      continue;
+    }
+
     it = mCachedImages.erase( it );
   }
+
+  // tiles rendered during this session may be outdated, or belong to a layer which is going away
+  QMap<QString, QgsWeakMapLayerPointer>::iterator scopeIt = mTileScopeLayers.begin();
+  for ( ; scopeIt != mTileScopeLayers.end(); )
+  {
+    if ( scopeIt.value().data() != layer )
+    {
+      ++scopeIt;
+      continue;
+    }
+
+    clearTileScope( scopeIt.key(), removeDiskTiles );
+    scopeIt = mTileScopeLayers.erase( scopeIt );
+  }
   dropUnusedConnections();
 }
 
@@ -315,3 +470,621 @@ void QgsMapRendererCache::clearCacheImage( const QString &cacheKey )
   dropUnusedConnections();
 }
 
+
+///@cond PRIVATE
+
+static qint64 floorDivide( qint64 value, qint64 divisor )
+{
+  return value >= 0 ? value / divisor : -( ( -value + divisor - 1 ) / divisor );
+}
+
+static qint64 ceilDivide( qint64 value, qint64 divisor )
+{
+  return -floorDivide( -value, divisor );
+}
+
+//! Returns the memory used by a tile, in kilobytes
+static int tileCost( const QImage &tile )
+{
+  return static_cast< int >( static_cast< qint64 >( tile.bytesPerLine() ) * tile.height() / 1024 );
+}
+
+static QString tileKey( const QString &scope, const QString &gridKey, qint64 column, qint64 row )
+{
+  return QStringLiteral( "%1/%2/%3_%4" ).arg( scope, gridKey ).arg( column ).arg( row );
+}
+
+///@endcond
+
+void QgsMapRendererCache::setTileCacheEnabled( bool enabled )
+{
+  QMutexLocker lock( &mMutex );
+  mTileCacheEnabled = enabled;
+}
+
+bool QgsMapRendererCache::isTileCacheEnabled() const
+{
+  QMutexLocker lock( &mMutex );
+  return mTileCacheEnabled;
+}
+
+void QgsMapRendererCache::setTileCacheDirectory( const QString &directory )
+{
+  waitForTileWrites();
+
+  QMutexLocker lock( &mMutex );
+
+  mTileCacheDirectory = directory;
+  mDiskTiles.clear();
+  mDiskTileOrder.clear();
+  mDiskTileCounter = 0;
+  mDiskTileCacheSize = 0;
+
+  if ( directory.isEmpty() )
+    return;
+
+  QDir().mkpath( directory );
+
+  // reuse tiles from previous sessions, the least recently written ones being evicted first
+  QList< QFileInfo > files;
+  QDirIterator it( directory, QStringList() << QStringLiteral( "*.png" ), QDir::Files, QDirIterator::Subdirectories );
+  while ( it.hasNext() )
+  {
+    it.next();
+    files << it.fileInfo();
+  }
+  std::sort( files.begin(), files.end(), []( const QFileInfo & a, const QFileInfo & b )
+  {
+    return a.lastModified() < b.lastModified();
+  } );
+
+  for ( const QFileInfo &file : qgis::as_const( files ) )
+  {
+    touchDiskTile( file.absoluteFilePath(), file.size() );
+  }
+  trimDiskTiles();
+}
+
+QString QgsMapRendererCache::tileCacheDirectory() const
+{
+  QMutexLocker lock( &mMutex );
+  return mTileCacheDirectory;
+}
+
+void QgsMapRendererCache::setMaximumTileCacheMemory( qint64 bytes )
+{
+  QMutexLocker lock( &mMutex );
+  mTiles.setMaxCost( static_cast< int >( std::min< qint64 >( bytes / 1024, std::numeric_limits< int >::max() ) ) );
+}
+
+qint64 QgsMapRendererCache::maximumTileCacheMemory() const
+{
+  QMutexLocker lock( &mMutex );
+  return static_cast< qint64 >( mTiles.maxCost() ) * 1024;
+}
+
+void QgsMapRendererCache::setMaximumTileCacheDiskSize( qint64 bytes )
+{
+  QMutexLocker lock( &mMutex );
+  mMaximumTileCacheDiskSize = bytes;
+  trimDiskTiles();
+}
+
+qint64 QgsMapRendererCache::maximumTileCacheDiskSize() const
+{
+  QMutexLocker lock( &mMutex );
+  return mMaximumTileCacheDiskSize;
+}
+
+//! Returns the text of an expression variable \a value, for tile scopes
+static QString variableString( const QVariant &value )
+{
+  if ( value.type() == QVariant::List || value.type() == QVariant::StringList )
+    return value.toStringList().join( ',' );
+  if ( value.canConvert< QgsGeometry >() )
+    return value.value< QgsGeometry >().asWkt();
+  return value.toString();
+}
+
+QgsMapRendererCache::LayerTileScope QgsMapRendererCache::layerTileScope( QgsMapLayer *layer, const QString &style )
+{
+  LayerTileScope scope;
+
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  auto addData = [&hash]( const QString & data )
+  {
+    hash.addData( data.toUtf8() );
+    hash.addData( "\n", 1 );
+  };
+
+  addData( layer->id() );
+  addData( layer->source() );
+  QgsVectorLayer *vl = qobject_cast< QgsVectorLayer * >( layer );
+  if ( vl )
+    addData( vl->subsetString() );
+
+  // tiles stored on disk by earlier sessions are not reused once the data is modified
+  QDateTime timestamp;
+  if ( const QgsDataProvider *provider = layer->dataProvider() )
+  {
+    timestamp = provider->dataTimestamp();
+    if ( !timestamp.isValid() )
+    {
+      const QString path = QgsProviderRegistry::instance()->decodeUri( layer->providerType(), layer->source() ).value( QStringLiteral( "path" ) ).toString();
+      if ( !path.isEmpty() )
+        timestamp = QFileInfo( path ).lastModified();
+    }
+  }
+  addData( timestamp.isValid() ? timestamp.toString( Qt::ISODateWithMs ) : QString() );
+
+  QString styleXml = style;
+  if ( styleXml.isEmpty() )
+  {
+    QgsMapLayerStyle layerStyle;
+    layerStyle.readFromLayer( layer );
+    styleXml = layerStyle.xmlData();
+  }
+  addData( styleXml );
+  scope.layer = hash.result();
+
+  // variables used in the expressions of the style, e.g. @name or var('name') (with XML escaped quotes)
+  const QRegularExpression variableRx( QStringLiteral( "@([A-Za-z_][A-Za-z0-9_]*)|var\\(\\s*(?:'|&apos;)([^'&]+)(?:'|&apos;)" ) );
+  QRegularExpressionMatchIterator matchIt = variableRx.globalMatch( styleXml );
+  while ( matchIt.hasNext() )
+  {
+    const QRegularExpressionMatch match = matchIt.next();
+    scope.variables << ( match.captured( 1 ).isEmpty() ? match.captured( 2 ) : match.captured( 1 ) );
+  }
+  scope.variables.removeDuplicates();
+  scope.variables.sort();
+
+  if ( vl && vl->selectedFeatureCount() > 0 )
+  {
+    QList< QgsFeatureId > selectedIds = qgis::setToList( vl->selectedFeatureIds() );
+    std::sort( selectedIds.begin(), selectedIds.end() );
+    QCryptographicHash selectionHash( QCryptographicHash::Sha1 );
+    for ( QgsFeatureId id : qgis::as_const( selectedIds ) )
+      selectionHash.addData( reinterpret_cast< const char * >( &id ), sizeof( id ) );
+    scope.selection = selectionHash.result();
+  }
+
+  return scope;
+}
+
+QString QgsMapRendererCache::tileCacheScope( QgsMapLayer *layer, const QgsMapSettings &settings )
+{
+  if ( !layer )
+    return QString();
+
+  QgsVectorLayer *vl = qobject_cast< QgsVectorLayer * >( layer );
+  if ( vl )
+  {
+    // editing layers are always rendered, and their images contain vertex markers
+    if ( vl->isEditable() )
+      return QString();
+
+    // renderers which look at all the features in the visible extent cannot be split into tiles
+    const QString rendererType = vl->renderer() ? vl->renderer()->type() : QString();
+    if ( rendererType == QLatin1String( "heatmapRenderer" )
+         || rendererType == QLatin1String( "pointCluster" )
+         || rendererType == QLatin1String( "pointDisplacement" ) )
+      return QString();
+  }
+  else if ( QgsRasterLayer *rl = qobject_cast< QgsRasterLayer * >( layer ) )
+  {
+    if ( rl->renderer() && rl->renderer()->minMaxOrigin().extent() == QgsRasterMinMaxOrigin::UpdatedCanvas )
+      return QString();
+  }
+  else
+  {
+    return QString();
+  }
+
+  LayerTileScope layerScope;
+  const QMap< QString, QString > styleOverrides = settings.layerStyleOverrides();
+  const auto overrideIt = styleOverrides.constFind( layer->id() );
+  if ( overrideIt != styleOverrides.constEnd() )
+  {
+    layerScope = layerTileScope( layer, overrideIt.value() );
+  }
+  else
+  {
+    QMutexLocker lock( &mMutex );
+    const auto it = mLayerTileScopes.constFind( layer->id() );
+    if ( it != mLayerTileScopes.constEnd() )
+    {
+      layerScope = it.value();
+    }
+    else
+    {
+      // serializing the style is expensive, keep the result until the layer changes
+      lock.unlock();
+      layerScope = layerTileScope( layer, QString() );
+      connect( layer, &QgsMapLayer::styleChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::rendererChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::dataSourceChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::opacityChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::blendModeChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::repaintRequested, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      connect( layer, &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      if ( vl )
+      {
+        connect( vl, &QgsVectorLayer::subsetStringChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+        connect( vl, &QgsVectorLayer::selectionChanged, this, &QgsMapRendererCache::layerTileScopeChanged, Qt::UniqueConnection );
+      }
+      lock.relock();
+      mLayerTileScopes.insert( layer->id(), layerScope );
+    }
+  }
+
+  // styles using the visible extent cannot be split into tiles
+  static const QStringList extentVariables
+  {
+    QStringLiteral( "map_extent" ),
+    QStringLiteral( "map_extent_center" ),
+    QStringLiteral( "map_extent_width" ),
+    QStringLiteral( "map_extent_height" )
+  };
+  for ( const QString &variable : qgis::as_const( layerScope.variables ) )
+  {
+    if ( extentVariables.contains( variable ) )
+      return QString();
+  }
+
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  auto addData = [&hash]( const QString & data )
+  {
+    hash.addData( data.toUtf8() );
+    hash.addData( "\n", 1 );
+  };
+
+  hash.addData( layerScope.layer );
+  if ( !layerScope.variables.isEmpty() )
+  {
+    // as in the context of the layer render jobs
+    QgsExpressionContext context = settings.expressionContext();
+    context.appendScope( QgsExpressionContextUtils::layerScope( layer ) );
+    for ( const QString &variable : qgis::as_const( layerScope.variables ) )
+    {
+      addData( variable );
+      addData( variableString( context.variable( variable ) ) );
+    }
+  }
+  addData( settings.destinationCrs().toWkt() );
+  addData( QString::number( settings.outputDpi(), 'g', 17 ) );
+  addData( QString::number( static_cast< int >( settings.flags() ) ) );
+  addData( QString::number( static_cast< int >( settings.outputImageFormat() ) ) );
+  addData( QString::number( settings.devicePixelRatio(), 'g', 17 ) );
+  if ( settings.isTemporal() )
+  {
+    addData( settings.temporalRange().begin().toString( Qt::ISODateWithMs ) );
+    addData( settings.temporalRange().end().toString( Qt::ISODateWithMs ) );
+  }
+  addData( QString::number( settings.zRange().lower(), 'g', 17 ) );
+  addData( QString::number( settings.zRange().upper(), 'g', 17 ) );
+  if ( settings.testFlag( QgsMapSettings::DrawSelection ) && !layerScope.selection.isEmpty() )
+  {
+    addData( settings.selectionColor().name( QColor::HexArgb ) );
+    hash.addData( layerScope.selection );
+  }
+
+  return QString::fromLatin1( hash.result().toHex() );
+}
+
+int QgsMapRendererCache::tileCacheMargin( QgsMapLayer *layer, QgsRenderContext &context )
+{
+  QgsVectorLayer *vl = qobject_cast< QgsVectorLayer * >( layer );
+  if ( !vl || !vl->renderer() )
+    return 0;
+
+  const double bleed = QgsSymbolBleed::rendererBleed( vl->renderer(), context );
+  // layers are rendered with this margin around their tiles, keep it small compared to a tile
+  if ( !std::isfinite( bleed ) || bleed > TILE_SIZE )
+    return -1;
+
+  // one more pixel for antialiasing
+  return static_cast< int >( std::ceil( bleed ) ) + 1;
+}
+
+bool QgsMapRendererCache::tileGrid( const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, TileGrid &grid )
+{
+  const double mapUnitsPerPixel = mapToPixel.mapUnitsPerPixel();
+  if ( !qgsDoubleNear( mapToPixel.mapRotation(), 0.0 ) || mapUnitsPerPixel <= 0 || extent.isEmpty() )
+    return false;
+
+  // tiles of a scale form a grid anchored at the map origin, whatever the extent of the images they come from
+  grid.left = extent.xMinimum() / mapUnitsPerPixel;
+  grid.top = -extent.yMaximum() / mapUnitsPerPixel;
+  if ( !std::isfinite( grid.left ) || !std::isfinite( grid.top ) || std::fabs( grid.left ) > 1e13 || std::fabs( grid.top ) > 1e13 )
+    return false;
+
+  grid.key = QString::number( mapUnitsPerPixel, 'g', 10 );
+  return true;
+}
+
+QgsRectangle QgsMapRendererCache::tileCacheRenderExtent( const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, int margin, QSize &size )
+{
+  TileGrid grid;
+  if ( margin < 0 || !tileGrid( extent, mapToPixel, grid ) || mapToPixel.mapWidth() <= 0 || mapToPixel.mapHeight() <= 0 )
+    return QgsRectangle();
+
+  // all the tiles touched by the map, as in tileCacheImage()
+  const qint64 firstColumn = floorDivide( static_cast< qint64 >( std::floor( grid.left ) ), TILE_SIZE );
+  const qint64 lastColumn = floorDivide( static_cast< qint64 >( std::ceil( grid.left + mapToPixel.mapWidth() ) ) - 1, TILE_SIZE );
+  const qint64 firstRow = floorDivide( static_cast< qint64 >( std::floor( grid.top ) ), TILE_SIZE );
+  const qint64 lastRow = floorDivide( static_cast< qint64 >( std::ceil( grid.top + mapToPixel.mapHeight() ) ) - 1, TILE_SIZE );
+
+  const qint64 width = ( lastColumn - firstColumn + 1 ) * TILE_SIZE + 2 * margin;
+  const qint64 height = ( lastRow - firstRow + 1 ) * TILE_SIZE + 2 * margin;
+  if ( width > std::numeric_limits< int >::max() || height > std::numeric_limits< int >::max() )
+    return QgsRectangle();
+  size = QSize( static_cast< int >( width ), static_cast< int >( height ) );
+
+  const double mapUnitsPerPixel = mapToPixel.mapUnitsPerPixel();
+  const double left = static_cast< double >( firstColumn * TILE_SIZE - margin );
+  const double top = static_cast< double >( firstRow * TILE_SIZE - margin );
+  return QgsRectangle( left * mapUnitsPerPixel, -( top + height ) * mapUnitsPerPixel,
+                       ( left + width ) * mapUnitsPerPixel, -top * mapUnitsPerPixel );
+}
+
+QString QgsMapRendererCache::tileFilePath( const QString &scope, const QString &gridKey, qint64 column, qint64 row ) const
+{
+  const QString gridHash = QString::fromLatin1( QCryptographicHash::hash( gridKey.toUtf8(), QCryptographicHash::Md5 ).toHex().left( 16 ) );
+  return QStringLiteral( "%1/%2/%3_%4_%5.png" ).arg( mTileCacheDirectory, scope, gridHash ).arg( column ).arg( row );
+}
+
+void QgsMapRendererCache::touchDiskTile( const QString &path, qint64 size )
+{
+  auto it = mDiskTiles.find( path );
+  if ( it != mDiskTiles.end() )
+  {
+    mDiskTileOrder.remove( it->first );
+    mDiskTileCacheSize -= it->second;
+    mDiskTiles.erase( it );
+  }
+
+  const qint64 order = ++mDiskTileCounter;
+  mDiskTiles.insert( path, qMakePair( order, size ) );
+  mDiskTileOrder.insert( order, path );
+  mDiskTileCacheSize += size;
+}
+
+void QgsMapRendererCache::removeDiskTile( const QString &path )
+{
+  // the file is removed once written
+  mPendingDiskTiles.remove( path );
+
+  auto it = mDiskTiles.find( path );
+  if ( it == mDiskTiles.end() )
+    return;
+
+  QFile::remove( path );
+  mDiskTileOrder.remove( it->first );
+  mDiskTileCacheSize -= it->second;
+  mDiskTiles.erase( it );
+}
+
+void QgsMapRendererCache::trimDiskTiles()
+{
+  // never evict the most recently used tile
+  while ( mDiskTileCacheSize > mMaximumTileCacheDiskSize && mDiskTileOrder.size() > 1 )
+  {
+    removeDiskTile( mDiskTileOrder.first() );
+  }
+}
+
+void QgsMapRendererCache::clearTileScope( const QString &scope, bool removeDiskTiles )
+{
+  const QString prefix = scope + '/';
+  const QList< QString > keys = mTiles.keys();
+  for ( const QString &key : keys )
+  {
+    if ( key.startsWith( prefix ) )
+      mTiles.remove( key );
+  }
+
+  if ( !removeDiskTiles || mTileCacheDirectory.isEmpty() )
+    return;
+
+  const QString pathPrefix = QStringLiteral( "%1/%2/" ).arg( mTileCacheDirectory, scope );
+  const QList< QString > paths = mDiskTiles.keys() + mPendingDiskTiles.keys();
+  for ( const QString &path : paths )
+  {
+    if ( path.startsWith( pathPrefix ) )
+      removeDiskTile( path );
+  }
+}
+
+void QgsMapRendererCache::setTileCacheImage( QgsMapLayer *layer, const QString &scope, const QImage &image, const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, int margin )
+{
+  QMutexLocker lock( &mMutex );
+
+  if ( !mTileCacheEnabled || scope.isEmpty() || image.isNull() || !qgsDoubleNear( image.devicePixelRatio(), 1.0 )
+       || image.width() != mapToPixel.mapWidth() || image.height() != mapToPixel.mapHeight() )
+    return;
+
+  TileGrid grid;
+  if ( !tileGrid( extent, mapToPixel, grid ) )
+    return;
+
+  // images which are not aligned on the pixels of the grid cannot be split into tiles
+  const qint64 left = std::llround( grid.left );
+  const qint64 top = std::llround( grid.top );
+  if ( std::fabs( grid.left - left ) > 0.01 || std::fabs( grid.top - top ) > 0.01 )
+    return;
+
+  if ( layer )
+  {
+    mTileScopeLayers.insert( scope, layer );
+    if ( !mConnectedLayers.contains( QgsWeakMapLayerPointer( layer ) ) )
+    {
+      connect( layer, &QgsMapLayer::repaintRequested, this, &QgsMapRendererCache::layerRequestedRepaint );
+      connect( layer, &QgsMapLayer::willBeDeleted, this, &QgsMapRendererCache::layerWillBeDeleted );
+      mConnectedLayers << layer;
+    }
+  }
+
+  // only tiles entirely covered by the image are stored, away from the edges where
+  // symbols of features outside the rendered extent are missing
+  margin = std::max( margin, 0 );
+  const qint64 firstColumn = ceilDivide( left + margin, TILE_SIZE );
+  const qint64 lastColumn = floorDivide( left + image.width() - margin, TILE_SIZE ) - 1;
+  const qint64 firstRow = ceilDivide( top + margin, TILE_SIZE );
+  const qint64 lastRow = floorDivide( top + image.height() - margin, TILE_SIZE ) - 1;
+
+  QList< PendingDiskTile > diskTiles;
+
+  for ( qint64 row = firstRow; row <= lastRow; ++row )
+  {
+    for ( qint64 column = firstColumn; column <= lastColumn; ++column )
+    {
+      const QString key = tileKey( scope, grid.key, column, row );
+      if ( mTiles.contains( key ) )
+        continue;
+
+      const QImage tile = image.copy( static_cast< int >( column * TILE_SIZE - left ), static_cast< int >( row * TILE_SIZE - top ), TILE_SIZE, TILE_SIZE );
+      mTiles.insert( key, new QImage( tile ), tileCost( tile ) );
+
+      if ( mTileCacheDirectory.isEmpty() )
+        continue;
+
+      const QString path = tileFilePath( scope, grid.key, column, row );
+      if ( mDiskTiles.contains( path ) )
+      {
+        touchDiskTile( path, mDiskTiles.value( path ).second );
+        continue;
+      }
+      if ( mPendingDiskTiles.contains( path ) )
+        continue;
+
+      PendingDiskTile diskTile;
+      diskTile.path = path;
+      diskTile.image = tile;
+      diskTile.id = ++mDiskTileWriteCounter;
+      mPendingDiskTiles.insert( path, diskTile.id );
+      diskTiles << diskTile;
+    }
+  }
+  trimDiskTiles();
+
+  if ( diskTiles.isEmpty() )
+    return;
+
+  // encoding PNG files is slow, don't block the thread rendering the map
+  mTileWrites.erase( std::remove_if( mTileWrites.begin(), mTileWrites.end(), []( const QFuture< void > &write )
+  {
+    return write.isFinished();
+  } ), mTileWrites.end() );
+  mTileWrites << QtConcurrent::run( this, &QgsMapRendererCache::writeDiskTiles, diskTiles );
+}
+
+void QgsMapRendererCache::writeDiskTiles( const QList< PendingDiskTile > &tiles )
+{
+  for ( const PendingDiskTile &tile : tiles )
+  {
+    QDir().mkpath( QFileInfo( tile.path ).absolutePath() );
+    const bool saved = tile.image.save( tile.path, "PNG" );
+    const qint64 size = QFileInfo( tile.path ).size();
+
+    QMutexLocker lock( &mMutex );
+    if ( mPendingDiskTiles.value( tile.path ) != tile.id )
+    {
+      // removed while being written
+      if ( !mPendingDiskTiles.contains( tile.path ) )
+        QFile::remove( tile.path );
+      continue;
+    }
+
+    mPendingDiskTiles.remove( tile.path );
+    if ( saved )
+      touchDiskTile( tile.path, size );
+  }
+
+  QMutexLocker lock( &mMutex );
+  trimDiskTiles();
+}
+
+void QgsMapRendererCache::waitForTileWrites()
+{
+  QMutexLocker lock( &mMutex );
+  const QList< QFuture< void > > writes = mTileWrites;
+  lock.unlock();
+
+  for ( QFuture< void > write : writes )
+    write.waitForFinished();
+}
+
+QImage QgsMapRendererCache::tileCacheImage( const QString &scope )
+{
+  QMutexLocker lock( &mMutex );
+
+  if ( !mTileCacheEnabled || scope.isEmpty() )
+    return QImage();
+
+  TileGrid grid;
+  if ( !tileGrid( mExtent, mMtp, grid ) )
+    return QImage();
+
+  const int width = mMtp.mapWidth();
+  const int height = mMtp.mapHeight();
+  if ( width <= 0 || height <= 0 )
+    return QImage();
+
+  const qint64 firstColumn = floorDivide( static_cast< qint64 >( std::floor( grid.left ) ), TILE_SIZE );
+  const qint64 lastColumn = floorDivide( static_cast< qint64 >( std::ceil( grid.left + width ) ) - 1, TILE_SIZE );
+  const qint64 firstRow = floorDivide( static_cast< qint64 >( std::floor( grid.top ) ), TILE_SIZE );
+  const qint64 lastRow = floorDivide( static_cast< qint64 >( std::ceil( grid.top + height ) ) - 1, TILE_SIZE );
+
+  QImage image( width, height, QImage::Format_ARGB32_Premultiplied );
+  image.fill( Qt::transparent );
+  QPainter painter( &image );
+  painter.setCompositionMode( QPainter::CompositionMode_Source );
+
+  for ( qint64 row = firstRow; row <= lastRow; ++row )
+  {
+    for ( qint64 column = firstColumn; column <= lastColumn; ++column )
+    {
+      const QString key = tileKey( scope, grid.key, column, row );
+      QImage *tile = mTiles.object( key );
+      if ( !tile && !mTileCacheDirectory.isEmpty() )
+      {
+        const QString path = tileFilePath( scope, grid.key, column, row );
+        if ( mDiskTiles.contains( path ) )
+        {
+          QImage diskTile( path );
+          if ( diskTile.size() == QSize( TILE_SIZE, TILE_SIZE ) )
+          {
+            touchDiskTile( path, mDiskTiles.value( path ).second );
+            tile = new QImage( diskTile.convertToFormat( QImage::Format_ARGB32_Premultiplied ) );
+            mTiles.insert( key, tile, tileCost( *tile ) );
+            // the cache may delete the tile straight away if it does not fit
+            tile = mTiles.object( key );
+          }
+          else
+          {
+            removeDiskTile( path );
+          }
+        }
+      }
+
+      if ( !tile )
+        return QImage();
+
+      painter.drawImage( QPointF( static_cast< double >( column * TILE_SIZE ) - grid.left, static_cast< double >( row * TILE_SIZE ) - grid.top ), *tile );
+    }
+  }
+  painter.end();
+  return image;
+}
+
+void QgsMapRendererCache::setLabelPlacements( const QgsLabelPlacementCache &placements )
+{
+  QMutexLocker lock( &mMutex );
+  mLabelPlacements = placements;
+}
+
+QgsLabelPlacementCache QgsMapRendererCache::labelPlacements() const
+{
+  QMutexLocker lock( &mMutex );
+  return mLabelPlacements;
+}
@@ -20,9 +20,16 @@
 #include <QMap>
 #include <QImage>
 #include <QMutex>
+#include <QCache>
+#include <QFuture>
 
 #include "qgsrectangle.h"
 #include "qgsmaplayer.h"
+#include "qgslabelplacementcache.h"
+#include "qgsfeatureid.h"
+
+class QgsMapSettings;
+class QgsRenderContext;
 
 
 /**
@@ -39,6 +46,13 @@
  * for particular layers between the first render update and the moment the layer
  * actually has partially rendered something in the resulting image.
  *
+ * Optionally, the cache can also keep layer renders split into tiles of a fixed grid
+ * (see setTileCacheEnabled()). Tiles are keyed by the layer, its style and the render
+ * settings, the map scale and the tile index, and are evicted in least recently used order.
+ * With a tile cache directory, tiles are also stored on disk and reused across sessions.
+ * A layer image can then be assembled from tiles when returning to a previously rendered
+ * area, e.g. after panning away and back.
+ *
  * The class is thread-safe (multiple classes can access the same instance safely).
  *
  * \since QGIS 2.4
@@ -49,6 +63,7 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
   public:
 
     QgsMapRendererCache();
+    ~QgsMapRendererCache() override;
 
     /**
      * Invalidates the cache contents, clearing all cached images.
@@ -131,6 +146,44 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
      */
     bool hasAnyCacheImage( const QString &cacheKey, double minimumScaleThreshold = 0, double maximumScaleThreshold = 0 ) const;
 
+    /**
+     * Returns TRUE if the cache contains an image with the specified \a cacheKey that has the same
+     * extent and scale as the cache's global extent and scale, but which is outdated within its
+     * dirtyExtent() or around the dirtyFeatureIds() because features of its layer have been edited.
+     *
+     * Such images are not reported by hasCacheImage(). They can be updated by only redrawing
+     * the dirty extent over the cacheImage().
+     *
+     * \see dirtyExtent()
+     * \since QGIS 3.18
+     */
+    bool hasDirtyCacheImage( const QString &cacheKey ) const;
+
+    /**
+     * Returns the extent, in the layer's CRS, which needs to be redrawn in the image cached with
+     * the specified \a cacheKey, or a null rectangle if the image is up to date.
+     *
+     * Images of vector layers are kept when the layer requests a repaint after its features have
+     * been edited (see QgsVectorLayer::featuresEdited()), with the extent of the edited features
+     * marked as dirty. All other repaints remove the image from the cache.
+     *
+     * The original geometries of the provider features returned by dirtyFeatureIds() are not
+     * included in this extent and also need to be redrawn.
+     *
+     * \see hasDirtyCacheImage()
+     * \since QGIS 3.18
+     */
+    QgsRectangle dirtyExtent( const QString &cacheKey ) const;
+
+    /**
+     * Returns the ids of the data provider features whose original geometries need to be redrawn in
+     * the image cached with the specified \a cacheKey, in addition to the dirtyExtent().
+     *
+     * \see QgsVectorLayer::featuresEdited()
+     * \since QGIS 3.18
+     */
+    QgsFeatureIds dirtyFeatureIds( const QString &cacheKey ) const;
+
     /**
      * Returns the cached image for the specified \a cacheKey. The \a cacheKey usually
      * matches the QgsMapLayer::id() which the image is a render of.
@@ -173,10 +226,201 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
      */
     void invalidateCacheForLayer( QgsMapLayer *layer );
 
+    /**
+     * Sets whether layer images are also cached as tiles.
+     *
+     * \see isTileCacheEnabled()
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    void setTileCacheEnabled( bool enabled );
+
+    /**
+     * Returns TRUE if layer images are also cached as tiles.
+     *
+     * \see setTileCacheEnabled()
+     * \since QGIS 3.18
+     */
+    bool isTileCacheEnabled() const;
+
+    /**
+     * Sets the \a directory used to store tiles on disk. Tiles already present in the directory
+     * (e.g. from a previous session) are reused. An empty \a directory keeps tiles in memory only.
+     *
+     * Tiles are keyed by layer source and style, and by the modification time of the layer data when the
+     * data provider reports it (see QgsDataProvider::dataTimestamp()) or the data source is a file. Tiles
+     * of other sources, e.g. databases, are only invalidated when the layer requests a repaint during the
+     * session, so the disk cache should not be used for such layers if their data is modified outside of QGIS.
+     *
+     * \see tileCacheDirectory()
+     * \since QGIS 3.18
+     */
+    void setTileCacheDirectory( const QString &directory );
+
+    /**
+     * Returns the directory used to store tiles on disk, or an empty string if tiles are only kept in memory.
+     *
+     * \see setTileCacheDirectory()
+     * \since QGIS 3.18
+     */
+    QString tileCacheDirectory() const;
+
+    /**
+     * Sets the maximum memory used by tiles, in \a bytes.
+     *
+     * \see maximumTileCacheMemory()
+     * \since QGIS 3.18
+     */
+    void setMaximumTileCacheMemory( qint64 bytes );
+
+    /**
+     * Returns the maximum memory used by tiles, in bytes.
+     *
+     * \see setMaximumTileCacheMemory()
+     * \since QGIS 3.18
+     */
+    qint64 maximumTileCacheMemory() const;
+
+    /**
+     * Sets the maximum size of the tiles stored on disk, in \a bytes.
+     *
+     * \see maximumTileCacheDiskSize()
+     * \since QGIS 3.18
+     */
+    void setMaximumTileCacheDiskSize( qint64 bytes );
+
+    /**
+     * Returns the maximum size of the tiles stored on disk, in bytes.
+     *
+     * \see setMaximumTileCacheDiskSize()
+     * \since QGIS 3.18
+     */
+    qint64 maximumTileCacheDiskSize() const;
+
+    /**
+     * Returns the scope identifying tiles of a \a layer rendered with the given map \a settings.
+     *
+     * The scope is a hash of the layer source, data modification time and style, of the values of the
+     * expression variables used by the style, and of the settings which affect layer images, such as the
+     * destination CRS and the output DPI. An empty string is returned if the layer cannot be cached as
+     * tiles because its rendering depends on the visible extent (e.g. heatmaps, raster layers stretched to
+     * the canvas extent or styles using the map_extent variables).
+     *
+     * The part of the scope depending on the layer is kept until the layer's style, renderer, source,
+     * subset or selection changes, or the layer requests a repaint. Variable values are read from the
+     * expression context of the \a settings and from the layer on each call.
+     *
+     * This must be called from the thread the \a layer lives in.
+     *
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    QString tileCacheScope( QgsMapLayer *layer, const QgsMapSettings &settings );
+
+    /**
+     * Returns the width, in pixels, of the border of \a layer images rendered with the specified
+     * \a context which may miss parts of symbols of features outside the rendered extent, or -1
+     * if the extent of the layer symbols cannot be estimated (e.g. with data defined sizes
+     * or paint effects).
+     *
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    static int tileCacheMargin( QgsMapLayer *layer, QgsRenderContext &context );
+
+    /**
+     * Returns the extent of a layer image which covers all the tiles needed for an image of the map
+     * \a extent at the specified \a mapToPixel, plus \a margin pixels on each side. The size of the
+     * image in pixels is returned in \a size.
+     *
+     * Rendering a layer over this extent, instead of the map extent, lets setTileCacheImage() store
+     * all the tiles of the map, including those along its edges.
+     *
+     * A null rectangle is returned if images of the map cannot be cached as tiles, e.g. for rotated maps.
+     *
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    static QgsRectangle tileCacheRenderExtent( const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, int margin, QSize &size SIP_OUT );
+
+    /**
+     * Splits a rendered \a image of the map \a extent at the specified \a mapToPixel into tiles,
+     * and stores the tiles which are entirely covered by the image under the specified \a scope.
+     *
+     * Tiles form a grid anchored at the map origin for each scale, so the \a extent must be aligned on
+     * whole pixels of that grid, as the extents returned by tileCacheRenderExtent() are.
+     *
+     * Tiles closer to the image edges than \a margin pixels are not stored, as they may miss parts
+     * of symbols of features outside the rendered extent (see tileCacheMargin()).
+     *
+     * If \a layer is set, its tiles are removed when the layer requests a repaint.
+     *
+     * Images of rotated maps or with a device pixel ratio other than 1 are not cached.
+     *
+     * With a tile cache directory, tiles are written to disk in a background thread.
+     *
+     * \see tileCacheImage()
+     * \see tileCacheScope()
+     * \see waitForTileWrites()
+     * \since QGIS 3.18
+     */
+    void setTileCacheImage( QgsMapLayer *layer, const QString &scope, const QImage &image, const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, int margin = 0 );
+
+    /**
+     * Blocks until the tiles being written to the tile cache directory in the background are stored.
+     *
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    void waitForTileWrites();
+
+    /**
+     * Returns an image of the current cache extent and scale assembled from the tiles stored under
+     * the specified \a scope, or a null image if some of the required tiles are not cached.
+     *
+     * Tiles are drawn at the nearest whole pixel if the extent is not aligned on the tile grid.
+     *
+     * \see setTileCacheImage()
+     * \since QGIS 3.18
+     */
+    QImage tileCacheImage( const QString &scope );
+
+    /**
+     * Stores the label \a placements of the last render, so that the next render can keep labels in place.
+     *
+     * Label placements are not removed by clear(), as they are only used as hints.
+     *
+     * \see labelPlacements()
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    void setLabelPlacements( const QgsLabelPlacementCache &placements ) SIP_SKIP;
+
+    /**
+     * Returns the label placements of the last render.
+     *
+     * \see setLabelPlacements()
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    QgsLabelPlacementCache labelPlacements() const SIP_SKIP;
+
   private slots:
     //! Remove layer (that emitted the signal) from the cache
     void layerRequestedRepaint();
 
+    //! Remove layer (that emitted the signal) from the cache, keeping its tiles on disk
+    void layerWillBeDeleted();
+
+    //! Marks the edited extent and features of the layer (that emitted the signal) as dirty in its cached image
+    void layerFeaturesEdited( const QgsRectangle &extent, const QgsFeatureIds &providerFeatureIds );
+
+    //! Forgets the edits of the layer (that emitted the signal), so that its next repaint removes its cached image
+    void layerStyleChanged();
+
+    //! Removes the tile scope of the layer (that emitted the signal)
+    void layerTileScopeChanged();
+
   private:
 
     struct CacheParameters
@@ -185,6 +429,12 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
       QgsWeakMapLayerPointerList dependentLayers;
       QgsRectangle cachedExtent;
       QgsMapToPixel cachedMtp;
+      //! Extent of the layer features edited since the image was rendered, in layer CRS
+      QgsRectangle dirtyExtent;
+      //! Provider features whose original geometries were edited since the image was rendered
+      QgsFeatureIds dirtyFeatureIds;
+      //! TRUE if features were edited since the layer's last repaint request
+      bool editedSinceRepaint = false;
     };
 
     //! Invalidate cache contents (without locking)
@@ -195,6 +445,66 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
 
     QSet< QgsWeakMapLayerPointer > dependentLayers() const;
 
+    //! Tile grid position of an image, see tileGrid()
+    struct TileGrid
+    {
+      //! Key of the scale of the grid
+      QString key;
+      //! Position of the image's top left corner in the grid, in pixels from the map origin
+      double left = 0;
+      double top = 0;
+    };
+
+    //! Returns the tile grid matching an image of \a extent at \a mapToPixel, or FALSE if tiles cannot be used
+    static bool tileGrid( const QgsRectangle &extent, const QgsMapToPixel &mapToPixel, TileGrid &grid );
+
+    //! Part of the tile scope of a layer depending on the layer only, see tileCacheScope()
+    struct LayerTileScope
+    {
+      //! Hash of the layer source and style
+      QByteArray layer;
+      //! Hash of the selected feature ids, empty if there is no selection
+      QByteArray selection;
+      //! Names of the expression variables used by the style, sorted
+      QStringList variables;
+    };
+
+    //! Computes the tile scope part of a \a layer, using the \a style XML if not empty instead of the layer's style
+    static LayerTileScope layerTileScope( QgsMapLayer *layer, const QString &style );
+
+    //! Tile waiting to be written to disk
+    struct PendingDiskTile
+    {
+      QString path;
+      QImage image;
+      //! Identifier of the write, a tile removed and stored again while being written gets a new one
+      qint64 id = 0;
+    };
+
+    //! Stores \a tiles on disk, runs in a background thread
+    void writeDiskTiles( const QList< PendingDiskTile > &tiles );
+
+    //! Returns the path of the file storing a tile on disk
+    QString tileFilePath( const QString &scope, const QString &gridKey, qint64 column, qint64 row ) const;
+
+    //! Registers a tile file on disk as the most recently used one, and removes older files if needed (without locking)
+    void touchDiskTile( const QString &path, qint64 size );
+
+    //! Removes a tile file from disk, or cancels its pending write (without locking)
+    void removeDiskTile( const QString &path );
+
+    //! Removes the least recently used tile files until the disk cache fits its maximum size (without locking)
+    void trimDiskTiles();
+
+    //! Removes the tiles of a scope from memory, and from disk if \a removeDiskTiles is TRUE (without locking)
+    void clearTileScope( const QString &scope, bool removeDiskTiles );
+
+    /**
+     * Removes cached images and tiles of a layer. If \a keepEditedImage is TRUE, the layer's
+     * own image is kept if it has been marked as dirty since the last call.
+     */
+    void invalidateCacheForLayerPrivate( QgsMapLayer *layer, bool removeDiskTiles, bool keepEditedImage = false );
+
     mutable QMutex mMutex;
     QgsRectangle mExtent;
     QgsMapToPixel mMtp;
@@ -205,6 +515,31 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     QMap<QString, CacheParameters> mCachedImages;
     //! List of all layers on which this cache is currently connected
     QSet< QgsWeakMapLayerPointer > mConnectedLayers;
+
+    bool mTileCacheEnabled = false;
+    QString mTileCacheDirectory;
+    qint64 mMaximumTileCacheDiskSize = 512 * 1024 * 1024;
+
+    //! Tiles kept in memory, with their size in kilobytes as cost
+    QCache< QString, QImage > mTiles;
+    //! Layers of the tile scopes stored during the session
+    QMap< QString, QgsWeakMapLayerPointer > mTileScopeLayers;
+
+    //! Tile files stored on disk, with their position in the use order and size
+    QHash< QString, QPair< qint64, qint64 > > mDiskTiles;
+    //! Tile files stored on disk, from the least to the most recently used
+    QMap< qint64, QString > mDiskTileOrder;
+    qint64 mDiskTileCounter = 0;
+    qint64 mDiskTileCacheSize = 0;
+
+    //! Tile scope parts of the layers, by layer id
+    QHash< QString, LayerTileScope > mLayerTileScopes;
+    //! Tile files being written to disk in the background, with the identifier of their write
+    QHash< QString, qint64 > mPendingDiskTiles;
+    qint64 mDiskTileWriteCounter = 0;
+    QList< QFuture< void > > mTileWrites;
+
+    QgsLabelPlacementCache mLabelPlacements;
 };
 
 
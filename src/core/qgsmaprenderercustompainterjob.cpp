@@ -315,6 +315,7 @@ void QgsMapRendererCustomPainterJob::doRender()
       }
 
       job.completed = job.renderer->render();
+      job.copyTileImage();
 
       job.renderingTime += layerTime.elapsed();
     }
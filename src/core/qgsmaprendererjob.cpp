@@ -43,6 +43,10 @@
 #include "qgsmaplayertemporalproperties.h"
 #include "qgsmaplayerelevationproperties.h"
 #include "qgsvectorlayerrenderer.h"
+#include "qgsvectorlayer.h"
+#include "qgspainteffect.h"
+#include "qgsvectordataprovider.h"
+#include "qgsfeatureiterator.h"
 
 ///@cond PRIVATE
 
@@ -51,6 +55,10 @@ const QString QgsMapRendererJob::LABEL_PREVIEW_CACHE_ID = QStringLiteral( "_prev
 
 bool LayerRenderJob::imageCanBeComposed() const
 {
+  // layers drawn over tiles only have an image once rendered
+  if ( tileImage && !tileImageCopied )
+    return false;
+
   if ( imageInitialized )
   {
     if ( renderer )
@@ -68,6 +76,22 @@ bool LayerRenderJob::imageCanBeComposed() const
   }
 }
 
+void LayerRenderJob::copyTileImage()
+{
+  if ( !tileImage || !img )
+    return;
+
+  // the layer painter draws into the tile image
+  if ( context.painter() && context.painter()->isActive() )
+    context.painter()->end();
+
+  QPainter painter( img );
+  painter.setCompositionMode( QPainter::CompositionMode_Source );
+  painter.drawImage( tileImageOffset, *tileImage );
+  painter.end();
+  tileImageCopied = true;
+}
+
 QgsMapRendererJob::QgsMapRendererJob( const QgsMapSettings &settings )
   : mSettings( settings )
 
@@ -306,15 +330,161 @@ QPainter *QgsMapRendererJob::allocateImageAndPainter( QString layerId, QImage *&
   image = allocateImage( layerId );
   if ( image )
   {
-    painter = new QPainter( image );
-    painter->setRenderHint( QPainter::Antialiasing, mSettings.testFlag( QgsMapSettings::Antialiasing ) );
+    painter = createImagePainter( image );
+  }
+  return painter;
+}
+
+QPainter *QgsMapRendererJob::createImagePainter( QImage *image ) const
+{
+  QPainter *painter = new QPainter( image );
+  painter->setRenderHint( QPainter::Antialiasing, mSettings.testFlag( QgsMapSettings::Antialiasing ) );
 #if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
-    painter->setRenderHint( QPainter::LosslessImageRendering, mSettings.testFlag( QgsMapSettings::LosslessImageRendering ) );
+  painter->setRenderHint( QPainter::LosslessImageRendering, mSettings.testFlag( QgsMapSettings::LosslessImageRendering ) );
 #endif
-  }
   return painter;
 }
 
+bool QgsMapRendererJob::prepareDirtyExtentRedraw( QgsVectorLayer *layer, const QgsRectangle &dirtyExtent, const QgsFeatureIds &dirtyFeatureIds, QgsRenderContext &context, QRect &imageRect ) const
+{
+  QgsFeatureRenderer *renderer = layer->renderer();
+  if ( !renderer || ( dirtyExtent.isNull() && dirtyFeatureIds.isEmpty() ) || context.testFlag( QgsRenderContext::ApplyClipAfterReprojection ) )
+    return false;
+
+  // features are redrawn on their own, so their rendering must not depend on other features
+  const QString rendererType = renderer->type();
+  if ( rendererType != QLatin1String( "singleSymbol" )
+       && rendererType != QLatin1String( "categorizedSymbol" )
+       && rendererType != QLatin1String( "graduatedSymbol" )
+       && rendererType != QLatin1String( "RuleRenderer" ) )
+    return false;
+
+  if ( renderer->paintEffect() && renderer->paintEffect()->enabled() )
+    return false;
+
+  // layers involved in selective masking are rendered again in a second pass
+  const QList< QgsMapLayer * > layers = mSettings.layers();
+  for ( QgsMapLayer *ml : layers )
+  {
+    QgsVectorLayer *maskLayer = qobject_cast< QgsVectorLayer * >( ml );
+    if ( maskLayer && ( !QgsVectorLayerUtils::symbolLayerMasks( maskLayer ).isEmpty() || !QgsVectorLayerUtils::labelMasks( maskLayer ).isEmpty() ) )
+      return false;
+  }
+
+  // symbols and vertex markers can be drawn outside of the feature bounding boxes
+  QgsSettings settings;
+  double bleed = context.convertToPainterUnits( settings.value( QStringLiteral( "qgis/digitizing/marker_size_mm" ), 2.0 ).toDouble(), QgsUnitTypes::RenderMillimeters );
+  const QgsSymbolList symbols = renderer->symbols( context );
+  for ( QgsSymbol *symbol : symbols )
+  {
+    if ( symbol->hasDataDefinedProperties() )
+      return false;
+
+    bleed = std::max( bleed, QgsSymbolLayerUtils::estimateMaxSymbolBleed( symbol, context ) );
+    if ( symbol->type() == QgsSymbol::Marker )
+      bleed = std::max( bleed, static_cast< QgsMarkerSymbol * >( symbol )->size( context ) );
+  }
+  // antialiasing
+  bleed += 2;
+
+  // the original geometries of the edited provider features are only fetched once they are needed,
+  // in a single request rather than one per edit
+  QgsRectangle extent = dirtyExtent;
+  if ( !dirtyFeatureIds.isEmpty() )
+  {
+    if ( !layer->dataProvider() )
+      return false;
+
+    QgsFeatureIterator it = layer->dataProvider()->getFeatures( QgsFeatureRequest().setFilterFids( dirtyFeatureIds ).setNoAttributes() );
+    QgsFeature feature;
+    while ( it.nextFeature( feature ) )
+    {
+      if ( feature.hasGeometry() )
+        extent.combineExtentWith( feature.geometry().boundingBox() );
+    }
+    if ( extent.isNull() )
+      return false;
+  }
+
+  const QgsCoordinateTransform ct = context.coordinateTransform();
+  QgsRectangle mapExtent = extent;
+  try
+  {
+    if ( ct.isValid() )
+      mapExtent = ct.transformBoundingBox( extent );
+  }
+  catch ( QgsCsException & )
+  {
+    return false;
+  }
+
+  const QgsMapToPixel &mtp = mSettings.mapToPixel();
+  QPolygonF corners;
+  corners << mtp.transform( mapExtent.xMinimum(), mapExtent.yMinimum() ).toQPointF()
+          << mtp.transform( mapExtent.xMaximum(), mapExtent.yMinimum() ).toQPointF()
+          << mtp.transform( mapExtent.xMaximum(), mapExtent.yMaximum() ).toQPointF()
+          << mtp.transform( mapExtent.xMinimum(), mapExtent.yMaximum() ).toQPointF();
+  const QRectF dirtyRect = corners.boundingRect().adjusted( -bleed, -bleed, bleed, bleed );
+  imageRect = dirtyRect.toAlignedRect().intersected( QRect( QPoint( 0, 0 ), mSettings.outputSize() ) );
+
+  // features within the bleed distance of the redrawn area can also be drawn over it
+  const QRectF featuresRect = dirtyRect.adjusted( -bleed, -bleed, bleed, bleed );
+  QgsRectangle featuresExtent;
+  featuresExtent.setMinimal();
+  const QVector< QPointF > featuresCorners { featuresRect.topLeft(), featuresRect.topRight(), featuresRect.bottomLeft(), featuresRect.bottomRight() };
+  for ( const QPointF &corner : featuresCorners )
+  {
+    const QgsPointXY point = mtp.toMapCoordinates( corner.x(), corner.y() );
+    featuresExtent.combineExtentWith( point.x(), point.y() );
+  }
+
+  try
+  {
+    if ( ct.isValid() )
+      featuresExtent = ct.transformBoundingBox( featuresExtent, QgsCoordinateTransform::ReverseTransform );
+  }
+  catch ( QgsCsException & )
+  {
+    return false;
+  }
+
+  context.setExtent( featuresExtent );
+  return true;
+}
+
+bool QgsMapRendererJob::prepareTileImage( LayerRenderJob &job, const QgsCoordinateTransform &ct ) const
+{
+  QSize size;
+  const QgsRectangle tileExtent = QgsMapRendererCache::tileCacheRenderExtent( mSettings.visibleExtent(), mSettings.mapToPixel(), job.tileCacheMargin, size );
+  if ( tileExtent.isNull() )
+    return false;
+
+  QgsRectangle r1 = tileExtent, r2;
+  r1.grow( mSettings.extentBuffer() );
+  bool haveExtentInLayerCrs = true;
+  if ( ct.isValid() )
+    haveExtentInLayerCrs = reprojectToLayerExtent( job.layer, ct, r1, r2 );
+  if ( !r1.isFinite() || !r2.isFinite() )
+    return false;
+
+  std::unique_ptr< QImage > image = qgis::make_unique< QImage >( size, mSettings.outputImageFormat() );
+  if ( image->isNull() )
+    return false;
+  image->fill( 0 );
+
+  const double mapUnitsPerPixel = mSettings.mapToPixel().mapUnitsPerPixel();
+  job.context.setMapToPixel( QgsMapToPixel( mapUnitsPerPixel, tileExtent.center().x(), tileExtent.center().y(), size.width(), size.height(), 0 ) );
+  job.context.setExtent( r1 );
+  job.context.setMapExtent( tileExtent );
+  job.context.setFlag( QgsRenderContext::ApplyClipAfterReprojection, !haveExtentInLayerCrs );
+
+  job.tileImage = image.release();
+  job.tileImageExtent = tileExtent;
+  job.tileImageOffset = QPointF( ( tileExtent.xMinimum() - mSettings.visibleExtent().xMinimum() ) / mapUnitsPerPixel,
+                                 ( mSettings.visibleExtent().yMaximum() - tileExtent.yMaximum() ) / mapUnitsPerPixel );
+  return true;
+}
+
 LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter *painter, QgsLabelingEngine *labelingEngine2, bool deferredPainterSet )
 {
   LayerRenderJobs layerJobs;
@@ -332,6 +502,31 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter *painter, QgsLabelingEn
 
   bool requiresLabelRedraw = !( mCache && mCache->hasCacheImage( LABEL_CACHE_ID ) );
 
+  // layers involved in selective masking are composed in a second pass over the map image, they can't be drawn over tiles
+  QSet< QString > maskLayerIds;
+  if ( mCache && mCache->isTileCacheEnabled() )
+  {
+    const QList< QgsMapLayer * > layers = mSettings.layers();
+    for ( QgsMapLayer *layer : layers )
+    {
+      const QgsVectorLayer *vl = qobject_cast< const QgsVectorLayer * >( layer );
+      if ( !vl )
+        continue;
+
+      QList< QString > maskedLayerIds = QgsVectorLayerUtils::symbolLayerMasks( vl ).keys();
+      const QHash< QString, QHash< QString, QSet< QgsSymbolLayerId > > > labelMasks = QgsVectorLayerUtils::labelMasks( vl );
+      for ( auto it = labelMasks.constBegin(); it != labelMasks.constEnd(); ++it )
+        maskedLayerIds << it.value().keys();
+
+      if ( !maskedLayerIds.isEmpty() )
+      {
+        maskLayerIds.insert( vl->id() );
+        for ( const QString &id : qgis::as_const( maskedLayerIds ) )
+          maskLayerIds.insert( id );
+      }
+    }
+  }
+
   while ( li.hasPrevious() )
   {
     QgsMapLayer *ml = li.previous();
@@ -390,12 +585,18 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter *painter, QgsLabelingEn
 
     // Force render of layers that are being edited
     // or if there's a labeling engine that needs the layer to register features
+    bool forceRender = false;
+    bool redrawDirtyExtent = false;
     if ( mCache )
     {
       const bool requiresLabeling = ( labelingEngine2 && QgsPalLabeling::staticWillUseLayer( ml ) ) && requiresLabelRedraw;
       if ( ( vl && vl->isEditable() ) || requiresLabeling )
       {
-        mCache->clearCacheImage( ml->id() );
+        // after edits, only the area of the edited features needs to be redrawn over the cached image
+        redrawDirtyExtent = !requiresLabeling && mCache->hasDirtyCacheImage( ml->id() );
+        if ( !redrawDirtyExtent )
+          mCache->clearCacheImage( ml->id() );
+        forceRender = true;
       }
     }
 
@@ -430,18 +631,56 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter *painter, QgsLabelingEn
     // apply default opacity handling here!
     job.opacity = ml->type() != QgsMapLayerType::RasterLayer ? ml->opacity() : 1.0;
 
+    if ( mCache && !forceRender && mCache->isTileCacheEnabled() )
+      job.tileCacheScope = mCache->tileCacheScope( ml, mSettings );
+
     // if we can use the cache, let's do it and avoid rendering!
+    QImage cachedImage;
     if ( mCache && mCache->hasCacheImage( ml->id() ) )
+    {
+      cachedImage = mCache->cacheImage( ml->id() );
+    }
+    else if ( mCache && !job.tileCacheScope.isEmpty() )
+    {
+      // previously rendered area: assemble the layer image from tiles
+      cachedImage = mCache->tileCacheImage( job.tileCacheScope );
+      if ( !cachedImage.isNull() )
+        mCache->setCacheImageWithParameters( ml->id(), cachedImage, mSettings.visibleExtent(), mSettings.mapToPixel(), QList< QgsMapLayer * >() << ml );
+    }
+
+    if ( !cachedImage.isNull() )
     {
       job.cached = true;
       job.imageInitialized = true;
-      job.img = new QImage( mCache->cacheImage( ml->id() ) );
+      job.img = new QImage( cachedImage );
       job.img->setDevicePixelRatio( static_cast<qreal>( mSettings.devicePixelRatio() ) );
       job.renderer = nullptr;
       job.context.setPainter( nullptr );
       continue;
     }
 
+    if ( !job.tileCacheScope.isEmpty() )
+    {
+      job.tileCacheMargin = QgsMapRendererCache::tileCacheMargin( ml, job.context );
+      // labels, diagrams and masks are drawn over the map extent, only the layer image is drawn over tiles
+      if ( job.tileCacheMargin < 0 || maskLayerIds.contains( ml->id() ) || ( labelingEngine2 && QgsPalLabeling::staticWillUseLayer( ml ) )
+           || !qgsDoubleNear( mSettings.devicePixelRatio(), 1.0 ) || !prepareTileImage( job, ct ) )
+        job.tileCacheScope.clear();
+    }
+
+    QRect dirtyImageRect;
+    if ( redrawDirtyExtent && !prepareDirtyExtentRedraw( vl, mCache->dirtyExtent( ml->id() ), mCache->dirtyFeatureIds( ml->id() ), job.context, dirtyImageRect ) )
+    {
+      mCache->clearCacheImage( ml->id() );
+      redrawDirtyExtent = false;
+    }
+
+    if ( mSettings.testFlag( QgsMapSettings::RecordProfile ) )
+    {
+      job.profile = new QgsLayerRenderProfile( ml->id(), ml->name() );
+      job.context.setLayerRenderProfile( job.profile );
+    }
+
     QElapsedTimer layerTime;
     layerTime.start();
     job.renderer = ml->createMapRenderer( job.context );
@@ -451,14 +690,40 @@ LayerRenderJobs QgsMapRendererJob::prepareJobs( QPainter *painter, QgsLabelingEn
     // If we are drawing with an alternative blending mode then we need to render to a separate image
     // before compositing this on the map. This effectively flattens the layer and prevents
     // blending occurring between objects on the layer
-    if ( mCache || ( !painter && !deferredPainterSet ) || ( job.renderer && job.renderer->forceRasterRender() ) )
+    if ( redrawDirtyExtent )
+    {
+      job.img = new QImage( mCache->cacheImage( ml->id() ) );
+      QPainter *layerPainter = createImagePainter( job.img );
+
+      // clear the area to redraw, and make sure features do not draw outside of it
+      layerPainter->setCompositionMode( QPainter::CompositionMode_Source );
+      layerPainter->fillRect( dirtyImageRect, Qt::transparent );
+      layerPainter->setCompositionMode( QPainter::CompositionMode_SourceOver );
+      layerPainter->setClipRect( dirtyImageRect );
+
+      job.context.setPainter( layerPainter );
+      job.imageInitialized = true;
+    }
+    else if ( mCache || ( !painter && !deferredPainterSet ) || ( job.renderer && job.renderer->forceRasterRender() ) )
     {
       // Flattened image for drawing when a blending mode is set
-      job.context.setPainter( allocateImageAndPainter( ml->id(), job.img ) );
+      if ( job.tileImage )
+      {
+        job.img = allocateImage( ml->id() );
+        job.context.setPainter( job.img ? createImagePainter( job.tileImage ) : nullptr );
+      }
+      else
+      {
+        job.context.setPainter( allocateImageAndPainter( ml->id(), job.img ) );
+      }
       if ( ! job.img )
       {
         delete job.renderer;
         job.renderer = nullptr;
+        delete job.profile;
+        job.profile = nullptr;
+        delete job.tileImage;
+        job.tileImage = nullptr;
         layerJobs.removeLast();
         continue;
       }
@@ -608,6 +873,9 @@ LayerRenderJobs QgsMapRendererJob::prepareSecondPassJobs( LayerRenderJobs &first
     job2 = job;
     job2.cached = false;
     job2.firstPassJob = &job;
+    // the features are drawn again, only the first pass is profiled
+    job2.profile = nullptr;
+    job2.context.setLayerRenderProfile( nullptr );
     QgsVectorLayer *vl1 = qobject_cast<QgsVectorLayer *>( job.layer );
 
     // ... but clear the image
@@ -666,6 +934,10 @@ LabelRenderJob QgsMapRendererJob::prepareLabelingJob( QPainter *painter, QgsLabe
     {
       job.img = allocateImage( QStringLiteral( "labels" ) );
     }
+
+    // keep labels where they were in the previous render
+    if ( mCache && labelingEngine2 && mSettings.labelingEngineSettings().testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) )
+      labelingEngine2->setPreviousPlacements( mCache->labelPlacements() );
   }
 
   return job;
@@ -687,11 +959,15 @@ void QgsMapRendererJob::cleanupJobs( LayerRenderJobs &jobs )
         QgsDebugMsgLevel( QStringLiteral( "caching image for %1" ).arg( job.layerId ), 2 );
         mCache->setCacheImageWithParameters( job.layerId, *job.img, mSettings.visibleExtent(), mSettings.mapToPixel(), QList< QgsMapLayer * >() << job.layer );
         mCache->setCacheImageWithParameters( job.layerId + QStringLiteral( "_preview" ), *job.img, mSettings.visibleExtent(), mSettings.mapToPixel(), QList< QgsMapLayer * >() << job.layer );
+        if ( job.tileImage && job.tileImageCopied )
+          mCache->setTileCacheImage( job.layer, job.tileCacheScope, *job.tileImage, job.tileImageExtent, job.context.mapToPixel(), job.tileCacheMargin );
       }
 
       delete job.img;
       job.img = nullptr;
     }
+    delete job.tileImage;
+    job.tileImage = nullptr;
 
     // delete the mask image and painter
     if ( job.maskImage )
@@ -713,6 +989,15 @@ void QgsMapRendererJob::cleanupJobs( LayerRenderJobs &jobs )
 
     if ( job.layer )
       mPerLayerRenderingTime.insert( job.layer, job.renderingTime );
+
+    if ( job.profile )
+    {
+      job.profile->setTotalTime( job.renderingTime );
+      mRenderProfile.addLayer( *job.profile );
+      job.context.setLayerRenderProfile( nullptr );
+      delete job.profile;
+      job.profile = nullptr;
+    }
   }
 
   jobs.clear();
@@ -746,6 +1031,17 @@ void QgsMapRendererJob::cleanupSecondPassJobs( LayerRenderJobs &jobs )
 
 void QgsMapRendererJob::cleanupLabelJob( LabelRenderJob &job )
 {
+  if ( mCache && !job.cached && !job.context.renderingStopped() && job.context.labelingEngine()
+       && mSettings.labelingEngineSettings().testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) )
+  {
+    mCache->setLabelPlacements( job.context.labelingEngine()->placements() );
+  }
+
+  if ( mSettings.testFlag( QgsMapSettings::RecordProfile ) && !job.cached && job.context.labelingEngine() )
+  {
+    mRenderProfile.setLabeling( job.context.labelingEngine()->renderProfile() );
+  }
+
   if ( job.img )
   {
     if ( mCache && !job.cached && !job.context.renderingStopped() )
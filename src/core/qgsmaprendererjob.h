@@ -29,6 +29,8 @@
 
 #include "qgsmapsettings.h"
 #include "qgsmaskidprovider.h"
+#include "qgsrenderprofile.h"
+#include "qgsfeatureid.h"
 
 
 class QgsLabelingEngine;
@@ -36,6 +38,7 @@ class QgsLabelingResults;
 class QgsMapLayerRenderer;
 class QgsMapRendererCache;
 class QgsFeatureFilterProvider;
+class QgsVectorLayer;
 
 #ifndef SIP_RUN
 /// @cond PRIVATE
@@ -88,6 +91,68 @@ struct LayerRenderJob
    */
   int estimatedRenderingTime = 0;
 
+  /**
+   * Scope of the layer's tiles in the map renderer cache, or an empty string if the
+   * layer image should not be cached as tiles.
+   *
+   * \see QgsMapRendererCache::tileCacheScope()
+   * \since QGIS 3.18
+   */
+  QString tileCacheScope;
+
+  /**
+   * Width in pixels of the border of the layer image which is not stored as tiles, as it may
+   * miss parts of symbols of features outside the rendered extent.
+   *
+   * \see QgsMapRendererCache::tileCacheMargin()
+   * \since QGIS 3.18
+   */
+  int tileCacheMargin = 0;
+
+  /**
+   * Image of the layer over whole tiles of the map renderer cache around the map, which the layer
+   * is drawn into instead of img when its tiles are cached, or NULLPTR. Owned by the job.
+   *
+   * \see copyTileImage()
+   * \see QgsMapRendererCache::tileCacheRenderExtent()
+   * \since QGIS 3.18
+   */
+  QImage *tileImage = nullptr;
+
+  /**
+   * Map extent of tileImage.
+   *
+   * \since QGIS 3.18
+   */
+  QgsRectangle tileImageExtent;
+
+  /**
+   * Position of the top left corner of tileImage in img, in pixels.
+   *
+   * \since QGIS 3.18
+   */
+  QPointF tileImageOffset;
+
+  //! TRUE once the rendered tileImage has been copied into img
+  bool tileImageCopied = false;
+
+  /**
+   * Copies the part of tileImage covering the map into img, once the layer has been rendered.
+   * Does nothing if the layer is not drawn into a tile image.
+   *
+   * \since QGIS 3.18
+   */
+  void copyTileImage();
+
+  /**
+   * Timings of the layer render, or NULLPTR if the render is not profiled. Owned by the
+   * job, second pass jobs are never profiled.
+   *
+   * \see QgsMapSettings::RecordProfile
+   * \since QGIS 3.18
+   */
+  QgsLayerRenderProfile *profile = nullptr;
+
   QStringList errors; //!< Rendering errors
 
   /**
@@ -309,6 +374,17 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
      */
     QHash< QgsMapLayer *, int > perLayerRenderingTime() const SIP_SKIP;
 
+    /**
+     * Returns the timings and feature counts of each rendered layer and of labeling.
+     *
+     * The profile is only recorded if the QgsMapSettings::RecordProfile flag is set, and is
+     * complete once the job has finished.
+     *
+     * \see QgsMapRenderProfile::toJson()
+     * \since QGIS 3.18
+     */
+    QgsMapRenderProfile renderProfile() const { return mRenderProfile; }
+
     /**
      * Sets approximate render times (in ms) for map layers.
      *
@@ -370,6 +446,13 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
     //! Render time (in ms) per layer, by layer ID
     QHash< QgsWeakMapLayerPointer, int > mPerLayerRenderingTime;
 
+    /**
+     * Timings of the rendered layers and labeling, if QgsMapSettings::RecordProfile is set
+     *
+     * \since QGIS 3.18
+     */
+    QgsMapRenderProfile mRenderProfile;
+
     /**
      * Approximate expected layer rendering time per layer, by layer ID
      *
@@ -484,6 +567,29 @@ class CORE_EXPORT QgsMapRendererJob : public QObject
 
     //! Convenient method to allocate a new image and a new QPainter on this image
     QPainter *allocateImageAndPainter( QString layerId, QImage *&image );
+
+    //! Creates a new QPainter on \a image, with the render hints of the map settings
+    QPainter *createImagePainter( QImage *image ) const;
+
+    /**
+     * Restricts the rendering of an edited vector \a layer to the area which is affected by the
+     * features edited within \a dirtyExtent (in layer CRS) and by the original geometries of the
+     * provider features with \a dirtyFeatureIds. The extent of \a context is reduced accordingly,
+     * and the part of the layer image to redraw is stored in \a imageRect.
+     *
+     * Returns FALSE if the affected area cannot be determined, e.g. if symbol sizes are data defined.
+     */
+    bool prepareDirtyExtentRedraw( QgsVectorLayer *layer, const QgsRectangle &dirtyExtent, const QgsFeatureIds &dirtyFeatureIds, QgsRenderContext &context, QRect &imageRect ) const;
+
+    /**
+     * Sets up the layer of \a job, which has a tile cache scope and margin, to be drawn into a tile image
+     * over whole tiles of the map renderer cache, so that the tiles along the map edges can also be cached.
+     * The extent and map to pixel of the job context are set to those of the tile image, using the
+     * \a ct transform to the layer CRS.
+     *
+     * Returns FALSE if the tile image cannot be used, in which case the job is left unchanged.
+     */
+    bool prepareTileImage( LayerRenderJob &job, const QgsCoordinateTransform &ct ) const;
 };
 
 
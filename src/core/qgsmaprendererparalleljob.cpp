@@ -381,6 +381,8 @@ void QgsMapRendererParallelJob::renderLayerStatic( LayerRenderJob &job )
     QgsDebugMsg( QStringLiteral( "Caught unhandled unknown exception" ) );
   }
 
+  job.copyTileImage();
+
   job.errors = job.renderer->errors();
   job.renderingTime += t.elapsed();
   QgsDebugMsgLevel( QStringLiteral( "job %1 end [%2 ms] (layer %3)" ).arg( reinterpret_cast< quint64 >( &job ), 0, 16 ).arg( job.renderingTime ).arg( job.layerId ), 2 );
@@ -393,6 +393,9 @@ class CORE_EXPORT QgsMapSettings : public QgsTemporalRangeObject
       RenderBlocking           = 0x800, //!< Render and load remote sources in the same thread to ensure rendering remote sources (svg and images). WARNING: this flag must NEVER be used from GUI based applications (like the main QGIS application) or crashes will result. Only for use in external scripts or QGIS server.
       LosslessImageRendering   = 0x1000, //!< Render images losslessly whenever possible, instead of the default lossy jpeg rendering used for some destination devices (e.g. PDF). This flag only works with builds based on Qt 5.13 or later.
       Render3DMap              = 0x2000, //!< Render is for a 3D map
+      ParallelFeatureRendering = 0x4000, //!< Allow vector layers to split their features across worker threads, each rendering into a separate image composited in feature order. Only used for raster outputs, when the layer's renderer and blending allow it. Map canvases set it from the qgis/parallel_feature_rendering setting. Added in QGIS 3.18
+      StreamSymbolLevels       = 0x8000, //!< Draw vector layers using symbol levels as their features are fetched, into a temporary image per symbol layer, instead of keeping every feature in memory until all levels are drawn. Only used for raster outputs, when the images fit in the memory budget. Added in QGIS 3.18
+      RecordProfile            = 0x10000, //!< Record timings of the rendering stages of each layer and of labeling, see QgsMapRendererJob::renderProfile(). Added in QGIS 3.18
       // TODO: ignore scale-based visibility (overview)
     };
     Q_DECLARE_FLAGS( Flags, Flag )
@@ -71,6 +71,7 @@ QgsRenderContext::QgsRenderContext( const QgsRenderContext &rh )
   , mFeatureClipGeometry( rh.mFeatureClipGeometry )
   , mTextureOrigin( rh.mTextureOrigin )
   , mZRange( rh.mZRange )
+  , mLayerRenderProfile( rh.mLayerRenderProfile )
 #ifdef QGISDEBUG
   , mHasTransformContext( rh.mHasTransformContext )
 #endif
@@ -108,6 +109,7 @@ QgsRenderContext &QgsRenderContext::operator=( const QgsRenderContext &rh )
   mFeatureClipGeometry = rh.mFeatureClipGeometry;
   mTextureOrigin = rh.mTextureOrigin;
   mZRange = rh.mZRange;
+  mLayerRenderProfile = rh.mLayerRenderProfile;
   setIsTemporal( rh.isTemporal() );
   if ( isTemporal() )
     setTemporalRange( rh.temporalRange() );
@@ -219,6 +221,8 @@ QgsRenderContext QgsRenderContext::fromMapSettings( const QgsMapSettings &mapSet
   ctx.setFlag( RenderBlocking, mapSettings.testFlag( QgsMapSettings::RenderBlocking ) );
   ctx.setFlag( LosslessImageRendering, mapSettings.testFlag( QgsMapSettings::LosslessImageRendering ) );
   ctx.setFlag( Render3DMap, mapSettings.testFlag( QgsMapSettings::Render3DMap ) );
+  ctx.setFlag( ParallelFeatureRendering, mapSettings.testFlag( QgsMapSettings::ParallelFeatureRendering ) );
+  ctx.setFlag( StreamSymbolLevels, mapSettings.testFlag( QgsMapSettings::StreamSymbolLevels ) );
   ctx.setScaleFactor( mapSettings.outputDpi() / 25.4 ); // = pixels per mm
   ctx.setRendererScale( mapSettings.scale() );
   ctx.setExpressionContext( mapSettings.expressionContext() );
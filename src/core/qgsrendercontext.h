@@ -45,6 +45,7 @@ class QgsRenderedFeatureHandlerInterface;
 class QgsSymbolLayer;
 class QgsMaskIdProvider;
 class QgsMapClippingRegion;
+class QgsLayerRenderProfile;
 
 
 /**
@@ -86,6 +87,8 @@ class CORE_EXPORT QgsRenderContext : public QgsTemporalRangeObject
       ApplyScalingWorkaroundForTextRendering = 0x2000, //!< Whether a scaling workaround designed to stablise the rendering of small font sizes (or for painters scaled out by a large amount) when rendering text. Generally this is recommended, but it may incur some performance cost.
       Render3DMap              = 0x4000, //!< Render is for a 3D map
       ApplyClipAfterReprojection = 0x8000, //!< Feature geometry clipping to mapExtent() must be performed after the geometries are transformed using coordinateTransform(). Usually feature geometry clipping occurs using the extent() in the layer's CRS prior to geometry transformation, but in some cases when extent() could not be accurately calculated it is necessary to clip geometries to mapExtent() AFTER transforming them using coordinateTransform().
+      ParallelFeatureRendering = 0x10000, //!< Allow vector layers to split their features across worker threads, each rendering into a separate image composited in feature order. Only used for raster outputs, when the layer's renderer and blending allow it. Added in QGIS 3.18
+      StreamSymbolLevels = 0x20000, //!< Draw vector layers using symbol levels as their features are fetched, into a temporary image per symbol layer, instead of keeping every feature in memory until all levels are drawn. Only used for raster outputs, when the images fit in the memory budget. Added in QGIS 3.18
     };
     Q_DECLARE_FLAGS( Flags, Flag )
 
@@ -873,6 +876,26 @@ class CORE_EXPORT QgsRenderContext : public QgsTemporalRangeObject
      */
     void setZRange( const QgsDoubleRange &range );
 
+    /**
+     * Returns the profile collecting the timings of the layer being rendered, or NULLPTR
+     * if the render is not profiled.
+     *
+     * \see setLayerRenderProfile()
+     * \note Not available in Python bindings
+     * \since QGIS 3.18
+     */
+    QgsLayerRenderProfile *layerRenderProfile() const SIP_SKIP { return mLayerRenderProfile; }
+
+    /**
+     * Sets the \a profile collecting the timings of the layer being rendered. Ownership is
+     * not transferred and the profile must stay alive for the duration of any rendering operations.
+     *
+     * \see layerRenderProfile()
+     * \note Not available in Python bindings
+     * \since QGIS 3.18
+     */
+    void setLayerRenderProfile( QgsLayerRenderProfile *profile ) SIP_SKIP { mLayerRenderProfile = profile; }
+
   private:
 
     Flags mFlags;
@@ -971,6 +994,8 @@ class CORE_EXPORT QgsRenderContext : public QgsTemporalRangeObject
 
     QgsDoubleRange mZRange;
 
+    QgsLayerRenderProfile *mLayerRenderProfile = nullptr;
+
 #ifdef QGISDEBUG
     bool mHasTransformContext = false;
 #endif
@@ -0,0 +1,169 @@
+/***************************************************************************
+  qgsrenderprofile.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsrenderprofile.h"
+#include "qgssymbollayer.h"
+
+#include <QJsonDocument>
+
+//
+// QgsLayerRenderProfile
+//
+
+QgsLayerRenderProfile::QgsLayerRenderProfile( const QString &layerId, const QString &layerName )
+  : mLayerId( layerId )
+  , mLayerName( layerName )
+{
+}
+
+void QgsLayerRenderProfile::addSymbolLayerTime( const QString &type, qint64 nanoseconds )
+{
+  SymbolLayerTime &symbolLayer = mSymbolLayers[type];
+  symbolLayer.time += nanoseconds;
+  symbolLayer.count++;
+}
+
+void QgsLayerRenderProfile::merge( const QgsLayerRenderProfile &other )
+{
+  for ( int i = 0; i < 4; ++i )
+    mStageTimes[i] += other.mStageTimes[i];
+  mFetchedFeatureCount += other.mFetchedFeatureCount;
+  mRenderedFeatureCount += other.mRenderedFeatureCount;
+  for ( auto it = other.mSymbolLayers.constBegin(); it != other.mSymbolLayers.constEnd(); ++it )
+  {
+    SymbolLayerTime &symbolLayer = mSymbolLayers[it.key()];
+    symbolLayer.time += it.value().time;
+    symbolLayer.count += it.value().count;
+  }
+}
+
+QVariantMap QgsLayerRenderProfile::toVariantMap() const
+{
+  QVariantMap symbolLayers;
+  for ( auto it = mSymbolLayers.constBegin(); it != mSymbolLayers.constEnd(); ++it )
+  {
+    QVariantMap symbolLayer;
+    symbolLayer.insert( QStringLiteral( "time" ), it.value().time / 1e6 );
+    symbolLayer.insert( QStringLiteral( "count" ), it.value().count );
+    symbolLayers.insert( it.key(), symbolLayer );
+  }
+
+  QVariantMap map;
+  map.insert( QStringLiteral( "id" ), mLayerId );
+  map.insert( QStringLiteral( "name" ), mLayerName );
+  map.insert( QStringLiteral( "total" ), mTotalTime );
+  map.insert( QStringLiteral( "fetch" ), fetchTime() );
+  map.insert( QStringLiteral( "symbolize" ), symbolizeTime() );
+  map.insert( QStringLiteral( "paint" ), paintTime() );
+  map.insert( QStringLiteral( "label_registration" ), labelRegistrationTime() );
+  map.insert( QStringLiteral( "fetched_features" ), mFetchedFeatureCount );
+  map.insert( QStringLiteral( "rendered_features" ), mRenderedFeatureCount );
+  map.insert( QStringLiteral( "symbol_layers" ), symbolLayers );
+  return map;
+}
+
+//
+// QgsLabelingRenderProfile
+//
+
+QVariantMap QgsLabelingRenderProfile::toVariantMap() const
+{
+  QVariantMap map;
+  map.insert( QStringLiteral( "registration" ), mRegistrationTime );
+  map.insert( QStringLiteral( "candidates" ), mCandidatesTime );
+  map.insert( QStringLiteral( "solve" ), mSolveTime );
+  map.insert( QStringLiteral( "draw" ), mDrawTime );
+  map.insert( QStringLiteral( "features" ), mFeatureCount );
+  map.insert( QStringLiteral( "candidate_count" ), mCandidateCount );
+  map.insert( QStringLiteral( "labels" ), mLabelCount );
+  return map;
+}
+
+//
+// QgsMapRenderProfile
+//
+
+QgsLayerRenderProfile QgsMapRenderProfile::layer( const QString &layerId ) const
+{
+  for ( const QgsLayerRenderProfile &profile : mLayers )
+  {
+    if ( profile.layerId() == layerId )
+      return profile;
+  }
+  return QgsLayerRenderProfile();
+}
+
+void QgsMapRenderProfile::setLabeling( const QgsLabelingRenderProfile &profile )
+{
+  mLabeling = profile;
+  mHasLabeling = true;
+}
+
+QVariantMap QgsMapRenderProfile::toVariantMap() const
+{
+  QVariantList layers;
+  for ( const QgsLayerRenderProfile &profile : mLayers )
+    layers << profile.toVariantMap();
+
+  QVariantMap map;
+  map.insert( QStringLiteral( "layers" ), layers );
+  if ( mHasLabeling )
+    map.insert( QStringLiteral( "labeling" ), mLabeling.toVariantMap() );
+  return map;
+}
+
+QString QgsMapRenderProfile::toJson() const
+{
+  return QString::fromUtf8( QJsonDocument::fromVariant( toVariantMap() ).toJson( QJsonDocument::Indented ) );
+}
+
+//
+// QgsScopedLayerRenderProfile
+//
+
+QgsScopedLayerRenderProfile::QgsScopedLayerRenderProfile( QgsLayerRenderProfile *profile, QgsLayerRenderProfile::Stage stage )
+  : mProfile( profile )
+  , mStage( stage )
+{
+  if ( mProfile )
+    mTimer.start();
+}
+
+QgsScopedLayerRenderProfile::QgsScopedLayerRenderProfile( QgsLayerRenderProfile *profile, const QgsSymbolLayer *symbolLayer )
+  : mProfile( profile )
+  , mStage( QgsLayerRenderProfile::SymbolLayerPaint )
+  , mSymbolLayer( symbolLayer )
+{
+  if ( mProfile )
+  {
+    mProfile->mSymbolLayerDepth++;
+    mTimer.start();
+  }
+}
+
+QgsScopedLayerRenderProfile::~QgsScopedLayerRenderProfile()
+{
+  if ( !mProfile )
+    return;
+
+  const qint64 elapsed = mTimer.nsecsElapsed();
+  if ( mSymbolLayer )
+  {
+    mProfile->addSymbolLayerTime( mSymbolLayer->layerType(), elapsed );
+    // symbol layers of sub symbols are already included in their parent's time
+    if ( --mProfile->mSymbolLayerDepth > 0 )
+      return;
+  }
+  mProfile->addTime( mStage, elapsed );
+}
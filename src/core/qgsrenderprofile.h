@@ -0,0 +1,424 @@
+/***************************************************************************
+  qgsrenderprofile.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSRENDERPROFILE_H
+#define QGSRENDERPROFILE_H
+
+#include "qgis_core.h"
+#include "qgis_sip.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariantMap>
+
+#include <algorithm>
+
+class QgsSymbolLayer;
+
+/**
+ * \ingroup core
+ * \class QgsLayerRenderProfile
+ * \brief Timings and feature counts collected while rendering a map layer.
+ *
+ * Vector layer renderers split the time spent on features into:
+ *
+ * - fetching features from the data provider, see fetchTime()
+ * - symbolizing features: choosing symbols, evaluating data defined properties and
+ *   transforming and clipping geometries, see symbolizeTime()
+ * - painting symbol layers, see paintTime() and symbolLayerTime()
+ * - registering features for labeling and diagrams, see labelRegistrationTime()
+ *
+ * When features are drawn by several threads (see QgsMapSettings::ParallelFeatureRendering),
+ * the times of all threads are summed up, so they can exceed totalTime().
+ *
+ * Profiles are only collected when the QgsMapSettings::RecordProfile flag is set.
+ *
+ * \see QgsMapRenderProfile
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsLayerRenderProfile
+{
+  public:
+
+    //! Measured stages of a layer render
+    enum Stage
+    {
+      FeatureFetch, //!< Fetching features from the layer's data source
+      FeatureRender, //!< Drawing features with the layer's renderer, including symbol layer painting
+      SymbolLayerPaint, //!< Painting symbol layers
+      LabelRegistration, //!< Registering features with label and diagram providers
+    };
+
+    /**
+     * Constructor for an empty QgsLayerRenderProfile.
+     */
+    QgsLayerRenderProfile() = default;
+
+    /**
+     * Constructor for QgsLayerRenderProfile, for the layer with the specified \a layerId and \a layerName.
+     */
+    QgsLayerRenderProfile( const QString &layerId, const QString &layerName );
+
+    /**
+     * Returns the ID of the profiled layer.
+     */
+    QString layerId() const { return mLayerId; }
+
+    /**
+     * Returns the name of the profiled layer.
+     */
+    QString layerName() const { return mLayerName; }
+
+    /**
+     * Returns the total time it took to render the layer, in milliseconds.
+     * \see setTotalTime()
+     */
+    double totalTime() const { return mTotalTime; }
+
+    /**
+     * Sets the total time it took to render the layer, in milliseconds.
+     * \see totalTime()
+     */
+    void setTotalTime( double time ) { mTotalTime = time; }
+
+    /**
+     * Returns the time spent fetching features from the layer's data source, in milliseconds.
+     */
+    double fetchTime() const { return mStageTimes[FeatureFetch] / 1e6; }
+
+    /**
+     * Returns the time spent by the layer's renderer on features outside of symbol layer painting,
+     * in milliseconds. This includes symbol choice, data defined property evaluation and geometry
+     * transformation and clipping.
+     */
+    double symbolizeTime() const { return std::max< qint64 >( mStageTimes[FeatureRender] - mStageTimes[SymbolLayerPaint], 0 ) / 1e6; }
+
+    /**
+     * Returns the time spent painting symbol layers, in milliseconds.
+     *
+     * Symbol layers drawn by other symbol layers (e.g. markers of a marker line) are only
+     * counted once, as part of their parent symbol layer.
+     *
+     * \see symbolLayerTime()
+     */
+    double paintTime() const { return mStageTimes[SymbolLayerPaint] / 1e6; }
+
+    /**
+     * Returns the time spent registering features with label and diagram providers, in milliseconds.
+     */
+    double labelRegistrationTime() const { return mStageTimes[LabelRegistration] / 1e6; }
+
+    /**
+     * Returns the number of features fetched from the layer's data source.
+     */
+    long long fetchedFeatureCount() const { return mFetchedFeatureCount; }
+
+    /**
+     * Returns the number of features drawn by the layer's renderer.
+     */
+    long long renderedFeatureCount() const { return mRenderedFeatureCount; }
+
+    /**
+     * Returns the types of the painted symbol layers (e.g. "SimpleMarker").
+     * \see symbolLayerTime()
+     */
+    QStringList symbolLayerTypes() const { return mSymbolLayers.keys(); }
+
+    /**
+     * Returns the time spent painting symbol layers of the specified \a type, in milliseconds.
+     *
+     * Unlike paintTime(), the time of symbol layers of a sub symbol is also counted for
+     * their own type.
+     *
+     * \see symbolLayerTypes()
+     * \see symbolLayerPaintCount()
+     */
+    double symbolLayerTime( const QString &type ) const { return mSymbolLayers.value( type ).time / 1e6; }
+
+    /**
+     * Returns the number of times symbol layers of the specified \a type were painted.
+     * \see symbolLayerTime()
+     */
+    long long symbolLayerPaintCount( const QString &type ) const { return mSymbolLayers.value( type ).count; }
+
+    /**
+     * Adds \a nanoseconds to the time spent on a \a stage.
+     */
+    void addTime( Stage stage, qint64 nanoseconds ) SIP_SKIP { mStageTimes[stage] += nanoseconds; }
+
+    /**
+     * Adds \a count fetched features.
+     */
+    void addFetchedFeatures( long long count ) SIP_SKIP { mFetchedFeatureCount += count; }
+
+    /**
+     * Adds \a count features drawn by the renderer.
+     */
+    void addRenderedFeatures( long long count ) SIP_SKIP { mRenderedFeatureCount += count; }
+
+    /**
+     * Adds a paint of a symbol layer of the specified \a type which took \a nanoseconds.
+     */
+    void addSymbolLayerTime( const QString &type, qint64 nanoseconds ) SIP_SKIP;
+
+    /**
+     * Adds the timings and counts of \a other, e.g. collected by a separate thread rendering part of the layer.
+     */
+    void merge( const QgsLayerRenderProfile &other ) SIP_SKIP;
+
+    /**
+     * Returns the profile as a map, suitable for JSON serialization. Times are in milliseconds.
+     */
+    QVariantMap toVariantMap() const;
+
+  private:
+
+    struct SymbolLayerTime
+    {
+      qint64 time = 0;
+      long long count = 0;
+    };
+
+    QString mLayerId;
+    QString mLayerName;
+    double mTotalTime = 0;
+    qint64 mStageTimes[4] = { 0, 0, 0, 0 };
+    long long mFetchedFeatureCount = 0;
+    long long mRenderedFeatureCount = 0;
+    QMap< QString, SymbolLayerTime > mSymbolLayers;
+
+    //! Number of symbol layers being painted, used to count nested symbol layers once in the paint time
+    int mSymbolLayerDepth = 0;
+
+    friend class QgsScopedLayerRenderProfile;
+};
+
+/**
+ * \ingroup core
+ * \class QgsLabelingRenderProfile
+ * \brief Timings and counts collected by a QgsLabelingEngine for a map render.
+ *
+ * \see QgsMapRenderProfile
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsLabelingRenderProfile
+{
+  public:
+
+    /**
+     * Returns the time spent preparing label providers and their features for placement, in milliseconds.
+     */
+    double registrationTime() const { return mRegistrationTime; }
+
+    /**
+     * Sets the time spent preparing label providers and their features for placement, in milliseconds.
+     */
+    void setRegistrationTime( double time ) { mRegistrationTime = time; }
+
+    /**
+     * Returns the time spent generating label candidates, in milliseconds.
+     */
+    double candidatesTime() const { return mCandidatesTime; }
+
+    /**
+     * Sets the time spent generating label candidates, in milliseconds.
+     */
+    void setCandidatesTime( double time ) { mCandidatesTime = time; }
+
+    /**
+     * Returns the time spent solving label conflicts, in milliseconds.
+     */
+    double solveTime() const { return mSolveTime; }
+
+    /**
+     * Sets the time spent solving label conflicts, in milliseconds.
+     */
+    void setSolveTime( double time ) { mSolveTime = time; }
+
+    /**
+     * Returns the time spent drawing labels, in milliseconds.
+     */
+    double drawTime() const { return mDrawTime; }
+
+    /**
+     * Sets the time spent drawing labels, in milliseconds.
+     */
+    void setDrawTime( double time ) { mDrawTime = time; }
+
+    /**
+     * Returns the number of features with label candidates.
+     */
+    int featureCount() const { return mFeatureCount; }
+
+    /**
+     * Sets the number of features with label candidates.
+     */
+    void setFeatureCount( int count ) { mFeatureCount = count; }
+
+    /**
+     * Returns the total number of label candidates.
+     */
+    int candidateCount() const { return mCandidateCount; }
+
+    /**
+     * Sets the total number of label candidates.
+     */
+    void setCandidateCount( int count ) { mCandidateCount = count; }
+
+    /**
+     * Returns the number of placed labels.
+     */
+    int labelCount() const { return mLabelCount; }
+
+    /**
+     * Sets the number of placed labels.
+     */
+    void setLabelCount( int count ) { mLabelCount = count; }
+
+    /**
+     * Returns the profile as a map, suitable for JSON serialization. Times are in milliseconds.
+     */
+    QVariantMap toVariantMap() const;
+
+  private:
+
+    double mRegistrationTime = 0;
+    double mCandidatesTime = 0;
+    double mSolveTime = 0;
+    double mDrawTime = 0;
+    int mFeatureCount = 0;
+    int mCandidateCount = 0;
+    int mLabelCount = 0;
+};
+
+/**
+ * \ingroup core
+ * \class QgsMapRenderProfile
+ * \brief Timings and counts collected by a QgsMapRendererJob for each rendered layer and for labeling.
+ *
+ * Profiles are only collected when the QgsMapSettings::RecordProfile flag is set, and
+ * are retrieved with QgsMapRendererJob::renderProfile() once the job is finished. Unlike
+ * a profiler, this can be enabled in production to find which layers and styles are
+ * expensive to render.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsMapRenderProfile
+{
+  public:
+
+    /**
+     * Returns TRUE if no layer or labeling timings were recorded.
+     */
+    bool isEmpty() const { return mLayers.isEmpty() && !mHasLabeling; }
+
+    /**
+     * Returns the profiles of the rendered layers, in rendering order.
+     * Layers drawn from a cached image are not included.
+     */
+    QList< QgsLayerRenderProfile > layers() const { return mLayers; }
+
+    /**
+     * Returns the profile of the layer with the specified \a layerId, or an empty profile if the layer was not rendered.
+     */
+    QgsLayerRenderProfile layer( const QString &layerId ) const;
+
+    /**
+     * Adds the \a profile of a rendered layer.
+     */
+    void addLayer( const QgsLayerRenderProfile &profile ) { mLayers << profile; }
+
+    /**
+     * Returns TRUE if the labeling profile was recorded.
+     * \see labeling()
+     */
+    bool hasLabeling() const { return mHasLabeling; }
+
+    /**
+     * Returns the labeling profile.
+     * \see hasLabeling()
+     */
+    QgsLabelingRenderProfile labeling() const { return mLabeling; }
+
+    /**
+     * Sets the labeling \a profile.
+     */
+    void setLabeling( const QgsLabelingRenderProfile &profile );
+
+    /**
+     * Returns the profile as a map, suitable for JSON serialization. Times are in milliseconds.
+     * \see toJson()
+     */
+    QVariantMap toVariantMap() const;
+
+    /**
+     * Returns the profile as an indented JSON document. Times are in milliseconds.
+     * \see toVariantMap()
+     */
+    QString toJson() const;
+
+  private:
+
+    QList< QgsLayerRenderProfile > mLayers;
+    QgsLabelingRenderProfile mLabeling;
+    bool mHasLabeling = false;
+};
+
+#ifndef SIP_RUN
+
+/**
+ * \ingroup core
+ * \class QgsScopedLayerRenderProfile
+ * \brief Scoped object adding the time elapsed during its lifetime to a QgsLayerRenderProfile.
+ *
+ * Nothing is measured if the profile is NULLPTR, so the object can be placed on
+ * rendering code paths without checking whether profiling is enabled.
+ *
+ * \note Not available in Python bindings
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsScopedLayerRenderProfile
+{
+  public:
+
+    /**
+     * Measures a \a stage of the layer render, adding to \a profile.
+     */
+    QgsScopedLayerRenderProfile( QgsLayerRenderProfile *profile, QgsLayerRenderProfile::Stage stage );
+
+    /**
+     * Measures the painting of a \a symbolLayer, adding to \a profile.
+     */
+    QgsScopedLayerRenderProfile( QgsLayerRenderProfile *profile, const QgsSymbolLayer *symbolLayer );
+
+    ~QgsScopedLayerRenderProfile();
+
+    //! QgsScopedLayerRenderProfile cannot be copied
+    QgsScopedLayerRenderProfile( const QgsScopedLayerRenderProfile &other ) = delete;
+    //! QgsScopedLayerRenderProfile cannot be copied
+    QgsScopedLayerRenderProfile &operator=( const QgsScopedLayerRenderProfile &other ) = delete;
+
+  private:
+
+    QgsLayerRenderProfile *mProfile = nullptr;
+    QgsLayerRenderProfile::Stage mStage = QgsLayerRenderProfile::FeatureRender;
+    const QgsSymbolLayer *mSymbolLayer = nullptr;
+    QElapsedTimer mTimer;
+};
+
+#endif
+
+#endif // QGSRENDERPROFILE_H
@@ -85,6 +85,29 @@ class CORE_EXPORT QgsVectorSimplifyMethod
     //! Gets the maximum scale at which the layer should be simplified
     inline float maximumScale() const { return mMaximumScale; }
 
+    /**
+     * Sets whether simplified copies of the layer's geometries should be cached for rendering.
+     *
+     * When enabled, several levels of simplified geometries are built in the background the
+     * first time features of the layer are requested, and used instead of the provider's
+     * full resolution geometries when rendering at small scales. This benefits line and
+     * polygon layers with detailed geometries such as coastlines or boundaries, at the cost of
+     * keeping the simplified geometries and the attributes of all features in memory.
+     * The cache is not used for point layers and while the layer is being edited.
+     *
+     * \see cacheSimplifiedGeometries()
+     * \since QGIS 3.18
+     */
+    void setCacheSimplifiedGeometries( bool enabled ) { mCacheSimplifiedGeometries = enabled; }
+
+    /**
+     * Returns whether simplified copies of the layer's geometries should be cached for rendering.
+     *
+     * \see setCacheSimplifiedGeometries()
+     * \since QGIS 3.18
+     */
+    inline bool cacheSimplifiedGeometries() const { return mCacheSimplifiedGeometries; }
+
   private:
     //! Simplification hints for fast rendering of features of the vector layer managed
     SimplifyHints mSimplifyHints;
@@ -98,6 +121,8 @@ class CORE_EXPORT QgsVectorSimplifyMethod
     bool mLocalOptimization = true;
     //! Maximum scale at which the layer should be simplified (Maximum scale at which generalisation should be carried out)
     float mMaximumScale = 1;
+    //! Whether simplified geometries are cached for rendering
+    bool mCacheSimplifiedGeometries = false;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsVectorSimplifyMethod::SimplifyHints )
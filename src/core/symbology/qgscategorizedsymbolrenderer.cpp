@@ -185,6 +185,7 @@ QgsCategorizedSymbolRenderer::~QgsCategorizedSymbolRenderer() = default;
 void QgsCategorizedSymbolRenderer::rebuildHash()
 {
   mSymbolHash.clear();
+  mIntegerSymbolHash.clear();
 
   for ( const QgsRendererCategory &cat : qgis::as_const( mCategories ) )
   {
@@ -194,16 +195,28 @@ void QgsCategorizedSymbolRenderer::rebuildHash()
       const QVariantList list = val.toList();
       for ( const QVariant &v : list )
       {
-        mSymbolHash.insert( v.toString(), ( cat.renderState() || mCounting ) ? cat.symbol() : nullptr );
+        insertHashedSymbol( v.toString(), ( cat.renderState() || mCounting ) ? cat.symbol() : nullptr );
       }
     }
     else
     {
-      mSymbolHash.insert( val.toString(), ( cat.renderState() || mCounting ) ? cat.symbol() : nullptr );
+      insertHashedSymbol( val.toString(), ( cat.renderState() || mCounting ) ? cat.symbol() : nullptr );
     }
   }
 }
 
+void QgsCategorizedSymbolRenderer::insertHashedSymbol( const QString &key, QgsSymbol *symbol )
+{
+  mSymbolHash.insert( key, symbol );
+
+  // keys which are the string of an integer are also hashed by number, so that integer values
+  // can be looked up without converting them to strings
+  bool ok = false;
+  const qlonglong number = key.toLongLong( &ok );
+  if ( ok && QString::number( number ) == key )
+    mIntegerSymbolHash.insert( number, symbol );
+}
+
 QgsSymbol *QgsCategorizedSymbolRenderer::skipRender()
 {
   return nullptr;
@@ -219,7 +232,31 @@ QgsSymbol *QgsCategorizedSymbolRenderer::symbolForValue( const QVariant &value,
 {
   foundMatchingSymbol = false;
 
-  // TODO: special case for int, double
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    {
+      if ( value.isNull() )
+        break;
+
+      // all the keys which are the string of an integer are in the integer hash
+      QHash<qlonglong, QgsSymbol *>::const_iterator it = mIntegerSymbolHash.constFind( value.toLongLong() );
+      if ( it == mIntegerSymbolHash.constEnd() )
+      {
+        QgsDebugMsgLevel( "attribute value not found: " + value.toString(), 3 );
+        return nullptr;
+      }
+
+      foundMatchingSymbol = true;
+      return *it;
+    }
+
+    default:
+      break;
+  }
+
   QHash<QString, QgsSymbol *>::const_iterator it = mSymbolHash.constFind( value.isNull() ? QString() : value.toString() );
   if ( it == mSymbolHash.constEnd() )
   {
@@ -489,6 +489,12 @@ class CORE_EXPORT QgsCategorizedSymbolRenderer : public QgsFeatureRenderer
     QgsCategorizedSymbolRenderer &operator=( const QgsCategorizedSymbolRenderer & );
 #endif
 
+    //! Symbols of the hashed category values which are the string of an integer, by number
+    QHash<qlonglong, QgsSymbol *> mIntegerSymbolHash;
+
+    //! Adds a category value \a key to the symbol hashes
+    void insertHashedSymbol( const QString &key, QgsSymbol *symbol );
+
     //! Returns calculated classification value for a feature
     QVariant valueForFeature( const QgsFeature &feature, QgsRenderContext &context ) const;
 
@@ -18,6 +18,8 @@
 
 #include <ctime>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 #include "qgsgraduatedsymbolrenderer.h"
 
@@ -74,6 +76,32 @@ QgsGraduatedSymbolRenderer::~QgsGraduatedSymbolRenderer()
 
 const QgsRendererRange *QgsGraduatedSymbolRenderer::rangeForValue( double value ) const
 {
+  if ( !mRangeBounds.empty() )
+  {
+    // ranges are sorted and do not overlap: the first bound which is not below the value is the upper
+    // bound of the first range containing the value, or the lower bound of a range starting at the value
+    auto bound = std::lower_bound( mRangeBounds.begin(), mRangeBounds.end(), value );
+    std::size_t index = bound - mRangeBounds.begin();
+    if ( bound == mRangeBounds.end() || ( index % 2 == 0 && *bound != value ) )
+    {
+      // second chance -- the first bound within double tolerance of the value
+      const double epsilon = 4 * std::numeric_limits<double>::epsilon();
+      bound = std::partition_point( mRangeBounds.begin(), mRangeBounds.end(), [value, epsilon]( double b )
+      {
+        return !( b - value > -epsilon );
+      } );
+      index = bound - mRangeBounds.begin();
+      if ( bound == mRangeBounds.end() || !qgsDoubleNear( *bound, value ) )
+        return nullptr;
+    }
+
+    const QgsRendererRange &range = mRanges.at( static_cast< int >( index / 2 ) );
+    if ( range.renderState() || mCounting )
+      return &range;
+    else
+      return nullptr;
+  }
+
   for ( const QgsRendererRange &range : mRanges )
   {
     if ( range.lowerValue() <= value && range.upperValue() >= value )
@@ -179,6 +207,22 @@ void QgsGraduatedSymbolRenderer::startRender( QgsRenderContext &context, const Q
 
     range.symbol()->startRender( context, fields );
   }
+
+  // ranges sorted by value which do not overlap are looked up with a binary search over their bounds
+  mRangeBounds.clear();
+  mRangeBounds.reserve( 2 * static_cast< std::size_t >( mRanges.size() ) );
+  for ( const QgsRendererRange &range : qgis::as_const( mRanges ) )
+  {
+    const double lower = range.lowerValue();
+    const double upper = range.upperValue();
+    if ( std::isnan( lower ) || std::isnan( upper ) || lower > upper || ( !mRangeBounds.empty() && lower < mRangeBounds.back() ) )
+    {
+      mRangeBounds.clear();
+      break;
+    }
+    mRangeBounds.push_back( lower );
+    mRangeBounds.push_back( upper );
+  }
 }
 
 void QgsGraduatedSymbolRenderer::stopRender( QgsRenderContext &context )
@@ -192,6 +236,7 @@ void QgsGraduatedSymbolRenderer::stopRender( QgsRenderContext &context )
 
     range.symbol()->stopRender( context );
   }
+  mRangeBounds.clear();
 }
 
 QSet<QString> QgsGraduatedSymbolRenderer::usedAttributes( const QgsRenderContext &context ) const
@@ -21,6 +21,7 @@
 #include "qgsrenderer.h"
 #include "qgsrendererrange.h"
 #include "qgsclassificationmethod.h"
+#include <vector>
 
 class QgsVectorLayer;
 class QgsColorRamp;
@@ -468,6 +469,9 @@ class CORE_EXPORT QgsGraduatedSymbolRenderer : public QgsFeatureRenderer
 
   private:
 
+    //! Lower and upper bounds of the ranges while rendering, empty if the ranges are not sorted or overlap
+    std::vector< double > mRangeBounds;
+
     /**
      * Returns calculated value used for classifying a feature.
      */
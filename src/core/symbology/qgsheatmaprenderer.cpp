@@ -31,6 +31,14 @@
 
 #include <QDomDocument>
 #include <QDomElement>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <numeric>
+
+//! Number of points collected before their kernels are added to the values
+static const std::size_t POINT_BATCH_SIZE = 16384;
 
 QgsHeatmapRenderer::QgsHeatmapRenderer()
   : QgsFeatureRenderer( QStringLiteral( "heatmapRenderer" ) )
@@ -51,6 +59,8 @@ void QgsHeatmapRenderer::initializeValues( QgsRenderContext &context )
   mFeaturesRendered = 0;
   mRadiusPixels = std::round( context.convertToPainterUnits( mRadius, mRadiusUnit, mRadiusMapUnitScale ) / mRenderQuality );
   mRadiusSquared = mRadiusPixels * mRadiusPixels;
+  mPendingPoints.clear();
+  updateStencil();
 }
 
 void QgsHeatmapRenderer::startRender( QgsRenderContext &context, const QgsFields &fields )
@@ -127,9 +137,6 @@ bool QgsHeatmapRenderer::renderFeature( const QgsFeature &feature, QgsRenderCont
     }
   }
 
-  int width = context.painter()->device()->width() / mRenderQuality;
-  int height = context.painter()->device()->height() / mRenderQuality;
-
   //transform geometry if required
   QgsGeometry geom = feature.geometry();
   QgsCoordinateTransform xform = context.coordinateTransform();
@@ -141,41 +148,18 @@ bool QgsHeatmapRenderer::renderFeature( const QgsFeature &feature, QgsRenderCont
   //convert point to multipoint
   QgsMultiPointXY multiPoint = convertToMultipoint( &geom );
 
-  //loop through all points in multipoint
+  //loop through all points in multipoint, their kernels are added in batches
   for ( QgsMultiPointXY::const_iterator pointIt = multiPoint.constBegin(); pointIt != multiPoint.constEnd(); ++pointIt )
   {
     QgsPointXY pixel = context.mapToPixel().transform( *pointIt );
     int pointX = pixel.x() / mRenderQuality;
     int pointY = pixel.y() / mRenderQuality;
-    for ( int x = std::max( pointX - mRadiusPixels, 0 ); x < std::min( pointX + mRadiusPixels, width ); ++x )
-    {
-      if ( context.renderingStopped() )
-        break;
-
-      for ( int y = std::max( pointY - mRadiusPixels, 0 ); y < std::min( pointY + mRadiusPixels, height ); ++y )
-      {
-        int index = y * width + x;
-        if ( index >= mValues.count() )
-        {
-          continue;
-        }
-        double distanceSquared = std::pow( pointX - x, 2.0 ) + std::pow( pointY - y, 2.0 );
-        if ( distanceSquared > mRadiusSquared )
-        {
-          continue;
-        }
-
-        double score = weight * quarticKernel( std::sqrt( distanceSquared ), mRadiusPixels );
-        double value = mValues.at( index ) + score;
-        if ( value > mCalculatedMaxValue )
-        {
-          mCalculatedMaxValue = value;
-        }
-        mValues[ index ] = value;
-      }
-    }
+    mPendingPoints.push_back( PendingPoint{ pointX, pointY, weight } );
   }
 
+  if ( mPendingPoints.size() >= POINT_BATCH_SIZE )
+    addPendingPoints( context );
+
   mFeaturesRendered++;
 #if 0
   //TODO - enable progressive rendering
@@ -215,10 +199,125 @@ double QgsHeatmapRenderer::triangularKernel( const double distance, const int ba
   return ( 1. - ( distance / static_cast< double >( bandwidth ) ) );
 }
 
+void QgsHeatmapRenderer::updateStencil()
+{
+  if ( mStencilRadius == mRadiusPixels )
+    return;
+
+  mStencilRadius = mRadiusPixels;
+  mStencil.clear();
+  mStencilColumns.clear();
+  if ( mRadiusPixels <= 0 )
+    return;
+
+  // the kernel only depends on the offset between the pixel and the point, both in whole pixels
+  const int size = 2 * mRadiusPixels;
+  mStencil.assign( static_cast< std::size_t >( size ) * size, 0 );
+  mStencilColumns.assign( size, std::make_pair( size, -1 ) );
+  for ( int row = 0; row < size; ++row )
+  {
+    const int dy = row - mRadiusPixels;
+    for ( int column = 0; column < size; ++column )
+    {
+      const int dx = column - mRadiusPixels;
+      double distanceSquared = std::pow( -dx, 2.0 ) + std::pow( -dy, 2.0 );
+      if ( distanceSquared > mRadiusSquared )
+      {
+        continue;
+      }
+
+      mStencil[ static_cast< std::size_t >( row ) * size + column ] = quarticKernel( std::sqrt( distanceSquared ), mRadiusPixels );
+      mStencilColumns[ row ].first = std::min( mStencilColumns[ row ].first, column );
+      mStencilColumns[ row ].second = std::max( mStencilColumns[ row ].second, column );
+    }
+  }
+}
+
+void QgsHeatmapRenderer::addPendingPoints( QgsRenderContext &context )
+{
+  if ( mPendingPoints.empty() )
+    return;
+
+  if ( context.renderingStopped() || mStencil.empty() )
+  {
+    mPendingPoints.clear();
+    return;
+  }
+
+  const int width = context.painter()->device()->width() / mRenderQuality;
+  const int height = context.painter()->device()->height() / mRenderQuality;
+  const int valueCount = mValues.count();
+  double *values = mValues.data();
+
+  // bands of rows do not overlap, and the points of each band are added in order, so the values
+  // are the same as when adding one point after the other
+  const int bandCount = std::min( height, 2 * QThreadPool::globalInstance()->maxThreadCount() );
+  if ( bandCount <= 1 )
+  {
+    mCalculatedMaxValue = addPendingPointsToRows( values, valueCount, width, height, 0, height, mCalculatedMaxValue );
+  }
+  else
+  {
+    struct Band
+    {
+      int startRow;
+      int endRow;
+      double maximum;
+    };
+    std::vector< Band > bands;
+    const int bandHeight = ( height + bandCount - 1 ) / bandCount;
+    for ( int row = 0; row < height; row += bandHeight )
+      bands.push_back( Band{ row, std::min( row + bandHeight, height ), mCalculatedMaxValue } );
+
+    QtConcurrent::blockingMap( bands, [this, values, valueCount, width, height]( Band & band )
+    {
+      band.maximum = addPendingPointsToRows( values, valueCount, width, height, band.startRow, band.endRow, band.maximum );
+    } );
+
+    for ( const Band &band : bands )
+      mCalculatedMaxValue = std::max( mCalculatedMaxValue, band.maximum );
+  }
+
+  mPendingPoints.clear();
+}
+
+double QgsHeatmapRenderer::addPendingPointsToRows( double *values, int valueCount, int width, int height, int startRow, int endRow, double maximum ) const
+{
+  const int size = 2 * mStencilRadius;
+  for ( const PendingPoint &point : mPendingPoints )
+  {
+    const int firstRow = std::max( std::max( point.y - mStencilRadius, 0 ), startRow );
+    const int lastRow = std::min( std::min( point.y + mStencilRadius, height ), endRow );
+    const int firstColumn = std::max( point.x - mStencilRadius, 0 );
+    const int lastColumn = std::min( point.x + mStencilRadius, width );
+    for ( int y = firstRow; y < lastRow; ++y )
+    {
+      const int stencilRow = y - point.y + mStencilRadius;
+      const double *kernel = mStencil.data() + static_cast< std::size_t >( stencilRow ) * size;
+      const int xStart = std::max( firstColumn, point.x - mStencilRadius + mStencilColumns[ stencilRow ].first );
+      const int xEnd = std::min( { lastColumn, point.x - mStencilRadius + mStencilColumns[ stencilRow ].second + 1, valueCount - y * width } );
+      for ( int x = xStart; x < xEnd; ++x )
+      {
+        const int index = y * width + x;
+        double score = point.weight * kernel[ x - point.x + mStencilRadius ];
+        double value = values[ index ] + score;
+        if ( value > maximum )
+        {
+          maximum = value;
+        }
+        values[ index ] = value;
+      }
+    }
+  }
+  return maximum;
+}
+
 void QgsHeatmapRenderer::stopRender( QgsRenderContext &context )
 {
   QgsFeatureRenderer::stopRender( context );
 
+  if ( context.painter() )
+    addPendingPoints( context );
   renderImage( context );
   mWeightExpression.reset();
 }
@@ -237,26 +336,47 @@ void QgsHeatmapRenderer::renderImage( QgsRenderContext &context )
 
   double scaleMax = mExplicitMax > 0 ? mExplicitMax : mCalculatedMaxValue;
 
-  int idx = 0;
-  double pixVal = 0;
-  QColor pixColor;
-  for ( int heightIndex = 0; heightIndex < image.height(); ++heightIndex )
+  // most pixels are usually empty, so the color of empty pixels is only calculated once
+  const QRgb emptyColor = mGradientRamp->color( 0 ).rgba();
+  const int width = image.width();
+  const double *values = mValues.constData();
+  uchar *bits = image.bits();
+  const int bytesPerLine = image.bytesPerLine();
+  QgsColorRamp *ramp = mGradientRamp;
+  auto colorizeRow = [ =, &context ]( int heightIndex )
   {
     if ( context.renderingStopped() )
-      break;
+      return;
 
-    QRgb *scanLine = reinterpret_cast< QRgb * >( image.scanLine( heightIndex ) );
-    for ( int widthIndex = 0; widthIndex < image.width(); ++widthIndex )
+    QRgb *scanLine = reinterpret_cast< QRgb * >( bits + static_cast< std::size_t >( heightIndex ) * bytesPerLine );
+    int idx = heightIndex * width;
+    for ( int widthIndex = 0; widthIndex < width; ++widthIndex, ++idx )
     {
+      if ( !( values[ idx ] > 0 ) )
+      {
+        scanLine[widthIndex] = emptyColor;
+        continue;
+      }
+
       //scale result to fit in the range [0, 1]
-      pixVal = mValues.at( idx ) > 0 ? std::min( ( mValues.at( idx ) / scaleMax ), 1.0 ) : 0;
+      const double pixVal = std::min( ( values[ idx ] / scaleMax ), 1.0 );
 
       //convert value to color from ramp
-      pixColor = mGradientRamp->color( pixVal );
-
-      scanLine[widthIndex] = pixColor.rgba();
-      idx++;
+      scanLine[widthIndex] = ramp->color( pixVal ).rgba();
     }
+  };
+
+  // gradient ramps have no state, other ramps (e.g. random ramps) are only used from this thread
+  std::vector< int > rows( image.height() );
+  std::iota( rows.begin(), rows.end(), 0 );
+  if ( mGradientRamp->type() == QgsGradientColorRamp::typeString() && QThreadPool::globalInstance()->maxThreadCount() > 1 )
+  {
+    QtConcurrent::blockingMap( rows, colorizeRow );
+  }
+  else
+  {
+    for ( int heightIndex : rows )
+      colorizeRow( heightIndex );
   }
 
   if ( mRenderQuality > 1 )
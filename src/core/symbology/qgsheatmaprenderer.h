@@ -22,6 +22,8 @@
 #include "qgsexpression.h"
 #include "qgsgeometry.h"
 
+#include <vector>
+
 class QgsColorRamp;
 
 /**
@@ -208,9 +210,40 @@ class CORE_EXPORT QgsHeatmapRenderer : public QgsFeatureRenderer
     double epanechnikovKernel( double distance, int bandwidth ) const;
     double triangularKernel( double distance, int bandwidth ) const;
 
+#ifndef SIP_RUN
+    //! A point waiting to be added to the values, in pixels of the value grid
+    struct PendingPoint
+    {
+      int x;
+      int y;
+      double weight;
+    };
+#endif
+
+    //! Points which have not been added to the values yet
+    std::vector< PendingPoint > mPendingPoints;
+
+    //! Radius in pixels of the cached kernel stencil
+    int mStencilRadius = -1;
+    //! Kernel values for pixel offsets from -radius to radius - 1, row by row
+    std::vector< double > mStencil;
+    //! Range of stencil columns within the radius, for each stencil row
+    std::vector< std::pair< int, int > > mStencilColumns;
+
     QgsMultiPointXY convertToMultipoint( const QgsGeometry *geom );
     void initializeValues( QgsRenderContext &context );
     void renderImage( QgsRenderContext &context );
+
+    //! Calculates the kernel stencil for the current radius, if required
+    void updateStencil();
+    //! Adds the pending points to the values, splitting the grid in bands of rows processed in parallel
+    void addPendingPoints( QgsRenderContext &context );
+
+    /**
+     * Adds the kernels of the pending points to the rows from \a startRow (inclusive) to \a endRow (exclusive)
+     * of \a values, and returns the maximum of the updated values and \a maximum.
+     */
+    double addPendingPointsToRows( double *values, int valueCount, int width, int height, int startRow, int endRow, double maximum ) const;
 };
 
 
@@ -1164,6 +1164,25 @@ void QgsSimpleMarkerSymbolLayer::renderPoint( QPointF point, QgsSymbolRenderCont
   }
 }
 
+bool QgsSimpleMarkerSymbolLayer::prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset )
+{
+  // the cached images are only used when the marker does not depend on the feature
+  if ( !mUsingCache || !qgsDoubleNear( mCachedOpacity, context.opacity() ) || mDataDefinedProperties.hasActiveProperties() )
+    return false;
+
+  image = context.selected() ? mSelCache : mCache;
+  const double s = image.width();
+
+  bool hasDataDefinedSize = false;
+  const double scaledSize = calculateSize( context, hasDataDefinedSize );
+
+  bool hasDataDefinedRotation = false;
+  double angle = 0;
+  calculateOffsetAndRotation( context, scaledSize, hasDataDefinedRotation, offset, angle );
+  offset -= QPointF( s / 2.0, s / 2.0 );
+  return true;
+}
+
 QVariantMap QgsSimpleMarkerSymbolLayer::properties() const
 {
   QVariantMap map;
@@ -2227,6 +2246,51 @@ void QgsSvgMarkerSymbolLayer::renderPoint( QPointF point, QgsSymbolRenderContext
   context.renderContext().setPainterFlagsUsingContext( p );
 }
 
+bool QgsSvgMarkerSymbolLayer::prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset )
+{
+  // same as the image path of renderPoint(), for markers which do not depend on the feature
+  if ( mDataDefinedProperties.hasActiveProperties() || !mParameters.isEmpty() || context.renderContext().forceVectorOutput() )
+    return false;
+
+  bool hasDataDefinedSize = false;
+  const double scaledWidth = calculateSize( context, hasDataDefinedSize );
+  const double width = context.renderContext().convertToPainterUnits( scaledWidth, mSizeUnit, mSizeMapUnitScale );
+  if ( static_cast< int >( width ) < 1 || 10000.0 < width )
+    return false;
+
+  bool hasDataDefinedAspectRatio = false;
+  const double aspectRatio = calculateAspectRatio( context, scaledWidth, hasDataDefinedAspectRatio );
+  const double scaledHeight = scaledWidth * ( !qgsDoubleNear( aspectRatio, 0.0 ) ? aspectRatio : mDefaultAspectRatio );
+
+  QPointF outputOffset;
+  double angle = 0.0;
+  calculateOffsetAndRotation( context, scaledWidth, scaledHeight, outputOffset, angle );
+  if ( !qgsDoubleNear( angle, 0 ) )
+    return false;
+
+  const double strokeWidth = context.renderContext().convertToPainterUnits( mStrokeWidth, mStrokeWidthUnit, mStrokeWidthMapUnitScale );
+  const QColor fillColor = context.selected() && mHasFillParam ? context.renderContext().selectionColor() : mColor;
+
+  bool fitsInCache = true;
+  image = QgsApplication::svgCache()->svgAsImage( mPath, width, fillColor, mStrokeColor, strokeWidth,
+          context.renderContext().scaleFactor(), fitsInCache, aspectRatio,
+          ( context.renderContext().flags() & QgsRenderContext::RenderBlocking ) );
+  if ( !fitsInCache || image.width() <= 1 )
+    return false;
+
+  if ( context.selected() )
+    QgsImageOperation::adjustHueSaturation( image, 1.0, context.renderContext().selectionColor(), 1.0 );
+
+  if ( !qgsDoubleNear( context.opacity(), 1.0 ) )
+  {
+    image = image.copy();
+    QgsSymbolLayerUtils::multiplyImageOpacity( &image, context.opacity() );
+  }
+
+  offset = outputOffset - QPointF( image.width() / 2.0, image.height() / 2.0 );
+  return true;
+}
+
 double QgsSvgMarkerSymbolLayer::calculateSize( QgsSymbolRenderContext &context, bool &hasDataDefinedSize ) const
 {
   double scaledSize = mSize;
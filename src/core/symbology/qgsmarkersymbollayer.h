@@ -242,6 +242,7 @@ class CORE_EXPORT QgsSimpleMarkerSymbolLayer : public QgsSimpleMarkerSymbolLayer
     QString layerType() const override;
     void startRender( QgsSymbolRenderContext &context ) override;
     void renderPoint( QPointF point, QgsSymbolRenderContext &context ) override;
+    bool prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset ) override SIP_SKIP;
     QVariantMap properties() const override;
     QgsSimpleMarkerSymbolLayer *clone() const override SIP_FACTORY;
     void writeSldMarker( QDomDocument &doc, QDomElement &element, const QVariantMap &props ) const override;
@@ -521,6 +522,7 @@ class CORE_EXPORT QgsSvgMarkerSymbolLayer : public QgsMarkerSymbolLayer
     void stopRender( QgsSymbolRenderContext &context ) override;
 
     void renderPoint( QPointF point, QgsSymbolRenderContext &context ) override;
+    bool prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset ) override SIP_SKIP;
 
     QVariantMap properties() const override;
     bool usesMapUnits() const override;
@@ -14,6 +14,7 @@
  ***************************************************************************/
 
 #include "qgsrulebasedrenderer.h"
+#include "qgsrulebasedrendererfilterindex_p.h"
 #include "qgssymbollayer.h"
 #include "qgsexpression.h"
 #include "qgssymbollayerutils.h"
@@ -414,6 +415,8 @@ void QgsRuleBasedRenderer::Rule::toSld( QDomDocument &doc, QDomElement &element,
 bool QgsRuleBasedRenderer::Rule::startRender( QgsRenderContext &context, const QgsFields &fields, QString &filter )
 {
   mActiveChildren.clear();
+  mIndexedChildren.clear();
+  mChildFilterIndex.reset();
 
   if ( ! mIsActive )
     return false;
@@ -431,18 +434,39 @@ bool QgsRuleBasedRenderer::Rule::startRender( QgsRenderContext &context, const Q
   // init children
   // build temporary list of active rules (usable with this scale)
   QStringList subfilters;
+  // non else children processed by renderFeature(). Without else rules, children which are not
+  // active cannot render anything and are skipped
+  QList< QgsExpression * > childFilters;
+  int elseChildCount = 0;
   const auto constMChildren = mChildren;
   for ( Rule *rule : constMChildren )
   {
     QString subfilter;
-    if ( rule->startRender( context, fields, subfilter ) )
+    const bool active = rule->startRender( context, fields, subfilter );
+    if ( active )
     {
       // only add those which are active with current scale
       mActiveChildren.append( rule );
       subfilters.append( subfilter );
     }
+
+    if ( rule->isElse() )
+      elseChildCount++;
+    else if ( active || !mElseRules.isEmpty() )
+    {
+      mIndexedChildren.append( rule );
+      childFilters.append( rule->mFilter.get() );
+    }
   }
 
+  // index the filters of these children, so that each feature is only tested against the
+  // children whose filter may match it
+  std::unique_ptr< QgsRuleBasedRendererFilterIndex > childFilterIndex = qgis::make_unique< QgsRuleBasedRendererFilterIndex >( childFilters, fields );
+  if ( childFilterIndex->indexedFilterCount() > 0 || mIndexedChildren.count() < mChildren.count() - elseChildCount )
+    mChildFilterIndex = std::move( childFilterIndex );
+  else
+    mIndexedChildren.clear();
+
   // subfilters (on the same level) are joined with OR
   // Finally they are joined with their parent (this) with AND
   QString sf;
@@ -584,18 +608,36 @@ QgsRuleBasedRenderer::Rule::RenderResult QgsRuleBasedRenderer::Rule::renderFeatu
   bool willrendersomething = false;
 
   // process children
-  const auto constMChildren = mChildren;
-  for ( Rule *rule : constMChildren )
+  if ( mChildFilterIndex )
   {
-    // Don't process else rules yet
-    if ( !rule->isElse() )
+    // only the children whose filter may match the feature, the filter of the others is false
+    const QVector< bool > &candidates = mChildFilterIndex->candidates( featToRender.feat );
+    for ( int i = 0; i < mIndexedChildren.count(); ++i )
     {
-      RenderResult res = rule->renderFeature( featToRender, context, renderQueue );
+      if ( !candidates.at( i ) )
+        continue;
+
+      RenderResult res = mIndexedChildren.at( i )->renderFeature( featToRender, context, renderQueue );
       // consider inactive items as "rendered" so the else rule will ignore them
       willrendersomething |= ( res == Rendered || res == Inactive );
       rendered |= ( res == Rendered );
     }
   }
+  else
+  {
+    const auto constMChildren = mChildren;
+    for ( Rule *rule : constMChildren )
+    {
+      // Don't process else rules yet
+      if ( !rule->isElse() )
+      {
+        RenderResult res = rule->renderFeature( featToRender, context, renderQueue );
+        // consider inactive items as "rendered" so the else rule will ignore them
+        willrendersomething |= ( res == Rendered || res == Inactive );
+        rendered |= ( res == Rendered );
+      }
+    }
+  }
 
   // If none of the rules passed then we jump into the else rules and process them.
   if ( !willrendersomething )
@@ -733,6 +775,8 @@ void QgsRuleBasedRenderer::Rule::stopRender( QgsRenderContext &context )
   }
 
   mActiveChildren.clear();
+  mIndexedChildren.clear();
+  mChildFilterIndex.reset();
   mSymbolNormZLevels.clear();
 }
 
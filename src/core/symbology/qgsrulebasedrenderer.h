@@ -25,6 +25,7 @@
 #include "qgsrenderer.h"
 
 class QgsExpression;
+class QgsRuleBasedRendererFilterIndex;
 
 class QgsCategorizedSymbolRenderer;
 class QgsGraduatedSymbolRenderer;
@@ -473,6 +474,9 @@ class CORE_EXPORT QgsRuleBasedRenderer : public QgsFeatureRenderer
         // temporary while rendering
         QSet<int> mSymbolNormZLevels;
         RuleList mActiveChildren;
+        //! Non else children processed by renderFeature() when their filters are indexed
+        RuleList mIndexedChildren;
+        std::unique_ptr< QgsRuleBasedRendererFilterIndex > mChildFilterIndex;
 
         /**
          * Check which child rules are else rules and update the internal list of else rules
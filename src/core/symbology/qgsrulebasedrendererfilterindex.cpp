@@ -0,0 +1,401 @@
+/***************************************************************************
+  qgsrulebasedrendererfilterindex.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgsrulebasedrendererfilterindex_p.h"
+#include "qgsexpression.h"
+#include "qgsexpressionnodeimpl.h"
+
+#include <cmath>
+
+///@cond PRIVATE
+
+// integral values above this cannot all be represented as doubles, which expressions compare numbers as
+static const double MAX_INTEGRAL_KEY = 9007199254740992.0;
+
+bool QgsRuleBasedRendererFilterIndex::Range::contains( double value ) const
+{
+  if ( includeMinimum ? value < minimum : value <= minimum )
+    return false;
+  if ( includeMaximum ? value > maximum : value >= maximum )
+    return false;
+  return true;
+}
+
+QgsRuleBasedRendererFilterIndex::QgsRuleBasedRendererFilterIndex( const QList<QgsExpression *> &filters, const QgsFields &fields )
+  : mUnrestricted( filters.count(), true )
+  , mCandidates( filters.count(), true )
+{
+  QHash< int, int > fieldIndexes;
+  for ( int i = 0; i < filters.count(); ++i )
+  {
+    const QgsExpression *filter = filters.at( i );
+    Condition condition;
+    if ( !filter || !filter->rootNode() || !analyse( filter->rootNode(), fields, condition ) )
+      continue;
+
+    auto it = fieldIndexes.constFind( condition.field );
+    if ( it == fieldIndexes.constEnd() )
+    {
+      it = fieldIndexes.insert( condition.field, mFields.count() );
+      FieldIndex index;
+      index.field = condition.field;
+      mFields.append( index );
+    }
+    FieldIndex &index = mFields[ it.value()];
+
+    if ( condition.isRange )
+    {
+      condition.range.filter = i;
+      index.ranges.append( condition.range );
+    }
+    else
+    {
+      for ( qint64 number : qgis::as_const( condition.numbers ) )
+        index.numbers[ number ].append( i );
+      for ( const QString &string : qgis::as_const( condition.strings ) )
+        index.strings[ string ].append( i );
+    }
+    index.filters.append( i );
+    mUnrestricted[ i ] = false;
+    mIndexedFilterCount++;
+  }
+}
+
+const QVector<bool> &QgsRuleBasedRendererFilterIndex::candidates( const QgsFeature &feature )
+{
+  if ( !feature.isValid() )
+  {
+    // field references evaluate to NULL, leave it to the filters
+    mCandidates.fill( true );
+    return mCandidates;
+  }
+
+  mCandidates = mUnrestricted;
+  for ( const FieldIndex &index : qgis::as_const( mFields ) )
+    markCandidates( index, feature.attribute( index.field ) );
+  return mCandidates;
+}
+
+void QgsRuleBasedRendererFilterIndex::markCandidates( const FieldIndex &index, const QVariant &value )
+{
+  // comparisons with NULL are never true
+  if ( value.isNull() )
+    return;
+
+  double number = 0;
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+      number = value.toDouble();
+      if ( !std::isfinite( number ) )
+      {
+        markAll( index.filters );
+        return;
+      }
+      break;
+
+    case QVariant::String:
+    {
+      const QString string = value.toString();
+      auto it = index.strings.constFind( string );
+      if ( it != index.strings.constEnd() )
+        markAll( it.value() );
+
+      // strings which are not numbers are compared as strings to the range bounds
+      bool ok = false;
+      number = string.toDouble( &ok );
+      if ( !ok || !std::isfinite( number ) )
+      {
+        for ( const Range &range : index.ranges )
+          mCandidates[ range.filter ] = true;
+        return;
+      }
+      break;
+    }
+
+    default:
+      markAll( index.filters );
+      return;
+  }
+
+  qint64 key = 0;
+  if ( !index.numbers.isEmpty() && integralKey( number, key ) )
+  {
+    auto it = index.numbers.constFind( key );
+    if ( it != index.numbers.constEnd() )
+      markAll( it.value() );
+  }
+  for ( const Range &range : index.ranges )
+  {
+    if ( range.contains( number ) )
+      mCandidates[ range.filter ] = true;
+  }
+}
+
+void QgsRuleBasedRendererFilterIndex::markAll( const QVector<int> &filters )
+{
+  for ( int filter : filters )
+    mCandidates[ filter ] = true;
+}
+
+bool QgsRuleBasedRendererFilterIndex::integralKey( double value, qint64 &key )
+{
+  // numbers are equal for expressions when they are nearly equal
+  const double rounded = std::round( value );
+  if ( std::fabs( rounded ) > MAX_INTEGRAL_KEY || std::fabs( value - rounded ) > 1e-6 )
+    return false;
+  key = static_cast< qint64 >( rounded );
+  return true;
+}
+
+void QgsRuleBasedRendererFilterIndex::collectConjuncts( const QgsExpressionNode *node, QList<const QgsExpressionNode *> &conjuncts )
+{
+  if ( node->nodeType() == QgsExpressionNode::ntBinaryOperator )
+  {
+    const QgsExpressionNodeBinaryOperator *binary = static_cast< const QgsExpressionNodeBinaryOperator * >( node );
+    if ( binary->op() == QgsExpressionNodeBinaryOperator::boAnd )
+    {
+      collectConjuncts( binary->opLeft(), conjuncts );
+      collectConjuncts( binary->opRight(), conjuncts );
+      return;
+    }
+  }
+  conjuncts << node;
+}
+
+bool QgsRuleBasedRendererFilterIndex::constantValue( const QgsExpressionNode *node, QVariant &value )
+{
+  if ( node->nodeType() == QgsExpressionNode::ntLiteral )
+  {
+    value = static_cast< const QgsExpressionNodeLiteral * >( node )->value();
+    return true;
+  }
+
+  if ( node->nodeType() == QgsExpressionNode::ntUnaryOperator )
+  {
+    const QgsExpressionNodeUnaryOperator *unary = static_cast< const QgsExpressionNodeUnaryOperator * >( node );
+    if ( unary->op() != QgsExpressionNodeUnaryOperator::uoMinus || unary->operand()->nodeType() != QgsExpressionNode::ntLiteral )
+      return false;
+
+    const QVariant operand = static_cast< const QgsExpressionNodeLiteral * >( unary->operand() )->value();
+    switch ( operand.type() )
+    {
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+      case QVariant::Double:
+        if ( operand.isNull() )
+          return false;
+        value = QVariant( -operand.toDouble() );
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+  return false;
+}
+
+bool QgsRuleBasedRendererFilterIndex::addKey( const QVariant &value, Condition &condition )
+{
+  double number = 0;
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+      number = value.toDouble();
+      break;
+
+    case QVariant::String:
+    {
+      // strings which can be converted to numbers are compared as numbers to numeric values
+      // and as strings to other strings: the number key covers both
+      const QString string = value.toString();
+      bool ok = false;
+      number = string.toDouble( &ok );
+      if ( !ok || !std::isfinite( number ) )
+      {
+        condition.strings << string;
+        return true;
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  if ( !std::isfinite( number ) || std::floor( number ) != number || std::fabs( number ) > MAX_INTEGRAL_KEY )
+    return false;
+
+  condition.numbers << static_cast< qint64 >( number );
+  return true;
+}
+
+bool QgsRuleBasedRendererFilterIndex::analyse( const QgsExpressionNode *node, const QgsFields &fields, Condition &condition )
+{
+  QList< const QgsExpressionNode * > conjuncts;
+  collectConjuncts( node, conjuncts );
+
+  Condition range;
+  range.isRange = true;
+  for ( const QgsExpressionNode *conjunct : qgis::as_const( conjuncts ) )
+  {
+    if ( conjunct->nodeType() == QgsExpressionNode::ntInOperator )
+    {
+      const QgsExpressionNodeInOperator *in = static_cast< const QgsExpressionNodeInOperator * >( conjunct );
+      if ( in->isNotIn() || in->node()->nodeType() != QgsExpressionNode::ntColumnRef )
+        continue;
+
+      const int field = fields.lookupField( static_cast< const QgsExpressionNodeColumnRef * >( in->node() )->name() );
+      if ( field < 0 )
+        continue;
+
+      Condition keys;
+      keys.field = field;
+      bool valid = true;
+      const QList< QgsExpressionNode * > values = in->list()->list();
+      for ( const QgsExpressionNode *valueNode : values )
+      {
+        QVariant value;
+        if ( !constantValue( valueNode, value ) )
+        {
+          valid = false;
+          break;
+        }
+        // NULL list items never match
+        if ( !value.isNull() && !addKey( value, keys ) )
+        {
+          valid = false;
+          break;
+        }
+      }
+      if ( valid )
+      {
+        condition = keys;
+        return true;
+      }
+      continue;
+    }
+
+    if ( conjunct->nodeType() != QgsExpressionNode::ntBinaryOperator )
+      continue;
+
+    const QgsExpressionNodeBinaryOperator *binary = static_cast< const QgsExpressionNodeBinaryOperator * >( conjunct );
+    QgsExpressionNodeBinaryOperator::BinaryOperator op = binary->op();
+    const QgsExpressionNode *column = binary->opLeft();
+    const QgsExpressionNode *constant = binary->opRight();
+    if ( column->nodeType() != QgsExpressionNode::ntColumnRef )
+    {
+      std::swap( column, constant );
+      // constant < field is field > constant
+      switch ( op )
+      {
+        case QgsExpressionNodeBinaryOperator::boLT:
+          op = QgsExpressionNodeBinaryOperator::boGT;
+          break;
+        case QgsExpressionNodeBinaryOperator::boGT:
+          op = QgsExpressionNodeBinaryOperator::boLT;
+          break;
+        case QgsExpressionNodeBinaryOperator::boLE:
+          op = QgsExpressionNodeBinaryOperator::boGE;
+          break;
+        case QgsExpressionNodeBinaryOperator::boGE:
+          op = QgsExpressionNodeBinaryOperator::boLE;
+          break;
+        default:
+          break;
+      }
+    }
+
+    QVariant value;
+    if ( column->nodeType() != QgsExpressionNode::ntColumnRef || !constantValue( constant, value ) )
+      continue;
+
+    const int field = fields.lookupField( static_cast< const QgsExpressionNodeColumnRef * >( column )->name() );
+    if ( field < 0 )
+      continue;
+
+    if ( op == QgsExpressionNodeBinaryOperator::boEQ )
+    {
+      Condition keys;
+      keys.field = field;
+      // comparisons with NULL are never true, leave an empty list of keys
+      if ( value.isNull() || addKey( value, keys ) )
+      {
+        condition = keys;
+        return true;
+      }
+      continue;
+    }
+
+    if ( op != QgsExpressionNodeBinaryOperator::boLT && op != QgsExpressionNodeBinaryOperator::boLE
+         && op != QgsExpressionNodeBinaryOperator::boGT && op != QgsExpressionNodeBinaryOperator::boGE )
+      continue;
+
+    // only numeric bounds, strings are compared as strings to non numeric values
+    switch ( value.type() )
+    {
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+      case QVariant::Double:
+        break;
+      default:
+        continue;
+    }
+    const double bound = value.toDouble();
+    if ( value.isNull() || !std::isfinite( bound ) )
+      continue;
+
+    // ranges on the first compared field are combined
+    if ( range.field < 0 )
+      range.field = field;
+    else if ( range.field != field )
+      continue;
+
+    const bool inclusive = op == QgsExpressionNodeBinaryOperator::boLE || op == QgsExpressionNodeBinaryOperator::boGE;
+    if ( op == QgsExpressionNodeBinaryOperator::boGT || op == QgsExpressionNodeBinaryOperator::boGE )
+    {
+      if ( bound > range.range.minimum || ( bound == range.range.minimum && !inclusive ) )
+      {
+        range.range.minimum = bound;
+        range.range.includeMinimum = inclusive;
+      }
+    }
+    else if ( bound < range.range.maximum || ( bound == range.range.maximum && !inclusive ) )
+    {
+      range.range.maximum = bound;
+      range.range.includeMaximum = inclusive;
+    }
+  }
+
+  if ( range.field < 0 )
+    return false;
+
+  condition = range;
+  return true;
+}
+
+///@endcond
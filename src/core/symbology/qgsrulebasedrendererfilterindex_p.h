@@ -0,0 +1,142 @@
+/***************************************************************************
+  qgsrulebasedrendererfilterindex_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSRULEBASEDRENDERERFILTERINDEX_PRIVATE_H
+#define QGSRULEBASEDRENDERERFILTERINDEX_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_core.h"
+#include "qgsfeature.h"
+#include "qgsfields.h"
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <limits>
+
+class QgsExpression;
+class QgsExpressionNode;
+
+/**
+ * \ingroup core
+ * \brief Finds the rule filters which may be true for a feature without evaluating them.
+ *
+ * Each filter is analysed once for a condition on a single field which must hold for the
+ * filter to be true: a comparison of the field with a constant, an IN list of constants
+ * or a range of numeric constants, possibly combined with other conditions using AND.
+ * Filters with such a condition are indexed by field, in hashes of the compared values
+ * and lists of ranges, so that for each feature the attribute value of an indexed field
+ * is read once and only looked up.
+ *
+ * The index only rules out filters which cannot be true for a feature, the candidate
+ * filters must still be evaluated. Filters which cannot be analysed, and all filters
+ * restricted by a field whose value has a type the index does not handle, are always
+ * candidates.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsRuleBasedRendererFilterIndex
+{
+  public:
+
+    /**
+     * Analyses a list of \a filters, which may contain NULLPTR for rules without a filter.
+     * Field references are resolved against \a fields.
+     */
+    QgsRuleBasedRendererFilterIndex( const QList< QgsExpression * > &filters, const QgsFields &fields );
+
+    //! Returns the number of filters restricted by the index
+    int indexedFilterCount() const { return mIndexedFilterCount; }
+
+    /**
+     * Returns for each filter whether it may be true for a \a feature. Filters flagged
+     * FALSE are certainly not true for the feature.
+     */
+    const QVector< bool > &candidates( const QgsFeature &feature );
+
+  private:
+
+    //! Numeric range a field value must be in, bounds are ignored when infinite
+    struct Range
+    {
+      int filter = -1;
+      double minimum = -std::numeric_limits< double >::infinity();
+      bool includeMinimum = false;
+      double maximum = std::numeric_limits< double >::infinity();
+      bool includeMaximum = false;
+
+      bool contains( double value ) const;
+    };
+
+    struct FieldIndex
+    {
+      int field = -1;
+      //! Filters by integral numeric value they compare the field to
+      QHash< qint64, QVector< int > > numbers;
+      //! Filters by string value, for strings which cannot be converted to numbers
+      QHash< QString, QVector< int > > strings;
+      QVector< Range > ranges;
+      //! All the filters restricted by the field
+      QVector< int > filters;
+    };
+
+    //! Condition found for a filter
+    struct Condition
+    {
+      int field = -1;
+      bool isRange = false;
+      QList< qint64 > numbers;
+      QStringList strings;
+      Range range;
+    };
+
+    //! Looks for a condition in the AND chain starting at \a node, returns FALSE if there is none
+    static bool analyse( const QgsExpressionNode *node, const QgsFields &fields, Condition &condition );
+    //! Collects the operands of the AND chain starting at \a node
+    static void collectConjuncts( const QgsExpressionNode *node, QList< const QgsExpressionNode * > &conjuncts );
+    //! Retrieves the value of a literal, possibly negated, node
+    static bool constantValue( const QgsExpressionNode *node, QVariant &value );
+    //! Adds \a value to the keys of \a condition, returns FALSE if it cannot be indexed
+    static bool addKey( const QVariant &value, Condition &condition );
+    //! Returns TRUE if \a value is close enough to an integral number to be looked up, set in \a key
+    static bool integralKey( double value, qint64 &key );
+
+    void markCandidates( const FieldIndex &index, const QVariant &value );
+    void markAll( const QVector< int > &filters );
+
+    QVector< FieldIndex > mFields;
+    //! Candidates when no field value is known, only filters which are not indexed
+    QVector< bool > mUnrestricted;
+    QVector< bool > mCandidates;
+    int mIndexedFilterCount = 0;
+};
+
+/// @endcond
+
+#endif // QGSRULEBASEDRENDERERFILTERINDEX_PRIVATE_H
@@ -33,6 +33,7 @@
 #include "qgsmaptopixelgeometrysimplifier.h"
 #include "qgslogger.h"
 #include "qgsrendercontext.h" // for bigSymbolPreview
+#include "qgsrenderprofile.h"
 #include "qgsproject.h"
 #include "qgsstyle.h"
 #include "qgspainteffect.h"
@@ -772,6 +773,8 @@ void QgsSymbol::renderUsingLayer( QgsSymbolLayer *layer, QgsSymbolRenderContext
   if ( layer->dataDefinedProperties().hasActiveProperties() && !layer->dataDefinedProperties().valueAsBool( QgsSymbolLayer::PropertyLayerEnabled, context.renderContext().expressionContext(), true ) )
     return;
 
+  QgsScopedLayerRenderProfile profile( context.renderContext().layerRenderProfile(), layer );
+
   QgsGeometryGeneratorSymbolLayer *generatorLayer = static_cast<QgsGeometryGeneratorSymbolLayer *>( layer );
 
   QgsPaintEffect *effect = generatorLayer->paintEffect();
@@ -1958,6 +1961,8 @@ void QgsMarkerSymbol::renderPointUsingLayer( QgsMarkerSymbolLayer *layer, QPoint
   if ( layer->dataDefinedProperties().hasActiveProperties() && !layer->dataDefinedProperties().valueAsBool( QgsSymbolLayer::PropertyLayerEnabled, context.renderContext().expressionContext(), true ) )
     return;
 
+  QgsScopedLayerRenderProfile profile( context.renderContext().layerRenderProfile(), layer );
+
   QgsPaintEffect *effect = layer->paintEffect();
   if ( effect && effect->enabled() )
   {
@@ -2015,6 +2020,80 @@ void QgsMarkerSymbol::renderPoint( QPointF point, const QgsFeature *f, QgsRender
   }
 }
 
+///@cond PRIVATE
+
+//! Marker image prepared by a symbol layer, see QgsMarkerSymbol::renderPoints()
+struct QgsPreparedMarkerImage
+{
+  QgsMarkerSymbolLayer *layer;
+  QImage image;
+  QPointF offset;
+};
+
+static bool prepareMarkerImages( const QgsSymbolLayerList &layers, QgsSymbolRenderContext &symbolContext, QVector< QgsPreparedMarkerImage > &images )
+{
+  for ( QgsSymbolLayer *symbolLayer : layers )
+  {
+    if ( !symbolLayer->enabled() || !symbolContext.renderContext().isSymbolLayerEnabled( symbolLayer ) )
+      continue;
+
+    if ( symbolLayer->type() != QgsSymbol::Marker || ( symbolLayer->paintEffect() && symbolLayer->paintEffect()->enabled() ) )
+      return false;
+
+    QgsPreparedMarkerImage markerImage;
+    markerImage.layer = static_cast< QgsMarkerSymbolLayer * >( symbolLayer );
+    if ( !markerImage.layer->prepareMarkerImage( symbolContext, markerImage.image, markerImage.offset ) )
+      return false;
+
+    images << markerImage;
+  }
+  return true;
+}
+
+///@endcond
+
+bool QgsMarkerSymbol::canRenderPointsAsImages( QgsRenderContext &context, bool selected )
+{
+  if ( hasDataDefinedProperties() )
+    return false;
+
+  QgsSymbolRenderContext symbolContext( context, QgsUnitTypes::RenderUnknownUnit, mOpacity, selected, mRenderHints );
+  QVector< QgsPreparedMarkerImage > images;
+  return prepareMarkerImages( mLayers, symbolContext, images );
+}
+
+void QgsMarkerSymbol::renderPoints( const QPolygonF &points, QgsRenderContext &context, bool selected )
+{
+  QPainter *painter = context.painter();
+  QgsSymbolRenderContext symbolContext( context, QgsUnitTypes::RenderUnknownUnit, mOpacity, selected, mRenderHints );
+  QVector< QgsPreparedMarkerImage > images;
+  if ( !painter || hasDataDefinedProperties() || !prepareMarkerImages( mLayers, symbolContext, images ) )
+  {
+    for ( QPointF point : points )
+    {
+      if ( context.renderingStopped() )
+        break;
+
+      renderPoint( point, nullptr, context, -1, selected );
+    }
+    return;
+  }
+
+  // layers are drawn in turn at each point, like renderPoint() would
+  QgsLayerRenderProfile *profile = context.layerRenderProfile();
+  for ( QPointF point : points )
+  {
+    if ( context.renderingStopped() )
+      break;
+
+    for ( const QgsPreparedMarkerImage &markerImage : qgis::as_const( images ) )
+    {
+      QgsScopedLayerRenderProfile layerProfile( profile, markerImage.layer );
+      painter->drawImage( point + markerImage.offset, markerImage.image );
+    }
+  }
+}
+
 QRectF QgsMarkerSymbol::bounds( QPointF point, QgsRenderContext &context, const QgsFeature &feature ) const
 {
   QgsSymbolRenderContext symbolContext( context, QgsUnitTypes::RenderUnknownUnit, mOpacity, false, mRenderHints, &feature, feature.fields() );
@@ -2279,6 +2358,8 @@ void QgsLineSymbol::renderPolylineUsingLayer( QgsLineSymbolLayer *layer, const Q
   if ( layer->dataDefinedProperties().hasActiveProperties() && !layer->dataDefinedProperties().valueAsBool( QgsSymbolLayer::PropertyLayerEnabled, context.renderContext().expressionContext(), true ) )
     return;
 
+  QgsScopedLayerRenderProfile profile( context.renderContext().layerRenderProfile(), layer );
+
   QgsPaintEffect *effect = layer->paintEffect();
   if ( effect && effect->enabled() )
   {
@@ -2360,6 +2441,8 @@ void QgsFillSymbol::renderPolygonUsingLayer( QgsSymbolLayer *layer, const QPolyg
   if ( layer->dataDefinedProperties().hasActiveProperties() && !layer->dataDefinedProperties().valueAsBool( QgsSymbolLayer::PropertyLayerEnabled, context.renderContext().expressionContext(), true ) )
     return;
 
+  QgsScopedLayerRenderProfile profile( context.renderContext().layerRenderProfile(), layer );
+
   QgsSymbol::SymbolType layertype = layer->type();
 
   QgsPaintEffect *effect = layer->paintEffect();
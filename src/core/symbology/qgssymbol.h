@@ -1172,6 +1172,38 @@ class CORE_EXPORT QgsMarkerSymbol : public QgsSymbol
      */
     void renderPoint( QPointF point, const QgsFeature *f, QgsRenderContext &context, int layer = -1, bool selected = false );
 
+    /**
+     * Returns TRUE if renderPoints() can draw the symbol from prerendered marker images in the given
+     * render \a context, i.e. all points rendered with the symbol look the same.
+     *
+     * This is the case when the symbol has no data defined properties and all its enabled symbol layers
+     * can prepare a marker image without a paint effect (see QgsMarkerSymbolLayer::prepareMarkerImage()),
+     * such as simple and SVG markers.
+     *
+     * If \a selected is TRUE then the symbol is checked for the "selected feature" style.
+     *
+     * Must be called between startRender() and stopRender().
+     *
+     * \since QGIS 3.18
+     */
+    bool canRenderPointsAsImages( QgsRenderContext &context, bool selected = false );
+
+    /**
+     * Renders the symbol at each of the specified \a points, using the given render \a context.
+     *
+     * When canRenderPointsAsImages() is TRUE the marker image of each symbol layer is prepared once
+     * and drawn at every point, which is much faster than rendering the points one by one. Otherwise
+     * each point is rendered with renderPoint(), without an associated feature.
+     *
+     * If \a selected is TRUE then the symbol will be drawn using the "selected feature"
+     * style and colors instead of the symbol's normal style.
+     *
+     * Must be called between startRender() and stopRender().
+     *
+     * \since QGIS 3.18
+     */
+    void renderPoints( const QPolygonF &points, QgsRenderContext &context, bool selected = false );
+
     /**
      * Returns the approximate bounding box of the marker symbol, which includes the bounding box
      * of all symbol layers for the symbol. It is recommended to use this method only between startRender()
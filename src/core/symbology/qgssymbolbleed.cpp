@@ -0,0 +1,91 @@
+/***************************************************************************
+  qgssymbolbleed.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgssymbolbleed_p.h"
+#include "qgsrenderer.h"
+#include "qgsrendercontext.h"
+#include "qgssymbol.h"
+#include "qgssymbollayer.h"
+#include "qgspainteffect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+///@cond PRIVATE
+
+double QgsSymbolBleed::symbolBleed( QgsSymbol *symbol, const QgsRenderContext &context )
+{
+  if ( symbol->hasDataDefinedProperties() )
+    return std::numeric_limits< double >::infinity();
+
+  double bleed = 0;
+  const QgsSymbolLayerList layers = symbol->symbolLayers();
+  for ( QgsSymbolLayer *layer : layers )
+  {
+    if ( layer->paintEffect() && layer->paintEffect()->enabled() )
+      return std::numeric_limits< double >::infinity();
+
+    double layerBleed = layer->estimateMaxBleed( context );
+    switch ( layer->type() )
+    {
+      case QgsSymbol::Marker:
+      {
+        // the whole size rather than half of it, which covers rotated markers and anchor points
+        const QgsMarkerSymbolLayer *marker = static_cast< const QgsMarkerSymbolLayer * >( layer );
+        const double offset = std::max( std::fabs( marker->offset().x() ), std::fabs( marker->offset().y() ) );
+        layerBleed += context.convertToPainterUnits( marker->size(), marker->sizeUnit(), marker->sizeMapUnitScale() )
+                      + context.convertToPainterUnits( offset, marker->offsetUnit(), marker->offsetMapUnitScale() );
+        break;
+      }
+
+      case QgsSymbol::Line:
+      {
+        const QgsLineSymbolLayer *line = static_cast< const QgsLineSymbolLayer * >( layer );
+        layerBleed += line->width( context ) / 2
+                      + context.convertToPainterUnits( std::fabs( line->offset() ), line->offsetUnit(), line->offsetMapUnitScale() );
+        break;
+      }
+
+      case QgsSymbol::Fill:
+        break;
+
+      case QgsSymbol::Hybrid:
+        // geometry generators may draw anywhere
+        return std::numeric_limits< double >::infinity();
+    }
+
+    if ( QgsSymbol *subSymbol = layer->subSymbol() )
+      layerBleed += symbolBleed( subSymbol, context );
+    bleed = std::max( bleed, layerBleed );
+  }
+  return bleed;
+}
+
+double QgsSymbolBleed::rendererBleed( QgsFeatureRenderer *renderer, QgsRenderContext &context )
+{
+  if ( renderer->paintEffect() && renderer->paintEffect()->enabled() )
+    return std::numeric_limits< double >::infinity();
+
+  double bleed = 0;
+  const QgsSymbolList symbols = renderer->symbols( context );
+  for ( QgsSymbol *symbol : symbols )
+  {
+    if ( symbol )
+      bleed = std::max( bleed, symbolBleed( symbol, context ) );
+  }
+  return bleed;
+}
+
+///@endcond
@@ -0,0 +1,66 @@
+/***************************************************************************
+  qgssymbolbleed_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSSYMBOLBLEED_PRIVATE_H
+#define QGSSYMBOLBLEED_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_core.h"
+
+class QgsFeatureRenderer;
+class QgsRenderContext;
+class QgsSymbol;
+
+/**
+ * \ingroup core
+ * \brief Estimates how far from their geometries symbols draw, for rendering only the part of an
+ * image which features can change.
+ *
+ * Unlike QgsSymbolLayerUtils::estimateMaxSymbolBleed(), the estimate covers the size of markers and
+ * the width and offset of lines, and is infinite when it cannot be known in advance.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsSymbolBleed
+{
+  public:
+
+    /**
+     * Returns how far from its geometry a \a symbol may draw, in painter units, or infinity if
+     * the symbol has data defined properties, paint effects or geometry generators.
+     */
+    static double symbolBleed( QgsSymbol *symbol, const QgsRenderContext &context );
+
+    /**
+     * Returns how far from their geometries the symbols of a \a renderer may draw, in painter units,
+     * or infinity if unknown.
+     */
+    static double rendererBleed( QgsFeatureRenderer *renderer, QgsRenderContext &context );
+};
+
+/// @endcond
+
+#endif // QGSSYMBOLBLEED_PRIVATE_H
@@ -464,6 +464,14 @@ void QgsMarkerSymbolLayer::stopRender( QgsSymbolRenderContext &context )
   Q_UNUSED( context )
 }
 
+bool QgsMarkerSymbolLayer::prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset )
+{
+  Q_UNUSED( context )
+  Q_UNUSED( image )
+  Q_UNUSED( offset )
+  return false;
+}
+
 void QgsMarkerSymbolLayer::drawPreviewIcon( QgsSymbolRenderContext &context, QSize size )
 {
   startRender( context );
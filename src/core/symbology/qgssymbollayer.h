@@ -33,6 +33,7 @@
 #include "qgspropertycollection.h"
 #include "qgspainteffect.h"
 
+class QImage;
 class QPainter;
 class QSize;
 class QPolygonF;
@@ -634,6 +635,22 @@ class CORE_EXPORT QgsMarkerSymbolLayer : public QgsSymbolLayer
      */
     virtual void renderPoint( QPointF point, QgsSymbolRenderContext &context ) = 0;
 
+    /**
+     * Prepares an image of the marker which can be drawn at each point instead of calling renderPoint(),
+     * when rendering many points which share the same appearance (see QgsMarkerSymbol::renderPoints()).
+     *
+     * Returns FALSE if the marker cannot be drawn from a prerendered image in the given \a context, e.g.
+     * because some of its properties are data defined or vector output is required. Otherwise \a image
+     * is set to the marker image and \a offset to the position of the image's top left corner relative
+     * to the point, in painter units.
+     *
+     * Must be called between startRender() and stopRender(). The default implementation returns FALSE.
+     *
+     * \note not available in Python bindings
+     * \since QGIS 3.18
+     */
+    virtual bool prepareMarkerImage( QgsSymbolRenderContext &context, QImage &image, QPointF &offset ) SIP_SKIP;
+
     void drawPreviewIcon( QgsSymbolRenderContext &context, QSize size ) override;
 
     /**
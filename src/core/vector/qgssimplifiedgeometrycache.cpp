@@ -0,0 +1,235 @@
+/***************************************************************************
+  qgssimplifiedgeometrycache.cpp
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#include "qgssimplifiedgeometrycache_p.h"
+#include "qgsmaptopixelgeometrysimplifier.h"
+#include "qgsvectordataprovider.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+
+///@cond PRIVATE
+
+/**
+ * Iterates over the features of one level of a QgsSimplifiedGeometryCache, like a provider iterator would.
+ */
+class QgsSimplifiedGeometryCacheIterator : public QgsAbstractFeatureIterator
+{
+  public:
+
+    QgsSimplifiedGeometryCacheIterator( const std::shared_ptr< const QgsSimplifiedGeometryCache::Data > &data, int level, const QgsFeatureRequest &request )
+      : QgsAbstractFeatureIterator( request )
+      , mData( data )
+      , mLevel( level )
+      , mFilterRect( request.filterRect() )
+    {
+    }
+
+    ~QgsSimplifiedGeometryCacheIterator() override
+    {
+      close();
+    }
+
+    bool rewind() override
+    {
+      if ( mClosed )
+        return false;
+
+      mIndex = 0;
+      return true;
+    }
+
+    bool close() override
+    {
+      mClosed = true;
+      return true;
+    }
+
+  protected:
+
+    bool fetchFeature( QgsFeature &feature ) override
+    {
+      feature.setValid( false );
+
+      if ( mClosed )
+        return false;
+
+      while ( mIndex < mData->ids.size() )
+      {
+        const int i = mIndex++;
+        if ( !mFilterRect.isNull() && ( mData->boundingBoxes.at( i ).isNull() || !mFilterRect.intersects( mData->boundingBoxes.at( i ) ) ) )
+          continue;
+
+        feature.setId( mData->ids.at( i ) );
+        feature.setFields( mData->fields, false );
+        feature.setAttributes( mData->attributes.at( i ) );
+        feature.setGeometry( mData->geometries[ mLevel ].at( i ) );
+        feature.setValid( true );
+        return true;
+      }
+
+      close();
+      return false;
+    }
+
+  private:
+
+    std::shared_ptr< const QgsSimplifiedGeometryCache::Data > mData;
+    int mLevel = 0;
+    QgsRectangle mFilterRect;
+    int mIndex = 0;
+};
+
+///@endcond
+
+QgsSimplifiedGeometryCache::~QgsSimplifiedGeometryCache()
+{
+  if ( mCanceled )
+    *mCanceled = true;
+  mFuture.waitForFinished();
+}
+
+void QgsSimplifiedGeometryCache::build( QgsVectorDataProvider *provider, QgsVectorSimplifyMethod::SimplifyAlgorithm algorithm )
+{
+  QMutexLocker locker( &mMutex );
+  if ( mState != Empty && mAlgorithm == algorithm )
+    return;
+
+  if ( mCanceled )
+    *mCanceled = true;
+  mData.reset();
+  mAlgorithm = algorithm;
+
+  const QgsRectangle extent = provider ? provider->extent() : QgsRectangle();
+  if ( !provider || provider->featureCount() > MAXIMUM_FEATURE_COUNT || extent.isNull() || extent.isEmpty() )
+  {
+    mState = Unsupported;
+    mFuture = QFuture< std::shared_ptr< const Data > >();
+    return;
+  }
+
+  std::shared_ptr< QgsAbstractFeatureSource > source( provider->featureSource() );
+  mCanceled = std::make_shared< std::atomic< bool > >( false );
+  mState = Building;
+  mFuture = QtConcurrent::run( buildData, source, extent, algorithm, mCanceled );
+}
+
+void QgsSimplifiedGeometryCache::invalidate()
+{
+  QMutexLocker locker( &mMutex );
+  if ( mCanceled )
+    *mCanceled = true;
+  mCanceled.reset();
+  mFuture = QFuture< std::shared_ptr< const Data > >();
+  mData.reset();
+  mState = Empty;
+}
+
+bool QgsSimplifiedGeometryCache::isReady()
+{
+  QMutexLocker locker( &mMutex );
+  collectResult();
+  return mState == Ready;
+}
+
+void QgsSimplifiedGeometryCache::waitForFinished()
+{
+  QFuture< std::shared_ptr< const Data > > future;
+  {
+    QMutexLocker locker( &mMutex );
+    future = mFuture;
+  }
+  future.waitForFinished();
+}
+
+double QgsSimplifiedGeometryCache::levelTolerance( const QgsRectangle &extent, int level )
+{
+  return std::max( extent.width(), extent.height() ) / ( 256.0 * std::pow( 4.0, level ) );
+}
+
+QgsFeatureIterator QgsSimplifiedGeometryCache::getFeatures( const QgsFeatureRequest &request )
+{
+  if ( request.simplifyMethod().methodType() != QgsSimplifyMethod::OptimizeForRendering
+       || request.filterType() != QgsFeatureRequest::FilterNone
+       || request.flags() & ( QgsFeatureRequest::NoGeometry | QgsFeatureRequest::ExactIntersect )
+       || !request.orderBy().isEmpty()
+       || request.invalidGeometryCheck() != QgsFeatureRequest::GeometryNoCheck )
+    return QgsFeatureIterator();
+
+  std::shared_ptr< const Data > data;
+  {
+    QMutexLocker locker( &mMutex );
+    collectResult();
+    data = mData;
+  }
+  if ( !data )
+    return QgsFeatureIterator();
+
+  // use the coarsest level which is still at least as detailed as requested
+  const double tolerance = request.simplifyMethod().tolerance();
+  for ( int level = 0; level < LEVEL_COUNT; ++level )
+  {
+    if ( data->tolerances[level] <= tolerance )
+      return QgsFeatureIterator( new QgsSimplifiedGeometryCacheIterator( data, level, request ) );
+  }
+  return QgsFeatureIterator();
+}
+
+void QgsSimplifiedGeometryCache::collectResult()
+{
+  if ( mState != Building || !mFuture.isFinished() )
+    return;
+
+  mData = mFuture.result();
+  mState = mData ? Ready : Unsupported;
+  mFuture = QFuture< std::shared_ptr< const Data > >();
+  mCanceled.reset();
+}
+
+std::shared_ptr< const QgsSimplifiedGeometryCache::Data > QgsSimplifiedGeometryCache::buildData( std::shared_ptr< QgsAbstractFeatureSource > source, QgsRectangle extent,
+    QgsVectorSimplifyMethod::SimplifyAlgorithm algorithm, std::shared_ptr< std::atomic< bool > > canceled )
+{
+  std::shared_ptr< Data > data = std::make_shared< Data >();
+  data->fields = source->fields();
+
+  std::vector< std::unique_ptr< QgsMapToPixelSimplifier > > simplifiers;
+  for ( int level = 0; level < LEVEL_COUNT; ++level )
+  {
+    data->tolerances[level] = levelTolerance( extent, level );
+    simplifiers.emplace_back( qgis::make_unique< QgsMapToPixelSimplifier >( QgsMapToPixelSimplifier::SimplifyGeometry, data->tolerances[level],
+                              static_cast< QgsMapToPixelSimplifier::SimplifyAlgorithm >( algorithm ) ) );
+  }
+
+  QgsFeatureIterator it = source->getFeatures();
+  QgsFeature feature;
+  while ( it.nextFeature( feature ) )
+  {
+    if ( *canceled || data->ids.size() >= MAXIMUM_FEATURE_COUNT )
+      return nullptr;
+
+    data->ids << feature.id();
+    data->attributes << feature.attributes();
+    const QgsGeometry geometry = feature.geometry();
+    data->boundingBoxes << ( geometry.isNull() ? QgsRectangle() : geometry.boundingBox() );
+    for ( int level = 0; level < LEVEL_COUNT; ++level )
+      data->geometries[level] << ( geometry.isNull() ? geometry : simplifiers[level]->simplify( geometry ) );
+  }
+
+  if ( !it.isValid() || *canceled )
+    return nullptr;
+
+  return data;
+}
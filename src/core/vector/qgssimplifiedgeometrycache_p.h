@@ -0,0 +1,150 @@
+/***************************************************************************
+  qgssimplifiedgeometrycache_p.h
+  --------------------------------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+****************************************************************************
+*                                                                          *
+*   This program is free software; you can redistribute it and/or modify   *
+*   it under the terms of the GNU General Public License as published by   *
+*   the Free Software Foundation; either version 2 of the License, or      *
+*   (at your option) any later version.                                    *
+*                                                                          *
+***************************************************************************/
+
+#ifndef QGSSIMPLIFIEDGEOMETRYCACHE_PRIVATE_H
+#define QGSSIMPLIFIEDGEOMETRYCACHE_PRIVATE_H
+
+#define SIP_NO_FILE
+
+/// @cond PRIVATE
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgis_core.h"
+#include "qgsfeatureiterator.h"
+#include "qgsfields.h"
+#include "qgsgeometry.h"
+#include "qgsvectorsimplifymethod.h"
+
+#include <QFuture>
+#include <QMutex>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+class QgsVectorDataProvider;
+
+/**
+ * \ingroup core
+ * \brief Pre-simplified copies of all features of a vector layer, at several levels of detail.
+ *
+ * The cache is built in a background thread from a snapshot of the layer's provider. It
+ * stores the attributes and original bounding box of each feature once, together with
+ * LEVEL_COUNT simplified versions of its geometry. Level 0 is the coarsest one and uses a
+ * tolerance of 1/256 of the layer extent, each following level is four times finer.
+ *
+ * Rendering requests (OptimizeForRendering simplification) whose tolerance is at least
+ * the one of the finest level are served from the coarsest level which still satisfies
+ * the requested tolerance, avoiding the fetch and simplification of full resolution
+ * geometries at small scales. The map to pixel simplification of the renderer then runs
+ * on far fewer vertices.
+ *
+ * Layers with more than MAXIMUM_FEATURE_COUNT features are not cached.
+ *
+ * \since QGIS 3.18
+ */
+class CORE_EXPORT QgsSimplifiedGeometryCache
+{
+  public:
+
+    //! Number of simplification levels
+    static const int LEVEL_COUNT = 4;
+
+    //! Maximum number of features of a cached layer
+    static const int MAXIMUM_FEATURE_COUNT = 200000;
+
+    //! Cached features, immutable once built
+    struct Data
+    {
+      QgsFields fields;
+      QVector< QgsFeatureId > ids;
+      QVector< QgsAttributes > attributes;
+      QVector< QgsRectangle > boundingBoxes;
+      double tolerances[LEVEL_COUNT];
+      QVector< QgsGeometry > geometries[LEVEL_COUNT];
+    };
+
+    QgsSimplifiedGeometryCache() = default;
+    ~QgsSimplifiedGeometryCache();
+
+    //! QgsSimplifiedGeometryCache cannot be copied
+    QgsSimplifiedGeometryCache( const QgsSimplifiedGeometryCache &other ) = delete;
+    //! QgsSimplifiedGeometryCache cannot be copied
+    QgsSimplifiedGeometryCache &operator=( const QgsSimplifiedGeometryCache &other ) = delete;
+
+    /**
+     * Starts building the cache in the background from the features of \a provider, simplified
+     * with \a algorithm. Does nothing if the cache is already built or being built with the same
+     * algorithm, or if the provider was found to have too many features.
+     */
+    void build( QgsVectorDataProvider *provider, QgsVectorSimplifyMethod::SimplifyAlgorithm algorithm );
+
+    /**
+     * Discards the cached features, e.g. after the layer's data has changed. A pending
+     * build is canceled. The cache is built again by the next call to build().
+     */
+    void invalidate();
+
+    //! Returns TRUE if the cached features are available
+    bool isReady();
+
+    //! Blocks until a pending build has finished
+    void waitForFinished();
+
+    /**
+     * Returns the tolerance (in layer units) of simplification \a level for a layer with the given \a extent.
+     */
+    static double levelTolerance( const QgsRectangle &extent, int level );
+
+    /**
+     * Returns an iterator over the cached features matching a provider \a request, or an invalid
+     * iterator if the request cannot be served from the cache and must be sent to the provider.
+     */
+    QgsFeatureIterator getFeatures( const QgsFeatureRequest &request );
+
+  private:
+
+    enum State
+    {
+      Empty,
+      Building,
+      Ready,
+      Unsupported,
+    };
+
+    //! Takes the result of a finished build, must be called with mMutex locked
+    void collectResult();
+
+    static std::shared_ptr< const Data > buildData( std::shared_ptr< QgsAbstractFeatureSource > source, QgsRectangle extent,
+        QgsVectorSimplifyMethod::SimplifyAlgorithm algorithm, std::shared_ptr< std::atomic< bool > > canceled );
+
+    QMutex mMutex;
+    State mState = Empty;
+    QgsVectorSimplifyMethod::SimplifyAlgorithm mAlgorithm = QgsVectorSimplifyMethod::Distance;
+    std::shared_ptr< const Data > mData;
+    QFuture< std::shared_ptr< const Data > > mFuture;
+    std::shared_ptr< std::atomic< bool > > mCanceled;
+};
+
+/// @endcond
+
+#endif // QGSSIMPLIFIEDGEOMETRYCACHE_PRIVATE_H
@@ -92,6 +92,7 @@
 #include "qgspallabeling.h"
 #include "qgsrulebasedlabeling.h"
 #include "qgssimplifymethod.h"
+#include "qgssimplifiedgeometrycache_p.h"
 #include "qgsstoredexpressionmanager.h"
 #include "qgsexpressioncontext.h"
 #include "qgsfeedback.h"
@@ -206,6 +207,9 @@ QgsVectorLayer::QgsVectorLayer( const QString &vectorLayerPath,
   connect( QgsProject::instance()->relationManager(), &QgsRelationManager::relationsLoaded, this, &QgsVectorLayer::onRelationsLoaded );
 
   connect( this, &QgsVectorLayer::subsetStringChanged, this, &QgsMapLayer::configChanged );
+  connect( this, &QgsVectorLayer::subsetStringChanged, this, &QgsVectorLayer::invalidateSimplifiedGeometryCache );
+  connect( this, &QgsVectorLayer::dataChanged, this, &QgsVectorLayer::invalidateSimplifiedGeometryCache );
+  connect( this, &QgsVectorLayer::afterCommitChanges, this, &QgsVectorLayer::invalidateSimplifiedGeometryCache );
   connect( this, &QgsVectorLayer::dataSourceChanged, this, &QgsVectorLayer::supportsEditingChanged );
   connect( this, &QgsVectorLayer::readOnlyChanged, this, &QgsVectorLayer::supportsEditingChanged );
 
@@ -1473,6 +1477,7 @@ bool QgsVectorLayer::startEditing()
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::featureAdded, this, &QgsVectorLayer::featureAdded );
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::featureDeleted, this, &QgsVectorLayer::onFeatureDeleted );
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::geometryChanged, this, &QgsVectorLayer::geometryChanged );
+  connect( mEditBuffer, &QgsVectorLayerEditBuffer::featuresEdited, this, &QgsVectorLayer::featuresEdited );
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::attributeValueChanged, this, &QgsVectorLayer::attributeValueChanged );
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::attributeAdded, this, &QgsVectorLayer::attributeAdded );
   connect( mEditBuffer, &QgsVectorLayerEditBuffer::attributeDeleted, this, &QgsVectorLayer::attributeDeleted );
@@ -1736,6 +1741,7 @@ QString QgsVectorLayer::loadDefaultStyle( bool &resultFlag )
 bool QgsVectorLayer::setDataProvider( QString const &provider, const QgsDataProvider::ProviderOptions &options, QgsDataProvider::ReadFlags flags )
 {
   mProviderKey = provider;
+  mSimplifiedGeometryCache.reset();
   delete mDataProvider;
 
   // For Postgres provider primary key unicity is tested at construction time,
@@ -2535,6 +2541,7 @@ bool QgsVectorLayer::readStyle( const QDomNode &node, QString &errorMessage,
       mSimplifyMethod.setThreshold( e.attribute( QStringLiteral( "simplifyDrawingTol" ), QStringLiteral( "1" ) ).toFloat() );
       mSimplifyMethod.setForceLocalOptimization( e.attribute( QStringLiteral( "simplifyLocal" ), QStringLiteral( "1" ) ).toInt() );
       mSimplifyMethod.setMaximumScale( e.attribute( QStringLiteral( "simplifyMaxScale" ), QStringLiteral( "1" ) ).toFloat() );
+      mSimplifyMethod.setCacheSimplifiedGeometries( e.attribute( QStringLiteral( "simplifyCache" ), QStringLiteral( "0" ) ).toInt() );
     }
 
     //diagram renderer and diagram layer settings
@@ -2844,6 +2851,7 @@ bool QgsVectorLayer::writeStyle( QDomNode &node, QDomDocument &doc, QString &err
       mapLayerNode.setAttribute( QStringLiteral( "simplifyDrawingTol" ), QString::number( mSimplifyMethod.threshold() ) );
       mapLayerNode.setAttribute( QStringLiteral( "simplifyLocal" ), mSimplifyMethod.forceLocalOptimization() ? 1 : 0 );
       mapLayerNode.setAttribute( QStringLiteral( "simplifyMaxScale" ), QString::number( mSimplifyMethod.maximumScale() ) );
+      mapLayerNode.setAttribute( QStringLiteral( "simplifyCache" ), mSimplifyMethod.cacheSimplifiedGeometries() ? 1 : 0 );
     }
 
     //save customproperties
@@ -5377,6 +5385,13 @@ QSet<QgsMapLayerDependency> QgsVectorLayer::dependencies() const
   return mDependencies;
 }
 
+void QgsVectorLayer::invalidateSimplifiedGeometryCache()
+{
+  QMutexLocker locker( &mFeatureSourceConstructorMutex );
+  if ( mSimplifiedGeometryCache )
+    mSimplifiedGeometryCache->invalidate();
+}
+
 void QgsVectorLayer::emitDataChanged()
 {
   if ( mDataChangedFired )
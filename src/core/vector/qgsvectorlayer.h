@@ -81,6 +81,7 @@ class QgsGeometryOptions;
 class QgsStyleEntityVisitorInterface;
 class QgsVectorLayerTemporalProperties;
 class QgsFeatureRendererGenerator;
+class QgsSimplifiedGeometryCache;
 
 typedef QList<int> QgsAttributeList;
 typedef QSet<int> QgsAttributeIds;
@@ -2672,6 +2673,19 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer, public QgsExpressionConte
      */
     void geometryChanged( QgsFeatureId fid, const QgsGeometry &geometry );
 
+    /**
+     * Emitted when features are added, deleted or modified in the edit buffer, with the \a extent
+     * (in layer CRS) covering their geometries before and after the change. The original geometries
+     * of the edited data provider features with \a providerFeatureIds are not included in \a extent.
+     *
+     * This allows map renderers to only redraw the affected part of the layer. A null \a extent
+     * without \a providerFeatureIds is used when the affected area is unknown.
+     *
+     * \see QgsVectorLayerEditBuffer::featuresEdited()
+     * \since QGIS 3.18
+     */
+    void featuresEdited( const QgsRectangle &extent, const QgsFeatureIds &providerFeatureIds );
+
     //! Emitted when attributes are deleted from the provider
     void committedAttributesDeleted( const QString &layerId, const QgsAttributeList &deletedAttributes );
     //! Emitted when attributes are added to the provider
@@ -2797,6 +2811,7 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer, public QgsExpressionConte
     void onDirtyTransaction( const QString &sql, const QString &name );
     void emitDataChanged();
     void onAfterCommitChangesDependency();
+    void invalidateSimplifiedGeometryCache();
 
   private:
     void updateDefaultValues( QgsFeatureId fid, QgsFeature feature = QgsFeature() );
@@ -2964,6 +2979,9 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer, public QgsExpressionConte
 
     mutable QMutex mFeatureSourceConstructorMutex;
 
+    //! Pre-simplified geometries used for rendering, created by QgsVectorLayerFeatureSource when enabled
+    mutable std::shared_ptr< QgsSimplifiedGeometryCache > mSimplifiedGeometryCache;
+
     QgsVectorLayerFeatureCounter *mFeatureCounter = nullptr;
 
     std::unique_ptr<QgsGeometryOptions> mGeometryOptions;
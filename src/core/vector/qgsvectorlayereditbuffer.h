@@ -203,6 +203,22 @@ class CORE_EXPORT QgsVectorLayerEditBuffer : public QObject
      */
     void geometryChanged( QgsFeatureId fid, const QgsGeometry &geom );
 
+    /**
+     * Emitted when features are added, deleted or modified, with the \a extent (in layer CRS)
+     * covering their geometries before and after the change. This can be used to only
+     * redraw the affected part of a map.
+     *
+     * The geometries of features which are not stored in the edit buffer are not fetched
+     * when editing: they are only reported by their \a providerFeatureIds, and the area they
+     * cover can be retrieved from the data provider when it is needed.
+     *
+     * A null \a extent without \a providerFeatureIds is used when the affected area is unknown,
+     * e.g. when changing the layer fields.
+     *
+     * \since QGIS 3.18
+     */
+    void featuresEdited( const QgsRectangle &extent, const QgsFeatureIds &providerFeatureIds );
+
     void attributeValueChanged( QgsFeatureId fid, int idx, const QVariant & );
     void attributeAdded( int idx );
     void attributeDeleted( int idx );
@@ -16,6 +16,7 @@
 
 #include "qgsexpressionfieldbuffer.h"
 #include "qgsgeometrysimplifier.h"
+#include "qgssimplifiedgeometrycache_p.h"
 #include "qgssimplifymethod.h"
 #include "qgsvectordataprovider.h"
 #include "qgsvectorlayereditbuffer.h"
@@ -85,6 +86,18 @@ QgsVectorLayerFeatureSource::QgsVectorLayerFeatureSource( const QgsVectorLayer *
 #endif
   }
 
+  const QgsVectorSimplifyMethod &simplifyMethod = layer->mSimplifyMethod;
+  if ( !mHasEditBuffer && simplifyMethod.cacheSimplifiedGeometries()
+       && simplifyMethod.simplifyHints() & QgsVectorSimplifyMethod::GeometrySimplification
+       && ( layer->geometryType() == QgsWkbTypes::LineGeometry || layer->geometryType() == QgsWkbTypes::PolygonGeometry ) )
+  {
+    // build the layer's simplified geometries the first time they may be needed
+    if ( !layer->mSimplifiedGeometryCache )
+      layer->mSimplifiedGeometryCache = std::make_shared< QgsSimplifiedGeometryCache >();
+    layer->mSimplifiedGeometryCache->build( layer->dataProvider(), simplifyMethod.simplifyAlgorithm() );
+    mSimplifiedGeometryCache = layer->mSimplifiedGeometryCache;
+  }
+
   std::unique_ptr< QgsExpressionContextScope > layerScope( QgsExpressionContextUtils::layerScope( layer ) );
   mLayerScope = *layerScope;
 }
@@ -295,7 +308,11 @@ QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayerFeat
     }
     else
     {
-      mProviderIterator = mSource->mProviderFeatureSource->getFeatures( mProviderRequest );
+      // serve small scale rendering from pre-simplified geometries when available
+      if ( mSource->mSimplifiedGeometryCache && !mHasVirtualAttributes )
+        mProviderIterator = mSource->mSimplifiedGeometryCache->getFeatures( mProviderRequest );
+      if ( !mProviderIterator.isValid() )
+        mProviderIterator = mSource->mProviderFeatureSource->getFeatures( mProviderRequest );
     }
 
     rewindEditBuffer();
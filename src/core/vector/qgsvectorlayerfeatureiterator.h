@@ -35,6 +35,7 @@ class QgsVectorLayerEditBuffer;
 class QgsVectorLayerJoinBuffer;
 class QgsVectorLayerJoinInfo;
 class QgsExpressionContext;
+class QgsSimplifiedGeometryCache;
 
 class QgsVectorLayerFeatureIterator;
 
@@ -120,6 +121,8 @@ class CORE_EXPORT QgsVectorLayerFeatureSource : public QgsAbstractFeatureSource
 #ifdef SIP_RUN
     QgsVectorLayerFeatureSource( const QgsVectorLayerFeatureSource &other );
 #endif
+
+    std::shared_ptr< QgsSimplifiedGeometryCache > mSimplifiedGeometryCache;
 };
 
 /**
@@ -22,6 +22,7 @@
 #include "qgspallabeling.h"
 #include "qgsrenderer.h"
 #include "qgsrendercontext.h"
+#include "qgsrenderprofile.h"
 #include "qgssinglesymbolrenderer.h"
 #include "qgssymbollayer.h"
 #include "qgssymbollayerutils.h"
@@ -37,13 +38,88 @@
 #include "qgslogger.h"
 #include "qgssettings.h"
 #include "qgsexpressioncontextutils.h"
+#include "qgsexpressionset.h"
 #include "qgsrenderedfeaturehandlerinterface.h"
 #include "qgsvectorlayertemporalproperties.h"
 #include "qgsmapclippingutils.h"
 #include "qgsfeaturerenderergenerator.h"
+#include "qgspoint.h"
+#include "qgssymbolbleed_p.h"
 
 #include <QPicture>
 #include <QTimer>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+///@cond PRIVATE
+
+//! Number of features drawn by a worker thread at a time when rendering features in parallel
+static const int PARALLEL_BATCH_SIZE = 1000;
+
+//! Maximum number of points drawn together by QgsMarkerSymbol::renderPoints()
+static const int POINT_BATCH_SIZE = 1000;
+
+/**
+ * Batch of features drawn by a worker thread, with the renderer clone, render context and image used to draw it.
+ */
+struct QgsVectorLayerRendererBatch
+{
+  std::unique_ptr< QgsFeatureRenderer > renderer;
+  std::unique_ptr< QgsRenderContext > context;
+  QImage image;
+  QPainter painter;
+  //! Timings of the batch, merged into the layer profile once the batches are drawn
+  QgsLayerRenderProfile profile;
+  QVector< QgsFeature > features;
+  std::vector< char > rendered;
+  //! Part of the image painted since it was last composited, in logical pixels
+  QRectF dirtyRect;
+};
+
+/**
+ * Returns the part of \a bounds which a \a feature drawn with symbols bleeding up to \a margin painter units
+ * can paint, in logical pixels. The whole \a bounds are returned if the feature extent cannot be transformed.
+ */
+static QRectF featurePaintedRect( const QgsFeature &feature, const QgsRenderContext &context, double margin, const QRectF &bounds )
+{
+  QgsRectangle extent = feature.geometry().boundingBox();
+  try
+  {
+    if ( context.coordinateTransform().isValid() )
+      extent = context.coordinateTransform().transformBoundingBox( extent );
+  }
+  catch ( QgsCsException & )
+  {
+    return bounds;
+  }
+
+  // all the corners, the map may be rotated
+  const QgsMapToPixel &mtp = context.mapToPixel();
+  const QgsPointXY corners[] =
+  {
+    mtp.transform( extent.xMinimum(), extent.yMinimum() ),
+    mtp.transform( extent.xMinimum(), extent.yMaximum() ),
+    mtp.transform( extent.xMaximum(), extent.yMinimum() ),
+    mtp.transform( extent.xMaximum(), extent.yMaximum() ),
+  };
+  QRectF rect( corners[0].toQPointF(), QSizeF( 0, 0 ) );
+  for ( const QgsPointXY &corner : corners )
+  {
+    rect.setLeft( std::min( rect.left(), corner.x() ) );
+    rect.setRight( std::max( rect.right(), corner.x() ) );
+    rect.setTop( std::min( rect.top(), corner.y() ) );
+    rect.setBottom( std::max( rect.bottom(), corner.y() ) );
+  }
+  return rect.adjusted( -margin, -margin, margin, margin ).intersected( bounds );
+}
+
+//! Maximum memory used by the symbol layer images when streaming symbol levels, in bytes
+static const qint64 MAX_LEVEL_IMAGES_SIZE = 256 * 1024 * 1024;
+
+///@endcond
 
 QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer *layer, QgsRenderContext &context )
   : QgsMapLayerRenderer( layer->id(), &context )
@@ -142,6 +218,9 @@ QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer *layer, QgsRender
     mRenderer->setVertexMarkerAppearance( mVertexMarkerStyle, mVertexMarkerSize );
   }
   renderContext()->expressionContext() << QgsExpressionContextUtils::layerScope( layer );
+  // the expressions of the renderers, labeling, diagrams and data defined properties of the layer share
+  // the evaluation of their common subexpressions
+  renderContext()->expressionContext().setExpressionSet( std::make_shared< QgsExpressionSet >() );
 
   for ( const std::unique_ptr< QgsFeatureRenderer > &renderer : mRenderers )
   {
@@ -391,7 +470,11 @@ bool QgsVectorLayerRenderer::renderInternal( QgsFeatureRenderer *renderer )
     context.setVectorSimplifyMethod( vectorMethod );
   }
 
-  QgsFeatureIterator fit = mSource->getFeatures( featureRequest );
+  QgsFeatureIterator fit;
+  {
+    QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureFetch );
+    fit = mSource->getFeatures( featureRequest );
+  }
   // Attach an interruption checker so that iterators that have potentially
   // slow fetchFeature() implementations, such as in the WFS provider, can
   // check it, instead of relying on just the mContext.renderingStopped() check
@@ -420,8 +503,6 @@ bool QgsVectorLayerRenderer::renderInternal( QgsFeatureRenderer *renderer )
 
 void QgsVectorLayerRenderer::drawRenderer( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit )
 {
-  const bool isMainRenderer = renderer == mRenderer;
-
   QgsExpressionContextScope *symbolScope = QgsExpressionContextUtils::updateSymbolScope( nullptr, new QgsExpressionContextScope() );
   QgsRenderContext &context = *renderContext();
   context.expressionContext().appendScope( symbolScope );
@@ -433,90 +514,494 @@ void QgsVectorLayerRenderer::drawRenderer( QgsFeatureRenderer *renderer, QgsFeat
     clipEngine->prepareGeometry();
   }
 
-  QgsFeature fet;
-  while ( fit.nextFeature( fet ) )
+  mBatchPoints = canBatchPoints( renderer );
+
+  if ( canDrawFeaturesParallel( renderer ) )
   {
-    try
+    drawFeaturesParallel( renderer, fit, clipEngine.get(), symbolScope );
+  }
+  else
+  {
+    QgsFeature fet;
+    while ( fetchFeature( fit, fet ) )
     {
-      if ( context.renderingStopped() )
+      try
+      {
+        if ( context.renderingStopped() )
+        {
+          QgsDebugMsgLevel( QStringLiteral( "Drawing of vector layer %1 canceled." ).arg( layerId() ), 2 );
+          break;
+        }
+
+        if ( !fet.hasGeometry() || fet.geometry().isEmpty() )
+          continue; // skip features without geometry
+
+        if ( clipEngine && !clipEngine->intersects( fet.geometry().constGet() ) )
+          continue; // skip features outside of clipping region
+
+        drawFeature( renderer, fet, symbolScope );
+      }
+      catch ( const QgsCsException &cse )
       {
-        QgsDebugMsgLevel( QStringLiteral( "Drawing of vector layer %1 canceled." ).arg( layerId() ), 2 );
-        break;
+        Q_UNUSED( cse )
+        QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                     .arg( fet.id() ).arg( cse.what() ) );
       }
+    }
+  }
 
-      if ( !fet.hasGeometry() || fet.geometry().isEmpty() )
-        continue; // skip features without geometry
+  {
+    QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+    flushPointBatch();
+  }
+  mBatchPoints = false;
 
-      if ( clipEngine && !clipEngine->intersects( fet.geometry().constGet() ) )
-        continue; // skip features outside of clipping region
+  delete context.expressionContext().popScope();
 
-      if ( mApplyClipGeometries )
-        context.setFeatureClipGeometry( mClipFeatureGeom );
+  stopRenderer( renderer, nullptr );
+}
+
+bool QgsVectorLayerRenderer::fetchFeature( QgsFeatureIterator &fit, QgsFeature &feature )
+{
+  QgsLayerRenderProfile *profile = renderContext()->layerRenderProfile();
+  if ( !profile )
+    return fit.nextFeature( feature );
+
+  QElapsedTimer timer;
+  timer.start();
+  const bool fetched = fit.nextFeature( feature );
+  profile->addTime( QgsLayerRenderProfile::FeatureFetch, timer.nsecsElapsed() );
+  if ( fetched )
+    profile->addFetchedFeatures( 1 );
+  return fetched;
+}
+
+void QgsVectorLayerRenderer::drawFeature( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope )
+{
+  const bool isMainRenderer = renderer == mRenderer;
+  QgsRenderContext &context = *renderContext();
+
+  if ( mApplyClipGeometries )
+    context.setFeatureClipGeometry( mClipFeatureGeom );
+
+  context.expressionContext().setFeature( feature );
+
+  bool sel = isMainRenderer && context.showSelection() && mSelectedFeatureIds.contains( feature.id() );
+  bool drawMarker = isMainRenderer && ( mDrawVertexMarkers && context.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
+
+  // render feature
+  bool rendered = false;
+  {
+    QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+    // selected features and vertex markers are drawn one by one
+    if ( !mBatchPoints || sel || drawMarker || !batchPoints( renderer, feature, rendered ) )
+    {
+      flushPointBatch();
+      rendered = renderer->renderFeature( feature, context, -1, sel, drawMarker );
+    }
+  }
+  if ( rendered && context.layerRenderProfile() )
+    context.layerRenderProfile()->addRenderedFeatures( 1 );
+
+  // labeling - register feature
+  if ( rendered )
+    registerRenderedFeature( renderer, feature, symbolScope );
+}
+
+bool QgsVectorLayerRenderer::canBatchPoints( QgsFeatureRenderer *renderer )
+{
+  QgsRenderContext &context = *renderContext();
+  if ( mGeometryType != QgsWkbTypes::PointGeometry || !context.painter() )
+    return false;
+
+  // renderers which draw each feature with the symbol returned by symbolForFeature()
+  static const QStringList BATCH_RENDERER_TYPES
+  {
+    QStringLiteral( "singleSymbol" ),
+    QStringLiteral( "categorizedSymbol" ),
+    QStringLiteral( "graduatedSymbol" ),
+  };
+  if ( !BATCH_RENDERER_TYPES.contains( renderer->type() ) )
+    return false;
+
+  // rendered feature handlers need the bounds of each feature, feature clipping its geometry
+  if ( context.hasRenderedFeatureHandlers() || mApplyClipGeometries )
+    return false;
+
+  // features are only batched when their symbol looks the same for every point, so that the
+  // batch gives the same result as drawing the features one by one
+  const QgsSymbolList symbols = renderer->symbols( context );
+  if ( symbols.isEmpty() )
+    return false;
+
+  for ( QgsSymbol *symbol : symbols )
+  {
+    if ( symbol->type() != QgsSymbol::Marker || !static_cast< QgsMarkerSymbol * >( symbol )->canRenderPointsAsImages( context ) )
+      return false;
+  }
+  return true;
+}
+
+bool QgsVectorLayerRenderer::batchPoints( QgsFeatureRenderer *renderer, const QgsFeature &feature, bool &rendered )
+{
+  QgsRenderContext &context = *renderContext();
+  const QgsAbstractGeometry *geometry = feature.geometry().constGet();
+  const QgsWkbTypes::Type flatType = QgsWkbTypes::flatType( geometry->wkbType() );
+  if ( flatType != QgsWkbTypes::Point && flatType != QgsWkbTypes::MultiPoint )
+    return false;
+
+  QgsSymbol *symbol = renderer->symbolForFeature( feature, context );
+  rendered = symbol;
+  if ( !symbol )
+    return true;
+
+  if ( symbol != mPointBatchSymbol || mPointBatch.size() >= POINT_BATCH_SIZE )
+  {
+    flushPointBatch();
+    mPointBatchSymbol = static_cast< QgsMarkerSymbol * >( symbol );
+  }
+
+  // painter coordinates, as calculated by QgsSymbol::renderFeature()
+  const QgsCoordinateTransform ct = context.coordinateTransform();
+  const QgsMapToPixel &mtp = context.mapToPixel();
+  const int previousSize = mPointBatch.size();
+  try
+  {
+    for ( auto part = geometry->const_parts_begin(); part != geometry->const_parts_end(); ++part )
+    {
+      const QgsPoint *point = qgsgeometry_cast< const QgsPoint * >( *part );
+      if ( !point )
+        continue;
+
+      double x = point->x();
+      double y = point->y();
+      if ( ct.isValid() )
+      {
+        double z = 0.0;
+        ct.transformInPlace( x, y, z );
+      }
+      mtp.transformInPlace( x, y );
+      mPointBatch << QPointF( x, y );
+    }
+  }
+  catch ( QgsCsException & )
+  {
+    mPointBatch.resize( previousSize );
+    throw;
+  }
+  return true;
+}
+
+void QgsVectorLayerRenderer::flushPointBatch()
+{
+  if ( mPointBatchSymbol && !mPointBatch.isEmpty() )
+    mPointBatchSymbol->renderPoints( mPointBatch, *renderContext() );
+
+  mPointBatch.clear();
+  mPointBatchSymbol = nullptr;
+}
+
+void QgsVectorLayerRenderer::registerRenderedFeature( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope )
+{
+  // as soon as first feature is rendered, we can start showing layer updates.
+  // but if we are blocking render updates (so that a previously cached image is being shown), we wait
+  // at most e.g. 3 seconds before we start forcing progressive updates.
+  if ( !mBlockRenderUpdates || mElapsedTimer.elapsed() > MAX_TIME_TO_USE_CACHED_PREVIEW_IMAGE )
+  {
+    mReadyToCompose = true;
+  }
+
+  registerFeatureForLabeling( renderer, feature, symbolScope );
+}
+
+void QgsVectorLayerRenderer::registerFeatureForLabeling( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope )
+{
+  const bool isMainRenderer = renderer == mRenderer;
+  QgsRenderContext &context = *renderContext();
+
+  // new labeling engine
+  if ( isMainRenderer && context.labelingEngine() && ( mLabelProvider || mDiagramProvider ) )
+  {
+    QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::LabelRegistration );
+
+    QgsGeometry obstacleGeometry;
+    QgsSymbolList symbols = renderer->originalSymbolsForFeature( feature, context );
+    QgsSymbol *symbol = nullptr;
+    if ( !symbols.isEmpty() && feature.geometry().type() == QgsWkbTypes::PointGeometry )
+    {
+      obstacleGeometry = QgsVectorLayerLabelProvider::getPointObstacleGeometry( feature, context, symbols );
+    }
+
+    if ( !symbols.isEmpty() )
+    {
+      symbol = symbols.at( 0 );
+      QgsExpressionContextUtils::updateSymbolScope( symbol, symbolScope );
+    }
+
+    if ( mApplyLabelClipGeometries )
+      context.setFeatureClipGeometry( mLabelClipFeatureGeom );
+
+    if ( mLabelProvider )
+    {
+      mLabelProvider->registerFeature( feature, context, obstacleGeometry, symbol );
+    }
+    if ( mDiagramProvider )
+    {
+      mDiagramProvider->registerFeature( feature, context, obstacleGeometry );
+    }
+
+    if ( mApplyLabelClipGeometries )
+      context.setFeatureClipGeometry( QgsGeometry() );
+  }
+}
+
+bool QgsVectorLayerRenderer::canDrawFeaturesParallel( QgsFeatureRenderer *renderer )
+{
+  QgsRenderContext &context = *renderContext();
+  if ( !context.testFlag( QgsRenderContext::ParallelFeatureRendering ) || QThreadPool::globalInstance()->maxThreadCount() < 2 )
+    return false;
+
+  // renderers which draw each feature on its own, so clones of them can draw separate parts of the layer.
+  // Renderers accumulating features (e.g. point displacement or heatmaps) need to see the whole layer,
+  // and the rule-based renderer only queues features, drawing them by z-level when rendering stops.
+  static const QStringList PARALLEL_RENDERER_TYPES
+  {
+    QStringLiteral( "singleSymbol" ),
+    QStringLiteral( "categorizedSymbol" ),
+    QStringLiteral( "graduatedSymbol" ),
+  };
+  if ( !PARALLEL_RENDERER_TYPES.contains( renderer->type() ) )
+    return false;
+
+  // batches are composited with source over, which gives the same result as drawing features one by one
+  // only for features blended with source over
+  if ( context.useAdvancedEffects() && mFeatureBlendMode != QPainter::CompositionMode_SourceOver )
+    return false;
+
+  // rendered feature handlers and mask painters are not thread safe
+  if ( context.hasRenderedFeatureHandlers() || context.maskPainter() )
+    return false;
+
+  return hasRasterDestination();
+}
+
+bool QgsVectorLayerRenderer::hasRasterDestination()
+{
+  const QgsRenderContext &context = *renderContext();
+  const QPainter *painter = context.painter();
+  return painter && painter->device() && painter->device()->devType() == QInternal::Image
+         && painter->transform().isIdentity()
+         && !context.testFlag( QgsRenderContext::ForceVectorOutput );
+}
+
+void QgsVectorLayerRenderer::drawFeaturesParallel( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit, QgsGeometryEngine *clipEngine, QgsExpressionContextScope *symbolScope )
+{
+  const bool isMainRenderer = renderer == mRenderer;
+  QgsRenderContext &context = *renderContext();
+  QPainter *painter = context.painter();
+  const QImage *destination = static_cast< const QImage * >( painter->device() );
 
-      context.expressionContext().setFeature( fet );
+  // features only change the pixels around their extent, batches composite and clear just these.
+  // The margin covers symbols and vertex markers, plus a pixel of antialiasing
+  double margin = QgsSymbolBleed::rendererBleed( renderer, context );
+  if ( isMainRenderer && mDrawVertexMarkers && context.drawEditingInformation() )
+    margin = std::max( margin, context.convertToPainterUnits( mVertexMarkerSize, QgsUnitTypes::RenderMillimeters ) );
+  margin += 1;
 
-      bool sel = isMainRenderer && context.showSelection() && mSelectedFeatureIds.contains( fet.id() );
-      bool drawMarker = isMainRenderer && ( mDrawVertexMarkers && context.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
+  // batches are created as needed, up to one per thread
+  const int maxBatches = QThreadPool::globalInstance()->maxThreadCount();
+  std::vector< std::unique_ptr< QgsVectorLayerRendererBatch > > batches;
 
-      // render feature
-      bool rendered = renderer->renderFeature( fet, context, -1, sel, drawMarker );
+  QgsFeature fet;
+  bool finished = false;
+  while ( !finished )
+  {
+    // 1. fetch features for a batch per thread
+    int batchCount = 0;
+    while ( batchCount < maxBatches && !finished )
+    {
+      if ( batchCount == static_cast< int >( batches.size() ) )
+        batches.emplace_back( qgis::make_unique< QgsVectorLayerRendererBatch >() );
+      QVector< QgsFeature > &features = batches[batchCount]->features;
+      features.clear();
 
-      // labeling - register feature
-      if ( rendered )
+      while ( features.size() < PARALLEL_BATCH_SIZE )
       {
-        // as soon as first feature is rendered, we can start showing layer updates.
-        // but if we are blocking render updates (so that a previously cached image is being shown), we wait
-        // at most e.g. 3 seconds before we start forcing progressive updates.
-        if ( !mBlockRenderUpdates || mElapsedTimer.elapsed() > MAX_TIME_TO_USE_CACHED_PREVIEW_IMAGE )
+        if ( context.renderingStopped() || !fetchFeature( fit, fet ) )
         {
-          mReadyToCompose = true;
+          finished = true;
+          break;
         }
 
-        // new labeling engine
-        if ( isMainRenderer && context.labelingEngine() && ( mLabelProvider || mDiagramProvider ) )
-        {
-          QgsGeometry obstacleGeometry;
-          QgsSymbolList symbols = renderer->originalSymbolsForFeature( fet, context );
-          QgsSymbol *symbol = nullptr;
-          if ( !symbols.isEmpty() && fet.geometry().type() == QgsWkbTypes::PointGeometry )
-          {
-            obstacleGeometry = QgsVectorLayerLabelProvider::getPointObstacleGeometry( fet, context, symbols );
-          }
+        if ( !fet.hasGeometry() || fet.geometry().isEmpty() )
+          continue; // skip features without geometry
 
-          if ( !symbols.isEmpty() )
-          {
-            symbol = symbols.at( 0 );
-            QgsExpressionContextUtils::updateSymbolScope( symbol, symbolScope );
-          }
+        if ( clipEngine && !clipEngine->intersects( fet.geometry().constGet() ) )
+          continue; // skip features outside of clipping region
 
-          if ( mApplyLabelClipGeometries )
-            context.setFeatureClipGeometry( mLabelClipFeatureGeom );
+        features << fet;
+      }
 
-          if ( mLabelProvider )
-          {
-            mLabelProvider->registerFeature( fet, context, obstacleGeometry, symbol );
-          }
-          if ( mDiagramProvider )
-          {
-            mDiagramProvider->registerFeature( fet, context, obstacleGeometry );
-          }
+      if ( !features.isEmpty() )
+        batchCount++;
+    }
 
-          if ( mApplyLabelClipGeometries )
-            context.setFeatureClipGeometry( QgsGeometry() );
+    if ( batchCount == 0 )
+      break;
+
+    if ( batchCount == 1 && finished && !batches[0]->renderer )
+    {
+      // a layer with a single batch of features: not worth using separate images
+      for ( QgsFeature &feature : batches[0]->features )
+      {
+        if ( context.renderingStopped() )
+          break;
+
+        try
+        {
+          drawFeature( renderer, feature, symbolScope );
+        }
+        catch ( const QgsCsException &cse )
+        {
+          Q_UNUSED( cse )
+          QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                       .arg( feature.id() ).arg( cse.what() ) );
         }
       }
+      break;
     }
-    catch ( const QgsCsException &cse )
+
+    // 2. prepare the renderer clones and images of new batches. Each renderer clone has its own
+    // render context, painting into an image matching the destination
+    for ( int i = 0; i < batchCount; ++i )
     {
-      Q_UNUSED( cse )
-      QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
-                   .arg( fet.id() ).arg( cse.what() ) );
+      QgsVectorLayerRendererBatch &batch = *batches[i];
+      if ( batch.renderer )
+        continue;
+
+      batch.image = QImage( destination->size(), QImage::Format_ARGB32_Premultiplied );
+      batch.image.setDotsPerMeterX( destination->dotsPerMeterX() );
+      batch.image.setDotsPerMeterY( destination->dotsPerMeterY() );
+      batch.image.setDevicePixelRatio( destination->devicePixelRatioF() );
+      batch.image.fill( Qt::transparent );
+      batch.painter.begin( &batch.image );
+      batch.painter.setRenderHints( painter->renderHints() );
+
+      batch.context = qgis::make_unique< QgsRenderContext >( context );
+      batch.context->setPainter( &batch.painter );
+      batch.context->setLabelingEngine( nullptr );
+      if ( context.layerRenderProfile() )
+        batch.context->setLayerRenderProfile( &batch.profile );
+
+      batch.renderer.reset( renderer->clone() );
+      if ( isMainRenderer && mDrawVertexMarkers )
+        batch.renderer->setVertexMarkerAppearance( mVertexMarkerStyle, mVertexMarkerSize );
+      batch.renderer->startRender( *batch.context, mFields );
+    }
+
+    // 3. draw the batches concurrently
+    auto drawBatch = [this, &context, isMainRenderer, margin]( std::unique_ptr< QgsVectorLayerRendererBatch > &batch )
+    {
+      QgsRenderContext &batchContext = *batch->context;
+      const QRectF bounds( QPointF( 0, 0 ), QSizeF( batch->image.size() ) / batch->image.devicePixelRatioF() );
+      batch->rendered.assign( batch->features.size(), 0 );
+      for ( int i = 0; i < batch->features.size(); ++i )
+      {
+        if ( context.renderingStopped() )
+          break;
+
+        QgsFeature &feature = batch->features[i];
+        try
+        {
+          if ( mApplyClipGeometries )
+            batchContext.setFeatureClipGeometry( mClipFeatureGeom );
+
+          batchContext.expressionContext().setFeature( feature );
+
+          const bool sel = isMainRenderer && batchContext.showSelection() && mSelectedFeatureIds.contains( feature.id() );
+          const bool drawMarker = isMainRenderer && ( mDrawVertexMarkers && batchContext.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
+
+          QgsScopedLayerRenderProfile profile( batchContext.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+          batch->rendered[i] = batch->renderer->renderFeature( feature, batchContext, -1, sel, drawMarker );
+          if ( batch->rendered[i] )
+            batch->dirtyRect |= std::isfinite( margin ) ? featurePaintedRect( feature, batchContext, margin, bounds ) : bounds;
+        }
+        catch ( const QgsCsException &cse )
+        {
+          Q_UNUSED( cse )
+          QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                       .arg( feature.id() ).arg( cse.what() ) );
+        }
+      }
+    };
+    QtConcurrent::blockingMap( batches.begin(), batches.begin() + batchCount, drawBatch );
+
+    // 4. composite the batch images in order and register the rendered features for labeling
+    for ( int i = 0; i < batchCount; ++i )
+    {
+      QgsVectorLayerRendererBatch &batch = *batches[i];
+      if ( std::find( batch.rendered.begin(), batch.rendered.end(), 1 ) == batch.rendered.end() )
+        continue;
+
+      if ( context.layerRenderProfile() )
+        context.layerRenderProfile()->addRenderedFeatures( std::count( batch.rendered.begin(), batch.rendered.end(), 1 ) );
+
+      // whole pixels of the image covering the painted part
+      const qreal dpr = batch.image.devicePixelRatioF();
+      const QRect source = QRectF( batch.dirtyRect.topLeft() * dpr, batch.dirtyRect.size() * dpr ).toAlignedRect().intersected( batch.image.rect() );
+      batch.dirtyRect = QRectF();
+      if ( !source.isEmpty() )
+      {
+        const QRectF target( QPointF( source.topLeft() ) / dpr, QSizeF( source.size() ) / dpr );
+        painter->drawImage( target, batch.image, source );
+
+        batch.painter.save();
+        batch.painter.setCompositionMode( QPainter::CompositionMode_Source );
+        batch.painter.fillRect( target, Qt::transparent );
+        batch.painter.restore();
+      }
+
+      for ( int j = 0; j < batch.features.size(); ++j )
+      {
+        if ( !batch.rendered[j] )
+          continue;
+
+        QgsFeature &feature = batch.features[j];
+        try
+        {
+          context.expressionContext().setFeature( feature );
+          registerRenderedFeature( renderer, feature, symbolScope );
+        }
+        catch ( const QgsCsException &cse )
+        {
+          Q_UNUSED( cse )
+          QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                       .arg( feature.id() ).arg( cse.what() ) );
+        }
+      }
     }
   }
 
-  delete context.expressionContext().popScope();
+  for ( const std::unique_ptr< QgsVectorLayerRendererBatch > &batch : batches )
+  {
+    if ( !batch->renderer )
+      continue;
 
-  stopRenderer( renderer, nullptr );
+    {
+      // renderers may defer drawing features until they are stopped
+      QgsScopedLayerRenderProfile profile( batch->context->layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+      batch->renderer->stopRender( *batch->context );
+    }
+    batch->painter.end();
+
+    if ( context.layerRenderProfile() )
+      context.layerRenderProfile()->merge( batch->profile );
+  }
+
+  if ( context.renderingStopped() )
+  {
+    QgsDebugMsgLevel( QStringLiteral( "Drawing of vector layer %1 canceled." ).arg( layerId() ), 2 );
+  }
 }
 
 void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit )
@@ -546,12 +1031,41 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
     clipEngine->prepareGeometry();
   }
 
+  // find out the order
+  QgsSymbolLevelOrder levels;
+  const QgsSymbolList rendererSymbols = renderer->symbols( context );
+  for ( int i = 0; i < rendererSymbols.count(); i++ )
+  {
+    QgsSymbol *sym = rendererSymbols[i];
+    for ( int j = 0; j < sym->symbolLayerCount(); j++ )
+    {
+      int level = sym->symbolLayer( j )->renderingPass();
+      if ( level < 0 || level >= 1000 ) // ignore invalid levels
+        continue;
+      QgsSymbolLevelItem item( sym, j );
+      while ( level >= levels.count() ) // append new empty levels
+        levels.append( QgsSymbolLevel() );
+      levels[level].append( item );
+    }
+  }
+
+  QList< QgsSymbolLevelItem > levelItems;
+  for ( const QgsSymbolLevel &level : qgis::as_const( levels ) )
+    levelItems.append( level );
+
+  if ( canDrawLevelsToImages( levelItems.count() ) )
+  {
+    drawLevelsToImages( renderer, fit, levelItems, clipEngine.get(), symbolScope );
+    stopRenderer( renderer, selRenderer );
+    return;
+  }
+
   if ( mApplyLabelClipGeometries )
     context.setFeatureClipGeometry( mLabelClipFeatureGeom );
 
   // 1. fetch features
   QgsFeature fet;
-  while ( fit.nextFeature( fet ) )
+  while ( fetchFeature( fit, fet ) )
   {
     if ( context.renderingStopped() )
     {
@@ -567,7 +1081,11 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
       continue; // skip features outside of clipping region
 
     context.expressionContext().setFeature( fet );
-    QgsSymbol *sym = renderer->symbolForFeature( fet, context );
+    QgsSymbol *sym = nullptr;
+    {
+      QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+      sym = renderer->symbolForFeature( fet, context );
+    }
     if ( !sym )
     {
       continue;
@@ -582,6 +1100,8 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
     // new labeling engine
     if ( isMainRenderer && context.labelingEngine() && ( mLabelProvider || mDiagramProvider ) )
     {
+      QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::LabelRegistration );
+
       QgsGeometry obstacleGeometry;
       QgsSymbolList symbols = renderer->originalSymbolsForFeature( fet, context );
       QgsSymbol *symbol = nullptr;
@@ -619,27 +1139,15 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
     return;
   }
 
-  // find out the order
-  QgsSymbolLevelOrder levels;
-  QgsSymbolList symbols = renderer->symbols( context );
-  for ( int i = 0; i < symbols.count(); i++ )
-  {
-    QgsSymbol *sym = symbols[i];
-    for ( int j = 0; j < sym->symbolLayerCount(); j++ )
-    {
-      int level = sym->symbolLayer( j )->renderingPass();
-      if ( level < 0 || level >= 1000 ) // ignore invalid levels
-        continue;
-      QgsSymbolLevelItem item( sym, j );
-      while ( level >= levels.count() ) // append new empty levels
-        levels.append( QgsSymbolLevel() );
-      levels[level].append( item );
-    }
-  }
-
   if ( mApplyClipGeometries )
     context.setFeatureClipGeometry( mClipFeatureGeom );
 
+  if ( context.layerRenderProfile() )
+  {
+    for ( auto it = features.constBegin(); it != features.constEnd(); ++it )
+      context.layerRenderProfile()->addRenderedFeatures( it.value().size() );
+  }
+
   // 2. draw features in correct order
   for ( int l = 0; l < levels.count(); l++ )
   {
@@ -671,7 +1179,10 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
 
         try
         {
-          renderer->renderFeature( *fit, context, layer, sel, drawMarker );
+          {
+            QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+            renderer->renderFeature( *fit, context, layer, sel, drawMarker );
+          }
 
           // as soon as first feature is rendered, we can start showing layer updates.
           // but if we are blocking render updates (so that a previously cached image is being shown), we wait
@@ -694,9 +1205,124 @@ void QgsVectorLayerRenderer::drawRendererLevels( QgsFeatureRenderer *renderer, Q
   stopRenderer( renderer, selRenderer );
 }
 
+bool QgsVectorLayerRenderer::canDrawLevelsToImages( int itemCount )
+{
+  QgsRenderContext &context = *renderContext();
+  if ( !context.testFlag( QgsRenderContext::StreamSymbolLevels ) || itemCount == 0 )
+    return false;
+
+  // symbol layer images are composited with source over
+  if ( context.useAdvancedEffects() && mFeatureBlendMode != QPainter::CompositionMode_SourceOver )
+    return false;
+
+  if ( !hasRasterDestination() )
+    return false;
+
+  const QPaintDevice *device = context.painter()->device();
+  const qint64 imageSize = static_cast< qint64 >( device->width() ) * device->height() * 4;
+  return imageSize * itemCount <= MAX_LEVEL_IMAGES_SIZE;
+}
+
+void QgsVectorLayerRenderer::drawLevelsToImages( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit, const QList< QgsSymbolLevelItem > &items, QgsGeometryEngine *clipEngine, QgsExpressionContextScope *symbolScope )
+{
+  const bool isMainRenderer = renderer == mRenderer;
+  QgsRenderContext &context = *renderContext();
+  QPainter *painter = context.painter();
+  const QImage *destination = static_cast< const QImage * >( painter->device() );
+
+  // indices of the level items of each symbol
+  QHash< QgsSymbol *, QVector< int > > symbolItems;
+  for ( int i = 0; i < items.count(); ++i )
+    symbolItems[ items.at( i ).symbol() ] << i;
+
+  // images are only created for the items which get features
+  std::vector< QImage > images( items.count() );
+  std::vector< std::unique_ptr< QPainter > > painters( items.count() );
+
+  QgsFeature fet;
+  while ( fetchFeature( fit, fet ) )
+  {
+    if ( context.renderingStopped() )
+      break;
+
+    if ( !fet.hasGeometry() )
+      continue; // skip features without geometry
+
+    if ( clipEngine && !clipEngine->intersects( fet.geometry().constGet() ) )
+      continue; // skip features outside of clipping region
+
+    context.expressionContext().setFeature( fet );
+    QgsSymbol *sym = nullptr;
+    {
+      QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+      sym = renderer->symbolForFeature( fet, context );
+    }
+    if ( !sym )
+      continue;
+
+    if ( context.layerRenderProfile() )
+      context.layerRenderProfile()->addRenderedFeatures( 1 );
+
+    const bool sel = isMainRenderer && context.showSelection() && mSelectedFeatureIds.contains( fet.id() );
+    // maybe vertex markers should be drawn only during the last pass...
+    const bool drawMarker = isMainRenderer && ( mDrawVertexMarkers && context.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
+
+    try
+    {
+      if ( mApplyClipGeometries )
+        context.setFeatureClipGeometry( mClipFeatureGeom );
+
+      const QVector< int > featureItems = symbolItems.value( sym );
+      for ( int item : featureItems )
+      {
+        if ( !painters[item] )
+        {
+          images[item] = QImage( destination->size(), QImage::Format_ARGB32_Premultiplied );
+          images[item].setDotsPerMeterX( destination->dotsPerMeterX() );
+          images[item].setDotsPerMeterY( destination->dotsPerMeterY() );
+          images[item].fill( Qt::transparent );
+          painters[item] = qgis::make_unique< QPainter >( &images[item] );
+          painters[item]->setRenderHints( painter->renderHints() );
+        }
+
+        QgsScopedRenderContextPainterSwap swap( context, painters[item].get() );
+        QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
+        renderer->renderFeature( fet, context, items.at( item ).layer(), sel, drawMarker );
+      }
+
+      if ( mApplyClipGeometries )
+        context.setFeatureClipGeometry( QgsGeometry() );
+
+      registerFeatureForLabeling( renderer, fet, symbolScope );
+    }
+    catch ( const QgsCsException &cse )
+    {
+      Q_UNUSED( cse )
+      QgsDebugMsg( QStringLiteral( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                   .arg( fet.id() ).arg( cse.what() ) );
+    }
+  }
+
+  // composite the symbol layer images in level order
+  for ( std::size_t i = 0; i < painters.size(); ++i )
+  {
+    if ( !painters[i] )
+      continue;
+
+    painters[i]->end();
+    if ( !context.renderingStopped() )
+    {
+      painter->drawImage( 0, 0, images[i] );
+      mReadyToCompose = true;
+    }
+  }
+}
+
 void QgsVectorLayerRenderer::stopRenderer( QgsFeatureRenderer *renderer, QgsSingleSymbolRenderer *selRenderer )
 {
   QgsRenderContext &context = *renderContext();
+  // renderers may defer drawing features until they are stopped, e.g. the rule based renderer
+  QgsScopedLayerRenderProfile profile( context.layerRenderProfile(), QgsLayerRenderProfile::FeatureRender );
   renderer->stopRender( context );
   if ( selRenderer )
   {
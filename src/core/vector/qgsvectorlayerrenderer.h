@@ -27,11 +27,16 @@ class QgsDiagramLayerSettings;
 class QgsFeatureIterator;
 class QgsSingleSymbolRenderer;
 class QgsMapClippingRegion;
+class QgsGeometryEngine;
+class QgsExpressionContextScope;
+class QgsSymbolLevelItem;
+class QgsMarkerSymbol;
 
 #define SIP_NO_FILE
 
 #include <QList>
 #include <QPainter>
+#include <QPolygonF>
 #include <QElapsedTimer>
 
 typedef QList<int> QgsAttributeList;
@@ -112,6 +117,70 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
      */
     void drawRendererLevels( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit );
 
+    /**
+     * Returns TRUE if symbol levels with \a itemCount level items can be drawn with drawLevelsToImages().
+     */
+    bool canDrawLevelsToImages( int itemCount );
+
+    /**
+     * Draws the features from \a fit as they are fetched, each symbol layer into its own temporary image.
+     * The images are composited in the order of the symbol level \a items, so the result matches
+     * drawRendererLevels() without keeping all features in memory.
+     * Features without geometry or outside of \a clipEngine are skipped.
+     */
+    void drawLevelsToImages( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit, const QList< QgsSymbolLevelItem > &items, QgsGeometryEngine *clipEngine, QgsExpressionContextScope *symbolScope );
+
+    /**
+     * Returns TRUE if the context paints to an untransformed raster image, so that features can be
+     * drawn into separate images and composited later.
+     */
+    bool hasRasterDestination();
+
+    /**
+     * Returns TRUE if the features of \a renderer can be drawn by worker threads with drawFeaturesParallel().
+     */
+    bool canDrawFeaturesParallel( QgsFeatureRenderer *renderer );
+
+    /**
+     * Draws the features from \a fit in batches, which are painted concurrently by clones of \a renderer,
+     * each into its own image. The part of each image covered by its features and their symbols is
+     * composited onto the context painter in batch order, and
+     * labels and diagrams are registered from the calling thread in feature order, so the output matches
+     * drawing features one by one.
+     * Features without geometry or outside of \a clipEngine are skipped.
+     */
+    void drawFeaturesParallel( QgsFeatureRenderer *renderer, QgsFeatureIterator &fit, QgsGeometryEngine *clipEngine, QgsExpressionContextScope *symbolScope );
+
+    /**
+     * Fetches the next feature from \a fit, adding the time it took to the layer render profile if there is one.
+     */
+    bool fetchFeature( QgsFeatureIterator &fit, QgsFeature &feature );
+
+    //! Draws a single \a feature with \a renderer and registers it for labeling if it was rendered
+    void drawFeature( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope );
+
+    /**
+     * Returns TRUE if the point features drawn by \a renderer look the same for every point of a symbol,
+     * so that consecutive features sharing a symbol can be drawn together with QgsMarkerSymbol::renderPoints().
+     */
+    bool canBatchPoints( QgsFeatureRenderer *renderer );
+
+    /**
+     * Adds the points of \a feature to the current point batch, drawing the batch first if it uses another symbol.
+     * Returns FALSE if the feature is not a point feature and must be drawn by the renderer instead.
+     * \a rendered is set to TRUE if \a renderer has a symbol for the feature.
+     */
+    bool batchPoints( QgsFeatureRenderer *renderer, const QgsFeature &feature, bool &rendered );
+
+    //! Draws and clears the current point batch
+    void flushPointBatch();
+
+    //! Handles a \a feature drawn by \a renderer, registering it with the label and diagram providers
+    void registerRenderedFeature( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope );
+
+    //! Registers a \a feature of \a renderer with the label and diagram providers
+    void registerFeatureForLabeling( QgsFeatureRenderer *renderer, QgsFeature &feature, QgsExpressionContextScope *symbolScope );
+
     //! Stop version 2 renderer and selected renderer (if required)
     void stopRenderer( QgsFeatureRenderer *renderer, QgsSingleSymbolRenderer *selRenderer );
 
@@ -142,6 +211,13 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
 
     QgsWkbTypes::GeometryType mGeometryType;
 
+    //! TRUE if drawFeature() collects point features into batches, see canBatchPoints()
+    bool mBatchPoints = false;
+    //! Symbol of the current point batch
+    QgsMarkerSymbol *mPointBatchSymbol = nullptr;
+    //! Points of the current batch, in painter coordinates
+    QPolygonF mPointBatch;
+
     QSet<QString> mAttrNames;
 
     //! used with old labeling engine (QgsPalLabeling): whether labeling is enabled
@@ -51,6 +51,7 @@ void QgsVectorLayerUndoCommandAddFeature::undo()
   mBuffer->mAddedFeatures.remove( mFeature.id() );
 
   emit mBuffer->featureDeleted( mFeature.id() );
+  emit mBuffer->featuresEdited( mFeature.geometry().boundingBox(), QgsFeatureIds() );
 }
 
 void QgsVectorLayerUndoCommandAddFeature::redo()
@@ -58,6 +59,7 @@ void QgsVectorLayerUndoCommandAddFeature::redo()
   mBuffer->mAddedFeatures.insert( mFeature.id(), mFeature );
 
   emit mBuffer->featureAdded( mFeature.id() );
+  emit mBuffer->featuresEdited( mFeature.geometry().boundingBox(), QgsFeatureIds() );
 }
 
 
@@ -72,6 +74,15 @@ QgsVectorLayerUndoCommandDeleteFeature::QgsVectorLayerUndoCommandDeleteFeature(
     QgsFeatureMap::const_iterator it = mBuffer->mAddedFeatures.constFind( mFid );
     Q_ASSERT( it != mBuffer->mAddedFeatures.constEnd() );
     mOldAddedFeature = it.value();
+    mExtent = mOldAddedFeature.geometry().boundingBox();
+  }
+  else if ( mBuffer->mChangedGeometries.contains( mFid ) )
+  {
+    mExtent = mBuffer->mChangedGeometries.value( mFid ).boundingBox();
+  }
+  else
+  {
+    mProviderFeatureIds << mFid;
   }
 }
 
@@ -87,6 +98,7 @@ void QgsVectorLayerUndoCommandDeleteFeature::undo()
   }
 
   emit mBuffer->featureAdded( mFid );
+  emit mBuffer->featuresEdited( mExtent, mProviderFeatureIds );
 }
 
 void QgsVectorLayerUndoCommandDeleteFeature::redo()
@@ -101,6 +113,7 @@ void QgsVectorLayerUndoCommandDeleteFeature::redo()
   }
 
   emit mBuffer->featureDeleted( mFid );
+  emit mBuffer->featuresEdited( mExtent, mProviderFeatureIds );
 }
 
 
@@ -120,6 +133,16 @@ QgsVectorLayerUndoCommandChangeGeometry::QgsVectorLayerUndoCommandChangeGeometry
   {
     mOldGeom = mBuffer->mChangedGeometries.value( mFid, QgsGeometry() );
   }
+
+  if ( !mOldGeom.isNull() )
+  {
+    mOldExtent = mOldGeom.boundingBox();
+  }
+  else if ( !FID_IS_NEW( mFid ) )
+  {
+    // the feature has not been modified yet, its geometry comes from the provider and is only fetched if needed
+    mProviderFeatureIds << mFid;
+  }
 }
 
 int QgsVectorLayerUndoCommandChangeGeometry::id() const
@@ -177,6 +200,9 @@ void QgsVectorLayerUndoCommandChangeGeometry::undo()
     }
   }
 
+  QgsRectangle extent = mOldExtent;
+  extent.combineExtentWith( mNewGeom.boundingBox() );
+  emit mBuffer->featuresEdited( extent, mProviderFeatureIds );
 }
 
 void QgsVectorLayerUndoCommandChangeGeometry::redo()
@@ -193,6 +219,10 @@ void QgsVectorLayerUndoCommandChangeGeometry::redo()
     mBuffer->mChangedGeometries[ mFid ] = mNewGeom;
   }
   emit mBuffer->geometryChanged( mFid, mNewGeom );
+
+  QgsRectangle extent = mOldExtent;
+  extent.combineExtentWith( mNewGeom.boundingBox() );
+  emit mBuffer->featuresEdited( extent, mProviderFeatureIds );
 }
 
 
@@ -221,6 +251,13 @@ QgsVectorLayerUndoCommandChangeAttribute::QgsVectorLayerUndoCommandChangeAttribu
     mFirstChange = false;
   }
 
+  // only the geometries of features stored in the edit buffer are known without fetching them
+  if ( FID_IS_NEW( mFid ) )
+    mExtent = mBuffer->mAddedFeatures.value( mFid ).geometry().boundingBox();
+  else if ( mBuffer->mChangedGeometries.contains( mFid ) )
+    mExtent = mBuffer->mChangedGeometries.value( mFid ).boundingBox();
+  else
+    mProviderFeatureIds << mFid;
 }
 
 void QgsVectorLayerUndoCommandChangeAttribute::undo()
@@ -260,6 +297,7 @@ void QgsVectorLayerUndoCommandChangeAttribute::undo()
   }
 
   emit mBuffer->attributeValueChanged( mFid, mFieldIndex, original );
+  emit mBuffer->featuresEdited( mExtent, mProviderFeatureIds );
 }
 
 void QgsVectorLayerUndoCommandChangeAttribute::redo()
@@ -283,6 +321,7 @@ void QgsVectorLayerUndoCommandChangeAttribute::redo()
   }
 
   emit mBuffer->attributeValueChanged( mFid, mFieldIndex, mNewValue );
+  emit mBuffer->featuresEdited( mExtent, mProviderFeatureIds );
 }
 
 
@@ -306,6 +345,7 @@ void QgsVectorLayerUndoCommandAddAttribute::undo()
   mBuffer->updateLayerFields();
 
   emit mBuffer->attributeDeleted( mFieldIndex );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
 
 void QgsVectorLayerUndoCommandAddAttribute::redo()
@@ -315,6 +355,7 @@ void QgsVectorLayerUndoCommandAddAttribute::redo()
   mBuffer->updateLayerFields();
 
   emit mBuffer->attributeAdded( mFieldIndex );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
 
 
@@ -396,6 +437,7 @@ void QgsVectorLayerUndoCommandDeleteAttribute::undo()
   mBuffer->L->setEditFormConfig( formConfig );
 
   emit mBuffer->attributeAdded( mFieldIndex );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
 
 void QgsVectorLayerUndoCommandDeleteAttribute::redo()
@@ -414,6 +456,7 @@ void QgsVectorLayerUndoCommandDeleteAttribute::redo()
   mBuffer->handleAttributeDeleted( mFieldIndex ); // update changed attributes + new features
   mBuffer->updateLayerFields();
   emit mBuffer->attributeDeleted( mFieldIndex );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
 
 
@@ -442,6 +485,7 @@ void QgsVectorLayerUndoCommandRenameAttribute::undo()
   }
   mBuffer->updateLayerFields();
   emit mBuffer->attributeRenamed( mFieldIndex, mOldName );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
 
 void QgsVectorLayerUndoCommandRenameAttribute::redo()
@@ -457,4 +501,5 @@ void QgsVectorLayerUndoCommandRenameAttribute::redo()
   }
   mBuffer->updateLayerFields();
   emit mBuffer->attributeRenamed( mFieldIndex, mNewName );
+  emit mBuffer->featuresEdited( QgsRectangle(), QgsFeatureIds() );
 }
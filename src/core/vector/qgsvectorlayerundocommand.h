@@ -109,6 +109,8 @@ class CORE_EXPORT QgsVectorLayerUndoCommandDeleteFeature : public QgsVectorLayer
   private:
     QgsFeatureId mFid;
     QgsFeature mOldAddedFeature;
+    QgsRectangle mExtent;
+    QgsFeatureIds mProviderFeatureIds;
 };
 
 /**
@@ -138,6 +140,8 @@ class CORE_EXPORT QgsVectorLayerUndoCommandChangeGeometry : public QgsVectorLaye
     QgsFeatureId mFid;
     QgsGeometry mOldGeom;
     mutable QgsGeometry mNewGeom;
+    QgsRectangle mOldExtent;
+    QgsFeatureIds mProviderFeatureIds;
 };
 
 
@@ -169,6 +173,8 @@ class CORE_EXPORT QgsVectorLayerUndoCommandChangeAttribute : public QgsVectorLay
     QVariant mOldValue;
     QVariant mNewValue;
     bool mFirstChange;
+    QgsRectangle mExtent;
+    QgsFeatureIds mProviderFeatureIds;
 };
 
 /**
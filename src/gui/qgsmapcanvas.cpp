@@ -200,6 +200,9 @@ QgsMapCanvas::QgsMapCanvas( QWidget *parent )
 
   mWheelZoomFactor = settings.value( QStringLiteral( "qgis/zoom_factor" ), 2 ).toDouble();
 
+  // vector layers may split the drawing of their features across worker threads
+  mSettings.setFlag( QgsMapSettings::ParallelFeatureRendering, settings.value( QStringLiteral( "qgis/parallel_feature_rendering" ), false ).toBool() );
+
   QSize s = viewport()->size();
   mSettings.setOutputSize( s );
   mSettings.setDevicePixelRatio( devicePixelRatio() );
@@ -488,6 +491,15 @@ void QgsMapCanvas::setCachingEnabled( bool enabled )
   if ( enabled )
   {
     mCache = new QgsMapRendererCache;
+
+    QgsSettings settings;
+    if ( settings.value( QStringLiteral( "qgis/map_tile_cache/enabled" ), false ).toBool() )
+    {
+      mCache->setTileCacheEnabled( true );
+      mCache->setMaximumTileCacheMemory( settings.value( QStringLiteral( "qgis/map_tile_cache/max_memory_mb" ), 64 ).toLongLong() * 1024 * 1024 );
+      mCache->setMaximumTileCacheDiskSize( settings.value( QStringLiteral( "qgis/map_tile_cache/max_disk_mb" ), 512 ).toLongLong() * 1024 * 1024 );
+      mCache->setTileCacheDirectory( settings.value( QStringLiteral( "qgis/map_tile_cache/directory" ) ).toString() );
+    }
   }
   else
   {
@@ -2796,6 +2808,10 @@ void QgsMapCanvas::refreshAllLayers()
   for ( QgsMapLayer *layer : layers )
   {
     layer->reload();
+
+    // the layer data may have changed, also drop its tiles stored on disk
+    if ( mCache )
+      mCache->invalidateCacheForLayer( layer );
   }
 
   redrawAllLayers();
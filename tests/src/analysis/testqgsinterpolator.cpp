@@ -16,6 +16,15 @@ Email                : nyall dot dawson at gmail dot com
 
 #include "qgsapplication.h"
 #include "qgsdualedgetriangulation.h"
+#include "qgsidwinterpolator.h"
+#include "qgstininterpolator.h"
+#include "qgsgridfilewriter.h"
+#include "qgsogrutils.h"
+#include "qgsvectorlayer.h"
+#include "qgsvectordataprovider.h"
+
+#include <QTemporaryDir>
+#include <gdal.h>
 
 class TestQgsInterpolator : public QObject
 {
@@ -29,6 +38,9 @@ class TestQgsInterpolator : public QObject
     void init() ;// will be called before each testfunction is executed.
     void cleanup() ;// will be called after every testfunction.
     void dualEdge();
+    void idwNeighbors();
+    void tinConcurrent();
+    void gridFileWriterGeoTiff();
 
   private:
 };
@@ -281,5 +293,197 @@ void TestQgsInterpolator::dualEdge()
 }
 
 
+void TestQgsInterpolator::idwNeighbors()
+{
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=EPSG:3857&field=value:double" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  const QList< QPair< QgsPointXY, double > > points = QList< QPair< QgsPointXY, double > >()
+      << qMakePair( QgsPointXY( 0, 0 ), 1.0 )
+      << qMakePair( QgsPointXY( 10, 0 ), 2.0 )
+      << qMakePair( QgsPointXY( 0, 10 ), 3.0 )
+      << qMakePair( QgsPointXY( 100, 100 ), 50.0 );
+  QgsFeatureList features;
+  for ( const auto &point : points )
+  {
+    QgsFeature f( layer.fields() );
+    f.setGeometry( QgsGeometry::fromPointXY( point.first ) );
+    f.setAttributes( QgsAttributes() << point.second );
+    features << f;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+  QgsInterpolator::LayerData data;
+  data.source = &layer;
+  data.valueSource = QgsInterpolator::ValueAttribute;
+  data.interpolationAttribute = 0;
+  data.sourceType = QgsInterpolator::SourcePoints;
+
+  QgsIDWInterpolator all( QList< QgsInterpolator::LayerData >() << data );
+  QgsIDWInterpolator nearest( QList< QgsInterpolator::LayerData >() << data );
+  QCOMPARE( nearest.maximumNeighbors(), 0 );
+  QCOMPARE( nearest.searchRadius(), 0.0 );
+  QVERIFY( nearest.prepareConcurrentInterpolation() );
+
+  // using as many neighbors as points matches the unrestricted interpolation
+  nearest.setMaximumNeighbors( 4 );
+  QCOMPARE( nearest.maximumNeighbors(), 4 );
+  double expected = 0;
+  double result = 0;
+  QCOMPARE( all.interpolatePoint( 3, 4, expected ), 0 );
+  QCOMPARE( nearest.interpolatePoint( 3, 4, result ), 0 );
+  QGSCOMPARENEAR( result, expected, 1e-10 );
+
+  // coincident points return their value
+  QCOMPARE( nearest.interpolatePoint( 10, 0, result ), 0 );
+  QCOMPARE( result, 2.0 );
+
+  // only the nearest point
+  nearest.setMaximumNeighbors( 1 );
+  QCOMPARE( nearest.interpolatePoint( 1, 1, result ), 0 );
+  QCOMPARE( result, 1.0 );
+  QCOMPARE( nearest.interpolatePoint( 90, 95, result ), 0 );
+  QCOMPARE( result, 50.0 );
+
+  // three nearest points, weighted by inverse squared distance
+  nearest.setMaximumNeighbors( 3 );
+  QCOMPARE( nearest.interpolatePoint( 3, 4, result ), 0 );
+  expected = ( 1.0 / 25 + 2.0 / 65 + 3.0 / 45 ) / ( 1.0 / 25 + 1.0 / 65 + 1.0 / 45 );
+  QGSCOMPARENEAR( result, expected, 1e-10 );
+
+  // search radius, locations without points in range are not interpolated
+  nearest.setMaximumNeighbors( 0 );
+  nearest.setSearchRadius( 9 );
+  QCOMPARE( nearest.searchRadius(), 9.0 );
+  QCOMPARE( nearest.interpolatePoint( 3, 4, result ), 0 );
+  expected = ( 1.0 / 25 + 2.0 / 65 + 3.0 / 45 ) / ( 1.0 / 25 + 1.0 / 65 + 1.0 / 45 );
+  QGSCOMPARENEAR( result, expected, 1e-10 );
+  QCOMPARE( nearest.interpolatePoint( 50, 50, result ), 1 );
+
+  // radius and count combined
+  nearest.setMaximumNeighbors( 1 );
+  QCOMPARE( nearest.interpolatePoint( 3, 4, result ), 0 );
+  QCOMPARE( result, 1.0 );
+}
+
+void TestQgsInterpolator::tinConcurrent()
+{
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=EPSG:3857&field=value:double" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  QgsFeatureList features;
+  const QList< QgsPointXY > corners = QList< QgsPointXY >() << QgsPointXY( 0, 0 ) << QgsPointXY( 100, 0 ) << QgsPointXY( 0, 100 ) << QgsPointXY( 100, 100 );
+  for ( int i = 0; i < 24; ++i )
+  {
+    QgsFeature f( layer.fields() );
+    f.setGeometry( QgsGeometry::fromPointXY( i < corners.size() ? corners.at( i ) : QgsPointXY( ( i * 37 ) % 97 + 1, ( i * 53 ) % 97 + 1 ) ) );
+    f.setAttributes( QgsAttributes() << static_cast< double >( ( i * 7 ) % 11 ) );
+    features << f;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+  QgsInterpolator::LayerData data;
+  data.source = &layer;
+  data.valueSource = QgsInterpolator::ValueAttribute;
+  data.interpolationAttribute = 0;
+  data.sourceType = QgsInterpolator::SourcePoints;
+
+  // Clough-Tocher interpolation stays serial
+  QgsTinInterpolator cloughTocher( QList< QgsInterpolator::LayerData >() << data, QgsTinInterpolator::CloughTocher );
+  QVERIFY( !cloughTocher.prepareConcurrentInterpolation() );
+
+  // the triangle index gives the same values as the triangulation walk
+  QgsTinInterpolator serial( QList< QgsInterpolator::LayerData >() << data, QgsTinInterpolator::Linear );
+  QgsTinInterpolator concurrent( QList< QgsInterpolator::LayerData >() << data, QgsTinInterpolator::Linear );
+  QVERIFY( concurrent.prepareConcurrentInterpolation() );
+  for ( int i = 0; i < 40; ++i )
+  {
+    for ( int j = 0; j < 40; ++j )
+    {
+      const double x = 1.25 + i * 2.5;
+      const double y = 1.25 + j * 2.5;
+      double expected = 0;
+      double result = 0;
+      QCOMPARE( serial.interpolatePoint( x, y, expected, nullptr ), 0 );
+      QCOMPARE( concurrent.interpolatePoint( x, y, result, nullptr ), 0 );
+      QGSCOMPARENEAR( result, expected, 1e-9 );
+    }
+  }
+
+  // outside of the triangulation
+  double result = 0;
+  QCOMPARE( concurrent.interpolatePoint( 150, 50, result, nullptr ), 2 );
+}
+
+void TestQgsInterpolator::gridFileWriterGeoTiff()
+{
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=EPSG:3857&field=value:double" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 20; ++i )
+  {
+    QgsFeature f( layer.fields() );
+    f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( ( i * 37 ) % 100, ( i * 53 ) % 100 ) ) );
+    f.setAttributes( QgsAttributes() << static_cast< double >( i ) );
+    features << f;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+  QgsInterpolator::LayerData data;
+  data.source = &layer;
+  data.valueSource = QgsInterpolator::ValueAttribute;
+  data.interpolationAttribute = 0;
+  data.sourceType = QgsInterpolator::SourcePoints;
+
+  QgsIDWInterpolator interpolator( QList< QgsInterpolator::LayerData >() << data );
+  interpolator.setMaximumNeighbors( 5 );
+  interpolator.setSearchRadius( 20 );
+
+  QTemporaryDir dir;
+  const QString fileName = dir.filePath( QStringLiteral( "idw.tif" ) );
+  // more rows than a GeoTIFF block, to cover partial blocks
+  const int columns = 50;
+  const int rows = 300;
+  const QgsRectangle extent( 0, 0, 100, 100 );
+  QgsGridFileWriter writer( &interpolator, fileName, extent, columns, rows );
+  QCOMPARE( writer.outputFormat(), QgsGridFileWriter::AsciiGrid );
+  writer.setOutputFormat( QgsGridFileWriter::GeoTiff );
+  QCOMPARE( writer.outputFormat(), QgsGridFileWriter::GeoTiff );
+  QCOMPARE( writer.writeFile(), 0 );
+
+  gdal::dataset_unique_ptr dataset( GDALOpen( fileName.toUtf8().constData(), GA_ReadOnly ) );
+  QVERIFY( dataset );
+  QCOMPARE( GDALGetRasterXSize( dataset.get() ), columns );
+  QCOMPARE( GDALGetRasterYSize( dataset.get() ), rows );
+  GDALRasterBandH band = GDALGetRasterBand( dataset.get(), 1 );
+  int hasNoData = 0;
+  QCOMPARE( GDALGetRasterNoDataValue( band, &hasNoData ), -9999.0 );
+  QVERIFY( hasNoData );
+
+  QVector< float > values( columns * rows );
+  QCOMPARE( GDALRasterIO( band, GF_Read, 0, 0, columns, rows, values.data(), columns, rows, GDT_Float32, 0, 0 ), CE_None );
+
+  // compare with direct interpolation at the cell centers
+  const double cellSizeX = extent.width() / columns;
+  const double cellSizeY = extent.height() / rows;
+  double y = extent.yMaximum() - cellSizeY / 2.0;
+  int noDataCells = 0;
+  for ( int i = 0; i < rows; ++i )
+  {
+    double x = extent.xMinimum() + cellSizeX / 2.0;
+    for ( int j = 0; j < columns; ++j )
+    {
+      double expected = 0;
+      if ( interpolator.interpolatePoint( x, y, expected ) != 0 )
+      {
+        expected = -9999;
+        noDataCells++;
+      }
+      QCOMPARE( values.at( i * columns + j ), static_cast< float >( expected ) );
+      x += cellSizeX;
+    }
+    y -= cellSizeY;
+  }
+  QVERIFY( noDataCells > 0 );
+}
+
 QGSTEST_MAIN( TestQgsInterpolator )
 #include "testqgsinterpolator.moc"
@@ -0,0 +1,164 @@
+/***************************************************************************
+  testqgskde.cpp
+  --------------
+  Date                 : March 2021
+  Copyright            : (C) 2021 by QGIS contributors
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgstest.h"
+
+#include "qgsapplication.h"
+#include "qgskde.h"
+#include "qgssettings.h"
+#include "qgsvectorlayer.h"
+#include "qgsvectordataprovider.h"
+
+#include <QTemporaryDir>
+#include <gdal.h>
+
+#include <limits>
+#include <vector>
+
+class TestQgsKde : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();// will be called before the first testfunction is executed.
+    void cleanupTestCase();// will be called after the last testfunction was executed.
+    void cleanup();// will be called after every testfunction.
+    void inMemoryMatchesFile_data();
+    void inMemoryMatchesFile();
+
+  private:
+    std::unique_ptr< QgsVectorLayer > mPointLayer;
+    QTemporaryDir mTempDir;
+
+    QgsKernelDensityEstimation::Result runKde( const QgsKernelDensityEstimation::Parameters &parameters, const QString &outputFile, bool inMemory );
+    static bool readRaster( const QString &file, int &columns, int &rows, std::vector< float > &values );
+};
+
+void TestQgsKde::initTestCase()
+{
+  QCoreApplication::setOrganizationName( QStringLiteral( "QGIS" ) );
+  QCoreApplication::setOrganizationDomain( QStringLiteral( "qgis.org" ) );
+  QCoreApplication::setApplicationName( QStringLiteral( "QGIS-TEST-KDE" ) );
+
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  // points spread over several tiles of the in-memory surface, with overlapping kernels
+  mPointLayer = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "Point?crs=epsg:3857&field=radius:double&field=weight:double" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( mPointLayer->isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 500; ++i )
+  {
+    QgsFeature f( mPointLayer->fields() );
+    f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( ( i * 37 ) % 601 + 0.3 * ( i % 7 ), ( i * 53 ) % 487 + 0.2 * ( i % 5 ) ) ) );
+    f.setAttributes( QgsAttributes() << 5.0 + i % 20 << 0.5 + ( i % 9 ) * 0.25 );
+    features << f;
+  }
+  QVERIFY( mPointLayer->dataProvider()->addFeatures( features ) );
+}
+
+void TestQgsKde::cleanupTestCase()
+{
+  mPointLayer.reset();
+  QgsApplication::exitQgis();
+}
+
+void TestQgsKde::cleanup()
+{
+  QgsSettings().remove( QStringLiteral( "qgis/kde_max_in_memory_cells" ) );
+}
+
+QgsKernelDensityEstimation::Result TestQgsKde::runKde( const QgsKernelDensityEstimation::Parameters &parameters, const QString &outputFile, bool inMemory )
+{
+  // a maximum of 0 cells forces updating the output file for each point
+  QgsSettings().setValue( QStringLiteral( "qgis/kde_max_in_memory_cells" ), inMemory ? std::numeric_limits< qint64 >::max() : 0 );
+
+  QgsKernelDensityEstimation kde( parameters, outputFile, QStringLiteral( "GTiff" ) );
+  return kde.run();
+}
+
+bool TestQgsKde::readRaster( const QString &file, int &columns, int &rows, std::vector< float > &values )
+{
+  gdal::dataset_unique_ptr dataset( GDALOpen( file.toUtf8().constData(), GA_ReadOnly ) );
+  if ( !dataset )
+    return false;
+
+  columns = GDALGetRasterXSize( dataset.get() );
+  rows = GDALGetRasterYSize( dataset.get() );
+  values.resize( static_cast< std::size_t >( columns ) * rows );
+  return GDALRasterIO( GDALGetRasterBand( dataset.get(), 1 ), GF_Read, 0, 0, columns, rows, values.data(), columns, rows, GDT_Float32, 0, 0 ) == CE_None;
+}
+
+void TestQgsKde::inMemoryMatchesFile_data()
+{
+  QTest::addColumn<QString>( "radiusField" );
+  QTest::addColumn<QString>( "weightField" );
+  QTest::addColumn<int>( "shape" );
+  QTest::addColumn<int>( "outputValues" );
+
+  QTest::newRow( "fixed radius" ) << QString() << QString() << static_cast< int >( QgsKernelDensityEstimation::KernelQuartic ) << static_cast< int >( QgsKernelDensityEstimation::OutputRaw );
+  QTest::newRow( "radius and weight fields" ) << QStringLiteral( "radius" ) << QStringLiteral( "weight" ) << static_cast< int >( QgsKernelDensityEstimation::KernelQuartic ) << static_cast< int >( QgsKernelDensityEstimation::OutputRaw );
+  QTest::newRow( "triangular scaled" ) << QString() << QStringLiteral( "weight" ) << static_cast< int >( QgsKernelDensityEstimation::KernelTriangular ) << static_cast< int >( QgsKernelDensityEstimation::OutputScaled );
+  QTest::newRow( "epanechnikov" ) << QStringLiteral( "radius" ) << QString() << static_cast< int >( QgsKernelDensityEstimation::KernelEpanechnikov ) << static_cast< int >( QgsKernelDensityEstimation::OutputScaled );
+}
+
+void TestQgsKde::inMemoryMatchesFile()
+{
+  QFETCH( QString, radiusField );
+  QFETCH( QString, weightField );
+  QFETCH( int, shape );
+  QFETCH( int, outputValues );
+
+  QgsKernelDensityEstimation::Parameters parameters;
+  parameters.source = mPointLayer.get();
+  parameters.radius = 15;
+  parameters.radiusField = radiusField;
+  parameters.weightField = weightField;
+  parameters.pixelSize = 0.7;
+  parameters.shape = static_cast< QgsKernelDensityEstimation::KernelShape >( shape );
+  parameters.decayRatio = 0.5;
+  parameters.outputValues = static_cast< QgsKernelDensityEstimation::OutputValues >( outputValues );
+
+  const QString fileOutput = mTempDir.filePath( QStringLiteral( "kde_file_%1.tif" ).arg( QTest::currentDataTag() ).replace( ' ', '_' ) );
+  const QString memoryOutput = mTempDir.filePath( QStringLiteral( "kde_memory_%1.tif" ).arg( QTest::currentDataTag() ).replace( ' ', '_' ) );
+  QCOMPARE( runKde( parameters, fileOutput, false ), QgsKernelDensityEstimation::Success );
+  QCOMPARE( runKde( parameters, memoryOutput, true ), QgsKernelDensityEstimation::Success );
+
+  int fileColumns = 0;
+  int fileRows = 0;
+  std::vector< float > fileValues;
+  QVERIFY( readRaster( fileOutput, fileColumns, fileRows, fileValues ) );
+  int memoryColumns = 0;
+  int memoryRows = 0;
+  std::vector< float > memoryValues;
+  QVERIFY( readRaster( memoryOutput, memoryColumns, memoryRows, memoryValues ) );
+
+  // the surface spans several tiles
+  QVERIFY( fileColumns > 256 );
+  QVERIFY( fileRows > 256 );
+  QCOMPARE( memoryColumns, fileColumns );
+  QCOMPARE( memoryRows, fileRows );
+
+  // the in-memory surface adds the kernels in the same order, the rasters must be identical
+  int differences = 0;
+  for ( std::size_t i = 0; i < fileValues.size(); ++i )
+  {
+    if ( memoryValues[i] != fileValues[i] )
+      differences++;
+  }
+  QCOMPARE( differences, 0 );
+}
+
+QGSTEST_MAIN( TestQgsKde )
+#include "testqgskde.moc"
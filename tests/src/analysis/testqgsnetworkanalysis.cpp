@@ -25,6 +25,11 @@ Email                : nyall dot dawson at gmail dot com
 #include "qgsgraphbuilder.h"
 #include "qgsgraph.h"
 #include "qgsgraphanalyzer.h"
+#include "qgsgraphrouter.h"
+#include "qgsgraphcontractionhierarchy.h"
+#include "qgscompactgraph.h"
+
+#include <QTemporaryDir>
 
 class TestQgsNetworkAnalysis : public QObject
 {
@@ -43,6 +48,10 @@ class TestQgsNetworkAnalysis : public QObject
     void dijkkjkjkskkjsktra();
     void testRouteFail();
     void testRouteFail2();
+    void testNegativeCost();
+    void testRouter();
+    void testContractionHierarchy();
+    void testCompactGraph();
 
   private:
     std::unique_ptr< QgsVectorLayer > buildNetwork();
@@ -575,7 +584,423 @@ void TestQgsNetworkAnalysis::testRouteFail2()
   QCOMPARE( resultCost.at( endVertexIdx ), 9.01 );
 }
 
+void TestQgsNetworkAnalysis::testNegativeCost()
+{
+  QgsGraph graph;
+  graph.addVertex( QgsPointXY( 0, 0 ) );
+  graph.addVertex( QgsPointXY( 1, 0 ) );
+  graph.addVertex( QgsPointXY( 0, 1 ) );
+  graph.addVertex( QgsPointXY( 2, 0 ) );
+  graph.addEdge( 0, 1, QVector< QVariant >() << 1 );
+  const int edgeTo3 = graph.addEdge( 1, 3, QVector< QVariant >() << 1 );
+  const int edgeTo2 = graph.addEdge( 0, 2, QVector< QVariant >() << 5 );
+  // cheaper path to vertex 1, found after vertices 1 and 3 have been reached through edge 0 -> 1
+  const int negativeEdge = graph.addEdge( 2, 1, QVector< QVariant >() << -5 );
+
+  QVector<int> resultTree;
+  QVector<double> resultCost;
+  QgsGraphAnalyzer::dijkstra( &graph, 0, 0, &resultTree, &resultCost );
+
+  QCOMPARE( resultTree, QVector< int >() << -1 << negativeEdge << edgeTo2 << edgeTo3 );
+  QCOMPARE( resultCost, QVector< double >() << 0.0 << 0.0 << 5.0 << 1.0 );
+}
+
+void TestQgsNetworkAnalysis::testRouter()
+{
+  std::unique_ptr<QgsVectorLayer> network = buildNetwork();
+  // has already a linestring LineString(0 0, 10 0, 10 10)
+
+  QgsFeature ff( 0 );
+  QgsFeatureList flist;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 10, 20 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 2 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 20, 10 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 3 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(20 -10, 20 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 4 );
+  flist << ff;
+  network->dataProvider()->addFeatures( flist );
+
+  std::unique_ptr< QgsVectorLayerDirector > director = qgis::make_unique< QgsVectorLayerDirector > ( network.get(),
+      -1, QString(), QString(), QString(), QgsVectorLayerDirector::DirectionForward );
+  std::unique_ptr< QgsNetworkStrategy > strategy = qgis::make_unique< TestNetworkStrategy >();
+  director->addStrategy( strategy.release() );
+  std::unique_ptr< QgsGraphBuilder > builder = qgis::make_unique< QgsGraphBuilder > ( network->sourceCrs(), true, 0 );
+
+  QVector<QgsPointXY > snapped;
+  director->makeGraph( builder.get(), QVector<QgsPointXY>(), snapped );
+  std::unique_ptr< QgsGraph > graph( builder->graph() );
+
+  const int point_0_0_idx = graph->findVertex( QgsPointXY( 0, 0 ) );
+  const int point_10_0_idx = graph->findVertex( QgsPointXY( 10, 0 ) );
+  const int point_10_10_idx = graph->findVertex( QgsPointXY( 10, 10 ) );
+  const int point_10_20_idx = graph->findVertex( QgsPointXY( 10, 20 ) );
+  const int point_20_10_idx = graph->findVertex( QgsPointXY( 20, 10 ) );
+  const int point_20_n10_idx = graph->findVertex( QgsPointXY( 20, -10 ) );
+
+  QgsGraphRouter router( graph.get(), 0 );
+  QCOMPARE( router.vertexCount(), graph->vertexCount() );
+  QCOMPARE( router.algorithm(), QgsGraphRouter::AStar );
+
+  // all algorithms must agree with a full dijkstra tree
+  QVector<int> resultTree;
+  QVector<double> resultCost;
+  for ( QgsGraphRouter::Algorithm algorithm : { QgsGraphRouter::Dijkstra, QgsGraphRouter::BidirectionalDijkstra, QgsGraphRouter::AStar } )
+  {
+    router.setAlgorithm( algorithm );
+    for ( int from = 0; from < graph->vertexCount(); ++from )
+    {
+      QgsGraphAnalyzer::dijkstra( graph.get(), from, 0, &resultTree, &resultCost );
+      for ( int to = 0; to < graph->vertexCount(); ++to )
+      {
+        double cost = -1;
+        const QVector< int > path = router.shortestPath( from, to, &cost );
+        if ( std::isinf( resultCost.at( to ) ) )
+        {
+          QVERIFY( std::isinf( cost ) );
+          QVERIFY( path.isEmpty() );
+          continue;
+        }
+        QCOMPARE( cost, resultCost.at( to ) );
+        if ( from == to )
+        {
+          QVERIFY( path.isEmpty() );
+          continue;
+        }
+
+        // path must be connected and go from start to end
+        int vertex = from;
+        double pathCost = 0;
+        for ( int edgeId : path )
+        {
+          QCOMPARE( graph->edge( edgeId ).fromVertex(), vertex );
+          vertex = graph->edge( edgeId ).toVertex();
+          pathCost += graph->edge( edgeId ).cost( 0 ).toDouble();
+        }
+        QCOMPARE( vertex, to );
+        QCOMPARE( pathCost, cost );
+      }
+    }
+  }
+
+  double cost = 0;
+  QVERIFY( router.shortestPath( point_10_20_idx, point_0_0_idx, &cost ).isEmpty() );
+  QVERIFY( std::isinf( cost ) );
+  QVERIFY( router.shortestPath( -1, point_0_0_idx, &cost ).isEmpty() );
+  QVERIFY( std::isinf( cost ) );
+
+  // forward tree
+  QVERIFY( !router.shortestTree( -1, resultTree, resultCost ) );
+  QVERIFY( router.shortestTree( point_0_0_idx, resultTree, resultCost ) );
+  QCOMPARE( resultTree.at( point_0_0_idx ), -1 );
+  QCOMPARE( resultCost.at( point_0_0_idx ), 0.0 );
+  QCOMPARE( resultCost.at( point_10_0_idx ), 1.0 );
+  QCOMPARE( resultCost.at( point_10_10_idx ), 2.0 );
+  QCOMPARE( resultCost.at( point_20_10_idx ), 4.0 );
+  QCOMPARE( resultTree.at( point_10_20_idx ), -1 );
+  QCOMPARE( resultTree.at( point_20_n10_idx ), -1 );
+
+  // limited forward tree
+  QVERIFY( router.shortestTree( point_0_0_idx, resultTree, resultCost, QgsGraphRouter::Forward, 2.5 ) );
+  QCOMPARE( resultCost.at( point_10_10_idx ), 2.0 );
+  QCOMPARE( resultTree.at( point_20_10_idx ), -1 );
+  QVERIFY( std::isinf( resultCost.at( point_20_10_idx ) ) );
+
+  // backward tree, edges lead towards 20 10
+  QVERIFY( router.shortestTree( point_20_10_idx, resultTree, resultCost, QgsGraphRouter::Backward ) );
+  QCOMPARE( resultTree.at( point_20_10_idx ), -1 );
+  QCOMPARE( resultCost.at( point_0_0_idx ), 4.0 );
+  QCOMPARE( graph->edge( resultTree.at( point_0_0_idx ) ).fromVertex(), point_0_0_idx );
+  QCOMPARE( graph->edge( resultTree.at( point_0_0_idx ) ).toVertex(), point_10_0_idx );
+  QCOMPARE( resultCost.at( point_10_20_idx ), 5.0 );
+  QCOMPARE( graph->edge( resultTree.at( point_10_20_idx ) ).toVertex(), point_10_10_idx );
+  QCOMPARE( resultCost.at( point_20_n10_idx ), 4.0 );
+  QCOMPARE( graph->edge( resultTree.at( point_20_n10_idx ) ).toVertex(), point_20_10_idx );
+
+  // copies share the graph but not the search state
+  QgsGraphRouter copy( router );
+  QCOMPARE( copy.algorithm(), router.algorithm() );
+  copy.shortestPath( point_0_0_idx, point_20_10_idx, &cost );
+  QCOMPARE( cost, 4.0 );
+}
+
+void TestQgsNetworkAnalysis::testContractionHierarchy()
+{
+  std::unique_ptr<QgsVectorLayer> network = buildNetwork();
+  // has already a linestring LineString(0 0, 10 0, 10 10)
+
+  QgsFeature ff( 0 );
+  QgsFeatureList flist;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 10, 20 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 2 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 20, 10 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 3 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(20 -10, 20 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 4 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(20 10, 30 10, 30 0, 10 0 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 1 );
+  flist << ff;
+  network->dataProvider()->addFeatures( flist );
+
+  std::unique_ptr< QgsVectorLayerDirector > director = qgis::make_unique< QgsVectorLayerDirector > ( network.get(),
+      -1, QString(), QString(), QString(), QgsVectorLayerDirector::DirectionForward );
+  std::unique_ptr< QgsNetworkStrategy > strategy = qgis::make_unique< TestNetworkStrategy >();
+  director->addStrategy( strategy.release() );
+  std::unique_ptr< QgsGraphBuilder > builder = qgis::make_unique< QgsGraphBuilder > ( network->sourceCrs(), true, 0 );
+
+  QVector<QgsPointXY > snapped;
+  director->makeGraph( builder.get(), QVector<QgsPointXY>(), snapped );
+  std::unique_ptr< QgsGraph > graph( builder->graph() );
+
+  QgsGraphContractionHierarchy hierarchy;
+  QVERIFY( !hierarchy.isValid() );
+  QVERIFY( !hierarchy.isBuiltFor( graph.get(), 0 ) );
+  QVERIFY( hierarchy.shortestPath( 0, 1 ).isEmpty() );
+
+  QVERIFY( hierarchy.build( graph.get(), 0 ) );
+  QVERIFY( hierarchy.isValid() );
+  QVERIFY( hierarchy.isBuiltFor( graph.get(), 0 ) );
+  QCOMPARE( hierarchy.vertexCount(), graph->vertexCount() );
+
+  // paths and costs must match a plain dijkstra search
+  QgsGraphRouter router( graph.get(), 0 );
+  router.setAlgorithm( QgsGraphRouter::Dijkstra );
+  QVector< int > vertices;
+  for ( int i = 0; i < graph->vertexCount(); ++i )
+    vertices << i;
+  vertices << -1;
+
+  const QVector< double > matrix = hierarchy.costMatrix( vertices, vertices );
+  QCOMPARE( matrix.size(), vertices.size() * vertices.size() );
+  for ( int i = 0; i < vertices.size(); ++i )
+  {
+    for ( int j = 0; j < vertices.size(); ++j )
+    {
+      const int from = vertices.at( i );
+      const int to = vertices.at( j );
+      double expected = 0;
+      router.shortestPath( from, to, &expected );
+      const double matrixCost = matrix.at( i * vertices.size() + j );
+      double cost = -1;
+      const QVector< int > path = hierarchy.shortestPath( from, to, &cost );
+      if ( std::isinf( expected ) )
+      {
+        QVERIFY( std::isinf( matrixCost ) );
+        QVERIFY( std::isinf( cost ) );
+        QVERIFY( path.isEmpty() );
+        continue;
+      }
+      QCOMPARE( matrixCost, expected );
+      QCOMPARE( cost, expected );
+
+      // shortcuts must be unpacked into connected graph edges
+      int vertex = from;
+      double pathCost = 0;
+      for ( int edgeId : path )
+      {
+        QCOMPARE( graph->edge( edgeId ).fromVertex(), vertex );
+        vertex = graph->edge( edgeId ).toVertex();
+        pathCost += graph->edge( edgeId ).cost( 0 ).toDouble();
+      }
+      QCOMPARE( vertex, to );
+      QCOMPARE( pathCost, cost );
+    }
+  }
+
+  // round trip through a file
+  QTemporaryDir dir;
+  const QString path = dir.filePath( QStringLiteral( "network.qch" ) );
+  QVERIFY( hierarchy.writeToFile( path ) );
+  QgsGraphContractionHierarchy restored;
+  QVERIFY( restored.readFromFile( path ) );
+  QVERIFY( restored.isBuiltFor( graph.get(), 0 ) );
+  QVERIFY( !restored.isBuiltFor( graph.get(), 1 ) );
+  QCOMPARE( restored.shortcutCount(), hierarchy.shortcutCount() );
+  QCOMPARE( restored.costMatrix( vertices, vertices ), matrix );
+
+  QVERIFY( !restored.readFromFile( dir.filePath( QStringLiteral( "missing.qch" ) ) ) );
+  QVERIFY( !restored.isValid() );
+
+  // corrupted files are rejected without allocating the sizes they claim
+  QFile file( path );
+  QVERIFY( file.open( QIODevice::ReadOnly ) );
+  const QByteArray contents = file.readAll();
+  file.close();
+
+  QByteArray corrupted = contents;
+  {
+    // size of the second vector, after the header and the vertex ranks
+    QDataStream stream( &corrupted, QIODevice::ReadWrite );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    stream.device()->seek( 32 + 8 + 4 * static_cast< qint64 >( graph->vertexCount() ) );
+    stream << ( static_cast< qint64 >( 1 ) << 40 );
+  }
+  const QString corruptedPath = dir.filePath( QStringLiteral( "corrupted.qch" ) );
+  QFile corruptedFile( corruptedPath );
+  QVERIFY( corruptedFile.open( QIODevice::WriteOnly ) );
+  corruptedFile.write( corrupted );
+  corruptedFile.close();
+  QVERIFY( !restored.readFromFile( corruptedPath ) );
+  QVERIFY( !restored.isValid() );
+
+  // shortcuts made of each other would never be unpacked
+  QByteArray cyclic = contents;
+  {
+    QDataStream stream( &cyclic, QIODevice::ReadWrite );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    const qint64 arcsStart = 32 + 8 + 4 * static_cast< qint64 >( graph->vertexCount() );
+    stream.device()->seek( arcsStart );
+    qint64 arcCount = 0;
+    stream >> arcCount;
+    QVERIFY( arcCount >= 2 );
+    // arcs are stored as from, to, edge, first and second vectors
+    auto setArcValue = [&stream, arcsStart, arcCount]( int vector, int arc, qint32 value ) -> void
+    {
+      stream.device()->seek( arcsStart + vector * ( 8 + 4 * arcCount ) + 8 + 4 * arc );
+      stream << value;
+    };
+    for ( int arc = 0; arc < 2; ++arc )
+    {
+      setArcValue( 2, arc, -1 );
+      setArcValue( 3, arc, 1 - arc );
+      setArcValue( 4, arc, 1 - arc );
+    }
+  }
+  const QString cyclicPath = dir.filePath( QStringLiteral( "cyclic.qch" ) );
+  QFile cyclicFile( cyclicPath );
+  QVERIFY( cyclicFile.open( QIODevice::WriteOnly ) );
+  cyclicFile.write( cyclic );
+  cyclicFile.close();
+  QVERIFY( !restored.readFromFile( cyclicPath ) );
+  QVERIFY( !restored.isValid() );
+
+  const QString truncatedPath = dir.filePath( QStringLiteral( "truncated.qch" ) );
+  QFile truncatedFile( truncatedPath );
+  QVERIFY( truncatedFile.open( QIODevice::WriteOnly ) );
+  truncatedFile.write( contents.left( contents.size() / 2 ) );
+  truncatedFile.close();
+  QVERIFY( !restored.readFromFile( truncatedPath ) );
+  QVERIFY( !restored.isValid() );
+
+  // a hierarchy does not match a modified graph
+  graph->addVertex( QgsPointXY( 100, 100 ) );
+  QVERIFY( !hierarchy.isBuiltFor( graph.get(), 0 ) );
+}
+
+void TestQgsNetworkAnalysis::testCompactGraph()
+{
+  std::unique_ptr<QgsVectorLayer> network = buildNetwork();
+  // has already a linestring LineString(0 0, 10 0, 10 10)
+
+  QgsFeature ff( 0 );
+  QgsFeatureList flist;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 10, 20 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 2 );
+  flist << ff;
+  ff.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 20, 10 10 )" ) ) );
+  ff.setAttributes( QgsAttributes() << 3 );
+  flist << ff;
+  network->dataProvider()->addFeatures( flist );
+
+  std::unique_ptr< QgsVectorLayerDirector > director = qgis::make_unique< QgsVectorLayerDirector > ( network.get(),
+      -1, QString(), QString(), QString(), QgsVectorLayerDirector::DirectionBoth );
+  std::unique_ptr< QgsNetworkStrategy > strategy = qgis::make_unique< TestNetworkStrategy >();
+  director->addStrategy( strategy.release() );
+
+  // the same director must produce identical graphs with both builders
+  QVector<QgsPointXY > snapped;
+  std::unique_ptr< QgsGraphBuilder > builder = qgis::make_unique< QgsGraphBuilder > ( network->sourceCrs(), true, 0 );
+  director->makeGraph( builder.get(), QVector<QgsPointXY>() << QgsPointXY( 5, 1 ), snapped );
+  std::unique_ptr< QgsGraph > graph( builder->graph() );
+
+  QVector<QgsPointXY > compactSnapped;
+  QgsCompactGraphBuilder compactBuilder( network->sourceCrs(), true, 0 );
+  director->makeGraph( &compactBuilder, QVector<QgsPointXY>() << QgsPointXY( 5, 1 ), compactSnapped );
+  std::unique_ptr< QgsCompactGraph > compact( compactBuilder.graph() );
+
+  QCOMPARE( compactSnapped, snapped );
+  QCOMPARE( compact->vertexCount(), graph->vertexCount() );
+  QCOMPARE( compact->edgeCount(), graph->edgeCount() );
+  QCOMPARE( compact->strategyCount(), 1 );
+  for ( int i = 0; i < graph->vertexCount(); ++i )
+  {
+    QCOMPARE( compact->vertexPoint( i ), graph->vertex( i ).point() );
+    QCOMPARE( compact->findVertex( graph->vertex( i ).point() ), i );
+    QCOMPARE( compact->outgoingEdges( i ).toList(), graph->vertex( i ).outgoingEdges() );
+    QCOMPARE( compact->incomingEdges( i ).toList(), graph->vertex( i ).incomingEdges() );
+  }
+  for ( int i = 0; i < graph->edgeCount(); ++i )
+  {
+    QCOMPARE( compact->edgeFromVertex( i ), graph->edge( i ).fromVertex() );
+    QCOMPARE( compact->edgeToVertex( i ), graph->edge( i ).toVertex() );
+    QCOMPARE( compact->edgeCost( i, 0 ), graph->edge( i ).cost( 0 ).toDouble() );
+  }
+  QCOMPARE( compact->findVertex( QgsPointXY( 100, 100 ) ), -1 );
+
+  // builder is reset after returning the graph
+  std::unique_ptr< QgsCompactGraph > empty( compactBuilder.graph() );
+  QCOMPARE( empty->vertexCount(), 0 );
+  QCOMPARE( empty->edgeCount(), 0 );
+
+  // conversions keep indices
+  QgsCompactGraph converted( graph.get() );
+  QCOMPARE( converted.edgeCount(), graph->edgeCount() );
+  QCOMPARE( converted.strategyCosts( 0 ), compact->strategyCosts( 0 ) );
+  std::unique_ptr< QgsGraph > roundTrip( compact->toGraph() );
+  QCOMPARE( roundTrip->vertexCount(), graph->vertexCount() );
+  QCOMPARE( roundTrip->edge( 3 ).toVertex(), graph->edge( 3 ).toVertex() );
+
+  // analysis results must match the ones on QgsGraph
+  for ( int start = 0; start < graph->vertexCount(); ++start )
+  {
+    QVector<int> resultTree;
+    QVector<double> resultCost;
+    QgsGraphAnalyzer::dijkstra( graph.get(), start, 0, &resultTree, &resultCost );
+    QVector<int> compactTree;
+    QVector<double> compactCost;
+    QgsGraphAnalyzer::dijkstra( compact.get(), start, 0, &compactTree, &compactCost );
+    QCOMPARE( compactTree, resultTree );
+    QCOMPARE( compactCost, resultCost );
+
+    std::unique_ptr< QgsGraph > tree( QgsGraphAnalyzer::shortestTree( compact.get(), start, 0 ) );
+    std::unique_ptr< QgsGraph > expectedTree( QgsGraphAnalyzer::shortestTree( graph.get(), start, 0 ) );
+    QCOMPARE( tree->vertexCount(), expectedTree->vertexCount() );
+    QCOMPARE( tree->edgeCount(), expectedTree->edgeCount() );
+  }
 
+  const int from = compact->findVertex( QgsPointXY( 0, 0 ) );
+  const int to = compact->findVertex( QgsPointXY( 10, 20 ) );
+  QgsGraphRouter router( compact.get(), 0 );
+  double cost = 0;
+  const QVector< int > path = router.shortestPath( from, to, &cost );
+  QVERIFY( !path.isEmpty() );
+  QCOMPARE( compact->edgeFromVertex( path.first() ), from );
+  QCOMPARE( compact->edgeToVertex( path.last() ), to );
+
+  // searches over the compact graph arrays must match the ones over the QgsGraph
+  QgsGraphRouter graphRouter( graph.get(), 0 );
+  for ( QgsGraphRouter::Algorithm algorithm : { QgsGraphRouter::Dijkstra, QgsGraphRouter::BidirectionalDijkstra, QgsGraphRouter::AStar } )
+  {
+    router.setAlgorithm( algorithm );
+    graphRouter.setAlgorithm( algorithm );
+    double expectedCost = 0;
+    QCOMPARE( router.shortestPath( from, to, &cost ), graphRouter.shortestPath( from, to, &expectedCost ) );
+    QCOMPARE( cost, expectedCost );
+  }
+  QVector< int > backwardTree;
+  QVector< double > backwardCost;
+  QVERIFY( router.shortestTree( to, backwardTree, backwardCost, QgsGraphRouter::Backward ) );
+  QVector< int > expectedBackwardTree;
+  QVector< double > expectedBackwardCost;
+  QVERIFY( graphRouter.shortestTree( to, expectedBackwardTree, expectedBackwardCost, QgsGraphRouter::Backward ) );
+  QCOMPARE( backwardTree, expectedBackwardTree );
+  QCOMPARE( backwardCost, expectedBackwardCost );
+}
 
 QGSTEST_MAIN( TestQgsNetworkAnalysis )
 #include "testqgsnetworkanalysis.moc"
@@ -28,6 +28,7 @@
 #endif
 
 #include <QDir>
+#include <vector>
 
 // If true regenerate raster reference images
 const bool REGENERATE_REFERENCES = false;
@@ -47,6 +48,7 @@ class TestNineCellFilters : public QObject
     void testAspect();
     void testRuggedness();
     void testTotalCurvature();
+    void testRowProcessing();
 #ifdef HAVE_OPENCL
     void testHillshadeCl();
     void testSlopeCl();
@@ -60,6 +62,8 @@ class TestNineCellFilters : public QObject
 
     template <class T> void _testAlg( const QString &name, bool useOpenCl = false );
 
+    template <class T> void _testRow( const QString &name );
+
     static QString referenceFile( const QString &name )
     {
       return QStringLiteral( "%1/analysis/%2.tif" ).arg( TEST_DATA_DIR, name );
@@ -215,6 +219,55 @@ void TestNineCellFilters::testTotalCurvature()
   _testAlg<QgsTotalCurvatureFilter>( QStringLiteral( "totalcurvature" ) );
 }
 
+template <class T>
+void TestNineCellFilters::_testRow( const QString &name )
+{
+  T ninecellFilter( SRC_FILE, tempFile( name ), "GTiff" );
+  QgsNineCellFilter &filter = ninecellFilter;
+  filter.setCellSizeX( 2.5 );
+  filter.setCellSizeY( 3 );
+  filter.setZFactor( 1.7 );
+  filter.setInputNodataValue( -9999 );
+  filter.setOutputNodataValue( -9999 );
+
+  // three rows of 50 cells with nodata padding, flat areas and scattered nodata cells
+  const int count = 50;
+  std::vector< float > rows[3];
+  for ( int row = 0; row < 3; ++row )
+  {
+    rows[row].resize( count + 2 );
+    for ( int i = 0; i < count + 2; ++i )
+    {
+      if ( i == 0 || i == count + 1 || ( i * 7 + row * 3 ) % 11 == 0 )
+        rows[row][i] = -9999;
+      else if ( i > 40 )
+        rows[row][i] = 5;
+      else
+        rows[row][i] = static_cast< float >( ( i * 37 + row * 91 ) % 100 ) / 3.0f;
+    }
+  }
+
+  std::vector< float > result( count );
+  filter.processNineCellRow( rows[0].data(), rows[1].data(), rows[2].data(), result.data(), count );
+
+  for ( int i = 0; i < count; ++i )
+  {
+    const float expected = filter.processNineCellWindow( &rows[0][i], &rows[0][i + 1], &rows[0][i + 2],
+                           &rows[1][i], &rows[1][i + 1], &rows[1][i + 2],
+                           &rows[2][i], &rows[2][i + 1], &rows[2][i + 2] );
+    QCOMPARE( result[i], expected );
+  }
+}
+
+void TestNineCellFilters::testRowProcessing()
+{
+  // row kernels must give the same results as the per cell calculation
+  _testRow<QgsSlopeFilter>( QStringLiteral( "slope" ) );
+  _testRow<QgsAspectFilter>( QStringLiteral( "aspect" ) );
+  _testRow<QgsHillshadeFilter>( QStringLiteral( "hillshade" ) );
+  _testRow<QgsRuggednessFilter>( QStringLiteral( "ruggedness" ) );
+  _testRow<QgsTotalCurvatureFilter>( QStringLiteral( "totalcurvature" ) );
+}
 
 QGSTEST_MAIN( TestNineCellFilters )
 
@@ -58,6 +58,14 @@
 #include "qgsrenderchecker.h"
 #include "qgsrelationmanager.h"
 #include "qgsmeshlayer.h"
+#include "qgsvectorlayerdirector.h"
+#include "qgsnetworkdistancestrategy.h"
+#include "qgsgraphbuilder.h"
+#include "qgsgraph.h"
+#include "qgsgraphanalyzer.h"
+
+#include <QTemporaryDir>
+#include <QThreadPool>
 
 class TestQgsProcessingAlgs: public QObject
 {
@@ -181,6 +189,9 @@ class TestQgsProcessingAlgs: public QObject
 
     void rasterize();
 
+    void shortestPathCostMatrix();
+    void serviceAreaFromLayerParallel();
+
   private:
 
     bool imageCheck( const QString &testName, const QString &renderedImage );
@@ -6669,6 +6680,223 @@ void TestQgsProcessingAlgs::exportMeshTimeSeries()
   outputFile.close();
 }
 
+void TestQgsProcessingAlgs::shortestPathCostMatrix()
+{
+  std::unique_ptr< QgsProcessingAlgorithm > alg( QgsApplication::processingRegistry()->createAlgorithmById( QStringLiteral( "native:shortestpathcostmatrix" ) ) );
+  QVERIFY( alg != nullptr );
+
+  std::unique_ptr< QgsVectorLayer > network = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "LineString?crs=epsg:3857" ), QStringLiteral( "network" ), QStringLiteral( "memory" ) );
+  QgsFeature f;
+  QgsFeatureList features;
+  for ( const QString &wkt : QStringList() << QStringLiteral( "LineString(0 0, 10 0)" ) << QStringLiteral( "LineString(10 0, 10 10)" )
+        << QStringLiteral( "LineString(0 0, 0 20)" ) << QStringLiteral( "LineString(0 20, 10 10)" ) << QStringLiteral( "LineString(30 30, 40 30)" ) )
+  {
+    f.setGeometry( QgsGeometry::fromWkt( wkt ) );
+    features << f;
+  }
+  network->dataProvider()->addFeatures( features );
+
+  std::unique_ptr< QgsVectorLayer > startPoints = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "Point?crs=epsg:3857" ), QStringLiteral( "start" ), QStringLiteral( "memory" ) );
+  features.clear();
+  for ( const QgsPointXY &point : QVector< QgsPointXY >() << QgsPointXY( 0, 0 ) << QgsPointXY( 10, 10 ) )
+  {
+    f.setGeometry( QgsGeometry::fromPointXY( point ) );
+    features << f;
+  }
+  startPoints->dataProvider()->addFeatures( features );
+
+  // the last end point is on a disconnected part of the network
+  std::unique_ptr< QgsVectorLayer > endPoints = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "Point?crs=epsg:3857" ), QStringLiteral( "end" ), QStringLiteral( "memory" ) );
+  features.clear();
+  for ( const QgsPointXY &point : QVector< QgsPointXY >() << QgsPointXY( 10, 0 ) << QgsPointXY( 0, 20 ) << QgsPointXY( 10, 10 ) << QgsPointXY( 40, 30 ) )
+  {
+    f.setGeometry( QgsGeometry::fromPointXY( point ) );
+    features << f;
+  }
+  endPoints->dataProvider()->addFeatures( features );
+
+  // expected costs from a plain dijkstra search on the same graph
+  QgsVectorLayerDirector director( network.get(), -1, QString(), QString(), QString(), QgsVectorLayerDirector::DirectionBoth );
+  director.addStrategy( new QgsNetworkDistanceStrategy() );
+  QgsGraphBuilder builder( network->sourceCrs(), true, 0 );
+  QVector< QgsPointXY > points;
+  for ( QgsVectorLayer *layer : { startPoints.get(), endPoints.get() } )
+  {
+    QgsFeatureIterator it = layer->getFeatures();
+    while ( it.nextFeature( f ) )
+      points << f.geometry().asPoint();
+  }
+  QVector< QgsPointXY > snapped;
+  director.makeGraph( &builder, points, snapped );
+  std::unique_ptr< QgsGraph > graph( builder.graph() );
+  QMap< QPair< QgsFeatureId, QgsFeatureId >, QVariant > expected;
+  for ( int i = 0; i < 2; ++i )
+  {
+    QVector< double > costs;
+    QgsGraphAnalyzer::dijkstra( graph.get(), graph->findVertex( snapped.at( i ) ), 0, nullptr, &costs );
+    for ( int j = 0; j < 4; ++j )
+    {
+      const double cost = costs.at( graph->findVertex( snapped.at( 2 + j ) ) );
+      expected.insert( qMakePair( static_cast< QgsFeatureId >( i + 1 ), static_cast< QgsFeatureId >( j + 1 ) ), std::isinf( cost ) ? QVariant() : QVariant( cost ) );
+    }
+  }
+  QVERIFY( expected.value( qMakePair( 1LL, 4LL ) ).isNull() );
+
+  QgsProject project;
+  project.setCrs( QgsCoordinateReferenceSystem( QStringLiteral( "EPSG:3857" ) ) );
+  std::unique_ptr< QgsProcessingContext > context = qgis::make_unique< QgsProcessingContext >();
+  context->setProject( &project );
+  QgsProcessingFeedback feedback;
+
+  QTemporaryDir dir;
+  const QString hierarchyPath = dir.filePath( QStringLiteral( "network.qch" ) );
+
+  QVariantMap parameters;
+  parameters.insert( QStringLiteral( "INPUT" ), QVariant::fromValue< QgsMapLayer * >( network.get() ) );
+  parameters.insert( QStringLiteral( "START_POINTS" ), QVariant::fromValue< QgsMapLayer * >( startPoints.get() ) );
+  parameters.insert( QStringLiteral( "END_POINTS" ), QVariant::fromValue< QgsMapLayer * >( endPoints.get() ) );
+  parameters.insert( QStringLiteral( "STRATEGY" ), 0 );
+  parameters.insert( QStringLiteral( "OUTPUT" ), QgsProcessing::TEMPORARY_OUTPUT );
+  parameters.insert( QStringLiteral( "HIERARCHY_OUTPUT" ), hierarchyPath );
+
+  auto checkCosts = [&expected, &context]( const QVariantMap & results )
+  {
+    QgsVectorLayer *output = qobject_cast< QgsVectorLayer * >( context->getMapLayer( results.value( QStringLiteral( "OUTPUT" ) ).toString() ) );
+    QVERIFY( output );
+    QCOMPARE( output->featureCount(), 8L );
+    QgsFeature feature;
+    QgsFeatureIterator it = output->getFeatures();
+    while ( it.nextFeature( feature ) )
+    {
+      const QPair< QgsFeatureId, QgsFeatureId > key = qMakePair( feature.attribute( QStringLiteral( "origin_id" ) ).toLongLong(), feature.attribute( QStringLiteral( "destination_id" ) ).toLongLong() );
+      QVERIFY( expected.contains( key ) );
+      const QVariant cost = feature.attribute( QStringLiteral( "cost" ) );
+      if ( expected.value( key ).isNull() )
+      {
+        QVERIFY( cost.isNull() );
+      }
+      else
+      {
+        QGSCOMPARENEAR( cost.toDouble(), expected.value( key ).toDouble(), 1e-9 );
+      }
+    }
+  };
+
+  bool ok = false;
+  QVariantMap results = alg->run( parameters, *context, &feedback, &ok );
+  QVERIFY( ok );
+  checkCosts( results );
+  QCOMPARE( results.value( QStringLiteral( "HIERARCHY_OUTPUT" ) ).toString(), hierarchyPath );
+  QVERIFY( QFile::exists( hierarchyPath ) );
+
+  // the saved hierarchy is read back by the next run, without writing another one
+  parameters.insert( QStringLiteral( "HIERARCHY" ), hierarchyPath );
+  parameters.remove( QStringLiteral( "HIERARCHY_OUTPUT" ) );
+  QgsProcessingFeedback reuseFeedback;
+  results = alg->run( parameters, *context, &reuseFeedback, &ok );
+  QVERIFY( ok );
+  checkCosts( results );
+  QVERIFY( reuseFeedback.textLog().contains( QStringLiteral( "Using contraction hierarchy from" ) ) );
+  QVERIFY( !results.contains( QStringLiteral( "HIERARCHY_OUTPUT" ) ) || results.value( QStringLiteral( "HIERARCHY_OUTPUT" ) ).toString().isEmpty() );
+
+  // a hierarchy built for another network is not used, the added edge does not change the costs
+  f.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(10 0, 20 0)" ) ) );
+  network->dataProvider()->addFeature( f );
+  QgsProcessingFeedback rebuildFeedback;
+  results = alg->run( parameters, *context, &rebuildFeedback, &ok );
+  QVERIFY( ok );
+  checkCosts( results );
+  QVERIFY( !rebuildFeedback.textLog().contains( QStringLiteral( "Using contraction hierarchy from" ) ) );
+}
+void TestQgsProcessingAlgs::serviceAreaFromLayerParallel()
+{
+  std::unique_ptr< QgsProcessingAlgorithm > alg( QgsApplication::processingRegistry()->createAlgorithmById( QStringLiteral( "native:serviceareafromlayer" ) ) );
+  QVERIFY( alg != nullptr );
+
+  // grid network, with a vertex at each crossing
+  std::unique_ptr< QgsVectorLayer > network = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "LineString?crs=epsg:3857" ), QStringLiteral( "network" ), QStringLiteral( "memory" ) );
+  QgsFeature f;
+  QgsFeatureList features;
+  for ( int i = 0; i <= 10; ++i )
+  {
+    for ( int j = 0; j < 10; ++j )
+    {
+      f.setGeometry( QgsGeometry::fromPolylineXY( QgsPolylineXY() << QgsPointXY( j * 10, i * 10 ) << QgsPointXY( ( j + 1 ) * 10, i * 10 ) ) );
+      features << f;
+      f.setGeometry( QgsGeometry::fromPolylineXY( QgsPolylineXY() << QgsPointXY( i * 10, j * 10 ) << QgsPointXY( i * 10, ( j + 1 ) * 10 ) ) );
+      features << f;
+    }
+  }
+  network->dataProvider()->addFeatures( features );
+
+  // enough origins for several batches, each split between the threads
+  std::unique_ptr< QgsVectorLayer > startPoints = qgis::make_unique< QgsVectorLayer >( QStringLiteral( "Point?crs=epsg:3857&field=id:integer" ), QStringLiteral( "start" ), QStringLiteral( "memory" ) );
+  features.clear();
+  for ( int i = 0; i < 300; ++i )
+  {
+    QgsFeature point( startPoints->fields() );
+    point.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( ( i * 7 ) % 100 + 0.5 * ( i % 3 ), ( ( i * 13 ) % 10 ) * 10 ) ) );
+    point.setAttributes( QgsAttributes() << i );
+    features << point;
+  }
+  startPoints->dataProvider()->addFeatures( features );
+
+  QgsProject project;
+  project.setCrs( QgsCoordinateReferenceSystem( QStringLiteral( "EPSG:3857" ) ) );
+  std::unique_ptr< QgsProcessingContext > context = qgis::make_unique< QgsProcessingContext >();
+  context->setProject( &project );
+
+  QVariantMap parameters;
+  parameters.insert( QStringLiteral( "INPUT" ), QVariant::fromValue< QgsMapLayer * >( network.get() ) );
+  parameters.insert( QStringLiteral( "START_POINTS" ), QVariant::fromValue< QgsMapLayer * >( startPoints.get() ) );
+  parameters.insert( QStringLiteral( "STRATEGY" ), 0 );
+  parameters.insert( QStringLiteral( "TRAVEL_COST2" ), 25 );
+  parameters.insert( QStringLiteral( "INCLUDE_BOUNDS" ), true );
+  parameters.insert( QStringLiteral( "OUTPUT" ), QgsProcessing::TEMPORARY_OUTPUT );
+  parameters.insert( QStringLiteral( "OUTPUT_LINES" ), QgsProcessing::TEMPORARY_OUTPUT );
+
+  // returns the attributes and geometries of each output, in order
+  auto runWithThreads = [&]( int threads ) -> QStringList
+  {
+    const int previousThreads = QThreadPool::globalInstance()->maxThreadCount();
+    QThreadPool::globalInstance()->setMaxThreadCount( threads );
+    QgsProcessingFeedback feedback;
+    bool ok = false;
+    const QVariantMap results = alg->run( parameters, *context, &feedback, &ok );
+    QThreadPool::globalInstance()->setMaxThreadCount( previousThreads );
+    QStringList output;
+    if ( !ok )
+      return output;
+
+    for ( const QString &name : QStringList() << QStringLiteral( "OUTPUT" ) << QStringLiteral( "OUTPUT_LINES" ) )
+    {
+      QgsVectorLayer *layer = qobject_cast< QgsVectorLayer * >( context->getMapLayer( results.value( name ).toString() ) );
+      if ( !layer )
+        return QStringList();
+
+      QgsFeature feature;
+      QgsFeatureIterator it = layer->getFeatures();
+      while ( it.nextFeature( feature ) )
+      {
+        QStringList values;
+        for ( const QVariant &value : feature.attributes() )
+          values << value.toString();
+        output << values.join( ',' ) + ' ' + feature.geometry().asWkt();
+      }
+    }
+    return output;
+  };
+
+  const QStringList serial = runWithThreads( 1 );
+  // within, upper and lower points and lines for each origin
+  QCOMPARE( serial.size(), 4 * 300 );
+  QVERIFY( serial.at( 0 ).startsWith( QStringLiteral( "0,within," ) ) );
+
+  const QStringList parallel = runWithThreads( 4 );
+  QCOMPARE( parallel.size(), serial.size() );
+  for ( int i = 0; i < serial.size(); ++i )
+    QCOMPARE( parallel.at( i ), serial.at( i ) );
+}
 
 bool TestQgsProcessingAlgs::imageCheck( const QString &testName, const QString &renderedImage )
 {
@@ -23,9 +23,12 @@ Email                : nyall dot dawson at gmail dot com
 #include "qgsrasterdataprovider.h"
 #include "qgsrasterlayer.h"
 #include "qgsrastermatrix.h"
+#include "qgsrastercalcprogram_p.h"
 #include "qgsapplication.h"
 #include "qgsproject.h"
 
+#include <cmath>
+
 Q_DECLARE_METATYPE( QgsRasterCalcNode::Operator )
 
 class TestQgsRasterCalculator : public QObject
@@ -54,6 +57,7 @@ class TestQgsRasterCalculator : public QObject
 
     void rasterRefOp();
     void dualOpRasterRaster(); //test dual op on raster ref and raster ref
+    void compiledProgram(); //test compiled expressions against node calculation
 
     void calcWithLayers();
     void calcWithReprojectedLayers();
@@ -432,6 +436,91 @@ void TestQgsRasterCalculator::dualOpRasterRaster()
   QCOMPARE( result.data()[5], -9999.0 );
 }
 
+void TestQgsRasterCalculator::compiledProgram()
+{
+  QgsRasterBlock m1( Qgis::Float32, 2, 3 );
+  m1.setNoDataValue( -1.0 );
+  m1.setValue( 0, 0, 1.0 );
+  m1.setValue( 0, 1, 2.0 );
+  m1.setValue( 1, 0, -2.0 );
+  m1.setValue( 1, 1, -1.0 ); //nodata
+  m1.setValue( 2, 0, 0.0 );
+  m1.setValue( 2, 1, 4.5 );
+
+  QgsRasterBlock m2( Qgis::Float32, 2, 3 );
+  m2.setNoDataValue( -2.0 ); //different no data value
+  m2.setValue( 0, 0, -1.0 );
+  m2.setValue( 0, 1, -2.0 ); //nodata
+  m2.setValue( 1, 0, 13.0 );
+  m2.setValue( 1, 1, 0.0 );
+  m2.setValue( 2, 0, 2.0 );
+  m2.setValue( 2, 1, -0.5 );
+
+  QMap<QString, QgsRasterBlock *> rasterData;
+  rasterData.insert( QStringLiteral( "raster1@1" ), &m1 );
+  rasterData.insert( QStringLiteral( "raster2@1" ), &m2 );
+
+  const double nodata = -9999;
+  const QStringList formulas
+  {
+    QStringLiteral( "\"raster1@1\" + \"raster2@1\"" ),
+    QStringLiteral( "\"raster1@1\" / \"raster2@1\" - 3" ),
+    QStringLiteral( "sqrt( \"raster1@1\" ) * log( \"raster2@1\" ) + log10( \"raster1@1\" )" ),
+    QStringLiteral( "\"raster1@1\" ^ \"raster2@1\" + \"raster2@1\" ^ 0.5" ),
+    QStringLiteral( "( \"raster1@1\" > 0 AND \"raster2@1\" <= 2 ) OR \"raster1@1\" = \"raster2@1\"" ),
+    QStringLiteral( "min( \"raster1@1\", \"raster2@1\" ) - max( abs( \"raster1@1\" ), -\"raster2@1\" )" ),
+    QStringLiteral( "atan( \"raster1@1\" ) + acos( \"raster2@1\" / 20 ) * sin( 2 ) / ( 1 - 1 )" ),
+    QStringLiteral( "2 * 3 + 1" ),
+  };
+
+  for ( const QString &formula : formulas )
+  {
+    QString error;
+    std::unique_ptr< QgsRasterCalcNode > node( QgsRasterCalcNode::parseRasterCalcString( formula, error ) );
+    QVERIFY( node );
+
+    QgsRasterMatrix expected( 2, 3, nullptr, nodata );
+    QVERIFY( node->calculate( rasterData, expected ) );
+
+    QgsRasterCalcProgram program( node.get() );
+    QVERIFY( program.isValid() );
+
+    std::vector< std::vector< double > > inputValues;
+    std::vector< const double * > inputs;
+    for ( const QString &name : program.rasterNames() )
+    {
+      QgsRasterBlock *block = rasterData.value( name );
+      QVERIFY( block );
+      std::vector< double > values;
+      bool isNoData = false;
+      for ( int i = 0; i < 6; ++i )
+      {
+        const double value = block->valueAndNoData( i / 2, i % 2, isNoData );
+        values.push_back( isNoData ? nodata : value );
+      }
+      inputValues.push_back( values );
+    }
+    for ( const std::vector< double > &values : inputValues )
+      inputs.push_back( values.data() );
+
+    std::vector< double > result( 6 );
+    program.evaluate( inputs.data(), result.data(), 6, nodata );
+    for ( int i = 0; i < 6; ++i )
+    {
+      const double expectedValue = expected.isNumber() ? expected.number() : expected.data()[ expected.nColumns() * expected.nRows() == 6 ? i : i % expected.nColumns() ];
+      if ( std::isnan( expectedValue ) )
+        QVERIFY( std::isnan( result[i] ) );
+      else
+        QCOMPARE( result[i], expectedValue );
+    }
+  }
+
+  // matrix nodes are not supported
+  QgsRasterMatrix matrix( 1, 1, new double[1] { 1.0 }, -1 );
+  QgsRasterCalcNode matrixNode( &matrix );
+  QVERIFY( !QgsRasterCalcProgram( &matrixNode ).isValid() );
+}
+
 void TestQgsRasterCalculator::calcWithLayers()
 {
   QgsRasterCalculatorEntry entry1;
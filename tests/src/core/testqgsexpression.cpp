@@ -35,6 +35,8 @@
 #include "qgsexpressionnodeimpl.h"
 #include "qgsvectorlayerutils.h"
 #include "qgsexpressioncontextutils.h"
+#include "qgsexpressioncolumnfilter_p.h"
+#include "qgsexpressionset.h"
 
 
 static void _parseAndEvalExpr( int arg )
@@ -4196,6 +4198,338 @@ class TestQgsExpression: public QObject
       QCOMPARE( exp2.referencedVariables(), QSet<QString>() << QStringLiteral( "field_name_part_var" ) << QStringLiteral( "static_feature" ) );
     }
 
+    void compiledEvaluation_data()
+    {
+      QTest::addColumn<QString>( "string" );
+
+      QTest::newRow( "field" ) << QStringLiteral( "\"int\"" );
+      QTest::newRow( "int arithmetic" ) << QStringLiteral( "\"int\" * 3 + 2 - \"int\" % 4" );
+      QTest::newRow( "double arithmetic" ) << QStringLiteral( "\"double\" / 2 + \"int\" ^ 2" );
+      QTest::newRow( "int division" ) << QStringLiteral( "\"int\" // 3" );
+      QTest::newRow( "division by zero" ) << QStringLiteral( "\"int\" / 0" );
+      QTest::newRow( "modulo by zero" ) << QStringLiteral( "\"int\" % 0" );
+      QTest::newRow( "null arithmetic" ) << QStringLiteral( "\"null_int\" + 1" );
+      QTest::newRow( "null int division" ) << QStringLiteral( "\"null_int\" // 2" );
+      QTest::newRow( "string plus" ) << QStringLiteral( "\"string\" + 'x'" );
+      QTest::newRow( "null string plus" ) << QStringLiteral( "\"null_string\" + 'x'" );
+      QTest::newRow( "numeric string plus" ) << QStringLiteral( "\"numeric_string\" + 1" );
+      QTest::newRow( "concat" ) << QStringLiteral( "\"string\" || \"int\" || \"double\" || (\"int\" > 2)" );
+      QTest::newRow( "concat null" ) << QStringLiteral( "\"string\" || \"null_string\"" );
+      QTest::newRow( "comparisons" ) << QStringLiteral( "\"int\" > 2 AND \"double\" <= 3.5 OR \"string\" = 'abc'" );
+      QTest::newRow( "string comparison" ) << QStringLiteral( "\"string\" < 'b'" );
+      QTest::newRow( "mixed comparison" ) << QStringLiteral( "\"numeric_string\" = 12" );
+      QTest::newRow( "date comparison" ) << QStringLiteral( "\"date\" > to_date('2020-01-01')" );
+      QTest::newRow( "date difference" ) << QStringLiteral( "day(\"date\" - to_date('2020-01-01')) + 1" );
+      QTest::newRow( "boolean comparison" ) << QStringLiteral( "(\"date\" IS NULL) = false" );
+      QTest::newRow( "minus date" ) << QStringLiteral( "-\"date\"" );
+      QTest::newRow( "null comparison" ) << QStringLiteral( "\"null_int\" = 1" );
+      QTest::newRow( "and shortcut" ) << QStringLiteral( "\"int\" < 0 AND \"string\" / 2" );
+      QTest::newRow( "or shortcut" ) << QStringLiteral( "\"int\" > 0 OR \"string\" / 2" );
+      QTest::newRow( "logic with null" ) << QStringLiteral( "\"null_int\" > 1 OR \"int\" < 0" );
+      QTest::newRow( "not" ) << QStringLiteral( "NOT (\"int\" = 5)" );
+      QTest::newRow( "not string" ) << QStringLiteral( "NOT \"string\"" );
+      QTest::newRow( "minus" ) << QStringLiteral( "-\"int\" - -\"double\"" );
+      QTest::newRow( "minus string" ) << QStringLiteral( "-\"numeric_string\"" );
+      QTest::newRow( "minus null" ) << QStringLiteral( "-\"null_int\"" );
+      QTest::newRow( "is" ) << QStringLiteral( "\"int\" IS 5 AND \"null_int\" IS NULL AND \"string\" IS NOT NULL" );
+      QTest::newRow( "in" ) << QStringLiteral( "\"string\" IN ('x', 'abc') AND \"int\" IN (1, 5.0)" );
+      QTest::newRow( "not in" ) << QStringLiteral( "\"int\" NOT IN (1, 2, NULL)" );
+      QTest::newRow( "in mixed" ) << QStringLiteral( "\"numeric_string\" IN (12, 'a')" );
+      QTest::newRow( "in expression" ) << QStringLiteral( "\"int\" IN (\"int\" + 1, 5)" );
+      QTest::newRow( "case" ) << QStringLiteral( "CASE WHEN \"int\" > 10 THEN 'big' WHEN \"int\" > 2 THEN \"string\" ELSE NULL END" );
+      QTest::newRow( "case without else" ) << QStringLiteral( "CASE WHEN \"int\" > 10 THEN 'big' END" );
+      QTest::newRow( "function" ) << QStringLiteral( "upper(\"string\") || length(\"string\") * 2" );
+      QTest::newRow( "like" ) << QStringLiteral( "\"string\" LIKE 'a%'" );
+      QTest::newRow( "missing field" ) << QStringLiteral( "\"missing\" + 1" );
+      QTest::newRow( "error" ) << QStringLiteral( "\"string\" * 2 + 1" );
+      QTest::newRow( "static" ) << QStringLiteral( "1 + 2 * 3" );
+    }
+
+    void compiledEvaluation()
+    {
+      QFETCH( QString, string );
+
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "int" ), QVariant::Int ) );
+      fields.append( QgsField( QStringLiteral( "double" ), QVariant::Double ) );
+      fields.append( QgsField( QStringLiteral( "string" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "null_int" ), QVariant::Int ) );
+      fields.append( QgsField( QStringLiteral( "null_string" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "numeric_string" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "date" ), QVariant::Date ) );
+      QgsFeature feature( fields );
+      feature.setAttributes( QgsAttributes() << 5 << 2.5 << QStringLiteral( "abc" ) << QVariant( QVariant::Int ) << QVariant( QVariant::String )
+                             << QStringLiteral( "12" ) << QDate( 2021, 3, 1 ) );
+
+      QgsExpressionContext context;
+      context.setFields( fields );
+      context.setFeature( feature );
+
+      // the compiled program must give the same results as the expression tree
+      QgsExpression exp( string );
+      exp.prepare( &context );
+      const QVariant result = exp.evaluate( &context );
+      const QString error = exp.evalErrorString();
+
+      QgsExpression treeExp( string );
+      treeExp.prepare( &context );
+      treeExp.setEvalErrorString( QString() );
+      const QVariant expected = const_cast< QgsExpressionNode * >( treeExp.rootNode() )->eval( &treeExp, &context );
+      QCOMPARE( result.type(), expected.type() );
+      QCOMPARE( result, expected );
+      QCOMPARE( error, treeExp.evalErrorString() );
+
+      // the registers are reused for the next feature
+      QgsFeature other = feature;
+      other.setAttribute( 0, 1 );
+      context.setFeature( other );
+      const QVariant otherResult = exp.evaluate( &context );
+      treeExp.setEvalErrorString( QString() );
+      const QVariant otherExpected = const_cast< QgsExpressionNode * >( treeExp.rootNode() )->eval( &treeExp, &context );
+      QCOMPARE( otherResult, otherExpected );
+      QCOMPARE( exp.evalErrorString(), treeExp.evalErrorString() );
+
+      // batch evaluation stops at the first error
+      QVariantList expectedResults;
+      if ( error.isEmpty() )
+      {
+        expectedResults << expected;
+        if ( !treeExp.hasEvalError() )
+          expectedResults << otherExpected;
+      }
+      const QVariantList results = exp.evaluateFeatures( QgsFeatureList() << feature << other, &context );
+      QCOMPARE( results, expectedResults );
+      QCOMPARE( exp.hasEvalError(), expectedResults.size() < 2 );
+      QCOMPARE( context.feature().attribute( 0 ), QVariant( expectedResults.isEmpty() ? 5 : 1 ) );
+    }
+
+    void columnFilter_data()
+    {
+      QTest::addColumn<QString>( "string" );
+
+      QTest::newRow( "int comparison" ) << QStringLiteral( "\"int\" > 100" );
+      QTest::newRow( "double comparison" ) << QStringLiteral( "\"double\" <= 12.5" );
+      QTest::newRow( "equality" ) << QStringLiteral( "\"double\" = \"int\" / 4" );
+      QTest::newRow( "string comparison" ) << QStringLiteral( "\"string\" = 'v3' OR \"string\" > 'v8'" );
+      QTest::newRow( "int arithmetic" ) << QStringLiteral( "\"int\" * 3 % 7 = 2" );
+      QTest::newRow( "double arithmetic" ) << QStringLiteral( "\"double\" ^ 2 - \"int\" / 3 > 100" );
+      QTest::newRow( "modulo by zero" ) << QStringLiteral( "\"int\" % (\"int\" % 3) = 1" );
+      QTest::newRow( "numeric result" ) << QStringLiteral( "\"int\" % 3" );
+      QTest::newRow( "logic with null" ) << QStringLiteral( "NOT (\"int\" > 50 AND \"double\" < 40) OR \"string\" = 'v1'" );
+      QTest::newRow( "is null" ) << QStringLiteral( "\"int\" IS NULL OR \"string\" IS NOT 'v2'" );
+      QTest::newRow( "in" ) << QStringLiteral( "\"int\" IN (3, 4, 5.0, NULL) OR \"string\" NOT IN ('v1', 'v2')" );
+      QTest::newRow( "minus with null" ) << QStringLiteral( "-\"int\" < -150" );
+      QTest::newRow( "null constant" ) << QStringLiteral( "\"int\" + NULL > 1 OR \"double\" IS NULL" );
+      QTest::newRow( "static" ) << QStringLiteral( "\"int\" > 2 * 50" );
+      QTest::newRow( "function" ) << QStringLiteral( "upper(\"string\") = 'V3'" );
+      QTest::newRow( "case" ) << QStringLiteral( "CASE WHEN \"int\" > 100 THEN \"double\" > 30 ELSE \"string\" = 'v4' END" );
+      QTest::newRow( "mixed types" ) << QStringLiteral( "\"string\" > 5" );
+    }
+
+    void columnFilter()
+    {
+      QFETCH( QString, string );
+
+      QgsVectorLayer layer( QStringLiteral( "Point?field=int:integer&field=double:double&field=string:string" ), QStringLiteral( "layer" ), QStringLiteral( "memory" ) );
+      QgsFeatureList features;
+      for ( int i = 0; i < 3000; ++i )
+      {
+        QgsFeature feature( layer.fields() );
+        feature.setAttributes( QgsAttributes() << ( i % 7 == 0 ? QVariant( QVariant::Int ) : QVariant( i % 200 ) )
+                               << ( i % 5 == 0 ? QVariant( QVariant::Double ) : QVariant( ( i % 200 ) / 4.0 ) )
+                               << ( i % 11 == 0 ? QVariant( QVariant::String ) : QVariant( QStringLiteral( "v%1" ).arg( i % 13 ) ) ) );
+        features << feature;
+      }
+      QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+      // expected features, evaluating the expression tree one feature at a time
+      QgsExpression exp( string );
+      QgsExpressionContext context;
+      context.setFields( layer.fields() );
+      exp.prepare( &context );
+      QList< QgsFeatureId > expected;
+      QgsFeature feature;
+      QgsFeatureIterator it = layer.dataProvider()->getFeatures();
+      while ( it.nextFeature( feature ) )
+      {
+        context.setFeature( feature );
+        if ( const_cast< QgsExpressionNode * >( exp.rootNode() )->eval( &exp, &context ).toBool() )
+          expected << feature.id();
+      }
+
+      // provider iterator, filtering features in batches
+      it = layer.dataProvider()->getFeatures( QgsFeatureRequest().setFilterExpression( string ) );
+      QList< QgsFeatureId > ids;
+      while ( it.nextFeature( feature ) )
+        ids << feature.id();
+      QCOMPARE( ids, expected );
+
+      // rewinding discards the features fetched ahead
+      QVERIFY( it.rewind() );
+      ids.clear();
+      while ( it.nextFeature( feature ) )
+      {
+        ids << feature.id();
+        if ( ids.size() == 5 )
+          break;
+      }
+      QVERIFY( it.rewind() );
+      ids.clear();
+      while ( it.nextFeature( feature ) )
+        ids << feature.id();
+      QCOMPARE( ids, expected );
+
+      // limited requests don't fetch ahead
+      it = layer.dataProvider()->getFeatures( QgsFeatureRequest().setFilterExpression( string ).setLimit( 10 ) );
+      ids.clear();
+      while ( it.nextFeature( feature ) )
+        ids << feature.id();
+      QCOMPARE( ids, expected.mid( 0, 10 ) );
+    }
+
+    void expressionSet()
+    {
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "name" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "x" ), QVariant::Int ) );
+      QgsFeature f1( fields, 1 );
+      f1.setAttributes( QgsAttributes() << QStringLiteral( "a" ) << 2 );
+      QgsFeature f2( fields, 2 );
+      f2.setAttributes( QgsAttributes() << QStringLiteral( "b" ) << 2 );
+
+      QgsExpressionContextScope *scope = new QgsExpressionContextScope();
+      scope->setVariable( QStringLiteral( "myvar" ), 10 );
+      QgsExpressionContext context;
+      context.appendScope( scope );
+      context.setFields( fields );
+      std::shared_ptr< QgsExpressionSet > set = std::make_shared< QgsExpressionSet >();
+      context.setExpressionSet( set );
+      QCOMPARE( context.expressionSet(), set.get() );
+
+      // the set is not copied with the context
+      QgsExpressionContext copy( context );
+      QVERIFY( !copy.expressionSet() );
+
+      QgsExpression e1( QStringLiteral( "upper(\"name\") = 'A' AND \"x\" > 1" ) );
+      QgsExpression e2( QStringLiteral( "upper(\"name\") || 'b'" ) );
+      QgsExpression e3( QStringLiteral( "upper(\"name\") = 'A' AND \"x\" > 1" ) );
+      QgsExpression e4( QStringLiteral( "upper(\"name\") || @myvar" ) );
+      QgsExpression e5( QStringLiteral( "upper(\"name\") || @myvar" ) );
+      QgsExpression e6( QStringLiteral( "rand(1, 1000000) + 0" ) );
+      QgsExpression e7( QStringLiteral( "rand(1, 1000000) + 0" ) );
+      for ( QgsExpression *exp : { &e1, &e2, &e3, &e4, &e5, &e6, &e7 } )
+        QVERIFY( exp->prepare( &context ) );
+      QCOMPARE( set->expressionCount(), 7 );
+      // the filters of e1 and e3, their two operands and upper("name")
+      QCOMPARE( set->sharedSubexpressionCount(), 4 );
+
+      context.setFeature( f1 );
+      QCOMPARE( e1.evaluate( &context ), QVariant( 1 ) );
+      QCOMPARE( e2.evaluate( &context ).toString(), QStringLiteral( "Ab" ) );
+      const long long hits = set->cacheHits();
+      QVERIFY( hits > 0 );
+      QCOMPARE( e3.evaluate( &context ), QVariant( 1 ) );
+      QVERIFY( set->cacheHits() > hits );
+
+      // results are not reused for other features
+      context.setFeature( f2 );
+      QCOMPARE( e3.evaluate( &context ), QVariant( 0 ) );
+      QCOMPARE( e1.evaluate( &context ), QVariant( 0 ) );
+      QCOMPARE( e2.evaluate( &context ).toString(), QStringLiteral( "Bb" ) );
+
+      // nor for subexpressions depending on variables or non deterministic functions
+      QCOMPARE( e4.evaluate( &context ).toString(), QStringLiteral( "B10" ) );
+      scope->setVariable( QStringLiteral( "myvar" ), 20 );
+      QCOMPARE( e5.evaluate( &context ).toString(), QStringLiteral( "B20" ) );
+      bool different = false;
+      for ( int i = 0; i < 10 && !different; ++i )
+        different = e6.evaluate( &context ) != e7.evaluate( &context );
+      QVERIFY( different );
+
+      // static values are shared between expressions prepared with the same variable values
+      scope->setVariable( QStringLiteral( "static_var" ), 5, true );
+      QgsExpression s1( QStringLiteral( "\"x\" + @static_var * 2" ) );
+      QVERIFY( s1.prepare( &context ) );
+      const long long staticHits = set->cacheHits();
+      QgsExpression s2( QStringLiteral( "\"x\" - @static_var * 2" ) );
+      QVERIFY( s2.prepare( &context ) );
+      QCOMPARE( set->cacheHits(), staticHits + 1 );
+      QCOMPARE( s2.evaluate( &context ), QVariant( -8 ) );
+      scope->setVariable( QStringLiteral( "static_var" ), 1, true );
+      QgsExpression s3( QStringLiteral( "\"x\" - @static_var * 2" ) );
+      QVERIFY( s3.prepare( &context ) );
+      QCOMPARE( s3.evaluate( &context ), QVariant( 0 ) );
+    }
+
+    void expressionSetNearlyEqualLiterals()
+    {
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "v" ), QVariant::Double ) );
+      QgsFeature f( fields, 1 );
+      f.setAttributes( QgsAttributes() << 1500002.0 );
+
+      QgsExpressionContext context;
+      context.setFields( fields );
+      std::shared_ptr< QgsExpressionSet > set = std::make_shared< QgsExpressionSet >();
+      context.setExpressionSet( set );
+
+      // literals which only differ past the digits shown by dump() are not the same subexpression
+      QgsExpression e1( QStringLiteral( "\"v\" > 1500000.5" ) );
+      QgsExpression e2( QStringLiteral( "\"v\" > 1500004.5" ) );
+      QgsExpression e3( QStringLiteral( "\"v\" > 1500000.5" ) );
+      for ( QgsExpression *exp : { &e1, &e2, &e3 } )
+        QVERIFY( exp->prepare( &context ) );
+      QCOMPARE( set->sharedSubexpressionCount(), 1 );
+
+      context.setFeature( f );
+      QCOMPARE( e1.evaluate( &context ), QVariant( 1 ) );
+      QCOMPARE( e2.evaluate( &context ), QVariant( 0 ) );
+      QCOMPARE( e3.evaluate( &context ), QVariant( 1 ) );
+
+      // nor the same static value
+      QgsExpression s1( QStringLiteral( "\"v\" + 0.1234561 * 1000000" ) );
+      QgsExpression s2( QStringLiteral( "\"v\" + 0.1234562 * 1000000" ) );
+      QVERIFY( s1.prepare( &context ) );
+      QVERIFY( s2.prepare( &context ) );
+      QGSCOMPARENEAR( s1.evaluate( &context ).toDouble(), 1623458.1, 0.000001 );
+      QGSCOMPARENEAR( s2.evaluate( &context ).toDouble(), 1623458.2, 0.000001 );
+
+      // literals of different types are not the same either
+      QgsExpression t1( QStringLiteral( "\"v\" || 1" ) );
+      QgsExpression t2( QStringLiteral( "\"v\" || '1'" ) );
+      QVERIFY( t1.prepare( &context ) );
+      QVERIFY( t2.prepare( &context ) );
+      QCOMPARE( set->sharedSubexpressionCount(), 1 );
+    }
+
+    void columnFilterTypes()
+    {
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "int" ), QVariant::Int ) );
+      fields.append( QgsField( QStringLiteral( "date" ), QVariant::Date ) );
+
+      QVERIFY( QgsExpressionColumnFilter::create( QgsExpression( QStringLiteral( "\"int\" > 2" ) ), fields ) );
+      QVERIFY( !QgsExpressionColumnFilter::create( QgsExpression( QStringLiteral( "\"date\" IS NULL" ) ), fields ) );
+      QVERIFY( !QgsExpressionColumnFilter::create( QgsExpression( QStringLiteral( "\"int\" > '2'" ) ), fields ) );
+      QVERIFY( !QgsExpressionColumnFilter::create( QgsExpression( QStringLiteral( "\"int\" // 2 = 1" ) ), fields ) );
+
+      std::unique_ptr< QgsExpressionColumnFilter > filter = QgsExpressionColumnFilter::create( QgsExpression( QStringLiteral( "\"int\" > 2" ) ), fields );
+      QgsFeature f1( fields );
+      f1.setAttributes( QgsAttributes() << 1 << QVariant() );
+      QgsFeature f2( fields );
+      f2.setAttributes( QgsAttributes() << 3 << QVariant() );
+      QgsFeature f3( fields );
+      f3.setAttributes( QgsAttributes() << QVariant( QVariant::Int ) << QVariant() );
+      QVector< bool > matches;
+      QVERIFY( filter->evaluate( QgsFeatureList() << f1 << f2 << f3, matches ) );
+      QCOMPARE( matches, QVector< bool >() << false << true << false );
+
+      // values which don't have the type of their field must be evaluated by the expression tree
+      QgsFeature f4( fields );
+      f4.setAttributes( QgsAttributes() << QStringLiteral( "5" ) << QVariant() );
+      QVERIFY( !filter->evaluate( QgsFeatureList() << f1 << f4, matches ) );
+    }
+
 };
 
 QGSTEST_MAIN( TestQgsExpression )
@@ -23,6 +23,7 @@
 #include "qgssymbollayerutils.h"
 #include "qgsvectorlayer.h"
 #include "qgsclassificationquantile.h"
+#include "qgsrendercontext.h"
 
 /**
  * \ingroup UnitTests
@@ -42,6 +43,7 @@ class TestQgsGraduatedSymbolRenderer: public QObject
     void rangesHaveGaps();
     void classifySymmetric();
     void testMatchingRangeForValue();
+    void testMatchingRangeForValueWhileRendering();
 
   private:
 };
@@ -315,5 +317,58 @@ void TestQgsGraduatedSymbolRenderer::testMatchingRangeForValue()
   QCOMPARE( renderer.rangeForValue( 3.7 + std::numeric_limits<double>::epsilon() * 2 )->label(), QStringLiteral( "r4" ) );
 }
 
+void TestQgsGraduatedSymbolRenderer::testMatchingRangeForValueWhileRendering()
+{
+  QgsGraduatedSymbolRenderer renderer( QStringLiteral( "value" ) );
+  QgsMarkerSymbol ms;
+  renderer.addClass( QgsRendererRange( 1, 2, ms.clone(), QStringLiteral( "r1" ) ) );
+  renderer.addClass( QgsRendererRange( 2, 4, ms.clone(), QStringLiteral( "r2" ) ) );
+  renderer.addClass( QgsRendererRange( 4, 4, ms.clone(), QStringLiteral( "r3" ) ) );
+  renderer.addClass( QgsRendererRange( 5, 7, ms.clone(), QStringLiteral( "r4" ), false ) );
+  renderer.addClass( QgsRendererRange( 8, 9, ms.clone(), QStringLiteral( "r5" ) ) );
+
+  const QList< double > values = QList< double >() << -1 << 0.5 << 1 << 1.5 << 2 << 3 << 4 << 4.5 << 5 << 6 << 7 << 7.5 << 8 << 9 << 10
+                                 << 1 - std::numeric_limits<double>::epsilon() * 2
+                                 << 9 + std::numeric_limits<double>::epsilon() * 8
+                                 << 4 + std::numeric_limits<double>::epsilon() * 4
+                                 << std::numeric_limits<double>::quiet_NaN()
+                                 << std::numeric_limits<double>::infinity();
+
+  QgsFields fields;
+  fields.append( QgsField( QStringLiteral( "value" ), QVariant::Double ) );
+  QgsRenderContext context;
+  context.setRendererScale( 1000 );
+
+  // ranges are looked up with a binary search while rendering, results must be the same
+  auto labels = [&renderer, &values]() -> QStringList
+  {
+    QStringList result;
+    for ( double value : values )
+    {
+      const QgsRendererRange *range = renderer.rangeForValue( value );
+      result << ( range ? range->label() : QString() );
+    }
+    return result;
+  };
+
+  const QStringList expected = labels();
+  QCOMPARE( expected.at( 2 ), QStringLiteral( "r1" ) );
+  QCOMPARE( expected.at( 4 ), QStringLiteral( "r1" ) );
+  QCOMPARE( expected.at( 6 ), QStringLiteral( "r2" ) );
+  QVERIFY( expected.at( 9 ).isEmpty() );
+  QCOMPARE( expected.at( 15 ), QStringLiteral( "r1" ) );
+
+  renderer.startRender( context, fields );
+  QCOMPARE( labels(), expected );
+  renderer.stopRender( context );
+
+  // overlapping ranges are looked up in order
+  renderer.addClass( QgsRendererRange( 0, 10, ms.clone(), QStringLiteral( "all" ) ) );
+  renderer.startRender( context, fields );
+  QCOMPARE( renderer.rangeForValue( 7.5 )->label(), QStringLiteral( "all" ) );
+  QCOMPARE( renderer.rangeForValue( 8 )->label(), QStringLiteral( "r5" ) );
+  renderer.stopRender( context );
+}
+
 QGSTEST_MAIN( TestQgsGraduatedSymbolRenderer )
 #include "testqgsgraduatedsymbolrenderer.moc"
@@ -26,12 +26,15 @@
 #include <qgsvectorlayerlabeling.h>
 #include <qgsvectorlayerlabelprovider.h>
 #include "qgsmultirenderchecker.h"
+#include "qgsmaprenderercache.h"
 #include "qgsfontutils.h"
 #include "qgsnullsymbolrenderer.h"
 #include "qgssinglesymbolrenderer.h"
 #include "qgssymbol.h"
 #include "pointset.h"
 
+#include <QThreadPool>
+
 class TestQgsLabelingEngine : public QObject
 {
     Q_OBJECT
@@ -90,6 +93,9 @@ class TestQgsLabelingEngine : public QObject
     void testLineAnchorHorizontal();
     void testLineAnchorHorizontalConstraints();
     void testShowAllLabelsWhenALabelHasNoCandidates();
+    void testSolveIndependentComponents();
+    void testCandidatesForSeveralLayers();
+    void testPreviousPlacements();
 
   private:
     QgsVectorLayer *vl = nullptr;
@@ -98,6 +104,7 @@ class TestQgsLabelingEngine : public QObject
 
     void setDefaultLabelParams( QgsPalLayerSettings &settings );
     QgsLabelingEngineSettings createLabelEngineSettings();
+    QMap< QString, QgsRectangle > placedLabels( const QgsMapSettings &mapSettings, int maxThreadCount );
     bool imageCheck( const QString &testName, QImage &image, int mismatchCount );
 
 };
@@ -162,6 +169,9 @@ void TestQgsLabelingEngine::testEngineSettings()
   settings.setFlag( QgsLabelingEngineSettings::DrawUnplacedLabels, false );
   QVERIFY( !settings.testFlag( QgsLabelingEngineSettings::DrawUnplacedLabels ) );
 
+  // labels are not kept in place unless requested
+  QVERIFY( !settings.testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) );
+
   settings.setUnplacedLabelColor( QColor( 0, 255, 0 ) );
   QCOMPARE( settings.unplacedLabelColor().name(), QStringLiteral( "#00ff00" ) );
 
@@ -171,11 +181,13 @@ void TestQgsLabelingEngine::testEngineSettings()
   settings.setFlag( QgsLabelingEngineSettings::DrawUnplacedLabels, true );
   settings.setUnplacedLabelColor( QColor( 0, 255, 0 ) );
   settings.setPlacementVersion( QgsLabelingEngineSettings::PlacementEngineVersion1 );
+  settings.setFlag( QgsLabelingEngineSettings::KeepPreviousPlacements, true );
   settings.writeSettingsToProject( &p );
   QgsLabelingEngineSettings settings2;
   settings2.readSettingsFromProject( &p );
   QCOMPARE( settings2.defaultTextRenderFormat(), QgsRenderContext::TextFormatAlwaysText );
   QVERIFY( settings2.testFlag( QgsLabelingEngineSettings::DrawUnplacedLabels ) );
+  QVERIFY( settings2.testFlag( QgsLabelingEngineSettings::KeepPreviousPlacements ) );
   QCOMPARE( settings2.unplacedLabelColor().name(), QStringLiteral( "#00ff00" ) );
 
   settings.setDefaultTextRenderFormat( QgsRenderContext::TextFormatAlwaysOutlines );
@@ -3317,5 +3329,212 @@ void TestQgsLabelingEngine::testShowAllLabelsWhenALabelHasNoCandidates()
   QVERIFY( imageCheck( QStringLiteral( "show_all_labels_when_no_candidates" ), img, 20 ) );
 }
 
+void TestQgsLabelingEngine::testSolveIndependentComponents()
+{
+  // test that labels in distinct clusters are solved independently, with the same
+  // results regardless of the number of threads
+  QgsPalLayerSettings settings;
+  setDefaultLabelParams( settings );
+  settings.fieldName = QStringLiteral( "\"id\"" );
+  settings.isExpression = true;
+  settings.placement = QgsPalLayerSettings::OverPoint;
+
+  std::unique_ptr< QgsVectorLayer> vl2( new QgsVectorLayer( QStringLiteral( "Point?crs=epsg:3857&field=id:integer" ), QStringLiteral( "vl" ), QStringLiteral( "memory" ) ) );
+  vl2->setRenderer( new QgsNullSymbolRenderer() );
+
+  // 10 x 10 clusters of three overlapping points each
+  QgsFeatureList features;
+  for ( int i = 0; i < 10; ++i )
+  {
+    for ( int j = 0; j < 10; ++j )
+    {
+      for ( int k = 0; k < 3; ++k )
+      {
+        QgsFeature f;
+        f.setAttributes( QgsAttributes() << features.size() );
+        f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( 500000 + i * 1000000.0, 500000 + j * 1000000.0 ) ) );
+        features << f;
+      }
+    }
+  }
+  QVERIFY( vl2->dataProvider()->addFeatures( features ) );
+  vl2->updateExtents();
+
+  vl2->setLabeling( new QgsVectorLayerSimpleLabeling( settings ) );
+  vl2->setLabelsEnabled( true );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setLabelingEngineSettings( createLabelEngineSettings() );
+  mapSettings.setDestinationCrs( vl2->crs() );
+  mapSettings.setOutputSize( QSize( 800, 800 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 10000000, 10000000 ) );
+  mapSettings.setLayers( QList<QgsMapLayer *>() << vl2.get() );
+  mapSettings.setOutputDpi( 96 );
+
+  const QMap< QString, QgsRectangle > labels = placedLabels( mapSettings, 4 );
+  // exactly one label per cluster
+  QCOMPARE( labels.size(), 100 );
+
+  QCOMPARE( placedLabels( mapSettings, 1 ), labels );
+}
+
+void TestQgsLabelingEngine::testCandidatesForSeveralLayers()
+{
+  // test that candidates generated concurrently for several layers, with obstacles
+  // from the other layers, give the same results as a single thread
+  QgsPalLayerSettings lineSettings;
+  setDefaultLabelParams( lineSettings );
+  lineSettings.fieldName = QStringLiteral( "'long label text along the line'" );
+  lineSettings.isExpression = true;
+  lineSettings.placement = QgsPalLayerSettings::Curved;
+  lineSettings.obstacleSettings().setIsObstacle( true );
+
+  QgsPalLayerSettings pointSettings;
+  setDefaultLabelParams( pointSettings );
+  pointSettings.fieldName = QStringLiteral( "\"id\"" );
+  pointSettings.isExpression = true;
+  pointSettings.placement = QgsPalLayerSettings::AroundPoint;
+  pointSettings.obstacleSettings().setIsObstacle( true );
+
+  std::unique_ptr< QgsVectorLayer> lines( new QgsVectorLayer( QStringLiteral( "LineString?crs=epsg:3857" ), QStringLiteral( "lines" ), QStringLiteral( "memory" ) ) );
+  std::unique_ptr< QgsVectorLayer> points( new QgsVectorLayer( QStringLiteral( "Point?crs=epsg:3857&field=id:integer" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) ) );
+  QgsFeatureList lineFeatures;
+  QgsFeatureList pointFeatures;
+  for ( int i = 0; i < 10; ++i )
+  {
+    QgsFeature f;
+    f.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(0 %1, 2000000 %2, 4000000 %1, 6000000 %2, 8000000 %1, 10000000 %2)" ).arg( i * 1000000 + 300000 ).arg( i * 1000000 + 700000 ) ) );
+    lineFeatures << f;
+    for ( int j = 0; j < 10; ++j )
+    {
+      QgsFeature point;
+      point.setAttributes( QgsAttributes() << pointFeatures.size() );
+      point.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( j * 1000000 + 500000, i * 1000000 + 500000 ) ) );
+      pointFeatures << point;
+    }
+  }
+  QVERIFY( lines->dataProvider()->addFeatures( lineFeatures ) );
+  QVERIFY( points->dataProvider()->addFeatures( pointFeatures ) );
+
+  for ( QgsVectorLayer *layer : { lines.get(), points.get() } )
+  {
+    layer->updateExtents();
+    layer->setRenderer( new QgsNullSymbolRenderer() );
+    layer->setLabeling( new QgsVectorLayerSimpleLabeling( layer == lines.get() ? lineSettings : pointSettings ) );
+    layer->setLabelsEnabled( true );
+  }
+
+  QgsMapSettings mapSettings;
+  mapSettings.setLabelingEngineSettings( createLabelEngineSettings() );
+  mapSettings.setDestinationCrs( points->crs() );
+  mapSettings.setOutputSize( QSize( 800, 800 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 10000000, 10000000 ) );
+  mapSettings.setLayers( QList<QgsMapLayer *>() << lines.get() << points.get() );
+  mapSettings.setOutputDpi( 96 );
+
+  const QMap< QString, QgsRectangle > labels = placedLabels( mapSettings, 4 );
+  QVERIFY( !labels.isEmpty() );
+  QCOMPARE( placedLabels( mapSettings, 1 ), labels );
+}
+
+void TestQgsLabelingEngine::testPreviousPlacements()
+{
+  // test that labels are kept where they were placed in the previous render
+  QgsPalLayerSettings settings;
+  setDefaultLabelParams( settings );
+  settings.fieldName = QStringLiteral( "'label'" );
+  settings.isExpression = true;
+  settings.placement = QgsPalLayerSettings::AroundPoint;
+
+  std::unique_ptr< QgsVectorLayer> vl2( new QgsVectorLayer( QStringLiteral( "Point?crs=epsg:3857" ), QStringLiteral( "vl" ), QStringLiteral( "memory" ) ) );
+  vl2->setRenderer( new QgsNullSymbolRenderer() );
+  QgsFeature f;
+  f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( 5000, 5000 ) ) );
+  QVERIFY( vl2->dataProvider()->addFeature( f ) );
+  vl2->updateExtents();
+  vl2->setLabeling( new QgsVectorLayerSimpleLabeling( settings ) );
+  vl2->setLabelsEnabled( true );
+
+  QgsMapSettings mapSettings;
+  QgsLabelingEngineSettings engineSettings = createLabelEngineSettings();
+  engineSettings.setFlag( QgsLabelingEngineSettings::UsePartialCandidates, false );
+  engineSettings.setFlag( QgsLabelingEngineSettings::KeepPreviousPlacements, true );
+  mapSettings.setLabelingEngineSettings( engineSettings );
+  mapSettings.setDestinationCrs( vl2->crs() );
+  mapSettings.setOutputSize( QSize( 400, 400 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 10000, 10000 ) );
+  mapSettings.setLayers( QList<QgsMapLayer *>() << vl2.get() );
+  mapSettings.setOutputDpi( 96 );
+
+  auto labelRect = [&mapSettings]( QgsMapRendererCache * cache )
+  {
+    QgsMapRendererSequentialJob job( mapSettings );
+    job.setCache( cache );
+    job.start();
+    job.waitForFinished();
+
+    std::unique_ptr< QgsLabelingResults > results( job.takeLabelingResults() );
+    const QList<QgsLabelPosition> positions = results->labelsWithinRect( mapSettings.extent() );
+    return positions.size() == 1 ? positions.at( 0 ).labelRect : QgsRectangle();
+  };
+
+  // without any previous placement, the label goes to the top right of the point
+  const QgsRectangle preferredRect = labelRect( nullptr );
+  QVERIFY( !preferredRect.isNull() );
+  QVERIFY( preferredRect.xMinimum() > 5000 && preferredRect.yMinimum() > 5000 );
+
+  // block the top right quadrant, so that the label goes elsewhere
+  QgsMapRendererCache cache;
+  mapSettings.setLabelBlockingRegions( QList< QgsLabelBlockingRegion >() << QgsLabelBlockingRegion( QgsGeometry::fromRect( QgsRectangle( 5000, 5000, 10000, 10000 ) ) ) );
+  const QgsRectangle blockedRect = labelRect( &cache );
+  QVERIFY( !blockedRect.isNull() );
+  QVERIFY( blockedRect != preferredRect );
+  QVERIFY( !cache.labelPlacements().isEmpty() );
+
+  // without the blocking region, the label stays at its previous position
+  mapSettings.setLabelBlockingRegions( QList< QgsLabelBlockingRegion >() );
+  cache.clear();
+  QCOMPARE( labelRect( &cache ), blockedRect );
+
+  // but not if the scale changed
+  mapSettings.setExtent( QgsRectangle( 0, 0, 12000, 12000 ) );
+  cache.clear();
+  const QgsRectangle zoomedRect = labelRect( &cache );
+  QVERIFY( zoomedRect.xMinimum() > 5000 && zoomedRect.yMinimum() > 5000 );
+
+  // nor when keeping labels in place is not enabled
+  mapSettings.setExtent( QgsRectangle( 0, 0, 10000, 10000 ) );
+  mapSettings.setLabelBlockingRegions( QList< QgsLabelBlockingRegion >() << QgsLabelBlockingRegion( QgsGeometry::fromRect( QgsRectangle( 5000, 5000, 10000, 10000 ) ) ) );
+  cache.clear();
+  QCOMPARE( labelRect( &cache ), blockedRect );
+  engineSettings.setFlag( QgsLabelingEngineSettings::KeepPreviousPlacements, false );
+  mapSettings.setLabelingEngineSettings( engineSettings );
+  mapSettings.setLabelBlockingRegions( QList< QgsLabelBlockingRegion >() );
+  cache.clear();
+  QCOMPARE( labelRect( &cache ), preferredRect );
+}
+
+QMap< QString, QgsRectangle > TestQgsLabelingEngine::placedLabels( const QgsMapSettings &mapSettings, int maxThreadCount )
+{
+  const int previousMaxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreadCount );
+
+  QgsMapRendererSequentialJob job( mapSettings );
+  job.start();
+  job.waitForFinished();
+
+  QThreadPool::globalInstance()->setMaxThreadCount( previousMaxThreadCount );
+
+  std::unique_ptr< QgsLabelingResults > results( job.takeLabelingResults() );
+  QMap< QString, QgsRectangle > labels;
+  const QList<QgsLabelPosition> positions = results->labelsWithinRect( mapSettings.extent() );
+  for ( const QgsLabelPosition &position : positions )
+  {
+    if ( !position.isUnplaced )
+      labels.insert( QStringLiteral( "%1:%2" ).arg( position.layerID ).arg( position.featureId ), position.labelRect );
+  }
+  return labels;
+}
+
 QGSTEST_MAIN( TestQgsLabelingEngine )
 #include "testqgslabelingengine.moc"
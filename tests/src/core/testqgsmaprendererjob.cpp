@@ -38,12 +38,25 @@
 #include "qgsrenderedfeaturehandlerinterface.h"
 #include "qgsmaprendererstagedrenderjob.h"
 #include "qgsmultirenderchecker.h"
+#include <QThreadPool>
 #include "qgspallabeling.h"
 #include "qgsvectorlayerlabeling.h"
 #include "qgsfontutils.h"
 #include "qgsrasterlayer.h"
 #include "qgssinglesymbolrenderer.h"
+#include "qgscategorizedsymbolrenderer.h"
+#include "qgsrulebasedrenderer.h"
+#include "qgslinesymbollayer.h"
+#include "qgssymbol.h"
 #include "qgsrasterlayertemporalproperties.h"
+#include "qgsmaprenderercache.h"
+#include "qgsrenderprofile.h"
+#include "qgsmarkersymbollayer.h"
+#include "qgssymbollayerutils.h"
+#include "qgspathresolver.h"
+#include "qgssymbollayerreference.h"
+#include "qgstextmasksettings.h"
+#include <QJsonDocument>
 
 //qgs unit test utility class
 #include "qgsmultirenderchecker.h"
@@ -90,9 +103,20 @@ class TestQgsMapRendererJob : public QObject
 
     void temporalRender();
 
+    void parallelFeatureRendering_data();
+    void parallelFeatureRendering();
+    void streamedSymbolLevels();
+    void dirtyExtentRedraw();
+    void renderProfile();
+    void batchedPointMarkers();
+    void tileCacheRevisit();
+
   private:
     bool imageCheck( const QString &type, const QImage &image, int mismatchCount = 0 );
 
+    //! Returns the number of pixels of \a image differing from \a expected by more than \a tolerance in a channel
+    int pixelMismatches( const QImage &image, const QImage &expected, int tolerance );
+
     QString mEncoding;
     QgsVectorFileWriter::WriterError mError =  QgsVectorFileWriter::NoError ;
     QgsCoordinateReferenceSystem mCRS;
@@ -946,6 +970,455 @@ void TestQgsMapRendererJob::temporalRender()
 
 }
 
+void TestQgsMapRendererJob::parallelFeatureRendering_data()
+{
+  QTest::addColumn<QString>( "rendererType" );
+  QTest::addColumn<double>( "rotation" );
+  QTest::addColumn<float>( "devicePixelRatio" );
+
+  QTest::newRow( "single symbol" ) << QStringLiteral( "singleSymbol" ) << 0.0 << 1.0f;
+  QTest::newRow( "categorized" ) << QStringLiteral( "categorizedSymbol" ) << 0.0 << 1.0f;
+  // not drawn in parallel, as it draws its features when it stops rendering
+  QTest::newRow( "rule based" ) << QStringLiteral( "RuleRenderer" ) << 0.0 << 1.0f;
+  // the part of the batch images composited follows the map rotation and device pixels
+  QTest::newRow( "rotated" ) << QStringLiteral( "singleSymbol" ) << 30.0 << 1.0f;
+  QTest::newRow( "high dpi" ) << QStringLiteral( "categorizedSymbol" ) << 0.0 << 2.0f;
+}
+
+void TestQgsMapRendererJob::parallelFeatureRendering()
+{
+  QFETCH( QString, rendererType );
+  QFETCH( double, rotation );
+  QFETCH( float, devicePixelRatio );
+
+  // several times the parallel batch size of overlapping points, so that their drawing order shows
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=EPSG:4326&field=cls:integer" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 100; ++i )
+  {
+    for ( int j = 0; j < 60; ++j )
+    {
+      QgsFeature f( layer.fields() );
+      f.setAttributes( QgsAttributes() << ( i + j ) % 3 );
+      f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( -40 + i * 0.8, -20 + j * 0.66 ) ) );
+      features << f;
+    }
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+  QCOMPARE( layer.featureCount(), 6000L );
+
+  const QList< QColor > colors = QList< QColor >() << QColor( 255, 0, 0 ) << QColor( 0, 160, 0 ) << QColor( 0, 0, 255 );
+  auto markerSymbol = []( const QColor & color ) -> QgsMarkerSymbol *
+  {
+    QgsMarkerSymbol *symbol = QgsMarkerSymbol::createSimple( QVariantMap() );
+    symbol->setColor( color );
+    symbol->setSize( 4 );
+    return symbol;
+  };
+
+  if ( rendererType == QLatin1String( "singleSymbol" ) )
+  {
+    layer.setRenderer( new QgsSingleSymbolRenderer( markerSymbol( colors.at( 0 ) ) ) );
+  }
+  else if ( rendererType == QLatin1String( "categorizedSymbol" ) )
+  {
+    QgsCategoryList categories;
+    for ( int i = 0; i < colors.count(); ++i )
+      categories << QgsRendererCategory( i, markerSymbol( colors.at( i ) ), QString::number( i ) );
+    layer.setRenderer( new QgsCategorizedSymbolRenderer( QStringLiteral( "cls" ), categories ) );
+  }
+  else
+  {
+    QgsRuleBasedRenderer::Rule *root = new QgsRuleBasedRenderer::Rule( nullptr );
+    root->appendChild( new QgsRuleBasedRenderer::Rule( markerSymbol( colors.at( 0 ) ), 0, 0, QStringLiteral( "cls = 0" ) ) );
+    root->appendChild( new QgsRuleBasedRenderer::Rule( markerSymbol( colors.at( 1 ) ), 0, 0, QStringLiteral( "cls = 1" ) ) );
+    root->appendChild( new QgsRuleBasedRenderer::Rule( markerSymbol( colors.at( 2 ) ), 0, 0, QStringLiteral( "ELSE" ) ) );
+    layer.setRenderer( new QgsRuleBasedRenderer( root ) );
+  }
+
+  // force a few worker threads, so that the layer features are split into several batches
+  const int maxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+  QThreadPool::globalInstance()->setMaxThreadCount( 4 );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setExtent( QgsRectangle( -42, -22, 42, 22 ) );
+  mapSettings.setDestinationCrs( layer.crs() );
+  mapSettings.setOutputSize( QSize( 512, 256 ) );
+  mapSettings.setRotation( rotation );
+  mapSettings.setDevicePixelRatio( devicePixelRatio );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, false );
+  mapSettings.setFlag( QgsMapSettings::Antialiasing );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << &layer );
+
+  QgsMapRendererSequentialJob renderJob( mapSettings );
+  renderJob.start();
+  renderJob.waitForFinished();
+  const QImage expected = renderJob.renderedImage();
+
+  mapSettings.setFlag( QgsMapSettings::ParallelFeatureRendering );
+  QgsMapRendererSequentialJob parallelRenderJob( mapSettings );
+  parallelRenderJob.start();
+  parallelRenderJob.waitForFinished();
+  const QImage img = parallelRenderJob.renderedImage();
+
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreadCount );
+
+  // something must have been drawn in both images
+  QVERIFY( expected.pixelColor( static_cast< int >( 256 * devicePixelRatio ), static_cast< int >( 128 * devicePixelRatio ) ) != mapSettings.backgroundColor() );
+
+  // batches are composited in feature order, so only rounding may differ
+  QCOMPARE( img.size(), expected.size() );
+  QCOMPARE( pixelMismatches( img, expected, 2 ), 0 );
+}
+
+void TestQgsMapRendererJob::streamedSymbolLevels()
+{
+  std::unique_ptr< QgsVectorLayer > linesLayer = qgis::make_unique< QgsVectorLayer >( TEST_DATA_DIR + QStringLiteral( "/lines.shp" ),
+      QStringLiteral( "lines" ), QStringLiteral( "ogr" ) );
+  QVERIFY( linesLayer->isValid() );
+
+  // casing drawn below the fill of every line
+  QgsSimpleLineSymbolLayer *casing = new QgsSimpleLineSymbolLayer( QColor( 0, 0, 0 ), 3 );
+  casing->setRenderingPass( 0 );
+  QgsSimpleLineSymbolLayer *fill = new QgsSimpleLineSymbolLayer( QColor( 255, 200, 0 ), 1.5 );
+  fill->setRenderingPass( 1 );
+  QgsLineSymbol *symbol = new QgsLineSymbol( QgsSymbolLayerList() << casing << fill );
+  linesLayer->setRenderer( new QgsSingleSymbolRenderer( symbol ) );
+  linesLayer->renderer()->setUsingSymbolLevels( true );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setExtent( linesLayer->extent() );
+  mapSettings.setDestinationCrs( linesLayer->crs() );
+  mapSettings.setOutputSize( QSize( 256, 256 ) );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, false );
+  mapSettings.setFlag( QgsMapSettings::Antialiasing );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << linesLayer.get() );
+
+  QgsMapRendererSequentialJob renderJob( mapSettings );
+  renderJob.start();
+  renderJob.waitForFinished();
+  const QImage expected = renderJob.renderedImage();
+
+  mapSettings.setFlag( QgsMapSettings::StreamSymbolLevels );
+  QgsMapRendererSequentialJob streamedRenderJob( mapSettings );
+  streamedRenderJob.start();
+  streamedRenderJob.waitForFinished();
+  const QImage img = streamedRenderJob.renderedImage();
+
+  // symbol layer images are composited in level order, so only rounding may differ
+  QCOMPARE( img.size(), expected.size() );
+  QCOMPARE( pixelMismatches( img, expected, 2 ), 0 );
+}
+
+void TestQgsMapRendererJob::dirtyExtentRedraw()
+{
+  QgsVectorLayer layer( QStringLiteral( "LineString?crs=EPSG:4326" ), QStringLiteral( "lines" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+
+  // a grid of lines, the horizontal ones crossing the area of any edited vertical line
+  QgsFeatureList features;
+  for ( int i = 0; i <= 10; ++i )
+  {
+    QgsFeature vertical;
+    vertical.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(%1 0, %1 10)" ).arg( i ) ) );
+    QgsFeature horizontal;
+    horizontal.setGeometry( QgsGeometry::fromWkt( QStringLiteral( "LineString(0 %1, 10 %1)" ).arg( i ) ) );
+    features << vertical << horizontal;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+  QgsLineSymbol *symbol = new QgsLineSymbol( QgsSymbolLayerList() << new QgsSimpleLineSymbolLayer( QColor( 0, 0, 0 ), 0.6 ) );
+  layer.setRenderer( new QgsSingleSymbolRenderer( symbol ) );
+  QVERIFY( layer.startEditing() );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setExtent( QgsRectangle( -1, -1, 11, 11 ) );
+  mapSettings.setDestinationCrs( layer.crs() );
+  mapSettings.setOutputSize( QSize( 256, 256 ) );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, false );
+  mapSettings.setFlag( QgsMapSettings::Antialiasing );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << &layer );
+
+  QgsMapRendererCache cache;
+  QgsMapRendererSequentialJob renderJob( mapSettings );
+  renderJob.setCache( &cache );
+  renderJob.start();
+  renderJob.waitForFinished();
+  QVERIFY( cache.hasCacheImage( layer.id() ) );
+
+  // move a line: the cached image is kept, with the area of the old and new line marked as dirty
+  QVERIFY( layer.changeGeometry( 1, QgsGeometry::fromWkt( QStringLiteral( "LineString(0.5 0, 0.5 10)" ) ) ) );
+  layer.triggerRepaint();
+  QVERIFY( !cache.hasCacheImage( layer.id() ) );
+  QVERIFY( cache.hasDirtyCacheImage( layer.id() ) );
+  QCOMPARE( cache.dirtyExtent( layer.id() ), QgsRectangle( 0, 0, 0.5, 10 ) );
+
+  QgsMapRendererSequentialJob dirtyRenderJob( mapSettings );
+  dirtyRenderJob.setCache( &cache );
+  dirtyRenderJob.start();
+  dirtyRenderJob.waitForFinished();
+  const QImage img = dirtyRenderJob.renderedImage();
+  QVERIFY( cache.hasCacheImage( layer.id() ) );
+
+  QgsMapRendererSequentialJob fullRenderJob( mapSettings );
+  fullRenderJob.start();
+  fullRenderJob.waitForFinished();
+  const QImage expected = fullRenderJob.renderedImage();
+
+  QCOMPARE( img.size(), expected.size() );
+  QCOMPARE( pixelMismatches( img, expected, 2 ), 0 );
+}
+
+void TestQgsMapRendererJob::renderProfile()
+{
+  QgsVectorLayer pointsLayer( TEST_DATA_DIR + QStringLiteral( "/points.shp" ), QStringLiteral( "points" ), QStringLiteral( "ogr" ) );
+  QVERIFY( pointsLayer.isValid() );
+
+  QgsPalLayerSettings settings;
+  settings.fieldName = QStringLiteral( "Class" );
+  QgsTextFormat format;
+  format.setFont( QgsFontUtils::getStandardTestFont( QStringLiteral( "Bold" ) ).family() );
+  format.setSize( 12 );
+  settings.setFormat( format );
+  pointsLayer.setLabeling( new QgsVectorLayerSimpleLabeling( settings ) );
+  pointsLayer.setLabelsEnabled( true );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setExtent( pointsLayer.extent().buffered( 10 ) );
+  mapSettings.setDestinationCrs( pointsLayer.crs() );
+  mapSettings.setOutputSize( QSize( 512, 512 ) );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, true );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << &pointsLayer );
+
+  // not recorded by default
+  QgsMapRendererSequentialJob job( mapSettings );
+  job.start();
+  job.waitForFinished();
+  QVERIFY( job.renderProfile().isEmpty() );
+
+  mapSettings.setFlag( QgsMapSettings::RecordProfile );
+  QgsMapRendererSequentialJob profiledJob( mapSettings );
+  profiledJob.start();
+  profiledJob.waitForFinished();
+  const QgsMapRenderProfile profile = profiledJob.renderProfile();
+
+  QCOMPARE( profile.layers().size(), 1 );
+  const QgsLayerRenderProfile layerProfile = profile.layer( pointsLayer.id() );
+  QCOMPARE( layerProfile.layerId(), pointsLayer.id() );
+  QCOMPARE( layerProfile.layerName(), QStringLiteral( "points" ) );
+  QCOMPARE( layerProfile.fetchedFeatureCount(), pointsLayer.featureCount() );
+  QCOMPARE( layerProfile.renderedFeatureCount(), pointsLayer.featureCount() );
+  QVERIFY( layerProfile.fetchTime() > 0 );
+  QVERIFY( layerProfile.paintTime() > 0 );
+  QVERIFY( layerProfile.symbolizeTime() >= 0 );
+  QVERIFY( layerProfile.labelRegistrationTime() > 0 );
+  QCOMPARE( layerProfile.symbolLayerTypes(), QStringList() << QStringLiteral( "SimpleMarker" ) );
+  QCOMPARE( layerProfile.symbolLayerPaintCount( QStringLiteral( "SimpleMarker" ) ), pointsLayer.featureCount() );
+  QGSCOMPARENEAR( layerProfile.symbolLayerTime( QStringLiteral( "SimpleMarker" ) ), layerProfile.paintTime(), 0.000001 );
+
+  QVERIFY( profile.hasLabeling() );
+  QVERIFY( profile.labeling().featureCount() > 0 );
+  QVERIFY( profile.labeling().candidateCount() >= profile.labeling().featureCount() );
+  QVERIFY( profile.labeling().labelCount() > 0 );
+  QVERIFY( profile.labeling().drawTime() > 0 );
+
+  // JSON dump
+  const QVariantMap json = QJsonDocument::fromJson( profile.toJson().toUtf8() ).toVariant().toMap();
+  const QVariantList layers = json.value( QStringLiteral( "layers" ) ).toList();
+  QCOMPARE( layers.size(), 1 );
+  const QVariantMap layer = layers.at( 0 ).toMap();
+  QCOMPARE( layer.value( QStringLiteral( "id" ) ).toString(), pointsLayer.id() );
+  QCOMPARE( layer.value( QStringLiteral( "fetched_features" ) ).toLongLong(), pointsLayer.featureCount() );
+  QCOMPARE( layer.value( QStringLiteral( "symbol_layers" ) ).toMap().value( QStringLiteral( "SimpleMarker" ) ).toMap().value( QStringLiteral( "count" ) ).toLongLong(), pointsLayer.featureCount() );
+  QCOMPARE( json.value( QStringLiteral( "labeling" ) ).toMap().value( QStringLiteral( "labels" ) ).toInt(), profile.labeling().labelCount() );
+
+  // features drawn again by the second pass of masked symbol layers are only counted once
+  format.mask().setEnabled( true );
+  format.mask().setMaskedSymbolLayers( QgsSymbolLayerReferenceList() << QgsSymbolLayerReference( pointsLayer.id(), QgsSymbolLayerId( QString(), 0 ) ) );
+  settings.setFormat( format );
+  pointsLayer.setLabeling( new QgsVectorLayerSimpleLabeling( settings ) );
+  QgsMapRendererSequentialJob maskedJob( mapSettings );
+  maskedJob.start();
+  maskedJob.waitForFinished();
+  const QgsLayerRenderProfile maskedProfile = maskedJob.renderProfile().layer( pointsLayer.id() );
+  QCOMPARE( maskedJob.renderProfile().layers().size(), 1 );
+  QCOMPARE( maskedProfile.fetchedFeatureCount(), pointsLayer.featureCount() );
+  QCOMPARE( maskedProfile.renderedFeatureCount(), pointsLayer.featureCount() );
+  QCOMPARE( maskedProfile.symbolLayerPaintCount( QStringLiteral( "SimpleMarker" ) ), pointsLayer.featureCount() );
+
+  // the rule based renderer draws the features when it is stopped
+  pointsLayer.setLabelsEnabled( false );
+  QgsRuleBasedRenderer::Rule *root = new QgsRuleBasedRenderer::Rule( nullptr );
+  root->appendChild( new QgsRuleBasedRenderer::Rule( QgsMarkerSymbol::createSimple( QgsStringMap() ), 0, 0, QStringLiteral( "\"Class\" = 'Jet'" ) ) );
+  root->appendChild( new QgsRuleBasedRenderer::Rule( QgsMarkerSymbol::createSimple( QgsStringMap() ), 0, 0, QStringLiteral( "ELSE" ) ) );
+  pointsLayer.setRenderer( new QgsRuleBasedRenderer( root ) );
+  QgsMapRendererSequentialJob ruleBasedJob( mapSettings );
+  ruleBasedJob.start();
+  ruleBasedJob.waitForFinished();
+  const QgsLayerRenderProfile ruleBasedProfile = ruleBasedJob.renderProfile().layer( pointsLayer.id() );
+  QCOMPARE( ruleBasedProfile.renderedFeatureCount(), pointsLayer.featureCount() );
+  QCOMPARE( ruleBasedProfile.symbolLayerPaintCount( QStringLiteral( "SimpleMarker" ) ), pointsLayer.featureCount() );
+  QVERIFY( ruleBasedProfile.paintTime() > 0 );
+  QVERIFY( ruleBasedProfile.symbolizeTime() >= 0 );
+}
+
+void TestQgsMapRendererJob::batchedPointMarkers()
+{
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=epsg:4326&field=cls:integer" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 40; ++i )
+  {
+    for ( int j = 0; j < 20; ++j )
+    {
+      QgsFeature f( layer.fields() );
+      // categories alternate, so that batches of consecutive features sharing a symbol are flushed often
+      f.setAttributes( QgsAttributes() << ( i * 7 + j ) % 4 );
+      f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( -40 + i * 2.03, -20 + j * 2.11 ) ) );
+      features << f;
+    }
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+  QgsCategoryList categories;
+  QgsMarkerSymbol *simple = QgsMarkerSymbol::createSimple( QVariantMap() );
+  simple->setColor( QColor( 255, 0, 0 ) );
+  simple->setSize( 4 );
+  categories << QgsRendererCategory( 0, simple, QStringLiteral( "0" ) );
+  QgsMarkerSymbol *transparent = QgsMarkerSymbol::createSimple( QVariantMap() );
+  transparent->setColor( QColor( 0, 160, 0 ) );
+  transparent->setSize( 5 );
+  transparent->setOpacity( 0.5 );
+  categories << QgsRendererCategory( 1, transparent, QStringLiteral( "1" ) );
+  QgsSvgMarkerSymbolLayer *svgLayer = new QgsSvgMarkerSymbolLayer( QgsSymbolLayerUtils::svgSymbolNameToPath( QStringLiteral( "/crosses/Star1.svg" ), QgsPathResolver() ) );
+  svgLayer->setSize( 6 );
+  svgLayer->setColor( QColor( 0, 0, 255 ) );
+  categories << QgsRendererCategory( 2, new QgsMarkerSymbol( QgsSymbolLayerList() << svgLayer ), QStringLiteral( "2" ) );
+  // several layers, drawn in turn at each point
+  QgsSimpleMarkerSymbolLayer *background = new QgsSimpleMarkerSymbolLayer( QgsSimpleMarkerSymbolLayerBase::Square, 5 );
+  background->setColor( QColor( 250, 200, 0 ) );
+  QgsSimpleMarkerSymbolLayer *foreground = new QgsSimpleMarkerSymbolLayer( QgsSimpleMarkerSymbolLayerBase::Star, 4 );
+  foreground->setColor( QColor( 100, 0, 100 ) );
+  foreground->setOffset( QPointF( 1, 1 ) );
+  categories << QgsRendererCategory( 3, new QgsMarkerSymbol( QgsSymbolLayerList() << background << foreground ), QStringLiteral( "3" ) );
+  layer.setRenderer( new QgsCategorizedSymbolRenderer( QStringLiteral( "cls" ), categories ) );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setExtent( QgsRectangle( -42, -22, 42, 22 ) );
+  mapSettings.setDestinationCrs( layer.crs() );
+  mapSettings.setOutputSize( QSize( 512, 256 ) );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, false );
+  mapSettings.setFlag( QgsMapSettings::Antialiasing );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << &layer );
+
+  QgsMapRendererSequentialJob batchedJob( mapSettings );
+  batchedJob.start();
+  batchedJob.waitForFinished();
+  const QImage img = batchedJob.renderedImage();
+
+  // rendered feature handlers keep the features on the per feature path
+  QList< QgsFeature > renderedFeatures;
+  QList< QgsGeometry > renderedGeometries;
+  TestHandler handler( renderedFeatures, renderedGeometries );
+  mapSettings.addRenderedFeatureHandler( &handler );
+  QgsMapRendererSequentialJob featureJob( mapSettings );
+  featureJob.start();
+  featureJob.waitForFinished();
+  const QImage expected = featureJob.renderedImage();
+  QCOMPARE( renderedFeatures.size(), 800 );
+
+  QImage blank( expected.size(), expected.format() );
+  blank.fill( mapSettings.backgroundColor() );
+  QVERIFY( pixelMismatches( expected, blank, 0 ) > 10000 );
+  QCOMPARE( img.size(), expected.size() );
+  QCOMPARE( pixelMismatches( img, expected, 0 ), 0 );
+}
+
+void TestQgsMapRendererJob::tileCacheRevisit()
+{
+  QgsVectorLayer layer( QStringLiteral( "Point?crs=EPSG:3857" ), QStringLiteral( "points" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 70; ++i )
+  {
+    for ( int j = 0; j < 15; ++j )
+    {
+      QgsFeature f;
+      f.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( i * 10 + 3, j * 10 + 3 ) ) );
+      features << f;
+    }
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+  QgsSimpleMarkerSymbolLayer *marker = new QgsSimpleMarkerSymbolLayer( QgsSimpleMarkerSymbolLayerBase::Circle, 3 );
+  marker->setColor( QColor( 200, 0, 0 ) );
+  layer.setRenderer( new QgsSingleSymbolRenderer( new QgsMarkerSymbol( QgsSymbolLayerList() << marker ) ) );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setDestinationCrs( layer.crs() );
+  mapSettings.setOutputSize( QSize( 300, 200 ) );
+  mapSettings.setFlag( QgsMapSettings::DrawLabeling, false );
+  mapSettings.setFlag( QgsMapSettings::Antialiasing );
+  mapSettings.setOutputDpi( 96 );
+  mapSettings.setLayers( QList< QgsMapLayer * >() << &layer );
+
+  QgsMapRendererCache cache;
+  cache.setTileCacheEnabled( true );
+  auto render = [&mapSettings, &cache]( const QgsRectangle & extent, bool useCache ) -> QImage
+  {
+    mapSettings.setExtent( extent );
+    QgsMapRendererSequentialJob job( mapSettings );
+    if ( useCache )
+      job.setCache( &cache );
+    job.start();
+    job.waitForFinished();
+    return job.renderedImage();
+  };
+
+  // an extent which is not aligned on whole pixels of the tile grid
+  const QgsRectangle extent( 10.3, 20.7, 160.3, 120.7 );
+  const QImage first = render( extent, true );
+
+  // pan away, replacing the cached layer image
+  render( QgsRectangle( 510.3, 20.7, 660.3, 120.7 ), true );
+
+  // add a feature without a repaint request, which only a new render of the layer draws
+  QgsFeature added;
+  added.setGeometry( QgsGeometry::fromPointXY( QgsPointXY( 80, 70 ) ) );
+  QVERIFY( layer.dataProvider()->addFeature( added ) );
+
+  // back to the first view: the layer image is assembled from the tiles of the first render, edges included
+  const QImage revisited = render( extent, true );
+  QCOMPARE( revisited.size(), first.size() );
+  QCOMPARE( pixelMismatches( revisited, first, 2 ), 0 );
+
+  // the added feature is at pixel 139, 101
+  const QImage rendered = render( extent, false );
+  QCOMPARE( rendered.pixelColor( 139, 101 ), QColor( 200, 0, 0 ) );
+  QCOMPARE( revisited.pixelColor( 139, 101 ), mapSettings.backgroundColor() );
+}
+
+int TestQgsMapRendererJob::pixelMismatches( const QImage &image, const QImage &expected, int tolerance )
+{
+  int mismatches = 0;
+  for ( int y = 0; y < image.height(); ++y )
+  {
+    for ( int x = 0; x < image.width(); ++x )
+    {
+      const QRgb pixel = image.pixel( x, y );
+      const QRgb expectedPixel = expected.pixel( x, y );
+      if ( std::abs( qRed( pixel ) - qRed( expectedPixel ) ) > tolerance || std::abs( qGreen( pixel ) - qGreen( expectedPixel ) ) > tolerance
+           || std::abs( qBlue( pixel ) - qBlue( expectedPixel ) ) > tolerance || std::abs( qAlpha( pixel ) - qAlpha( expectedPixel ) ) > tolerance )
+        mismatches++;
+    }
+  }
+  return mismatches;
+}
+
 bool TestQgsMapRendererJob::imageCheck( const QString &testName, const QImage &image, int mismatchCount )
 {
   mReport += "<h2>" + testName + "</h2>\n";
@@ -19,7 +19,9 @@
 #include <qgsrulebasedrenderer.h>
 
 #include <qgsapplication.h>
+#include <qgsexpressioncontext.h>
 #include <qgsreadwritecontext.h>
+#include "qgsrulebasedrendererfilterindex_p.h"
 #include <qgssymbol.h>
 #include <qgsvectorlayer.h>
 
@@ -179,6 +181,119 @@ class TestQgsRuleBasedRenderer: public QObject
 
     }
 
+    void test_filter_index()
+    {
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "int" ), QVariant::Int ) );
+      fields.append( QgsField( QStringLiteral( "str" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "dbl" ), QVariant::Double ) );
+
+      const QStringList filterStrings = QStringList()
+                                        << QStringLiteral( "\"int\" = 1" )
+                                        << QStringLiteral( "\"int\" IN (2, 3, NULL)" )
+                                        << QStringLiteral( "2 = \"int\"" )
+                                        << QStringLiteral( "\"str\" = 'a'" )
+                                        << QStringLiteral( "\"str\" IN ('b', '5')" )
+                                        << QStringLiteral( "\"dbl\" >= 1.5 AND \"dbl\" < 3" )
+                                        << QStringLiteral( "-1 > \"dbl\"" )
+                                        << QStringLiteral( "\"int\" = 4 AND \"str\" LIKE 'x%'" )
+                                        // not indexed
+                                        << QStringLiteral( "\"int\" = 1 OR \"int\" = 2" )
+                                        << QString()
+                                        << QStringLiteral( "\"str\" > 'a'" );
+
+      QgsExpressionContext context;
+      context.setFields( fields );
+      std::vector< std::unique_ptr< QgsExpression > > expressions;
+      QList< QgsExpression * > filters;
+      for ( const QString &filterString : filterStrings )
+      {
+        if ( filterString.isEmpty() )
+        {
+          filters << nullptr;
+          continue;
+        }
+        expressions.emplace_back( qgis::make_unique< QgsExpression >( filterString ) );
+        expressions.back()->prepare( &context );
+        filters << expressions.back().get();
+      }
+
+      QgsRuleBasedRendererFilterIndex index( filters, fields );
+      QCOMPARE( index.indexedFilterCount(), 8 );
+
+      // every filter which is true for a feature must be a candidate
+      const QVariantList intValues = QVariantList() << QVariant() << 1 << 2 << 3 << 4 << 5;
+      const QVariantList strValues = QVariantList() << QVariant() << QStringLiteral( "a" ) << QStringLiteral( "b" ) << QStringLiteral( "5" ) << QStringLiteral( "5.0" ) << QStringLiteral( "xy" );
+      const QVariantList dblValues = QVariantList() << QVariant() << -2.0 << 1.0 << 1.5 << 2.0 << 2.9 << 3.0;
+      for ( const QVariant &intValue : intValues )
+      {
+        for ( const QVariant &strValue : strValues )
+        {
+          for ( const QVariant &dblValue : dblValues )
+          {
+            QgsFeature f( fields );
+            f.setValid( true );
+            f.setAttributes( QgsAttributes() << intValue << strValue << dblValue );
+            context.setFeature( f );
+
+            const QVector< bool > candidates = index.candidates( f );
+            for ( int i = 0; i < filters.count(); ++i )
+            {
+              if ( filters.at( i ) && filters.at( i )->evaluate( &context ).toBool() )
+                QVERIFY2( candidates.at( i ), QStringLiteral( "%1 for %2, %3, %4" ).arg( filterStrings.at( i ), intValue.toString(), strValue.toString(), dblValue.toString() ).toLocal8Bit().constData() );
+            }
+          }
+        }
+      }
+
+      // only the filters which are not indexed remain for a feature matching no indexed filter
+      QgsFeature f( fields );
+      f.setValid( true );
+      f.setAttributes( QgsAttributes() << 5 << QStringLiteral( "c" ) << QVariant() );
+      QCOMPARE( index.candidates( f ), QVector< bool >() << false << false << false << false << false << false << false << false << true << true << true );
+
+      f.setAttributes( QgsAttributes() << 2 << QStringLiteral( "b" ) << 2.0 );
+      QCOMPARE( index.candidates( f ), QVector< bool >() << false << true << true << false << true << true << false << false << true << true << true );
+    }
+
+    void test_filter_index_render_fields()
+    {
+      // the filters are indexed against the fields passed to startRender, the expression
+      // context of the render context may not have any
+      QgsFields fields;
+      fields.append( QgsField( QStringLiteral( "name" ), QVariant::String ) );
+      fields.append( QgsField( QStringLiteral( "fld" ), QVariant::Int ) );
+
+      QgsSymbol *s1 = QgsSymbol::defaultSymbol( QgsWkbTypes::PointGeometry );
+      QgsSymbol *s2 = QgsSymbol::defaultSymbol( QgsWkbTypes::PointGeometry );
+      QgsSymbol *s3 = QgsSymbol::defaultSymbol( QgsWkbTypes::PointGeometry );
+      RRule *rootRule = new RRule( nullptr );
+      rootRule->appendChild( new RRule( s1, 0, 0, QStringLiteral( "fld = 1" ) ) );
+      rootRule->appendChild( new RRule( s2, 0, 0, QStringLiteral( "fld IN (2, 3)" ) ) );
+      rootRule->appendChild( new RRule( s3, 0, 0, QStringLiteral( "name = 'a'" ) ) );
+      QgsRuleBasedRenderer r( rootRule );
+
+      QgsRenderContext ctx;
+      r.startRender( ctx, fields );
+
+      QgsFeature f( fields );
+      f.setValid( true );
+      f.setAttributes( QgsAttributes() << QStringLiteral( "a" ) << 3 );
+      ctx.expressionContext().setFeature( f );
+      QgsSymbolList symbols = r.symbolsForFeature( f, ctx );
+      QCOMPARE( symbols.count(), 2 );
+      QCOMPARE( symbols.at( 0 ), s2 );
+      QCOMPARE( symbols.at( 1 ), s3 );
+
+      f.setAttributes( QgsAttributes() << QStringLiteral( "b" ) << 1 );
+      ctx.expressionContext().setFeature( f );
+      symbols = r.symbolsForFeature( f, ctx );
+      QCOMPARE( symbols.count(), 1 );
+      QCOMPARE( symbols.at( 0 ), s1 );
+
+      r.stopRender( ctx );
+    }
+
   private:
     void xml2domElement( const QString &testFile, QDomDocument &doc )
     {
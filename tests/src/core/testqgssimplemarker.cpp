@@ -20,6 +20,7 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QDesktopServices>
+#include <QPainter>
 
 //qgis includes...
 #include <qgsmaplayer.h>
@@ -88,6 +89,7 @@ class TestQgsSimpleMarkerSymbol : public QObject
     void colors();
     void opacityWithDataDefinedColor();
     void dataDefinedOpacity();
+    void renderPoints();
 
   private:
     bool mTestHasError =  false ;
@@ -470,6 +472,47 @@ void TestQgsSimpleMarkerSymbol::dataDefinedOpacity()
   QVERIFY( result );
 }
 
+void TestQgsSimpleMarkerSymbol::renderPoints()
+{
+  QgsSimpleMarkerSymbolLayer *marker = new QgsSimpleMarkerSymbolLayer( QgsSimpleMarkerSymbolLayerBase::Star, 6, 30 );
+  marker->setColor( QColor( 200, 100, 50 ) );
+  marker->setOffset( QPointF( 1, 2 ) );
+  QgsMarkerSymbol symbol( QgsSymbolLayerList() << marker );
+  symbol.setOpacity( 0.6 );
+
+  QPolygonF points;
+  points << QPointF( 20, 20 ) << QPointF( 35.5, 40.2 ) << QPointF( 80, 25 ) << QPointF( 60, 70 );
+
+  // drawing the points in a batch must give the same result as drawing them one by one
+  QImage batchImage( 100, 100, QImage::Format_ARGB32_Premultiplied );
+  batchImage.fill( Qt::white );
+  QImage pointImage = batchImage;
+
+  QPainter batchPainter( &batchImage );
+  QgsRenderContext context = QgsRenderContext::fromQPainter( &batchPainter );
+  symbol.startRender( context );
+  QVERIFY( symbol.canRenderPointsAsImages( context ) );
+  symbol.renderPoints( points, context );
+  symbol.stopRender( context );
+  batchPainter.end();
+
+  QPainter pointPainter( &pointImage );
+  context.setPainter( &pointPainter );
+  symbol.startRender( context );
+  for ( const QPointF &point : qgis::as_const( points ) )
+    symbol.renderPoint( point, nullptr, context );
+  symbol.stopRender( context );
+  pointPainter.end();
+
+  QCOMPARE( batchImage, pointImage );
+
+  // data defined markers are drawn one by one
+  marker->setDataDefinedProperty( QgsSymbolLayer::PropertySize, QgsProperty::fromExpression( QStringLiteral( "4 + 2" ) ) );
+  symbol.startRender( context );
+  QVERIFY( !symbol.canRenderPointsAsImages( context ) );
+  symbol.stopRender( context );
+}
+
 //
 // Private helper functions not called directly by CTest
 //
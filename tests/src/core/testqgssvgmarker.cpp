@@ -20,6 +20,7 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QDesktopServices>
+#include <QPainter>
 
 //qgis includes...
 #include <qgsmaplayer.h>
@@ -67,6 +68,7 @@ class TestQgsSvgMarkerSymbol : public QObject
     void opacityWithDataDefinedColor();
     void dataDefinedOpacity();
     void dynamicParameters();
+    void renderPoints();
 
   private:
     bool mTestHasError =  false ;
@@ -359,6 +361,58 @@ void TestQgsSvgMarkerSymbol::dynamicParameters()
   QVERIFY( result );
 }
 
+void TestQgsSvgMarkerSymbol::renderPoints()
+{
+  QgsSvgMarkerSymbolLayer *marker = new QgsSvgMarkerSymbolLayer( QgsSymbolLayerUtils::svgSymbolNameToPath( QStringLiteral( "/crosses/Star1.svg" ), QgsPathResolver() ) );
+  marker->setSize( 6 );
+  marker->setColor( QColor( 200, 100, 50 ) );
+  marker->setOffset( QPointF( 1, 2 ) );
+  QgsMarkerSymbol symbol( QgsSymbolLayerList() << marker );
+  symbol.setOpacity( 0.6 );
+
+  QPolygonF points;
+  points << QPointF( 20, 20 ) << QPointF( 35.5, 40.2 ) << QPointF( 80, 25 ) << QPointF( 60, 70 );
+
+  // drawing the points in a batch must give the same result as drawing them one by one
+  QImage batchImage( 100, 100, QImage::Format_ARGB32_Premultiplied );
+  batchImage.fill( Qt::white );
+  QImage pointImage = batchImage;
+
+  QPainter batchPainter( &batchImage );
+  QgsRenderContext context = QgsRenderContext::fromQPainter( &batchPainter );
+  context.setFlag( QgsRenderContext::RenderBlocking );
+  symbol.startRender( context );
+  QVERIFY( symbol.canRenderPointsAsImages( context ) );
+  symbol.renderPoints( points, context );
+  symbol.stopRender( context );
+  batchPainter.end();
+
+  QPainter pointPainter( &pointImage );
+  context.setPainter( &pointPainter );
+  symbol.startRender( context );
+  for ( const QPointF &point : qgis::as_const( points ) )
+    symbol.renderPoint( point, nullptr, context );
+  symbol.stopRender( context );
+  pointPainter.end();
+
+  QImage blank( 100, 100, QImage::Format_ARGB32_Premultiplied );
+  blank.fill( Qt::white );
+  QVERIFY( batchImage != blank );
+  QCOMPARE( batchImage, pointImage );
+
+  // rotated and data defined markers are drawn one by one
+  marker->setAngle( 30 );
+  symbol.startRender( context );
+  QVERIFY( !symbol.canRenderPointsAsImages( context ) );
+  symbol.stopRender( context );
+
+  marker->setAngle( 0 );
+  marker->setDataDefinedProperty( QgsSymbolLayer::PropertyFillColor, QgsProperty::fromExpression( QStringLiteral( "'red'" ) ) );
+  symbol.startRender( context );
+  QVERIFY( !symbol.canRenderPointsAsImages( context ) );
+  symbol.stopRender( context );
+}
+
 //
 // Private helper functions not called directly by CTest
 //
@@ -22,6 +22,7 @@
 #include <QDir>
 #include <QDesktopServices>
 #include <QSignalSpy>
+#include <QElapsedTimer>
 
 //qgis includes...
 #include <qgsgeometry.h>
@@ -35,6 +36,7 @@
 #include <qgsproject.h>
 #include <qgssymbol.h>
 #include <qgssinglesymbolrenderer.h>
+#include <qgssimplifymethod.h>
 //qgis test includes
 #include "qgsrenderchecker.h"
 
@@ -78,6 +80,7 @@ class TestQgsVectorLayer : public QObject
     void testAddTopologicalPoints();
     void testCopyPasteFieldConfiguration();
     void testCopyPasteFieldConfiguration_data();
+    void testSimplifiedGeometryCache();
 };
 
 void TestQgsVectorLayer::initTestCase()
@@ -412,5 +415,90 @@ void TestQgsVectorLayer::testCopyPasteFieldConfiguration()
   QCOMPARE( layer3.fieldConfigurationFlags( 0 ), categories.testFlag( QgsMapLayer::Fields ) ? QgsField::ConfigurationFlag::NotSearchable : QgsField::ConfigurationFlags() );
 }
 
+void TestQgsVectorLayer::testSimplifiedGeometryCache()
+{
+  QgsVectorLayer layer( QStringLiteral( "LineString?field=id:integer" ), QStringLiteral( "line" ), QStringLiteral( "memory" ) );
+  QVERIFY( layer.isValid() );
+
+  // a dense wavy line, 10000 vertices over 1000 map units
+  QgsPolylineXY points;
+  for ( int i = 0; i < 10000; ++i )
+    points << QgsPointXY( i * 0.1, std::sin( i * 0.1 ) );
+  QgsFeature f( layer.fields() );
+  f.setAttributes( QgsAttributes() << 7 );
+  f.setGeometry( QgsGeometry::fromPolylineXY( points ) );
+  QVERIFY( layer.dataProvider()->addFeature( f ) );
+  layer.updateExtents();
+
+  QgsVectorSimplifyMethod vectorSimplifyMethod = layer.simplifyMethod();
+  vectorSimplifyMethod.setCacheSimplifiedGeometries( true );
+  layer.setSimplifyMethod( vectorSimplifyMethod );
+
+  auto renderRequest = []( double tolerance )
+  {
+    QgsSimplifyMethod simplifyMethod;
+    simplifyMethod.setMethodType( QgsSimplifyMethod::OptimizeForRendering );
+    simplifyMethod.setTolerance( tolerance );
+    QgsFeatureRequest request;
+    request.setSimplifyMethod( simplifyMethod );
+    return request;
+  };
+
+  // the first request starts building the cache in the background and is served by the provider
+  QgsFeature feature;
+  QVERIFY( layer.getFeatures( renderRequest( 5 ) ).nextFeature( feature ) );
+
+  // wait for the cache
+  QElapsedTimer timer;
+  timer.start();
+  int vertexCount = 0;
+  do
+  {
+    QTest::qWait( 10 );
+    QVERIFY( layer.getFeatures( renderRequest( 5 ) ).nextFeature( feature ) );
+    vertexCount = feature.geometry().constGet()->nCoordinates();
+  }
+  while ( vertexCount == 10000 && timer.elapsed() < 10000 );
+
+  QVERIFY( vertexCount > 2 );
+  QVERIFY( vertexCount < 1000 );
+  QCOMPARE( feature.attribute( 0 ).toInt(), 7 );
+  QCOMPARE( feature.id(), f.id() );
+
+  // finer tolerances use a more detailed level
+  QVERIFY( layer.getFeatures( renderRequest( 0.5 ) ).nextFeature( feature ) );
+  QVERIFY( feature.geometry().constGet()->nCoordinates() > vertexCount );
+  QVERIFY( feature.geometry().constGet()->nCoordinates() < 10000 );
+
+  // tolerances below the finest level, exact requests and unsimplified requests go to the provider
+  QVERIFY( layer.getFeatures( renderRequest( 0.001 ) ).nextFeature( feature ) );
+  QCOMPARE( feature.geometry().constGet()->nCoordinates(), 10000 );
+  QVERIFY( layer.getFeatures( renderRequest( 5 ).setFlags( QgsFeatureRequest::ExactIntersect ).setFilterRect( QgsRectangle( 0, -1, 10, 1 ) ) ).nextFeature( feature ) );
+  QCOMPARE( feature.geometry().constGet()->nCoordinates(), 10000 );
+  QVERIFY( layer.getFeatures().nextFeature( feature ) );
+  QCOMPARE( feature.geometry().constGet()->nCoordinates(), 10000 );
+
+  // filter rect is applied to the original bounding boxes
+  QVERIFY( !layer.getFeatures( renderRequest( 5 ).setFilterRect( QgsRectangle( 0, 5, 10, 6 ) ) ).nextFeature( feature ) );
+  QVERIFY( layer.getFeatures( renderRequest( 5 ).setFilterRect( QgsRectangle( 0, -0.5, 10, 0.5 ) ) ).nextFeature( feature ) );
+
+  // edits invalidate the cache
+  QVERIFY( layer.startEditing() );
+  QVERIFY( layer.changeAttributeValue( f.id(), 0, 8 ) );
+  QVERIFY( layer.commitChanges() );
+  QVERIFY( layer.getFeatures( renderRequest( 5 ) ).nextFeature( feature ) );
+  QCOMPARE( feature.attribute( 0 ).toInt(), 8 );
+
+  // setting is persisted with the layer style
+  QDomDocument doc( QStringLiteral( "qgis" ) );
+  QString errorMsg;
+  QgsReadWriteContext context;
+  layer.exportNamedStyle( doc, errorMsg, context, QgsMapLayer::Rendering );
+  QgsVectorLayer layer2( QStringLiteral( "LineString" ), QStringLiteral( "line2" ), QStringLiteral( "memory" ) );
+  QVERIFY( !layer2.simplifyMethod().cacheSimplifiedGeometries() );
+  QVERIFY( layer2.importNamedStyle( doc, errorMsg ) );
+  QVERIFY( layer2.simplifyMethod().cacheSimplifiedGeometries() );
+}
+
 QGSTEST_MAIN( TestQgsVectorLayer )
 #include "testqgsvectorlayer.moc"
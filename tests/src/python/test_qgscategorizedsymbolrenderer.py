@@ -39,7 +39,7 @@ from qgis.core import (QgsCategorizedSymbolRenderer,
                        QgsRectangle,
                        QgsRenderContext
                        )
-from qgis.PyQt.QtCore import Qt, QVariant, QSize
+from qgis.PyQt.QtCore import Qt, QVariant, QSize, NULL
 from qgis.PyQt.QtGui import QColor
 from qgis.PyQt.QtXml import QDomDocument
 
@@ -386,6 +386,47 @@ class TestQgsCategorizedSymbolRenderer(unittest.TestCase):
 
         renderer.stopRender(context)
 
+    def testOriginalSymbolForFeatureIntegerValues(self):
+        # integer values are looked up by number
+        fields = QgsFields()
+        fields.append(QgsField('x', QVariant.Int))
+
+        renderer = QgsCategorizedSymbolRenderer()
+        renderer.setClassAttribute('x')
+
+        symbol_a = createMarkerSymbol()
+        symbol_a.setColor(QColor(255, 0, 0))
+        renderer.addCategory(QgsRendererCategory(1, symbol_a, 'a'))
+        symbol_b = createMarkerSymbol()
+        symbol_b.setColor(QColor(0, 255, 0))
+        renderer.addCategory(QgsRendererCategory('2', symbol_b, 'b'))
+        symbol_c = createMarkerSymbol()
+        symbol_c.setColor(QColor(0, 0, 255))
+        renderer.addCategory(QgsRendererCategory([3, -4], symbol_c, 'c'))
+        symbol_d = createMarkerSymbol()
+        symbol_d.setColor(QColor(255, 0, 255))
+        renderer.addCategory(QgsRendererCategory('05', symbol_d, 'd'))
+        default_symbol = createMarkerSymbol()
+        default_symbol.setColor(QColor(255, 255, 255))
+        renderer.addCategory(QgsRendererCategory('', default_symbol, 'default'))
+
+        context = QgsRenderContext()
+        renderer.startRender(context, fields)
+
+        f = QgsFeature(fields)
+        for value, color in ((1, QColor(255, 0, 0)),
+                             (2, QColor(0, 255, 0)),
+                             (3, QColor(0, 0, 255)),
+                             (-4, QColor(0, 0, 255)),
+                             (5, QColor(255, 255, 255)),
+                             ('05', QColor(255, 0, 255)),
+                             (NULL, QColor(255, 255, 255))):
+            f.setAttributes([value])
+            symbol = renderer.originalSymbolForFeature(f, context)
+            self.assertEqual(symbol.color(), color, value)
+
+        renderer.stopRender(context)
+
     def testLegendKeysWhileCounting(self):
         # test determining legend keys for features, while counting features
         fields = QgsFields()
@@ -0,0 +1,159 @@
+# -*- coding: utf-8 -*-
+"""QGIS Unit tests for QgsHeatmapRenderer
+
+.. note:: This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+"""
+__author__ = 'QGIS contributors'
+__date__ = '16/03/2021'
+__copyright__ = 'Copyright 2021, The QGIS Project'
+
+import qgis  # NOQA
+
+import math
+
+from qgis.PyQt.QtCore import QSize, QThreadPool
+from qgis.PyQt.QtGui import QColor, QImage, QPainter
+
+from qgis.core import (QgsVectorLayer,
+                       QgsFeature,
+                       QgsGeometry,
+                       QgsPointXY,
+                       QgsRectangle,
+                       QgsMapSettings,
+                       QgsMapRendererSequentialJob,
+                       QgsHeatmapRenderer,
+                       QgsGradientColorRamp,
+                       QgsUnitTypes)
+from qgis.testing import start_app, unittest
+
+start_app()
+
+
+class TestQgsHeatmapRenderer(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.max_thread_count = QThreadPool.globalInstance().maxThreadCount()
+
+    def setUp(self):
+        # the values are accumulated in bands of rows on several threads
+        QThreadPool.globalInstance().setMaxThreadCount(4)
+
+    def tearDown(self):
+        QThreadPool.globalInstance().setMaxThreadCount(self.max_thread_count)
+
+    def createLayer(self, count):
+        layer = QgsVectorLayer('Point?field=weight:double', 'points', 'memory')
+        self.assertTrue(layer.isValid())
+        features = []
+        for i in range(count):
+            f = QgsFeature(layer.fields())
+            f.setGeometry(QgsGeometry.fromPointXY(QgsPointXY((i * 37) % 197 + 0.25 * (i % 3) + 1,
+                                                             (i * 53) % 193 + 0.4 * (i % 2) + 2)))
+            f.setAttributes([0.5 + (i % 7) * 0.75])
+            features.append(f)
+        self.assertTrue(layer.dataProvider().addFeatures(features))
+        return layer
+
+    def mapSettings(self, layer):
+        settings = QgsMapSettings()
+        settings.setOutputSize(QSize(200, 200))
+        settings.setOutputDpi(96)
+        settings.setExtent(QgsRectangle(0, 0, 200, 200))
+        settings.setBackgroundColor(QColor(255, 255, 255))
+        settings.setLayers([layer])
+        return settings
+
+    def createRenderer(self, radius, quality, weight_expression=''):
+        renderer = QgsHeatmapRenderer()
+        renderer.setRadius(radius)
+        renderer.setRadiusUnit(QgsUnitTypes.RenderPixels)
+        renderer.setRenderQuality(quality)
+        renderer.setWeightExpression(weight_expression)
+        renderer.setColorRamp(QgsGradientColorRamp(QColor(255, 255, 255), QColor(200, 0, 50)))
+        return renderer
+
+    def expectedImage(self, layer, settings, radius, quality, use_weights):
+        """
+        Renders the heatmap by adding the kernel of each point after the other to the values
+        """
+        width = settings.outputSize().width() // quality
+        height = settings.outputSize().height() // quality
+        radius_pixels = int(math.floor(radius / quality + 0.5))
+        values = [0.0] * (width * height)
+        maximum = 0.0
+        map_to_pixel = settings.mapToPixel()
+        for f in layer.getFeatures():
+            weight = f['weight'] if use_weights else 1.0
+            pixel = map_to_pixel.transform(f.geometry().asPoint())
+            point_x = int(pixel.x() / quality)
+            point_y = int(pixel.y() / quality)
+            for x in range(max(point_x - radius_pixels, 0), min(point_x + radius_pixels, width)):
+                for y in range(max(point_y - radius_pixels, 0), min(point_y + radius_pixels, height)):
+                    distance_squared = (point_x - x) ** 2 + (point_y - y) ** 2
+                    if distance_squared > radius_pixels * radius_pixels:
+                        continue
+                    score = weight * (1.0 - (math.sqrt(distance_squared) / radius_pixels) ** 2) ** 2
+                    index = y * width + x
+                    values[index] += score
+                    maximum = max(maximum, values[index])
+
+        ramp = self.createRenderer(radius, quality).colorRamp()
+        image = QImage(width, height, QImage.Format_ARGB32)
+        for y in range(height):
+            for x in range(width):
+                value = values[y * width + x]
+                image.setPixel(x, y, ramp.color(min(value / maximum, 1.0) if value > 0 else 0).rgba())
+        if quality > 1:
+            image = image.scaled(settings.outputSize().width(), settings.outputSize().height())
+
+        expected = QImage(settings.outputSize(), QImage.Format_ARGB32)
+        expected.fill(settings.backgroundColor())
+        painter = QPainter(expected)
+        painter.drawImage(0, 0, image)
+        painter.end()
+        return expected
+
+    def checkRender(self, layer, radius, quality, use_weights):
+        layer.setRenderer(self.createRenderer(radius, quality, 'weight' if use_weights else ''))
+        settings = self.mapSettings(layer)
+
+        job = QgsMapRendererSequentialJob(settings)
+        job.start()
+        job.waitForFinished()
+        rendered = job.renderedImage().convertToFormat(QImage.Format_ARGB32)
+
+        expected = self.expectedImage(layer, settings, radius, quality, use_weights)
+        self.assertEqual(rendered.size(), expected.size())
+        mismatches = 0
+        for y in range(expected.height()):
+            for x in range(expected.width()):
+                if rendered.pixel(x, y) != expected.pixel(x, y):
+                    mismatches += 1
+        self.assertEqual(mismatches, 0)
+
+    def testRadius(self):
+        layer = self.createLayer(60)
+        self.checkRender(layer, 6, 1, False)
+        self.checkRender(layer, 17, 1, False)
+
+    def testRenderQuality(self):
+        layer = self.createLayer(60)
+        self.checkRender(layer, 12, 2, False)
+        self.checkRender(layer, 12, 3, False)
+
+    def testWeightField(self):
+        layer = self.createLayer(60)
+        self.checkRender(layer, 10, 1, True)
+
+    def testManyPoints(self):
+        # more points than are added to the values in one batch
+        layer = self.createLayer(20000)
+        self.checkRender(layer, 4, 1, True)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -16,11 +16,25 @@ from qgis.core import (QgsMapRendererCache,
                        QgsRectangle,
                        QgsVectorLayer,
                        QgsProject,
-                       QgsMapToPixel)
+                       QgsMapToPixel,
+                       QgsMapSettings,
+                       QgsHeatmapRenderer,
+                       QgsFeature,
+                       QgsGeometry,
+                       QgsPointXY,
+                       QgsField,
+                       QgsMarkerSymbol,
+                       QgsSingleSymbolRenderer,
+                       QgsRenderContext,
+                       QgsProperty,
+                       QgsSymbolLayer,
+                       QgsExpressionContext,
+                       QgsExpressionContextScope)
 from qgis.testing import start_app, unittest
-from qgis.PyQt.QtCore import QCoreApplication
-from qgis.PyQt.QtGui import QImage
+from qgis.PyQt.QtCore import QCoreApplication, QTemporaryDir, QVariant
+from qgis.PyQt.QtGui import QImage, QColor
 from time import sleep
+import os
 start_app()
 
 
@@ -313,6 +327,260 @@ class TestQgsMapRendererCache(unittest.TestCase):
         cache.setCacheImage('im1', im, [])
         self.assertEqual(cache.cacheImage('im1').width(), 202)
 
+    def testTileCache(self):
+        """
+        Test assembling layer images from cached tiles
+        """
+        cache = QgsMapRendererCache()
+        self.assertFalse(cache.isTileCacheEnabled())
+        cache.setTileCacheEnabled(True)
+        self.assertTrue(cache.isTileCacheEnabled())
+        cache.setMaximumTileCacheMemory(16 * 1024 * 1024)
+        self.assertEqual(cache.maximumTileCacheMemory(), 16 * 1024 * 1024)
+
+        layer = QgsVectorLayer("Point?field=fldtxt:string",
+                               "layer1", "memory")
+
+        def render(xmin, ymax, color):
+            # 600x600 pixels image at 1 map unit per pixel
+            extent = QgsRectangle(xmin, ymax - 600, xmin + 600, ymax)
+            mtp = QgsMapToPixel(1, xmin + 300, ymax - 300, 600, 600, 0)
+            im = QImage(600, 600, QImage.Format_ARGB32_Premultiplied)
+            im.fill(color)
+            # mark each pixel with its map position
+            for x in range(0, 600, 50):
+                im.setPixelColor(x, 10, QColor(int(xmin + x) % 256, 0, 0))
+            return extent, mtp, im
+
+        extent, mtp, im = render(0, 0, QColor(0, 255, 0))
+        cache.updateParameters(extent, mtp)
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+        cache.setTileCacheImage(layer, 'scope', im, extent, mtp)
+
+        # a view entirely inside the stored tiles (columns 0-1, rows 0-1) can be assembled
+        cache.updateParameters(QgsRectangle(10, -500, 500, -10), QgsMapToPixel(1, 255, -255, 490, 490, 0))
+        assembled = cache.tileCacheImage('scope')
+        self.assertFalse(assembled.isNull())
+        self.assertEqual(assembled.width(), 490)
+        self.assertEqual(assembled.pixelColor(40, 0), im.pixelColor(50, 10))
+        self.assertEqual(assembled.pixelColor(100, 100), QColor(0, 255, 0))
+
+        # other scopes, scales and partially covered areas are not cached
+        self.assertTrue(cache.tileCacheImage('other').isNull())
+        cache.updateParameters(QgsRectangle(10, -1000, 1000, -10), QgsMapToPixel(2, 505, -505, 495, 495, 0))
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+        cache.updateParameters(QgsRectangle(300, -500, 900, -10), QgsMapToPixel(1, 600, -255, 600, 490, 0))
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+
+        # clearing the cache removes tiles from memory
+        cache.updateParameters(QgsRectangle(10, -500, 500, -10), QgsMapToPixel(1, 255, -255, 490, 490, 0))
+        cache.setTileCacheImage(layer, 'scope', im, extent, mtp)
+        self.assertFalse(cache.tileCacheImage('scope').isNull())
+        cache.clear()
+        cache.updateParameters(QgsRectangle(10, -500, 500, -10), QgsMapToPixel(1, 255, -255, 490, 490, 0))
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+
+        # a layer repaint removes its tiles
+        cache.setTileCacheImage(layer, 'scope', im, extent, mtp)
+        self.assertFalse(cache.tileCacheImage('scope').isNull())
+        layer.triggerRepaint()
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+
+    def testTileCacheMargin(self):
+        """
+        Test that tiles near the image edges, which may miss symbols of features outside the image, are not stored
+        """
+        cache = QgsMapRendererCache()
+        cache.setTileCacheEnabled(True)
+
+        extent = QgsRectangle(0, -600, 600, 0)
+        mtp = QgsMapToPixel(1, 300, -300, 600, 600, 0)
+        im = QImage(600, 600, QImage.Format_ARGB32_Premultiplied)
+        im.fill(QColor(0, 255, 0))
+        cache.updateParameters(extent, mtp)
+        # with a 50 pixels margin, only the tile of column 1 and row 1 is stored
+        cache.setTileCacheImage(None, 'scope', im, extent, mtp, 50)
+
+        cache.updateParameters(QgsRectangle(10, -500, 500, -10), QgsMapToPixel(1, 255, -255, 490, 490, 0))
+        self.assertTrue(cache.tileCacheImage('scope').isNull())
+        cache.updateParameters(QgsRectangle(260, -500, 500, -260), QgsMapToPixel(1, 380, -380, 240, 240, 0))
+        self.assertFalse(cache.tileCacheImage('scope').isNull())
+
+        # margins of layer symbols
+        layer = QgsVectorLayer("Point?field=fldtxt:string",
+                               "layer1", "memory")
+        symbol = QgsMarkerSymbol.createSimple({'size': '10', 'size_unit': 'Pixel'})
+        layer.setRenderer(QgsSingleSymbolRenderer(symbol))
+        context = QgsRenderContext()
+        margin = QgsMapRendererCache.tileCacheMargin(layer, context)
+        self.assertGreaterEqual(margin, 10)
+
+        # data defined sizes can't be estimated
+        symbol.setDataDefinedSize(QgsProperty.fromField('size'))
+        layer.setRenderer(QgsSingleSymbolRenderer(symbol))
+        self.assertEqual(QgsMapRendererCache.tileCacheMargin(layer, context), -1)
+
+    def testTileCacheDisk(self):
+        """
+        Test reusing tiles stored on disk
+        """
+        temp_dir = QTemporaryDir()
+        cache = QgsMapRendererCache()
+        cache.setTileCacheEnabled(True)
+        cache.setTileCacheDirectory(temp_dir.path())
+        self.assertEqual(cache.tileCacheDirectory(), temp_dir.path())
+
+        extent = QgsRectangle(0, -512, 512, 0)
+        mtp = QgsMapToPixel(1, 256, -256, 512, 512, 0)
+        im = QImage(512, 512, QImage.Format_ARGB32_Premultiplied)
+        im.fill(QColor(255, 0, 0))
+        cache.updateParameters(extent, mtp)
+        cache.setTileCacheImage(None, 'scope', im, extent, mtp)
+        # tiles are written in the background
+        cache.waitForTileWrites()
+
+        # a new cache, e.g. in a later session, reuses the tiles
+        cache2 = QgsMapRendererCache()
+        cache2.setTileCacheEnabled(True)
+        cache2.setTileCacheDirectory(temp_dir.path())
+        cache2.updateParameters(extent, mtp)
+        assembled = cache2.tileCacheImage('scope')
+        self.assertFalse(assembled.isNull())
+        self.assertEqual(assembled.pixelColor(300, 300), QColor(255, 0, 0))
+
+        # least recently used tiles are evicted to fit the disk size limit
+        cache2.setMaximumTileCacheDiskSize(1)
+        cache3 = QgsMapRendererCache()
+        cache3.setTileCacheEnabled(True)
+        cache3.setTileCacheDirectory(temp_dir.path())
+        cache3.updateParameters(extent, mtp)
+        self.assertTrue(cache3.tileCacheImage('scope').isNull())
+
+    def testTileCacheScope(self):
+        """
+        Test tile scopes of layers
+        """
+        layer = QgsVectorLayer("Point?field=fldtxt:string",
+                               "layer1", "memory")
+        cache = QgsMapRendererCache()
+        settings = QgsMapSettings()
+        scope = cache.tileCacheScope(layer, settings)
+        self.assertTrue(scope)
+        self.assertEqual(cache.tileCacheScope(layer, settings), scope)
+
+        # scope depends on the render settings
+        settings.setOutputDpi(300)
+        dpi_scope = cache.tileCacheScope(layer, settings)
+        self.assertNotEqual(dpi_scope, scope)
+
+        # and on the layer style
+        layer.setRenderer(QgsSingleSymbolRenderer(QgsMarkerSymbol.createSimple({'color': '255,0,0'})))
+        style_scope = cache.tileCacheScope(layer, settings)
+        self.assertNotEqual(style_scope, dpi_scope)
+        self.assertEqual(cache.tileCacheScope(layer, settings), style_scope)
+        layer.setOpacity(0.5)
+        self.assertNotEqual(cache.tileCacheScope(layer, settings), style_scope)
+
+        # extent dependent renderers can't be split into tiles
+        layer.setRenderer(QgsHeatmapRenderer())
+        self.assertFalse(cache.tileCacheScope(layer, settings))
+
+        # nor styles using the visible extent
+        symbol = QgsMarkerSymbol.createSimple({'color': '255,0,0'})
+        symbol.symbolLayer(0).setDataDefinedProperty(QgsSymbolLayer.PropertyFillColor, QgsProperty.fromExpression("if(x(@map_extent_center) > 0, 'red', 'blue')"))
+        layer.setRenderer(QgsSingleSymbolRenderer(symbol))
+        self.assertFalse(cache.tileCacheScope(layer, settings))
+
+        # scope depends on the values of the variables used by the style
+        symbol.symbolLayer(0).setDataDefinedProperty(QgsSymbolLayer.PropertyFillColor, QgsProperty.fromExpression("var('fill')"))
+        layer.setRenderer(QgsSingleSymbolRenderer(symbol))
+        variables = QgsExpressionContextScope()
+        variables.setVariable('fill', 'red')
+        settings.setExpressionContext(QgsExpressionContext([variables]))
+        red_scope = cache.tileCacheScope(layer, settings)
+        self.assertTrue(red_scope)
+        variables = QgsExpressionContextScope()
+        variables.setVariable('fill', 'blue')
+        settings.setExpressionContext(QgsExpressionContext([variables]))
+        self.assertNotEqual(cache.tileCacheScope(layer, settings), red_scope)
+
+    def testTileCacheScopeDataTimestamp(self):
+        """
+        Test that tile scopes of file layers depend on the file modification time
+        """
+        temp_dir = QTemporaryDir()
+        path = os.path.join(temp_dir.path(), 'points.geojson')
+        with open(path, 'w') as f:
+            f.write('{"type": "FeatureCollection", "features": [{"type": "Feature", "properties": {}, "geometry": {"type": "Point", "coordinates": [1, 2]}}]}')
+        os.utime(path, (1000000000, 1000000000))
+        layer = QgsVectorLayer(path, 'points', 'ogr')
+        self.assertTrue(layer.isValid())
+        settings = QgsMapSettings()
+        scope = QgsMapRendererCache().tileCacheScope(layer, settings)
+        self.assertTrue(scope)
+        self.assertEqual(QgsMapRendererCache().tileCacheScope(layer, settings), scope)
+
+        # e.g. the data modified outside of QGIS between two sessions
+        os.utime(path, (1100000000, 1100000000))
+        self.assertNotEqual(QgsMapRendererCache().tileCacheScope(layer, settings), scope)
+
+    def testDirtyExtentAfterEdits(self):
+        """
+        Test that layer images are kept with a dirty extent after edits
+        """
+        cache = QgsMapRendererCache()
+        layer = QgsVectorLayer("Point?field=fldtxt:string",
+                               "layer1", "memory")
+        im = QImage(200, 200, QImage.Format_RGB32)
+        cache.setCacheImage(layer.id(), im, [layer])
+        cache.setCacheImage('labels', im, [layer])
+        self.assertTrue(layer.startEditing())
+
+        f = QgsFeature(layer.fields())
+        f.setGeometry(QgsGeometry.fromPointXY(QgsPointXY(5, 6)))
+        self.assertTrue(layer.addFeature(f))
+        self.assertFalse(cache.hasCacheImage(layer.id()))
+        self.assertTrue(cache.hasDirtyCacheImage(layer.id()))
+        self.assertEqual(cache.dirtyExtent(layer.id()), QgsRectangle(5, 6, 5, 6))
+
+        # the repaint following the edits keeps the layer image, but not other images depending on the layer
+        layer.triggerRepaint()
+        self.assertTrue(cache.hasDirtyCacheImage(layer.id()))
+        self.assertFalse(cache.hasCacheImage('labels'))
+
+        # further edits extend the dirty extent
+        self.assertTrue(layer.changeGeometry(f.id(), QgsGeometry.fromPointXY(QgsPointXY(7, 8))))
+        self.assertEqual(cache.dirtyExtent(layer.id()), QgsRectangle(5, 6, 7, 8))
+        layer.triggerRepaint()
+        self.assertTrue(cache.hasDirtyCacheImage(layer.id()))
+
+        # other repaints remove the image
+        layer.triggerRepaint()
+        self.assertFalse(cache.hasDirtyCacheImage(layer.id()))
+        self.assertTrue(cache.cacheImage(layer.id()).isNull())
+
+        # as do edits of unknown extent
+        cache.setCacheImage(layer.id(), im, [layer])
+        self.assertTrue(layer.addAttribute(QgsField('new1', QVariant.String)))
+        self.assertFalse(cache.hasDirtyCacheImage(layer.id()))
+        self.assertTrue(cache.cacheImage(layer.id()).isNull())
+
+        # edits of provider features only report their ids, the image is kept
+        self.assertTrue(layer.commitChanges())
+        fid = next(layer.getFeatures()).id()
+        cache.setCacheImage(layer.id(), im, [layer])
+        self.assertTrue(layer.startEditing())
+        self.assertTrue(layer.changeAttributeValue(fid, 0, 'a'))
+        self.assertTrue(cache.hasDirtyCacheImage(layer.id()))
+        self.assertTrue(cache.dirtyExtent(layer.id()).isNull())
+        self.assertEqual(cache.dirtyFeatureIds(layer.id()), {fid})
+
+        # a style change after edits is not taken for the edits, its repaint removes the image
+        layer.setOpacity(0.5)
+        layer.triggerRepaint()
+        self.assertFalse(cache.hasDirtyCacheImage(layer.id()))
+        self.assertTrue(cache.cacheImage(layer.id()).isNull())
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -13,12 +13,14 @@ __copyright__ = 'Copyright 2016, The QGIS Project'
 import qgis  # NOQA
 
 from qgis.PyQt.QtCore import QVariant
+from qgis.PyQt.QtTest import QSignalSpy
 
 from qgis.core import (QgsVectorLayer,
                        QgsFeature,
                        QgsGeometry,
                        QgsPointXY,
-                       QgsField)
+                       QgsField,
+                       QgsRectangle)
 from qgis.testing import start_app, unittest
 
 start_app()
@@ -391,6 +393,57 @@ class TestQgsVectorLayerEditBuffer(unittest.TestCase):
         self.assertEqual(layer.editBuffer().addedAttributes()[0].name(), 'new1')
         self.assertEqual(layer.editBuffer().addedAttributes()[1].name(), 'new2')
 
+    def testFeaturesEdited(self):
+        # test the extents reported for edits
+        layer = createLayerWithOnePoint()
+        fid = next(layer.getFeatures()).id()
+        self.assertTrue(layer.startEditing())
+        spy = QSignalSpy(layer.featuresEdited)
+
+        # the old geometry of an unmodified feature is not fetched from the provider, only its id is reported
+        self.assertTrue(layer.changeAttributeValue(fid, 1, 4))
+        self.assertEqual(len(spy), 1)
+        self.assertTrue(spy[-1][0].isNull())
+        self.assertEqual(spy[-1][1], {fid})
+        layer.undoStack().undo()
+
+        # geometry change covers the new geometry, and the old one through the provider feature id
+        layer.changeGeometry(fid, QgsGeometry.fromPointXY(QgsPointXY(10, 20)))
+        self.assertEqual(len(spy), 3)
+        self.assertEqual(spy[-1][0], QgsRectangle(10, 20, 10, 20))
+        self.assertEqual(spy[-1][1], {fid})
+
+        # undo reports the same extent
+        layer.undoStack().undo()
+        self.assertEqual(len(spy), 4)
+        self.assertEqual(spy[-1][0], QgsRectangle(10, 20, 10, 20))
+        self.assertEqual(spy[-1][1], {fid})
+        layer.undoStack().redo()
+
+        # added and deleted features
+        f = QgsFeature(layer.fields())
+        f.setGeometry(QgsGeometry.fromPointXY(QgsPointXY(5, 6)))
+        f.setAttributes(["test2", 456])
+        self.assertTrue(layer.addFeature(f))
+        self.assertEqual(spy[-1][0], QgsRectangle(5, 6, 5, 6))
+        self.assertTrue(layer.deleteFeature(f.id()))
+        self.assertEqual(spy[-1][0], QgsRectangle(5, 6, 5, 6))
+
+        self.assertFalse(spy[-1][1])
+
+        # the geometry of a modified feature is known from the edit buffer
+        self.assertTrue(layer.changeAttributeValue(fid, 1, 5))
+        self.assertEqual(spy[-1][0], QgsRectangle(10, 20, 10, 20))
+        self.assertFalse(spy[-1][1])
+        self.assertTrue(layer.deleteFeature(fid))
+        self.assertEqual(spy[-1][0], QgsRectangle(10, 20, 10, 20))
+        self.assertFalse(spy[-1][1])
+
+        # unknown extent when fields change
+        layer.addAttribute(QgsField('new1', QVariant.String))
+        self.assertTrue(spy[-1][0].isNull())
+        self.assertFalse(spy[-1][1])
+
 
 if __name__ == '__main__':
     unittest.main()